@@ -0,0 +1,68 @@
+// binlog.h - Deferred binary logging for the flashing hot paths
+#ifndef BINLOG_H
+#define BINLOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#define BINLOG_RING_ENTRIES     256     // 20 bytes each
+#define BINLOG_DRAIN_PRIORITY   1       // Just above idle: runs when flashing waits
+#define BINLOG_DRAIN_STACK      3072
+
+// Message ids index the format table in binlog.c - append only, the host
+// decodes dumps by id. Every argument is a uint32_t, at most three.
+typedef enum {
+    BINLOG_FLASH_ERASE_PAGE = 0,    // addr
+    BINLOG_FLASH_ERASE_DONE,        // elapsed ms (debug)
+    BINLOG_FLASH_ERASED,            // addr
+    BINLOG_FLASH_WRITE,             // size, addr
+    BINLOG_FLASH_WRITE_DONE,        // bytes, ms, KB/s
+    BINLOG_UPLOAD_ERASE,            // page addr
+    BINLOG_UPLOAD_WRITE,            // len, addr
+    BINLOG_HEX_EXT_LIN_ADDR,        // addr
+    BINLOG_HEX_EXT_SEG_ADDR,        // addr
+    BINLOG_MSG_COUNT
+} binlog_msg_t;
+
+typedef struct {
+    uint32_t timestamp_ms;          // esp_log_timestamp() when recorded
+    uint16_t id;                    // binlog_msg_t
+    uint16_t reserved;
+    uint32_t args[3];
+} binlog_entry_t;
+
+typedef struct {
+    uint32_t recorded;
+    uint32_t dropped;               // Lost to a full ring
+    uint32_t drained;               // Formatted by the drain task or read by the host
+    uint32_t pending;
+    uint64_t write_ns;              // Time spent inside binlog_write()
+    uint64_t drain_ns;              // Time the drain task spent formatting
+    bool deferred;
+} binlog_stats_t;
+
+// Create the drain task. Before this (or if it fails) messages are
+// formatted immediately, as ESP_LOGx would.
+esp_err_t binlog_init(void);
+
+// Record one message: id and raw arguments into the ring, no formatting.
+// Never blocks; drops the message if the ring is full, and skips it when
+// its tag's log level would not print it. In immediate mode it formats
+// and logs right away - the cost binlog saves.
+void binlog_write(binlog_msg_t id, uint32_t a0, uint32_t a1, uint32_t a2);
+
+// Deferred (default) or immediate formatting, for A/B timing of a flash
+void binlog_set_deferred(bool deferred);
+
+// Take up to max entries off the ring, oldest first (host-side decoding)
+int binlog_read(binlog_entry_t *entries, int max);
+
+void binlog_get_stats(binlog_stats_t *stats);
+
+// Format string, tag and ESP log level of a message id (NULL if unknown)
+const char *binlog_format(binlog_msg_t id);
+const char *binlog_tag(binlog_msg_t id);
+int binlog_level(binlog_msg_t id);
+
+#endif // BINLOG_H
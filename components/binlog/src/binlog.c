@@ -0,0 +1,176 @@
+// binlog.c - Deferred binary logging for the flashing hot paths
+//
+// An ESP_LOGI with printf formatting costs tens of microseconds of
+// formatting plus the UART write, and the hot paths log per page. Here the
+// caller only stores a message id and its raw arguments in a RAM ring; a
+// task just above idle formats them when the flashing loop is waiting on
+// the NVMC or the network, or the host reads them raw from /binlog.
+#include "binlog.h"
+#include "esp_log.h"
+#include "esp_cpu.h"
+#include "esp_rom_sys.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "BINLOG";
+
+typedef struct {
+    esp_log_level_t level;
+    const char *tag;
+    const char *format;
+} binlog_format_t;
+
+// Indexed by binlog_msg_t; tags are those of the code that logged before
+static const binlog_format_t formats[BINLOG_MSG_COUNT] = {
+    [BINLOG_FLASH_ERASE_PAGE] = { ESP_LOG_INFO,  "SWD_FLASH",  "Erasing page at 0x%08" PRIX32 },
+    [BINLOG_FLASH_ERASE_DONE] = { ESP_LOG_DEBUG, "SWD_FLASH",  "Erase complete after %" PRIu32 " ms" },
+    [BINLOG_FLASH_ERASED]     = { ESP_LOG_INFO,  "SWD_FLASH",  "Page at 0x%08" PRIX32 " erased successfully" },
+    [BINLOG_FLASH_WRITE]      = { ESP_LOG_INFO,  "SWD_FLASH",  "Writing %" PRIu32 " bytes to 0x%08" PRIX32 },
+    [BINLOG_FLASH_WRITE_DONE] = { ESP_LOG_INFO,  "SWD_FLASH",  "Write complete: %" PRIu32 " bytes in %" PRIu32 " ms (%" PRIu32 " KB/s)" },
+    [BINLOG_UPLOAD_ERASE]     = { ESP_LOG_INFO,  "WEB_UPLOAD", "Erasing page 0x%08" PRIX32 },
+    [BINLOG_UPLOAD_WRITE]     = { ESP_LOG_INFO,  "WEB_UPLOAD", "Writing %" PRIu32 " bytes to 0x%08" PRIX32 },
+    [BINLOG_HEX_EXT_LIN_ADDR] = { ESP_LOG_INFO,  "HEX_PARSER", "Extended linear address: 0x%08" PRIX32 },
+    [BINLOG_HEX_EXT_SEG_ADDR] = { ESP_LOG_INFO,  "HEX_PARSER", "Extended segment address: 0x%08" PRIX32 },
+};
+
+static binlog_entry_t ring[BINLOG_RING_ENTRIES];
+static uint32_t ring_head = 0;          // Next write
+static uint32_t ring_tail = 0;          // Next read
+static portMUX_TYPE ring_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static binlog_stats_t stats = { .deferred = true };
+static TaskHandle_t drain_task_handle = NULL;
+
+// Cycles are cheap to read but DFS changes what they are worth, so they are
+// converted at the clock they were counted at
+static uint64_t cycles_to_ns(uint32_t cycles) {
+    return (uint64_t)cycles * 1000ULL / esp_rom_get_cpu_ticks_per_us();
+}
+
+static void log_entry(const binlog_entry_t *entry, bool late) {
+    const binlog_format_t *f = &formats[entry->id];
+    char line[128];
+    snprintf(line, sizeof(line), f->format, entry->args[0], entry->args[1], entry->args[2]);
+    if (late) {
+        ESP_LOG_LEVEL(f->level, f->tag, "[%" PRIu32 "] %s", entry->timestamp_ms, line);
+    } else {
+        ESP_LOG_LEVEL(f->level, f->tag, "%s", line);
+    }
+}
+
+void binlog_write(binlog_msg_t id, uint32_t a0, uint32_t a1, uint32_t a2) {
+    if (id >= BINLOG_MSG_COUNT) {
+        return;
+    }
+    // Same filter as ESP_LOGx: below the build's or the tag's level the
+    // message would never print, so it is not worth a ring slot
+    const binlog_format_t *f = &formats[id];
+    if (f->level > LOG_LOCAL_LEVEL || esp_log_level_get(f->tag) < f->level) {
+        return;
+    }
+    uint32_t start = esp_cpu_get_cycle_count();
+
+    binlog_entry_t entry = {
+        .timestamp_ms = esp_log_timestamp(),
+        .id = id,
+        .args = { a0, a1, a2 }
+    };
+
+    if (!stats.deferred || !drain_task_handle) {
+        log_entry(&entry, false);
+    } else {
+        bool wake = false;
+        portENTER_CRITICAL(&ring_lock);
+        if (ring_head - ring_tail < BINLOG_RING_ENTRIES) {
+            // The drain task empties the ring before it waits again, so only
+            // the first entry into an empty ring needs to wake it
+            wake = ring_head == ring_tail;
+            ring[ring_head % BINLOG_RING_ENTRIES] = entry;
+            ring_head++;
+        } else {
+            stats.dropped++;
+        }
+        portEXIT_CRITICAL(&ring_lock);
+        if (wake) {
+            xTaskNotifyGive(drain_task_handle);
+        }
+    }
+
+    portENTER_CRITICAL(&ring_lock);
+    stats.recorded++;
+    stats.write_ns += cycles_to_ns(esp_cpu_get_cycle_count() - start);
+    portEXIT_CRITICAL(&ring_lock);
+}
+
+int binlog_read(binlog_entry_t *entries, int max) {
+    int count = 0;
+    portENTER_CRITICAL(&ring_lock);
+    while (count < max && ring_tail != ring_head) {
+        entries[count++] = ring[ring_tail % BINLOG_RING_ENTRIES];
+        ring_tail++;
+    }
+    stats.drained += count;
+    portEXIT_CRITICAL(&ring_lock);
+    return count;
+}
+
+// Sleeps on its notification, not a timer, so an idle binlog never wakes
+// the chip out of light sleep
+static void drain_task(void *arg) {
+    binlog_entry_t batch[8];
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        int count;
+        while ((count = binlog_read(batch, 8)) > 0) {
+            uint32_t start = esp_cpu_get_cycle_count();
+            for (int i = 0; i < count; i++) {
+                log_entry(&batch[i], true);
+            }
+            uint64_t ns = cycles_to_ns(esp_cpu_get_cycle_count() - start);
+            portENTER_CRITICAL(&ring_lock);
+            stats.drain_ns += ns;
+            portEXIT_CRITICAL(&ring_lock);
+        }
+    }
+}
+
+esp_err_t binlog_init(void) {
+    if (drain_task_handle) {
+        return ESP_OK;
+    }
+    if (xTaskCreate(drain_task, "binlog", BINLOG_DRAIN_STACK, NULL,
+                    BINLOG_DRAIN_PRIORITY, &drain_task_handle) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create drain task - logging immediately");
+        drain_task_handle = NULL;
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+void binlog_set_deferred(bool deferred) {
+    stats.deferred = deferred;
+    ESP_LOGI(TAG, "Hot path logging %s", deferred ? "deferred" : "immediate");
+}
+
+void binlog_get_stats(binlog_stats_t *out) {
+    portENTER_CRITICAL(&ring_lock);
+    *out = stats;
+    out->pending = ring_head - ring_tail;
+    portEXIT_CRITICAL(&ring_lock);
+}
+
+const char *binlog_format(binlog_msg_t id) {
+    return id < BINLOG_MSG_COUNT ? formats[id].format : NULL;
+}
+
+const char *binlog_tag(binlog_msg_t id) {
+    return id < BINLOG_MSG_COUNT ? formats[id].tag : NULL;
+}
+
+int binlog_level(binlog_msg_t id) {
+    return id < BINLOG_MSG_COUNT ? formats[id].level : ESP_LOG_NONE;
+}
@@ -0,0 +1,35 @@
+// golden.h - Golden copy of the target flash with page-level self-repair
+#ifndef GOLDEN_H
+#define GOLDEN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+typedef struct {
+    bool enabled;
+    uint32_t pages;             // Pages in the golden manifest
+    uint32_t cursor;            // Next manifest entry to check
+    uint32_t checks;            // Wake checks run (lifetime, RTC)
+    uint32_t pages_checked;
+    uint32_t mismatches;        // Pages found differing from golden
+    uint32_t repaired;          // Pages rewritten and verified
+    uint32_t repair_failures;
+    uint32_t last_check_us;     // Duration of the latest check
+} golden_info_t;
+
+// Upload pipeline hooks: begin clears the page set, note adds the pages a
+// write touched, commit reads them back from the target (still connected)
+// and makes them the golden image
+void golden_capture_begin(void);
+void golden_capture_note(uint32_t addr, uint32_t len);
+esp_err_t golden_capture_commit(void);
+
+// Every GOLDEN_CHECK_EVERY_N_WAKES wakes: hash the next window of golden
+// pages on the target and reflash the ones that differ. Takes the SWD
+// interface for the duration - call before any job can start.
+esp_err_t golden_check_on_wake(uint32_t wake_count);
+
+void golden_get_info(golden_info_t *info);
+
+#endif // GOLDEN_H
@@ -0,0 +1,560 @@
+// golden.c - Golden copy of the target flash with page-level self-repair
+//
+// A bad OTA from the mesh side occasionally leaves the radio with a corrupt
+// image. After each successful upload the pages the job wrote are read back
+// from the target and kept as the golden image: page contents in SPIFFS,
+// each file named after the SHA-256 of its contents (so identical pages are
+// stored once and re-uploading the same firmware writes nothing), plus a
+// manifest mapping page address to hash.
+//
+// Every GOLDEN_CHECK_EVERY_N_WAKES wakes the next GOLDEN_PAGES_PER_CHECK
+// manifest pages are read from the running target and hashed here; the
+// cursor lives in RTC memory, so the check walks the image round-robin and
+// each wake stays short. Only pages that differ are rewritten from the
+// cache, verified, and the target reset. When everything matches the core
+// is neither halted nor reset.
+#include "golden.h"
+#include "config.h"
+#include "swd_core.h"
+#include "swd_mem.h"
+#include "swd_flash.h"
+#include "power_mgmt.h"
+#include "power_energy.h"
+#include "telemetry.h"
+#include "mbedtls/sha256.h"
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+static const char *TAG = "GOLDEN";
+
+#define GOLDEN_MAGIC            0x474F4C44  // "GOLD"
+#define GOLDEN_RTC_MAGIC        0x47434B52  // "GCKR"
+
+// SPIFFS is mounted by main at /storage; object names must stay under 32
+// characters, so files carry a 96-bit hash prefix (the manifest has it all)
+#define GOLDEN_DIR              "/storage/g"
+#define GOLDEN_MANIFEST         "/storage/golden.idx"
+#define GOLDEN_MANIFEST_TMP     "/storage/golden.tmp"
+#define GOLDEN_NAME_BYTES       12
+
+#define GOLDEN_MAX_PAGES        (NRF52_FLASH_SIZE / NRF52_FLASH_PAGE_SIZE)
+#define GOLDEN_PAGE_WORDS       (NRF52_FLASH_PAGE_SIZE / 4)
+#define GOLDEN_HEX_BYTES_PER_PAGE (NRF52_FLASH_PAGE_SIZE * 11 / 4)  // 16 data bytes per 44-char record
+
+typedef struct {
+    uint32_t addr;
+    uint8_t sha[32];
+} golden_entry_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t count;
+    uint32_t crc;           // CRC32 over the entries
+} golden_manifest_hdr_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t cursor;
+    uint32_t checks;
+    uint32_t pages_checked;
+    uint32_t mismatches;
+    uint32_t repaired;
+    uint32_t repair_failures;
+    uint32_t last_check_us;
+} golden_rtc_t;
+
+RTC_DATA_ATTR static golden_rtc_t rtc_golden;
+
+static uint32_t capture_pages[GOLDEN_MAX_PAGES / 32];
+
+static const swd_config_t golden_swd_cfg = {
+    .pin_swclk = SWD_PIN_SWCLK,
+    .pin_swdio = SWD_PIN_SWDIO,
+    .pin_reset = SWD_PIN_RESET,
+    .swclk_khz = SWD_TARGET_KHZ
+};
+
+static void golden_rtc_validate(void) {
+    if (rtc_golden.magic != GOLDEN_RTC_MAGIC) {
+        memset(&rtc_golden, 0, sizeof(rtc_golden));
+        rtc_golden.magic = GOLDEN_RTC_MAGIC;
+    }
+}
+
+static void page_hash(const uint32_t *words, uint8_t sha[32]) {
+    mbedtls_sha256((const unsigned char *)words, NRF52_FLASH_PAGE_SIZE, sha, 0);
+}
+
+static void page_path(const uint8_t sha[32], char *path, size_t len) {
+    int n = snprintf(path, len, GOLDEN_DIR "/");
+    for (int i = 0; i < GOLDEN_NAME_BYTES && n + 2 < (int)len; i++) {
+        n += snprintf(path + n, len - n, "%02x", sha[i]);
+    }
+}
+
+// ============================================================================
+// Manifest and page cache
+// ============================================================================
+
+static esp_err_t manifest_read_header(FILE *f, golden_manifest_hdr_t *hdr) {
+    if (fread(hdr, sizeof(*hdr), 1, f) != 1 ||
+        hdr->magic != GOLDEN_MAGIC || hdr->count > GOLDEN_MAX_PAGES) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return ESP_OK;
+}
+
+// Caller frees *entries
+static esp_err_t manifest_load(golden_entry_t **entries, uint32_t *count) {
+    FILE *f = fopen(GOLDEN_MANIFEST, "rb");
+    if (!f) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    golden_manifest_hdr_t hdr;
+    esp_err_t ret = manifest_read_header(f, &hdr);
+    golden_entry_t *list = NULL;
+
+    if (ret == ESP_OK) {
+        list = malloc(hdr.count * sizeof(golden_entry_t) + 1);  // +1: count may be 0
+        if (!list) {
+            ret = ESP_ERR_NO_MEM;
+        } else if (fread(list, sizeof(golden_entry_t), hdr.count, f) != hdr.count ||
+                   esp_rom_crc32_le(0, (const uint8_t *)list,
+                                    hdr.count * sizeof(golden_entry_t)) != hdr.crc) {
+            ret = ESP_ERR_INVALID_CRC;
+        }
+    }
+    fclose(f);
+
+    if (ret != ESP_OK) {
+        free(list);
+        ESP_LOGW(TAG, "Manifest unusable: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    *entries = list;
+    *count = hdr.count;
+    return ESP_OK;
+}
+
+static uint32_t manifest_count(void) {
+    FILE *f = fopen(GOLDEN_MANIFEST, "rb");
+    if (!f) {
+        return 0;
+    }
+    golden_manifest_hdr_t hdr;
+    esp_err_t ret = manifest_read_header(f, &hdr);
+    fclose(f);
+    return ret == ESP_OK ? hdr.count : 0;
+}
+
+// Written beside the old one and swapped in, so power loss leaves one intact
+static esp_err_t manifest_save(const golden_entry_t *entries, uint32_t count) {
+    golden_manifest_hdr_t hdr = {
+        .magic = GOLDEN_MAGIC,
+        .count = count,
+        .crc = esp_rom_crc32_le(0, (const uint8_t *)entries, count * sizeof(golden_entry_t)),
+    };
+
+    FILE *f = fopen(GOLDEN_MANIFEST_TMP, "wb");
+    if (!f) {
+        return ESP_FAIL;
+    }
+    bool ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1 &&
+              fwrite(entries, sizeof(golden_entry_t), count, f) == count;
+    ok = (fclose(f) == 0) && ok;
+
+    // SPIFFS rename does not replace an existing file
+    if (ok) {
+        unlink(GOLDEN_MANIFEST);
+        ok = rename(GOLDEN_MANIFEST_TMP, GOLDEN_MANIFEST) == 0;
+    }
+    if (!ok) {
+        unlink(GOLDEN_MANIFEST_TMP);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t page_store(const uint32_t *words, const uint8_t sha[32]) {
+    char path[48];
+    page_path(sha, path, sizeof(path));
+
+    struct stat st;
+    if (stat(path, &st) == 0 && st.st_size == NRF52_FLASH_PAGE_SIZE) {
+        return ESP_OK;  // Same contents already cached
+    }
+
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        return ESP_FAIL;
+    }
+    bool ok = fwrite(words, NRF52_FLASH_PAGE_SIZE, 1, f) == 1;
+    ok = (fclose(f) == 0) && ok;
+    if (!ok) {
+        unlink(path);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+// Also re-hashes the file - never repair a target from a damaged cache
+static esp_err_t page_load(const uint8_t sha[32], uint32_t *words) {
+    char path[48];
+    page_path(sha, path, sizeof(path));
+
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    bool ok = fread(words, NRF52_FLASH_PAGE_SIZE, 1, f) == 1;
+    fclose(f);
+    if (!ok) {
+        return ESP_FAIL;
+    }
+
+    uint8_t actual[32];
+    page_hash(words, actual);
+    return memcmp(actual, sha, sizeof(actual)) == 0 ? ESP_OK : ESP_ERR_INVALID_CRC;
+}
+
+static bool name_in_manifest(const char *name, const golden_entry_t *entries, uint32_t count) {
+    uint8_t prefix[GOLDEN_NAME_BYTES];
+    if (strlen(name) != GOLDEN_NAME_BYTES * 2) {
+        return true;  // Not ours - leave it alone
+    }
+    for (int i = 0; i < GOLDEN_NAME_BYTES; i++) {
+        char hex[3] = { name[2 * i], name[2 * i + 1], 0 };
+        prefix[i] = (uint8_t)strtoul(hex, NULL, 16);
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        if (memcmp(entries[i].sha, prefix, GOLDEN_NAME_BYTES) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Drop cached pages the new manifest no longer references
+static void cache_prune(const golden_entry_t *entries, uint32_t count) {
+    DIR *dir = opendir(GOLDEN_DIR);
+    if (!dir) {
+        return;
+    }
+
+    uint32_t removed = 0;
+    struct dirent *de;
+    while ((de = readdir(dir)) != NULL) {
+        const char *slash = strrchr(de->d_name, '/');
+        const char *name = slash ? slash + 1 : de->d_name;
+        if (!name_in_manifest(name, entries, count)) {
+            char path[48];
+            // SPIFFS object names are at most 32 bytes
+            snprintf(path, sizeof(path), GOLDEN_DIR "/%.32s", name);
+            if (unlink(path) == 0) {
+                removed++;
+            }
+        }
+    }
+    closedir(dir);
+
+    if (removed > 0) {
+        ESP_LOGI(TAG, "Pruned %" PRIu32 " stale cached pages", removed);
+    }
+}
+
+// ============================================================================
+// Capture
+// ============================================================================
+
+void golden_capture_begin(void) {
+    memset(capture_pages, 0, sizeof(capture_pages));
+}
+
+void golden_capture_note(uint32_t addr, uint32_t len) {
+    if (len == 0) {
+        return;
+    }
+    uint32_t first = addr / NRF52_FLASH_PAGE_SIZE;
+    uint32_t last = (addr + len - 1) / NRF52_FLASH_PAGE_SIZE;
+    for (uint32_t page = first; page <= last && page < GOLDEN_MAX_PAGES; page++) {
+        capture_pages[page / 32] |= 1UL << (page % 32);
+    }
+}
+
+esp_err_t golden_capture_commit(void) {
+    if (!GOLDEN_ENABLE) {
+        return ESP_OK;
+    }
+
+    uint32_t count = 0;
+    for (uint32_t page = 0; page < GOLDEN_MAX_PAGES; page++) {
+        if (capture_pages[page / 32] & (1UL << (page % 32))) {
+            count++;
+        }
+    }
+    if (count == 0) {
+        return ESP_OK;
+    }
+
+    golden_entry_t *entries = malloc(count * sizeof(golden_entry_t));
+    uint32_t *words = malloc(NRF52_FLASH_PAGE_SIZE);
+    if (!entries || !words) {
+        free(entries);
+        free(words);
+        return ESP_ERR_NO_MEM;
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t ret = ESP_OK;
+    uint32_t n = 0;
+
+    for (uint32_t page = 0; page < GOLDEN_MAX_PAGES && ret == ESP_OK; page++) {
+        if (!(capture_pages[page / 32] & (1UL << (page % 32)))) {
+            continue;
+        }
+        entries[n].addr = page * NRF52_FLASH_PAGE_SIZE;
+        ret = swd_mem_read_block32(entries[n].addr, words, GOLDEN_PAGE_WORDS);
+        if (ret == ESP_OK) {
+            page_hash(words, entries[n].sha);
+            ret = page_store(words, entries[n].sha);
+        }
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Capture failed at 0x%08" PRIX32 ": %s",
+                     entries[n].addr, esp_err_to_name(ret));
+        }
+        n++;
+        vTaskDelay(1);
+    }
+
+    if (ret == ESP_OK) {
+        ret = manifest_save(entries, n);
+    }
+    if (ret == ESP_OK) {
+        cache_prune(entries, n);
+        golden_rtc_validate();
+        rtc_golden.cursor = 0;
+        ESP_LOGI(TAG, "Golden image: %" PRIu32 " pages captured in %" PRId64 " ms",
+                 n, (esp_timer_get_time() - start_us) / 1000);
+    } else {
+        // The previous golden image (if any) stays in force
+        ESP_LOGW(TAG, "Golden image not updated: %s", esp_err_to_name(ret));
+    }
+
+    free(entries);
+    free(words);
+    return ret;
+}
+
+// ============================================================================
+// Wake check and repair
+// ============================================================================
+
+static esp_err_t golden_connect(void) {
+    esp_err_t ret = swd_init(&golden_swd_cfg);
+    if (ret == ESP_OK) {
+        ret = swd_connect();
+    }
+    if (ret == ESP_OK) {
+        ret = swd_mem_init();
+    }
+    return ret;
+}
+
+// Stop the firmware so it cannot run from (or write to) pages being replaced
+static esp_err_t golden_halt_target(void) {
+    esp_err_t ret = swd_mem_write32(DHCSR_ADDR, DHCSR_DBGKEY | DHCSR_C_DEBUGEN | DHCSR_C_HALT);
+    for (int i = 0; i < 10 && ret == ESP_OK; i++) {
+        uint32_t dhcsr = 0;
+        ret = swd_mem_read32(DHCSR_ADDR, &dhcsr);
+        if (ret == ESP_OK && (dhcsr & DHCSR_S_HALT)) {
+            return ESP_OK;
+        }
+        vTaskDelay(1);
+    }
+    return ret == ESP_OK ? ESP_ERR_TIMEOUT : ret;
+}
+
+static esp_err_t golden_repair_page(const golden_entry_t *entry, uint32_t *words) {
+    esp_err_t ret = page_load(entry->sha, words);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Cached copy of 0x%08" PRIX32 " unusable: %s",
+                 entry->addr, esp_err_to_name(ret));
+        return ret;
+    }
+
+    // Erased flash already reads 0xFF - only program up to the last data word
+    uint32_t len = NRF52_FLASH_PAGE_SIZE;
+    while (len > 0 && words[len / 4 - 1] == 0xFFFFFFFF) {
+        len -= 4;
+    }
+
+    if (power_sag_guard() == ESP_ERR_TIMEOUT) {
+        ESP_LOGW(TAG, "Battery still sagging - continuing throttled");
+    }
+
+    ret = swd_flash_erase_page(entry->addr);
+    if (ret == ESP_OK && len > 0) {
+        ret = swd_flash_write_buffer(entry->addr, (const uint8_t *)words, len);
+    }
+    if (ret == ESP_OK) {
+        ret = swd_mem_read_block32(entry->addr, words, GOLDEN_PAGE_WORDS);
+    }
+    if (ret == ESP_OK) {
+        uint8_t actual[32];
+        page_hash(words, actual);
+        if (memcmp(actual, entry->sha, sizeof(actual)) != 0) {
+            ret = ESP_ERR_INVALID_CRC;
+        }
+    }
+    return ret;
+}
+
+static esp_err_t golden_repair(const golden_entry_t *entries, const uint32_t *bad,
+                               uint32_t n_bad, uint32_t *words) {
+    float predicted_mah = 0.0f;
+    float margin_mah = 0.0f;
+    if (power_energy_check_job(n_bad * GOLDEN_HEX_BYTES_PER_PAGE,
+                               &predicted_mah, &margin_mah) != ESP_OK) {
+        ESP_LOGW(TAG, "Repair postponed: needs ~%.1f mAh, %.1f mAh available",
+                 predicted_mah, margin_mah);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t ret = golden_halt_target();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot halt target: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    for (uint32_t i = 0; i < n_bad; i++) {
+        const golden_entry_t *entry = &entries[bad[i]];
+        esp_err_t page_ret = golden_repair_page(entry, words);
+        if (page_ret == ESP_OK) {
+            rtc_golden.repaired++;
+            ESP_LOGW(TAG, "Page 0x%08" PRIX32 " restored from golden image", entry->addr);
+        } else {
+            rtc_golden.repair_failures++;
+            ESP_LOGE(TAG, "Page 0x%08" PRIX32 " repair failed: %s",
+                     entry->addr, esp_err_to_name(page_ret));
+            ret = page_ret;
+        }
+    }
+    power_sag_end();
+    return ret;
+}
+
+esp_err_t golden_check_on_wake(uint32_t wake_count) {
+    if (!GOLDEN_ENABLE || GOLDEN_CHECK_EVERY_N_WAKES == 0 ||
+        wake_count % GOLDEN_CHECK_EVERY_N_WAKES != 0) {
+        return ESP_OK;
+    }
+    if (!power_target_is_on()) {
+        return ESP_OK;
+    }
+    if (swd_is_initialized()) {
+        return ESP_ERR_INVALID_STATE;  // A job owns the interface
+    }
+
+    golden_entry_t *entries = NULL;
+    uint32_t count = 0;
+    esp_err_t ret = manifest_load(&entries, &count);
+    if (ret == ESP_ERR_NOT_FOUND || (ret == ESP_OK && count == 0)) {
+        free(entries);
+        return ESP_OK;  // No golden image captured yet
+    }
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    golden_rtc_validate();
+    uint32_t window = count < GOLDEN_PAGES_PER_CHECK ? count : GOLDEN_PAGES_PER_CHECK;
+    uint32_t start = rtc_golden.cursor % count;
+    uint32_t *words = malloc(NRF52_FLASH_PAGE_SIZE);
+    uint32_t *bad = malloc(window * sizeof(uint32_t));
+    if (!words || !bad) {
+        free(entries);
+        free(words);
+        free(bad);
+        return ESP_ERR_NO_MEM;
+    }
+
+    swd_busy_begin();
+    energy_category_t previous = power_energy_enter(ENERGY_SWD_JOB);
+    int64_t start_us = esp_timer_get_time();
+
+    uint32_t checked = 0;
+    uint32_t n_bad = 0;
+    ret = golden_connect();
+
+    for (uint32_t i = 0; i < window && ret == ESP_OK; i++) {
+        uint32_t idx = (start + i) % count;
+        ret = swd_mem_read_block32(entries[idx].addr, words, GOLDEN_PAGE_WORDS);
+        if (ret != ESP_OK) {
+            break;
+        }
+        checked++;
+
+        uint8_t actual[32];
+        page_hash(words, actual);
+        if (memcmp(actual, entries[idx].sha, sizeof(actual)) != 0) {
+            ESP_LOGW(TAG, "Page 0x%08" PRIX32 " differs from golden image", entries[idx].addr);
+            bad[n_bad++] = idx;
+        }
+    }
+
+    rtc_golden.pages_checked += checked;
+    rtc_golden.mismatches += n_bad;
+
+    if (ret == ESP_OK && n_bad > 0) {
+        telemetry_record(TELEM_GOLDEN_MISMATCH, n_bad);
+        ret = golden_repair(entries, bad, n_bad, words);
+        swd_flash_reset_and_run();
+    }
+    swd_shutdown();
+
+    // Anything left unrepaired is looked at again on the next check
+    if (ret == ESP_OK) {
+        rtc_golden.cursor = (start + window) % count;
+    }
+    rtc_golden.checks++;
+    rtc_golden.last_check_us = (uint32_t)(esp_timer_get_time() - start_us);
+
+    power_energy_enter(previous);
+    swd_busy_end();
+
+    ESP_LOGI(TAG, "Checked %" PRIu32 "/%" PRIu32 " golden pages from #%" PRIu32 " in %" PRIu32 " ms: %" PRIu32 " differing (%s)",
+             checked, count, start, rtc_golden.last_check_us / 1000, n_bad,
+             esp_err_to_name(ret));
+
+    free(entries);
+    free(words);
+    free(bad);
+    return ret;
+}
+
+void golden_get_info(golden_info_t *info) {
+    memset(info, 0, sizeof(*info));
+    info->enabled = GOLDEN_ENABLE;
+    info->pages = manifest_count();
+    if (rtc_golden.magic == GOLDEN_RTC_MAGIC) {
+        info->cursor = rtc_golden.cursor;
+        info->checks = rtc_golden.checks;
+        info->pages_checked = rtc_golden.pages_checked;
+        info->mismatches = rtc_golden.mismatches;
+        info->repaired = rtc_golden.repaired;
+        info->repair_failures = rtc_golden.repair_failures;
+        info->last_check_us = rtc_golden.last_check_us;
+    }
+}
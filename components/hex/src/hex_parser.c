@@ -1,5 +1,6 @@
 #include "hex_parser.h"
 #include "esp_log.h"
+#include "binlog.h"
 #include <string.h>
 #include <stdlib.h>
 
@@ -121,7 +122,7 @@ esp_err_t hex_stream_parse(hex_stream_parser_t *parser, const uint8_t *data, siz
                             break;
                             
                         case HEX_TYPE_EOF:
-                            ESP_LOGI(TAG, "EOF record found. Lines: %lu, Data bytes: %lu",
+                            ESP_LOGI(TAG, "EOF record found. Lines: %" PRIu32 ", Data bytes: %" PRIu32,
                                     parser->line_count, parser->data_bytes);
                             if (parser->callback) {
                                 parser->callback(&record, 0, parser->user_ctx);
@@ -131,15 +132,13 @@ esp_err_t hex_stream_parse(hex_stream_parser_t *parser, const uint8_t *data, siz
                         case HEX_TYPE_EXT_LIN_ADDR:
                             parser->extended_addr = ((uint32_t)record.data[0] << 24) | 
                                                    ((uint32_t)record.data[1] << 16);
-                            ESP_LOGI(TAG, "Extended linear address: 0x%08lX", 
-                                    parser->extended_addr);
+                            binlog_write(BINLOG_HEX_EXT_LIN_ADDR, parser->extended_addr, 0, 0);
                             break;
                             
                         case HEX_TYPE_EXT_SEG_ADDR:
                             parser->segment_addr = (((uint32_t)record.data[0] << 8) | 
                                                    record.data[1]) << 4;
-                            ESP_LOGI(TAG, "Extended segment address: 0x%08lX", 
-                                    parser->segment_addr);
+                            binlog_write(BINLOG_HEX_EXT_SEG_ADDR, parser->segment_addr, 0, 0);
                             break;
                             
                         case HEX_TYPE_START_LIN_ADDR:
@@ -147,7 +146,7 @@ esp_err_t hex_stream_parse(hex_stream_parser_t *parser, const uint8_t *data, siz
                             break;
                     }
                 } else {
-                    ESP_LOGE(TAG, "Failed to parse line %lu: %s", 
+                    ESP_LOGE(TAG, "Failed to parse line %" PRIu32 ": %s", 
                             parser->line_count + 1, (char*)parser->line_buffer);
                 }
                 
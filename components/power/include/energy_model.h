@@ -0,0 +1,74 @@
+// energy_model.h - Per-state energy accounting
+//
+// Integrates time spent in each power state and converts it to charge with
+// configurable current coefficients. The ESP32 is always in exactly one of
+// the exclusive states; the nRF52 is a parallel load that is either on or
+// off. Time comes from the caller's clock, so nothing here touches hardware:
+// host/energy_sim.c runs simulated sleep schedules through the same code.
+#ifndef ENERGY_MODEL_H
+#define ENERGY_MODEL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum {
+    // ESP32 states (exclusive)
+    ENERGY_DEEP_SLEEP = 0,
+    ENERGY_BOOT,                // Reset/wake until WiFi is attempted
+    ENERGY_WIFI_CONNECT,        // Scan, associate, DHCP (and failed attempts)
+    ENERGY_ACTIVE_IDLE,         // Web server up, waiting for a client
+    ENERGY_SWD_JOB,             // Flashing, erase, SWD checks
+    // nRF52 load (parallel)
+    ENERGY_NRF52_ON,
+    ENERGY_NRF52_OFF,
+    ENERGY_CAT_COUNT
+} energy_category_t;
+
+#define ENERGY_ESP_STATE_COUNT  (ENERGY_SWD_JOB + 1)
+
+// Average supply current per category, in microamps
+typedef struct {
+    uint32_t current_ua[ENERGY_CAT_COUNT];
+} energy_coeffs_t;
+
+// Running totals; plain data so it can live in RTC memory
+typedef struct {
+    uint64_t time_ms[ENERGY_CAT_COUNT];
+    uint64_t since_ms;          // Caller's clock at the last accrual
+    uint8_t state;              // Current ESP32 state
+    uint8_t nrf52_on;
+} energy_account_t;
+
+typedef struct {
+    uint64_t observed_ms;       // Total ESP32 time accounted
+    double mah[ENERGY_CAT_COUNT];
+    double mah_per_day[ENERGY_CAT_COUNT];
+    double total_mah;
+    double total_mah_per_day;
+    double avg_current_ma;
+} energy_report_t;
+
+// Clear all totals and start in the given state at now_ms
+void energy_account_reset(energy_account_t *acc, energy_category_t state,
+                          bool nrf52_on, uint64_t now_ms);
+
+// Book time elapsed since the last accrual to the current state and nRF52 load
+void energy_account_sync(energy_account_t *acc, uint64_t now_ms);
+
+// Accrue, then switch state / nRF52 load. Returns the previous ESP32 state.
+energy_category_t energy_account_set_state(energy_account_t *acc,
+                                           energy_category_t state, uint64_t now_ms);
+void energy_account_set_nrf52(energy_account_t *acc, bool on, uint64_t now_ms);
+
+// Book time the clock did not see (e.g. deep sleep) to an ESP32 state,
+// with the nRF52 load in its current state
+void energy_account_add(energy_account_t *acc, energy_category_t state,
+                        uint64_t duration_ms);
+
+// Charge per category and per day of observed time
+void energy_model_report(const energy_account_t *acc, const energy_coeffs_t *coeffs,
+                         energy_report_t *report);
+
+const char* energy_category_name(energy_category_t cat);
+
+#endif // ENERGY_MODEL_H
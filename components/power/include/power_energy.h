@@ -0,0 +1,39 @@
+// power_energy.h - Device energy accountant (RTC-persisted energy_model)
+#ifndef POWER_ENERGY_H
+#define POWER_ENERGY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "energy_model.h"
+
+// Validate RTC totals and start booking this wake as ENERGY_BOOT
+void power_energy_init(bool nrf52_on);
+
+// Switch ESP32 state; returns the previous one so callers can restore it
+energy_category_t power_energy_enter(energy_category_t state);
+
+// nRF52 load switched (called from power_target_on/off)
+void power_energy_set_nrf52(bool on);
+
+// Book time up to now (call before a reboot)
+void power_energy_sync(void);
+
+// Book the upcoming deep sleep (call right before esp_deep_sleep_start)
+void power_energy_sleep(uint64_t sleep_us);
+
+// Book deep sleep found out about after the wake (wake stub slots)
+void power_energy_book_sleep(uint64_t sleep_us);
+
+// Totals with the configured ENERGY_*_UA coefficients
+void power_energy_get_report(energy_report_t *report);
+void power_energy_get_coeffs(energy_coeffs_t *coeffs);
+uint32_t power_energy_battery_capacity_mah(void);
+
+// Pre-flight check for an SWD job moving payload_bytes of hex (0 for jobs
+// without a payload): ESP_ERR_INVALID_STATE if its predicted charge exceeds
+// what the battery holds above ENERGY_JOB_RESERVE_PCT. Without a battery
+// reading the job is allowed and margin is -1. Either pointer may be NULL.
+esp_err_t power_energy_check_job(uint32_t payload_bytes, float *predicted_mah, float *margin_mah);
+
+#endif // POWER_ENERGY_H
@@ -0,0 +1,60 @@
+// power_history.h - Battery and wake history ring buffer (RTC memory + NVS)
+#ifndef POWER_HISTORY_H
+#define POWER_HISTORY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// How a wake ended (3 bits in the packed record)
+typedef enum {
+    HISTORY_OUTCOME_UNKNOWN = 0,
+    HISTORY_OUTCOME_NO_WIFI,            // Connect failed, went back to sleep
+    HISTORY_OUTCOME_IDLE,               // WiFi up, nobody used the web interface
+    HISTORY_OUTCOME_CLIENT,             // WiFi up, a client loaded the web interface
+    HISTORY_OUTCOME_LOW_BATTERY,        // Critical battery, WiFi skipped
+    HISTORY_OUTCOME_WIFI_LOST,          // Link dropped during the session
+    HISTORY_OUTCOME_SCHEDULED_REBOOT    // Absolute uptime timer fired
+} history_outcome_t;
+
+// WiFi mode used during the wake (2 bits)
+typedef enum {
+    HISTORY_WIFI_NONE = 0,
+    HISTORY_WIFI_NORMAL,
+    HISTORY_WIFI_LR
+} history_wifi_mode_t;
+
+// Decoded history record
+typedef struct {
+    float voltage;              // Battery voltage at end of wake (10 mV resolution)
+    uint32_t awake_sec;         // Time awake (exact below 128 s, 32 s steps above)
+    uint32_t sleep_sec;         // Sleep interval chosen afterwards (5 min resolution)
+    uint8_t wake_reason;        // wake_reason_t
+    uint8_t wifi_mode;          // history_wifi_mode_t
+    uint8_t outcome;            // history_outcome_t
+} history_entry_t;
+
+// Validate the RTC ring, restoring it from NVS after power loss
+esp_err_t power_history_init(void);
+
+// Annotate the current wake; the last value set is what gets recorded
+void power_history_set_outcome(history_outcome_t outcome);
+void power_history_set_wifi_mode(history_wifi_mode_t mode);
+
+// Append a record for the current wake (call once, just before sleep/reboot)
+void power_history_record(float voltage, uint32_t sleep_sec);
+
+// Write the ring to NVS now (normally done every POWER_HISTORY_NVS_INTERVAL records)
+esp_err_t power_history_flush(void);
+
+// Read access; index 0 is the oldest record
+uint16_t power_history_count(void);
+uint16_t power_history_capacity(void);
+bool power_history_get(uint16_t index, history_entry_t *entry);
+
+// Name helpers for the web API
+const char* power_history_outcome_name(uint8_t outcome);
+const char* power_history_wifi_mode_name(uint8_t mode);
+const char* power_history_wake_reason_name(uint8_t reason);
+
+#endif // POWER_HISTORY_H
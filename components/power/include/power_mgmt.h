@@ -55,9 +55,16 @@ typedef struct {
     bool is_critical;
     uint32_t samples_count;
     float voltage_avg;
+    uint32_t age_ms;            // Time since the last sampling burst
 } battery_status_t;
 
+// Battery is sampled in short bursts (median + IIR filtered), on demand and
+// from a scheduled event; both getters return the cached value and never
+// block on the ADC
 esp_err_t power_battery_init(void);
+// Take a burst if the cached reading is older than max_age_ms (0 = always).
+// Blocks for the burst, a few tens of ms.
+esp_err_t power_battery_refresh(uint32_t max_age_ms);
 esp_err_t power_get_battery_status(battery_status_t *status);
 float power_get_battery_voltage_real(void);
 
@@ -85,6 +92,20 @@ void power_set_wifi_info(bool is_lr, const char* ssid);
 bool power_get_wifi_is_lr(void);
 const char* power_get_wifi_ssid(void);
 
+// Runtime power management: DFS + automatic light sleep while idle.
+// Hold the performance lock around SWD/flash jobs - it pins the CPU at max
+// frequency, blocks light sleep and disables WiFi modem sleep (refcounted).
+esp_err_t power_pm_init(void);
+void power_perf_acquire(void);
+void power_perf_release(void);
+bool power_perf_active(void);
+
+// Battery sag guard for flash jobs - call between pages. Throttles (lower
+// WiFi TX power, gaps between pages) or pauses while the filtered voltage
+// sags; ESP_ERR_TIMEOUT if a pause ran out without recovery.
+esp_err_t power_sag_guard(void);
+void power_sag_end(void);     // Job finished - undo any throttling
+
 // Absolute uptime timer (scheduled maintenance reboot)
 esp_err_t power_check_absolute_timer(void);
 esp_err_t power_get_absolute_timer_status(uint64_t *accumulated_sec, uint64_t *limit_sec, uint64_t *remaining_sec);
@@ -0,0 +1,37 @@
+// power_schedule.h - Wake schedule learned from operator connection times
+#ifndef POWER_SCHEDULE_H
+#define POWER_SCHEDULE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#define SCHEDULE_BINS       48      // 30 minute time-of-day bins
+#define SCHEDULE_BIN_SEC    (86400 / SCHEDULE_BINS)
+
+typedef struct {
+    bool clock_synced;          // System clock set to real time (/time_sync)
+    bool hist_synced;           // Histogram bins aligned to real time
+    bool active;                // Enough data - intervals are being shaped
+    uint32_t samples;           // Client wakes recorded (saturating)
+    uint32_t time_of_day_sec;   // Current clock, seconds into the day
+    uint16_t weight_pct[SCHEDULE_BINS];  // Relative wake density, 100 = base rate
+} schedule_info_t;
+
+// Validate the RTC histogram, restoring it from NVS after power loss
+esp_err_t power_schedule_init(void);
+
+// A client used the web interface during this wake (counted once per wake)
+void power_schedule_record_client(void);
+
+// Reshape a battery-band interval: denser wakes where clients usually
+// connect, sparser elsewhere, same number of wakes per day on average
+uint64_t power_schedule_adjust_us(uint64_t base_us);
+
+// Set the system clock to real time; realigns a histogram that was
+// collected against the free-running clock
+esp_err_t power_schedule_time_sync(int64_t epoch_sec);
+
+void power_schedule_get_info(schedule_info_t *info);
+
+#endif // POWER_SCHEDULE_H
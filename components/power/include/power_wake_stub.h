@@ -0,0 +1,34 @@
+// power_wake_stub.h - RTC-resident deep sleep wake stub and slot schedule
+#ifndef POWER_WAKE_STUB_H
+#define POWER_WAKE_STUB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Arm the stub and the sleep timer for a sleep of total_us, planned at
+// battery_v for the band [min_v, max_v) (0 = no limit on that side).
+// The sleep is split into slots of slot_sec. At the end of every slot but
+// the last the stub takes one raw ADC sample and goes straight back to
+// sleep while the battery is still inside the band; the app only boots for
+// the connect wake, or early when the battery left the band.
+// Returns the length of the first timer, which is all the app sleeps for
+// certain (book the rest with power_wake_stub_collect()).
+uint64_t power_wake_stub_arm(uint64_t total_us, uint32_t slot_sec,
+                             float battery_v, float min_v, float max_v);
+
+// Call once after a deep sleep wake: collects what the stub did during the
+// last sleep. Returns the time the stub slept past the first timer.
+uint64_t power_wake_stub_collect(void);
+
+// Stub wakes that went back to sleep during the last sleep / since power-on
+uint32_t power_wake_stub_last_skipped(void);
+uint32_t power_wake_stub_total_skipped(void);
+
+// The last sleep ended before its connect wake because the battery left the band
+bool power_wake_stub_woke_early(void);
+
+// Raw ADC code of the stub's sample at this wake (0 = none)
+uint32_t power_wake_stub_battery_raw(void);
+
+#endif // POWER_WAKE_STUB_H
@@ -0,0 +1,89 @@
+// energy_model.c - Per-state energy accounting
+#include "energy_model.h"
+#include <string.h>
+
+#define MS_PER_DAY          86400000.0
+#define UA_MS_PER_MAH       3600000000.0    // 1 mAh = 1000 uA * 3600 * 1000 ms
+
+static const char *category_names[ENERGY_CAT_COUNT] = {
+    [ENERGY_DEEP_SLEEP]     = "deep_sleep",
+    [ENERGY_BOOT]           = "boot",
+    [ENERGY_WIFI_CONNECT]   = "wifi_connect",
+    [ENERGY_ACTIVE_IDLE]    = "active_idle",
+    [ENERGY_SWD_JOB]        = "swd_job",
+    [ENERGY_NRF52_ON]       = "nrf52_on",
+    [ENERGY_NRF52_OFF]      = "nrf52_off",
+};
+
+static void account_book(energy_account_t *acc, uint8_t state, uint64_t duration_ms) {
+    acc->time_ms[state] += duration_ms;
+    acc->time_ms[acc->nrf52_on ? ENERGY_NRF52_ON : ENERGY_NRF52_OFF] += duration_ms;
+}
+
+void energy_account_reset(energy_account_t *acc, energy_category_t state,
+                          bool nrf52_on, uint64_t now_ms) {
+    memset(acc, 0, sizeof(*acc));
+    acc->state = state < ENERGY_ESP_STATE_COUNT ? state : ENERGY_BOOT;
+    acc->nrf52_on = nrf52_on;
+    acc->since_ms = now_ms;
+}
+
+void energy_account_sync(energy_account_t *acc, uint64_t now_ms) {
+    // A clock that went backwards (new boot) books nothing
+    if (now_ms > acc->since_ms && acc->state < ENERGY_ESP_STATE_COUNT) {
+        account_book(acc, acc->state, now_ms - acc->since_ms);
+    }
+    acc->since_ms = now_ms;
+}
+
+energy_category_t energy_account_set_state(energy_account_t *acc,
+                                           energy_category_t state, uint64_t now_ms) {
+    energy_category_t previous = (energy_category_t)acc->state;
+
+    energy_account_sync(acc, now_ms);
+    if (state < ENERGY_ESP_STATE_COUNT) {
+        acc->state = state;
+    }
+    return previous;
+}
+
+void energy_account_set_nrf52(energy_account_t *acc, bool on, uint64_t now_ms) {
+    energy_account_sync(acc, now_ms);
+    acc->nrf52_on = on;
+}
+
+void energy_account_add(energy_account_t *acc, energy_category_t state,
+                        uint64_t duration_ms) {
+    if (state < ENERGY_ESP_STATE_COUNT) {
+        account_book(acc, state, duration_ms);
+    }
+}
+
+void energy_model_report(const energy_account_t *acc, const energy_coeffs_t *coeffs,
+                         energy_report_t *report) {
+    memset(report, 0, sizeof(*report));
+
+    for (int i = 0; i < ENERGY_ESP_STATE_COUNT; i++) {
+        report->observed_ms += acc->time_ms[i];
+    }
+
+    for (int i = 0; i < ENERGY_CAT_COUNT; i++) {
+        report->mah[i] = (double)acc->time_ms[i] * coeffs->current_ua[i] / UA_MS_PER_MAH;
+        report->total_mah += report->mah[i];
+    }
+
+    if (report->observed_ms == 0) {
+        return;
+    }
+
+    double days = report->observed_ms / MS_PER_DAY;
+    for (int i = 0; i < ENERGY_CAT_COUNT; i++) {
+        report->mah_per_day[i] = report->mah[i] / days;
+    }
+    report->total_mah_per_day = report->total_mah / days;
+    report->avg_current_ma = report->total_mah_per_day / 24.0;
+}
+
+const char* energy_category_name(energy_category_t cat) {
+    return cat < ENERGY_CAT_COUNT ? category_names[cat] : "unknown";
+}
@@ -0,0 +1,144 @@
+// power_energy.c - Device energy accountant
+//
+// Keeps an energy_account_t in RTC memory and drives it from esp_timer.
+// esp_timer restarts at zero on every boot, so each wake starts booking at
+// t=0 in ENERGY_BOOT (reset to app_main included); deep sleep is booked up
+// front with the armed duration because no clock runs across it.
+#include "power_energy.h"
+#include "power_mgmt.h"
+#include "config.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "freertos/FreeRTOS.h"
+
+static const char *TAG = "POWER_ENERGY";
+
+#define ENERGY_MAGIC    0x454E5247  // "ENRG"
+
+typedef struct {
+    uint32_t magic;
+    energy_account_t account;
+} energy_rtc_t;
+
+RTC_DATA_ATTR static energy_rtc_t rtc_energy;
+
+static portMUX_TYPE energy_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static const energy_coeffs_t energy_coeffs = {
+    .current_ua = {
+        [ENERGY_DEEP_SLEEP]     = ENERGY_DEEP_SLEEP_UA,
+        [ENERGY_BOOT]           = ENERGY_BOOT_UA,
+        [ENERGY_WIFI_CONNECT]   = ENERGY_WIFI_CONNECT_UA,
+        [ENERGY_ACTIVE_IDLE]    = ENERGY_ACTIVE_IDLE_UA,
+        [ENERGY_SWD_JOB]        = ENERGY_SWD_JOB_UA,
+        [ENERGY_NRF52_ON]       = ENERGY_NRF52_ON_UA,
+        [ENERGY_NRF52_OFF]      = ENERGY_NRF52_OFF_UA,
+    }
+};
+
+static uint64_t energy_now_ms(void) {
+    return (uint64_t)esp_timer_get_time() / 1000ULL;
+}
+
+void power_energy_init(bool nrf52_on) {
+    portENTER_CRITICAL(&energy_lock);
+    if (rtc_energy.magic != ENERGY_MAGIC) {
+        energy_account_reset(&rtc_energy.account, ENERGY_BOOT, nrf52_on, 0);
+        rtc_energy.magic = ENERGY_MAGIC;
+    } else {
+        rtc_energy.account.state = ENERGY_BOOT;
+        rtc_energy.account.nrf52_on = nrf52_on;
+        rtc_energy.account.since_ms = 0;
+    }
+    energy_account_sync(&rtc_energy.account, energy_now_ms());
+    portEXIT_CRITICAL(&energy_lock);
+}
+
+energy_category_t power_energy_enter(energy_category_t state) {
+    portENTER_CRITICAL(&energy_lock);
+    energy_category_t previous = energy_account_set_state(&rtc_energy.account, state,
+                                                          energy_now_ms());
+    portEXIT_CRITICAL(&energy_lock);
+    return previous;
+}
+
+void power_energy_set_nrf52(bool on) {
+    portENTER_CRITICAL(&energy_lock);
+    energy_account_set_nrf52(&rtc_energy.account, on, energy_now_ms());
+    portEXIT_CRITICAL(&energy_lock);
+}
+
+void power_energy_sync(void) {
+    portENTER_CRITICAL(&energy_lock);
+    energy_account_sync(&rtc_energy.account, energy_now_ms());
+    portEXIT_CRITICAL(&energy_lock);
+}
+
+void power_energy_sleep(uint64_t sleep_us) {
+    portENTER_CRITICAL(&energy_lock);
+    energy_account_sync(&rtc_energy.account, energy_now_ms());
+    energy_account_add(&rtc_energy.account, ENERGY_DEEP_SLEEP, sleep_us / 1000ULL);
+    portEXIT_CRITICAL(&energy_lock);
+}
+
+void power_energy_book_sleep(uint64_t sleep_us) {
+    portENTER_CRITICAL(&energy_lock);
+    energy_account_add(&rtc_energy.account, ENERGY_DEEP_SLEEP, sleep_us / 1000ULL);
+    portEXIT_CRITICAL(&energy_lock);
+}
+
+void power_energy_get_report(energy_report_t *report) {
+    energy_account_t snapshot;
+
+    portENTER_CRITICAL(&energy_lock);
+    energy_account_sync(&rtc_energy.account, energy_now_ms());
+    snapshot = rtc_energy.account;
+    portEXIT_CRITICAL(&energy_lock);
+
+    energy_model_report(&snapshot, &energy_coeffs, report);
+    ESP_LOGD(TAG, "%.1f h observed, %.2f mAh/day", report->observed_ms / 3600000.0,
+             report->total_mah_per_day);
+}
+
+void power_energy_get_coeffs(energy_coeffs_t *coeffs) {
+    *coeffs = energy_coeffs;
+}
+
+uint32_t power_energy_battery_capacity_mah(void) {
+    return ENERGY_BATTERY_CAPACITY_MAH;
+}
+
+esp_err_t power_energy_check_job(uint32_t payload_bytes, float *predicted_mah, float *margin_mah) {
+    // Worst case: the job runs at SWD_JOB with the target powered and hits
+    // one full sag pause
+    uint64_t duration_ms = ENERGY_JOB_OVERHEAD_MS + SAG_MAX_PAUSE_MS +
+                           (uint64_t)payload_bytes * 1000ULL / ENERGY_JOB_HEX_BYTES_PER_SEC;
+    float current_ma = (energy_coeffs.current_ua[ENERGY_SWD_JOB] +
+                        energy_coeffs.current_ua[ENERGY_NRF52_ON]) / 1000.0f;
+    float predicted = current_ma * duration_ms / 3600000.0f;
+
+    if (predicted_mah) *predicted_mah = predicted;
+
+    // No reading yet (sampler not started or first sample pending) means
+    // unknown, not empty - allow the job, as power_sag_guard does
+    battery_status_t battery;
+    if (power_get_battery_status(&battery) != ESP_OK || battery.voltage <= 0.0f) {
+        if (margin_mah) *margin_mah = -1.0f;
+        ESP_LOGW(TAG, "No battery reading - allowing job (~%.2f mAh) unchecked", predicted);
+        return ESP_OK;
+    }
+
+    float margin = 0.0f;
+    if (battery.percentage > ENERGY_JOB_RESERVE_PCT) {
+        margin = ENERGY_BATTERY_CAPACITY_MAH * (battery.percentage - ENERGY_JOB_RESERVE_PCT) / 100.0f;
+    }
+    if (margin_mah) *margin_mah = margin;
+
+    if (predicted > margin) {
+        ESP_LOGW(TAG, "Job needs ~%.2f mAh, battery margin %.2f mAh - refusing",
+                 predicted, margin);
+        return ESP_ERR_INVALID_STATE;
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,291 @@
+// power_history.c - Battery and wake history ring buffer
+//
+// Records are packed into 32 bits so a useful history fits in RTC slow memory:
+//   [7:0]   voltage      (mV - 2500) / 10, i.e. 2.50 V .. 5.05 V
+//   [15:8]  awake time   seconds below 128, then 128 + (s - 128) / 32
+//   [23:16] sleep time   units of 5 minutes (max ~21 h)
+//   [26:24] wake reason  wake_reason_t
+//   [28:27] wifi mode    history_wifi_mode_t
+//   [31:29] outcome      history_outcome_t
+#include "power_history.h"
+#include "power_mgmt.h"
+#include "config.h"
+#include "telemetry.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_rom_crc.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include <stddef.h>
+#include <string.h>
+
+static const char *TAG = "POWER_HIST";
+
+#define HISTORY_MAGIC           0x48495354  // "HIST"
+#define HISTORY_NVS_NAMESPACE   "power_hist"
+#define HISTORY_NVS_KEY         "ring"
+
+#define HISTORY_VOLTAGE_BASE_MV 2500
+#define HISTORY_VOLTAGE_STEP_MV 10
+#define HISTORY_AWAKE_LINEAR    128
+#define HISTORY_AWAKE_STEP_SEC  32
+#define HISTORY_SLEEP_STEP_SEC  300
+
+typedef struct {
+    uint32_t magic;
+    uint16_t head;          // Next slot to write
+    uint16_t count;         // Valid records
+    uint16_t unsaved;       // Records appended since last NVS compaction
+    uint16_t reserved;
+    uint32_t entries[POWER_HISTORY_ENTRIES];
+    uint32_t crc;           // CRC32 over everything above
+} history_ring_t;
+
+RTC_DATA_ATTR static history_ring_t rtc_history;
+
+static portMUX_TYPE history_lock = portMUX_INITIALIZER_UNLOCKED;
+static history_outcome_t wake_outcome = HISTORY_OUTCOME_UNKNOWN;
+static history_wifi_mode_t wake_wifi_mode = HISTORY_WIFI_NONE;
+static bool history_recorded = false;
+
+static uint32_t history_crc(const history_ring_t *ring) {
+    return esp_rom_crc32_le(0, (const uint8_t *)ring, offsetof(history_ring_t, crc));
+}
+
+static bool history_valid(const history_ring_t *ring) {
+    return ring->magic == HISTORY_MAGIC &&
+           ring->head < POWER_HISTORY_ENTRIES &&
+           ring->count <= POWER_HISTORY_ENTRIES &&
+           ring->crc == history_crc(ring);
+}
+
+static void history_reset(history_ring_t *ring) {
+    memset(ring, 0, sizeof(*ring));
+    ring->magic = HISTORY_MAGIC;
+    ring->crc = history_crc(ring);
+}
+
+static uint32_t history_pack(float voltage, uint32_t awake_sec, uint32_t sleep_sec,
+                             uint8_t wake_reason, uint8_t wifi_mode, uint8_t outcome) {
+    int32_t mv = (int32_t)(voltage * 1000.0f + 0.5f);
+    int32_t v_code = (mv - HISTORY_VOLTAGE_BASE_MV) / HISTORY_VOLTAGE_STEP_MV;
+    if (v_code < 0) v_code = 0;
+    if (v_code > 255) v_code = 255;
+
+    uint32_t a_code = awake_sec;
+    if (a_code >= HISTORY_AWAKE_LINEAR) {
+        a_code = HISTORY_AWAKE_LINEAR + (awake_sec - HISTORY_AWAKE_LINEAR) / HISTORY_AWAKE_STEP_SEC;
+        if (a_code > 255) a_code = 255;
+    }
+
+    uint32_t s_code = (sleep_sec + HISTORY_SLEEP_STEP_SEC / 2) / HISTORY_SLEEP_STEP_SEC;
+    if (s_code > 255) s_code = 255;
+
+    return (uint32_t)v_code |
+           (a_code << 8) |
+           (s_code << 16) |
+           ((uint32_t)(wake_reason & 0x7) << 24) |
+           ((uint32_t)(wifi_mode & 0x3) << 27) |
+           ((uint32_t)(outcome & 0x7) << 29);
+}
+
+static void history_unpack(uint32_t word, history_entry_t *entry) {
+    uint32_t v_code = word & 0xFF;
+    uint32_t a_code = (word >> 8) & 0xFF;
+    uint32_t s_code = (word >> 16) & 0xFF;
+
+    entry->voltage = (HISTORY_VOLTAGE_BASE_MV + v_code * HISTORY_VOLTAGE_STEP_MV) / 1000.0f;
+    entry->awake_sec = a_code < HISTORY_AWAKE_LINEAR ? a_code :
+                       HISTORY_AWAKE_LINEAR + (a_code - HISTORY_AWAKE_LINEAR) * HISTORY_AWAKE_STEP_SEC;
+    entry->sleep_sec = s_code * HISTORY_SLEEP_STEP_SEC;
+    entry->wake_reason = (word >> 24) & 0x7;
+    entry->wifi_mode = (word >> 27) & 0x3;
+    entry->outcome = (word >> 29) & 0x7;
+}
+
+// Caller must hold history_lock
+static void history_append_locked(uint32_t word) {
+    rtc_history.entries[rtc_history.head] = word;
+    rtc_history.head = (rtc_history.head + 1) % POWER_HISTORY_ENTRIES;
+    if (rtc_history.count < POWER_HISTORY_ENTRIES) {
+        rtc_history.count++;
+    }
+    rtc_history.unsaved++;
+    rtc_history.crc = history_crc(&rtc_history);
+}
+
+static esp_err_t history_load_nvs(history_ring_t *ring) {
+    nvs_handle_t handle;
+    esp_err_t ret = nvs_open(HISTORY_NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    size_t len = sizeof(*ring);
+    ret = nvs_get_blob(handle, HISTORY_NVS_KEY, ring, &len);
+    nvs_close(handle);
+
+    if (ret == ESP_OK && (len != sizeof(*ring) || !history_valid(ring))) {
+        ret = ESP_ERR_INVALID_CRC;
+    }
+    return ret;
+}
+
+esp_err_t power_history_flush(void) {
+    // Records appended while NVS is written stay counted as unsaved; on
+    // failure the flushed ones are counted again
+    history_ring_t snapshot;
+    portENTER_CRITICAL(&history_lock);
+    memcpy(&snapshot, &rtc_history, sizeof(snapshot));
+    uint16_t flushed = rtc_history.unsaved;
+    rtc_history.unsaved = 0;
+    rtc_history.crc = history_crc(&rtc_history);
+    portEXIT_CRITICAL(&history_lock);
+
+    snapshot.unsaved = 0;
+    snapshot.crc = history_crc(&snapshot);
+
+    nvs_handle_t handle;
+    esp_err_t ret = nvs_open(HISTORY_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret == ESP_OK) {
+        ret = nvs_set_blob(handle, HISTORY_NVS_KEY, &snapshot, sizeof(snapshot));
+        if (ret == ESP_OK) {
+            ret = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "History compaction failed: %s", esp_err_to_name(ret));
+        portENTER_CRITICAL(&history_lock);
+        rtc_history.unsaved += flushed;
+        rtc_history.crc = history_crc(&rtc_history);
+        portEXIT_CRITICAL(&history_lock);
+        return ret;
+    }
+
+    ESP_LOGI(TAG, "History compacted to NVS (%u records)", snapshot.count);
+    return ESP_OK;
+}
+
+esp_err_t power_history_init(void) {
+    if (!history_valid(&rtc_history)) {
+        history_ring_t restored;
+        esp_err_t ret = history_load_nvs(&restored);
+        if (ret == ESP_OK) {
+            memcpy(&rtc_history, &restored, sizeof(rtc_history));
+            ESP_LOGI(TAG, "History restored from NVS (%u records)", rtc_history.count);
+        } else {
+            history_reset(&rtc_history);
+            ESP_LOGI(TAG, "History started fresh (%s)", esp_err_to_name(ret));
+        }
+    } else {
+        ESP_LOGI(TAG, "History ring intact (%u records, %u unsaved)",
+                rtc_history.count, rtc_history.unsaved);
+    }
+
+    wake_outcome = HISTORY_OUTCOME_UNKNOWN;
+    wake_wifi_mode = HISTORY_WIFI_NONE;
+    history_recorded = false;
+    return ESP_OK;
+}
+
+void power_history_set_outcome(history_outcome_t outcome) {
+    wake_outcome = outcome;
+}
+
+void power_history_set_wifi_mode(history_wifi_mode_t mode) {
+    wake_wifi_mode = mode;
+}
+
+void power_history_record(float voltage, uint32_t sleep_sec) {
+    // Sleep and reboot paths can overlap (e.g. failsafe during disconnect);
+    // only the first one describes this wake
+    if (history_recorded) {
+        return;
+    }
+    history_recorded = true;
+
+    uint32_t awake_sec = (uint32_t)(esp_timer_get_time() / 1000000ULL);
+    uint32_t word = history_pack(voltage, awake_sec, sleep_sec,
+                                 (uint8_t)power_get_wake_reason(),
+                                 (uint8_t)wake_wifi_mode, (uint8_t)wake_outcome);
+
+    portENTER_CRITICAL(&history_lock);
+    history_append_locked(word);
+    uint16_t unsaved = rtc_history.unsaved;
+    portEXIT_CRITICAL(&history_lock);
+
+    ESP_LOGI(TAG, "Recorded wake: %.2fV, awake %" PRIu32 "s, sleep %" PRIu32 "s, %s/%s",
+            voltage, awake_sec, sleep_sec,
+            power_history_wifi_mode_name(wake_wifi_mode),
+            power_history_outcome_name(wake_outcome));
+
+    // Long-term copy in the flash log - this is its once-per-wake flush point
+    telemetry_record(TELEM_BATTERY_MV, (int32_t)(voltage * 1000.0f + 0.5f));
+    telemetry_record(TELEM_WAKE_OUTCOME, wake_outcome);
+    telemetry_record(TELEM_AWAKE_SEC, (int32_t)awake_sec);
+    telemetry_flush(wake_outcome == HISTORY_OUTCOME_LOW_BATTERY);
+
+    // Compact periodically, and straight away when a power loss is likely
+    if (unsaved >= POWER_HISTORY_NVS_INTERVAL ||
+        wake_outcome == HISTORY_OUTCOME_LOW_BATTERY) {
+        power_history_flush();
+    }
+}
+
+uint16_t power_history_count(void) {
+    return rtc_history.count;
+}
+
+uint16_t power_history_capacity(void) {
+    return POWER_HISTORY_ENTRIES;
+}
+
+bool power_history_get(uint16_t index, history_entry_t *entry) {
+    if (!entry) {
+        return false;
+    }
+
+    portENTER_CRITICAL(&history_lock);
+    if (index >= rtc_history.count) {
+        portEXIT_CRITICAL(&history_lock);
+        return false;
+    }
+    uint16_t oldest = (rtc_history.head + POWER_HISTORY_ENTRIES - rtc_history.count) % POWER_HISTORY_ENTRIES;
+    uint32_t word = rtc_history.entries[(oldest + index) % POWER_HISTORY_ENTRIES];
+    portEXIT_CRITICAL(&history_lock);
+
+    history_unpack(word, entry);
+    return true;
+}
+
+const char* power_history_outcome_name(uint8_t outcome) {
+    switch (outcome) {
+        case HISTORY_OUTCOME_NO_WIFI:           return "no_wifi";
+        case HISTORY_OUTCOME_IDLE:              return "idle";
+        case HISTORY_OUTCOME_CLIENT:            return "client";
+        case HISTORY_OUTCOME_LOW_BATTERY:       return "low_battery";
+        case HISTORY_OUTCOME_WIFI_LOST:         return "wifi_lost";
+        case HISTORY_OUTCOME_SCHEDULED_REBOOT:  return "scheduled_reboot";
+        default:                                return "unknown";
+    }
+}
+
+const char* power_history_wifi_mode_name(uint8_t mode) {
+    switch (mode) {
+        case HISTORY_WIFI_NORMAL:   return "normal";
+        case HISTORY_WIFI_LR:       return "lr";
+        default:                    return "none";
+    }
+}
+
+const char* power_history_wake_reason_name(uint8_t reason) {
+    switch (reason) {
+        case WAKE_REASON_TIMER:     return "timer";
+        case WAKE_REASON_GPIO:      return "gpio";
+        case WAKE_REASON_UART:      return "uart";
+        case WAKE_REASON_RESET:     return "reset";
+        default:                    return "unknown";
+    }
+}
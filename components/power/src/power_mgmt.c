@@ -1,4 +1,8 @@
 #include "power_mgmt.h"
+#include "power_history.h"
+#include "power_wake_stub.h"
+#include "power_energy.h"
+#include "power_schedule.h"
 #include "config.h"
 #include "esp_log.h"
 #include "esp_sleep.h"
@@ -10,17 +14,22 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
-#include "esp_adc/adc_oneshot.h"
+#include "esp_adc/adc_continuous.h"
 #include "esp_adc/adc_cali.h"
 #include "esp_adc/adc_cali_scheme.h"
+#include <string.h>
 
 static const char *TAG = "POWER_MGMT";
 static power_config_t power_config = {0};
 static bool power_state = true;
-static adc_oneshot_unit_handle_t adc1_handle = NULL;
+static adc_continuous_handle_t adc_cont_handle = NULL;
 static adc_cali_handle_t adc_cali_handle = NULL;
 static battery_status_t battery_stats = {0};
 static bool battery_monitoring_enabled = false;
+static SemaphoreHandle_t battery_adc_mutex = NULL;  // One burst at a time
+static portMUX_TYPE battery_lock = portMUX_INITIALIZER_UNLOCKED;
+static int64_t battery_last_update_us = 0;
+static int32_t battery_filtered_mv_q4 = 0;  // IIR state, mV * 16
 
 // RTC memory variables (persist through deep sleep on ESP32-C3)
 RTC_DATA_ATTR static uint32_t rtc_wake_count = 0;
@@ -45,24 +54,168 @@ static char wifi_current_ssid[33] = {0};
 #define BATTERY_MIN_VOLTAGE 3.0f
 #define BATTERY_CRITICAL_VOLTAGE 3.2f
 #define BATTERY_LOW_VOLTAGE 3.5f
-#define ADC_SAMPLES_COUNT 10
+
+// Sampling: the continuous (DMA) driver runs in short bursts so it only holds
+// its APB clock lock for a few milliseconds. Bursts are taken on demand
+// (power_battery_refresh) - there is no sampler task waking the CPU.
+#define BATTERY_SAMPLE_FREQ_HZ    SOC_ADC_SAMPLE_FREQ_THRES_LOW  // Lowest rate the DMA engine supports
+#define BATTERY_BURST_SAMPLES     16                             // Samples per burst (median window)
+#define BATTERY_FRAME_BYTES       (BATTERY_BURST_SAMPLES * SOC_ADC_DIGI_RESULT_BYTES)
+#define BATTERY_BURST_TIMEOUT_MS  100
+#define BATTERY_IIR_SHIFT         3                              // alpha = 1/8 per burst
+
+// Median of a small window - insertion sort is cheapest for 16 entries
+static uint32_t battery_median(uint32_t *samples, int count) {
+    for (int i = 1; i < count; i++) {
+        uint32_t v = samples[i];
+        int j = i - 1;
+        while (j >= 0 && samples[j] > v) {
+            samples[j + 1] = samples[j];
+            j--;
+        }
+        samples[j + 1] = v;
+    }
+    return samples[count / 2];
+}
+
+// Collect one burst of raw samples from the DMA driver, returns sample count
+static int battery_sample_burst(uint32_t *raw, int max_samples) {
+    uint8_t frame[BATTERY_FRAME_BYTES];
+    uint32_t frame_len = 0;
+    int count = 0;
+
+    if (adc_continuous_start(adc_cont_handle) != ESP_OK) {
+        return 0;
+    }
+
+    int64_t deadline = esp_timer_get_time() + BATTERY_BURST_TIMEOUT_MS * 1000LL;
+    while (count < max_samples && esp_timer_get_time() < deadline) {
+        esp_err_t ret = adc_continuous_read(adc_cont_handle, frame, sizeof(frame),
+                                            &frame_len, BATTERY_BURST_TIMEOUT_MS);
+        if (ret != ESP_OK) {
+            break;
+        }
+        for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= frame_len && count < max_samples;
+             i += SOC_ADC_DIGI_RESULT_BYTES) {
+            adc_digi_output_data_t *p = (adc_digi_output_data_t *)&frame[i];
+            if (p->type2.unit == ADC_UNIT_1 && p->type2.channel == BATTERY_ADC_CHANNEL) {
+                raw[count++] = p->type2.data;
+            }
+        }
+    }
+
+    adc_continuous_stop(adc_cont_handle);
+
+    // Drop anything converted after we stopped reading so the next burst starts fresh
+    while (adc_continuous_read(adc_cont_handle, frame, sizeof(frame), &frame_len, 0) == ESP_OK) {
+    }
+
+    return count;
+}
+
+// Fold a new filtered reading into the cached statistics
+static void battery_update_stats(float voltage) {
+    portENTER_CRITICAL(&battery_lock);
+    battery_stats.voltage = voltage;
+    battery_stats.samples_count++;
+    if (voltage > 2.0f && voltage < battery_stats.voltage_min) {
+        battery_stats.voltage_min = voltage;
+    }
+    if (voltage > battery_stats.voltage_max) {
+        battery_stats.voltage_max = voltage;
+    }
+    if (battery_stats.samples_count == 1) {
+        battery_stats.voltage_avg = voltage;
+    } else {
+        battery_stats.voltage_avg = (battery_stats.voltage_avg * 0.95f) + (voltage * 0.05f);
+    }
+    if (voltage >= BATTERY_MAX_VOLTAGE) {
+        battery_stats.percentage = 100.0f;
+    } else if (voltage <= BATTERY_MIN_VOLTAGE) {
+        battery_stats.percentage = 0.0f;
+    } else {
+        battery_stats.percentage = ((voltage - BATTERY_MIN_VOLTAGE) /
+                                   (BATTERY_MAX_VOLTAGE - BATTERY_MIN_VOLTAGE)) * 100.0f;
+    }
+    battery_stats.is_charging = (voltage > 4.1f);
+    battery_stats.is_critical = (voltage < BATTERY_CRITICAL_VOLTAGE);
+    battery_stats.is_low = (voltage < BATTERY_LOW_VOLTAGE);
+    battery_last_update_us = esp_timer_get_time();
+    portEXIT_CRITICAL(&battery_lock);
+}
+
+// One burst: median to reject spikes, then IIR to smooth. Caller holds battery_adc_mutex.
+static esp_err_t battery_take_sample(void) {
+    uint32_t raw[BATTERY_BURST_SAMPLES];
+
+    int count = battery_sample_burst(raw, BATTERY_BURST_SAMPLES);
+    if (count == 0) {
+        ESP_LOGW(TAG, "Battery burst returned no samples");
+        return ESP_ERR_TIMEOUT;
+    }
+
+    uint32_t median_raw = battery_median(raw, count);
+    int adc_mv = 0;
+    if (adc_cali_handle) {
+        adc_cali_raw_to_voltage(adc_cali_handle, (int)median_raw, &adc_mv);
+    } else {
+        adc_mv = (int)((median_raw * 3300UL) / 4095UL);
+    }
+    int32_t battery_mv = (int32_t)(adc_mv * VOLTAGE_DIVIDER_RATIO);
+
+    if (battery_last_update_us == 0) {
+        battery_filtered_mv_q4 = battery_mv << 4;
+    } else {
+        battery_filtered_mv_q4 += ((battery_mv << 4) - battery_filtered_mv_q4) >> BATTERY_IIR_SHIFT;
+    }
+
+    battery_update_stats((battery_filtered_mv_q4 >> 4) / 1000.0f);
+    return ESP_OK;
+}
+
+esp_err_t power_battery_refresh(uint32_t max_age_ms) {
+    if (!battery_adc_mutex) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(battery_adc_mutex, portMAX_DELAY);
+    // Re-check under the lock: a concurrent caller may have just sampled
+    portENTER_CRITICAL(&battery_lock);
+    int64_t last_update_us = battery_last_update_us;
+    portEXIT_CRITICAL(&battery_lock);
+    esp_err_t ret = ESP_OK;
+    if (last_update_us == 0 ||
+        esp_timer_get_time() - last_update_us >= (int64_t)max_age_ms * 1000) {
+        ret = battery_take_sample();
+    }
+    xSemaphoreGive(battery_adc_mutex);
+    return ret;
+}
 
 esp_err_t power_battery_init(void) {
     ESP_LOGI(TAG, "Initializing battery monitoring on GPIO2");
-    adc_oneshot_unit_init_cfg_t init_config1 = {
-        .unit_id = ADC_UNIT_1,
-        .ulp_mode = ADC_ULP_MODE_DISABLE,
+    adc_continuous_handle_cfg_t handle_config = {
+        .max_store_buf_size = BATTERY_FRAME_BYTES * 2,
+        .conv_frame_size = BATTERY_FRAME_BYTES,
     };
-    esp_err_t ret = adc_oneshot_new_unit(&init_config1, &adc1_handle);
+    esp_err_t ret = adc_continuous_new_handle(&handle_config, &adc_cont_handle);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to init ADC unit: %s", esp_err_to_name(ret));
         return ret;
     }
-    adc_oneshot_chan_cfg_t config = {
-        .bitwidth = ADC_BITWIDTH_12,
+    adc_digi_pattern_config_t pattern = {
         .atten = ADC_ATTEN_DB_12,
+        .channel = BATTERY_ADC_CHANNEL,
+        .unit = ADC_UNIT_1,
+        .bit_width = ADC_BITWIDTH_12,
+    };
+    adc_continuous_config_t dig_config = {
+        .pattern_num = 1,
+        .adc_pattern = &pattern,
+        .sample_freq_hz = BATTERY_SAMPLE_FREQ_HZ,
+        .conv_mode = ADC_CONV_SINGLE_UNIT_1,
+        .format = ADC_DIGI_OUTPUT_FORMAT_TYPE2,
     };
-    ret = adc_oneshot_config_channel(adc1_handle, BATTERY_ADC_CHANNEL, &config);
+    ret = adc_continuous_config(adc_cont_handle, &dig_config);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to config ADC channel: %s", esp_err_to_name(ret));
         return ret;
@@ -78,11 +231,22 @@ esp_err_t power_battery_init(void) {
     } else {
         ESP_LOGW(TAG, "ADC calibration not supported, using raw values");
     }
-    battery_monitoring_enabled = true;
     battery_stats.voltage_min = 999.0f;
     battery_stats.voltage_max = 0.0f;
     battery_stats.samples_count = 0;
     battery_stats.voltage_avg = 0.0f;
+
+    battery_adc_mutex = xSemaphoreCreateMutex();
+    if (!battery_adc_mutex) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Boot decisions need a real reading, so take the first burst right away
+    if (power_battery_refresh(0) != ESP_OK) {
+        ESP_LOGW(TAG, "No initial battery reading");
+    }
+
+    battery_monitoring_enabled = true;
     battery_status_t status;
     power_get_battery_status(&status);
     ESP_LOGI(TAG, "Battery monitoring initialized. Initial voltage: %.2fV", status.voltage);
@@ -90,62 +254,26 @@ esp_err_t power_battery_init(void) {
 }
 
 float power_get_battery_voltage_real(void) {
-    if (!battery_monitoring_enabled || !adc1_handle) {
+    if (!battery_monitoring_enabled) {
         return 0.0f;
     }
-    int adc_reading = 0;
-    int voltage_mv = 0;
-    float total_voltage = 0.0f;
-    for (int i = 0; i < ADC_SAMPLES_COUNT; i++) {
-        esp_err_t ret = adc_oneshot_read(adc1_handle, BATTERY_ADC_CHANNEL, &adc_reading);
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to read ADC");
-            continue;
-        }
-        if (adc_cali_handle) {
-            adc_cali_raw_to_voltage(adc_cali_handle, adc_reading, &voltage_mv);
-            total_voltage += (voltage_mv / 1000.0f);
-        } else {
-            float voltage = (adc_reading / 4095.0f) * 3.3f;
-            total_voltage += voltage;
-        }
-        vTaskDelay(pdMS_TO_TICKS(1));
-    }
-    float adc_voltage = total_voltage / ADC_SAMPLES_COUNT;
-    float battery_voltage = adc_voltage * VOLTAGE_DIVIDER_RATIO;
-    return battery_voltage;
+    portENTER_CRITICAL(&battery_lock);
+    float voltage = battery_stats.voltage;
+    portEXIT_CRITICAL(&battery_lock);
+    return voltage;
 }
 
+// Non-blocking: returns the latest filtered reading (power_battery_refresh takes new ones)
 esp_err_t power_get_battery_status(battery_status_t *status) {
     if (!status || !battery_monitoring_enabled) {
         return ESP_ERR_INVALID_ARG;
     }
-    float current_voltage = power_get_battery_voltage_real();
-    battery_stats.voltage = current_voltage;
-    battery_stats.samples_count++;
-    if (current_voltage > 2.0f && current_voltage < battery_stats.voltage_min) {
-        battery_stats.voltage_min = current_voltage;
-    }
-    if (current_voltage > battery_stats.voltage_max) {
-        battery_stats.voltage_max = current_voltage;
-    }
-    if (battery_stats.samples_count == 1) {
-        battery_stats.voltage_avg = current_voltage;
-    } else {
-        battery_stats.voltage_avg = (battery_stats.voltage_avg * 0.95f) + (current_voltage * 0.05f);
-    }
-    if (current_voltage >= BATTERY_MAX_VOLTAGE) {
-        battery_stats.percentage = 100.0f;
-    } else if (current_voltage <= BATTERY_MIN_VOLTAGE) {
-        battery_stats.percentage = 0.0f;
-    } else {
-        battery_stats.percentage = ((current_voltage - BATTERY_MIN_VOLTAGE) /
-                                   (BATTERY_MAX_VOLTAGE - BATTERY_MIN_VOLTAGE)) * 100.0f;
-    }
-    battery_stats.is_charging = (current_voltage > 4.1f);
-    battery_stats.is_critical = (current_voltage < BATTERY_CRITICAL_VOLTAGE);
-    battery_stats.is_low = (current_voltage < BATTERY_LOW_VOLTAGE);
+    portENTER_CRITICAL(&battery_lock);
     *status = battery_stats;
+    int64_t last_update_us = battery_last_update_us;
+    portEXIT_CRITICAL(&battery_lock);
+    status->age_ms = last_update_us > 0 ?
+        (uint32_t)((esp_timer_get_time() - last_update_us) / 1000) : UINT32_MAX;
     ESP_LOGD(TAG, "Battery: %.2fV (%.0f%%) Min:%.2fV Max:%.2fV Avg:%.2fV %s%s",
             status->voltage, status->percentage,
             status->voltage_min, status->voltage_max, status->voltage_avg,
@@ -204,7 +332,10 @@ esp_err_t power_mgmt_init(const power_config_t *config) {
         gpio_hold_en(gpio);
     }
 
+    power_energy_init(power_state);
     power_battery_init();
+    power_history_init();
+    power_schedule_init();
     ESP_LOGI(TAG, "Power management initialized");
     return ESP_OK;
 }
@@ -232,6 +363,7 @@ esp_err_t power_target_on(void) {
 
         power_state = true;
         rtc_nrf_power_state = true;
+        power_energy_set_nrf52(true);
         gpio_hold_en(gpio);
 
         return ESP_OK;
@@ -259,6 +391,7 @@ esp_err_t power_target_off(void) {
 
         power_state = false;
         rtc_nrf_power_state = false;
+        power_energy_set_nrf52(false);
         gpio_hold_en(gpio);
 
         return ESP_OK;
@@ -350,6 +483,7 @@ void power_set_wifi_info(bool is_lr, const char* ssid) {
         strncpy(wifi_current_ssid, ssid, sizeof(wifi_current_ssid) - 1);
         wifi_current_ssid[sizeof(wifi_current_ssid) - 1] = '\0';
     }
+    power_history_set_wifi_mode(is_lr ? HISTORY_WIFI_LR : HISTORY_WIFI_NORMAL);
 }
 
 bool power_get_wifi_is_lr(void) {
@@ -384,6 +518,24 @@ uint64_t calculate_sleep_duration_us(float battery_voltage) {
     return sleep_seconds * 1000000ULL;
 }
 
+// Voltage band a sleep length is chosen for in calculate_sleep_duration_us()
+// (0 = open end). The wake stub boots the app early once the battery leaves it.
+static void sleep_band(float battery_voltage, float *min_v, float *max_v) {
+    if (battery_voltage < BATTERY_CRITICAL_THRESHOLD) {
+        *min_v = 0.0f;
+        *max_v = BATTERY_CRITICAL_THRESHOLD;
+    } else if (battery_voltage < BATTERY_MEDIUM_HIGH_THRESHOLD) {
+        *min_v = BATTERY_CRITICAL_THRESHOLD;
+        *max_v = BATTERY_MEDIUM_HIGH_THRESHOLD;
+    } else if (battery_voltage < BATTERY_HIGH_THRESHOLD) {
+        *min_v = BATTERY_MEDIUM_HIGH_THRESHOLD;
+        *max_v = BATTERY_HIGH_THRESHOLD;
+    } else {
+        *min_v = BATTERY_HIGH_THRESHOLD;
+        *max_v = 0.0f;
+    }
+}
+
 esp_err_t power_check_absolute_timer(void) {
     if (!power_config.enable_absolute_timer) {
         return ESP_OK;
@@ -400,11 +552,11 @@ esp_err_t power_check_absolute_timer(void) {
         uint64_t interval_min = (power_config.absolute_reboot_interval_sec % 3600) / 60;
 
         ESP_LOGI(TAG, "Absolute uptime timer initialized");
-        ESP_LOGI(TAG, "  Reboot interval: %lu seconds", power_config.absolute_reboot_interval_sec);
+        ESP_LOGI(TAG, "  Reboot interval: %" PRIu32 " seconds", power_config.absolute_reboot_interval_sec);
         if (interval_hours > 0) {
-            ESP_LOGI(TAG, "  (%llu hours %llu minutes)", interval_hours, interval_min);
+            ESP_LOGI(TAG, "  (%" PRIu64 " hours %" PRIu64 " minutes)", interval_hours, interval_min);
         } else {
-            ESP_LOGI(TAG, "  (%llu minutes)", interval_min);
+            ESP_LOGI(TAG, "  (%" PRIu64 " minutes)", interval_min);
         }
         ESP_LOGI(TAG, "  Measures accumulated AWAKE time (sleep not counted)");
 
@@ -416,7 +568,7 @@ esp_err_t power_check_absolute_timer(void) {
         rtc_accumulated_awake_sec += awake_this_period;
         rtc_last_awake_check_sec = current_time_sec;
 
-        ESP_LOGD(TAG, "Absolute timer: +%llu sec this period, total %llu/%lu sec",
+        ESP_LOGD(TAG, "Absolute timer: +%" PRIu64 " sec this period, total %" PRIu64 "/%" PRIu32 " sec",
                 awake_this_period,
                 rtc_accumulated_awake_sec,
                 power_config.absolute_reboot_interval_sec);
@@ -439,26 +591,26 @@ esp_err_t power_check_absolute_timer(void) {
         ESP_LOGW(TAG, "╚════════════════════════════════════════════════════════════╝");
 
         if (total_runtime_hr > 0) {
-            ESP_LOGW(TAG, "║  Total runtime:     %llu hr %llu min (%llu sec)          ║",
+            ESP_LOGW(TAG, "║  Total runtime:     %" PRIu64 " hr %" PRIu64 " min (%" PRIu64 " sec)          ║",
                     total_runtime_hr, total_runtime_min % 60, total_runtime_sec);
         } else {
-            ESP_LOGW(TAG, "║  Total runtime:     %llu min (%llu sec)                  ║",
+            ESP_LOGW(TAG, "║  Total runtime:     %" PRIu64 " min (%" PRIu64 " sec)                  ║",
                     total_runtime_min, total_runtime_sec);
         }
 
         if (awake_hr > 0) {
-            ESP_LOGW(TAG, "║  Accumulated awake: %llu hr %llu min (%llu sec)          ║",
+            ESP_LOGW(TAG, "║  Accumulated awake: %" PRIu64 " hr %" PRIu64 " min (%" PRIu64 " sec)          ║",
                     awake_hr, awake_min % 60, rtc_accumulated_awake_sec);
         } else {
-            ESP_LOGW(TAG, "║  Accumulated awake: %llu min (%llu sec)                  ║",
+            ESP_LOGW(TAG, "║  Accumulated awake: %" PRIu64 " min (%" PRIu64 " sec)                  ║",
                     awake_min, rtc_accumulated_awake_sec);
         }
 
         if (threshold_hr > 0) {
-            ESP_LOGW(TAG, "║  Configured limit:  %llu hr %llu min (%lu sec)           ║",
+            ESP_LOGW(TAG, "║  Configured limit:  %" PRIu64 " hr %" PRIu64 " min (%" PRIu32 " sec)           ║",
                     threshold_hr, threshold_min % 60, power_config.absolute_reboot_interval_sec);
         } else {
-            ESP_LOGW(TAG, "║  Configured limit:  %llu min (%lu sec)                   ║",
+            ESP_LOGW(TAG, "║  Configured limit:  %" PRIu64 " min (%" PRIu32 " sec)                   ║",
                     threshold_min, power_config.absolute_reboot_interval_sec);
         }
 
@@ -468,6 +620,10 @@ esp_err_t power_check_absolute_timer(void) {
         ESP_LOGW(TAG, "╚════════════════════════════════════════════════════════════╝");
         ESP_LOGW(TAG, "");
 
+        power_history_set_outcome(HISTORY_OUTCOME_SCHEDULED_REBOOT);
+        power_history_record(power_get_battery_voltage_real(), 0);
+        power_energy_sync();
+
         vTaskDelay(pdMS_TO_TICKS(1000));
 
         rtc_boot_timestamp_sec = 0;
@@ -510,7 +666,9 @@ esp_err_t power_enter_adaptive_deep_sleep(void) {
         return ESP_OK;
     }
 
+    // The sleep length is planned from this reading, so take a fresh burst
     battery_status_t battery;
+    power_battery_refresh(0);
     power_get_battery_status(&battery);
     float voltage = battery.voltage;
 
@@ -520,12 +678,23 @@ esp_err_t power_enter_adaptive_deep_sleep(void) {
         rtc_wake_count = 0;
     }
 
-    ESP_LOGI(TAG, "Entering deep sleep (this will be wake #%lu)", rtc_wake_count);
+    ESP_LOGI(TAG, "Entering deep sleep (this will be wake #%" PRIu32 ")", rtc_wake_count);
 
     rtc_last_battery_voltage = voltage;
 
     uint64_t sleep_duration_us = calculate_sleep_duration_us(voltage);
-    rtc_last_sleep_us = sleep_duration_us;
+
+    // Critical battery keeps its fixed long sleep
+    if (voltage >= BATTERY_CRITICAL_THRESHOLD) {
+        sleep_duration_us = power_schedule_adjust_us(sleep_duration_us);
+    }
+
+    // Band this sleep is planned for - the wake stub boots early outside it
+    float band_min = 0.0f;
+    float band_max = 0.0f;
+    sleep_band(voltage, &band_min, &band_max);
+
+    power_history_record(voltage, (uint32_t)(sleep_duration_us / 1000000ULL));
 
     if (voltage < NRF52_POWER_OFF_VOLTAGE && ENABLE_BATTERY_PROTECTION) {
         ESP_LOGW(TAG, "Battery voltage %.2fV below threshold %.2fV - powering off nRF52",
@@ -562,15 +731,23 @@ esp_err_t power_enter_adaptive_deep_sleep(void) {
 
     gpio_deep_sleep_hold_en();
 
-    ESP_LOGI(TAG, "Entering deep sleep for %llu seconds (wake count: %lu)",
+    ESP_LOGI(TAG, "Entering deep sleep for %llu seconds (wake count: %" PRIu32 ")",
             sleep_duration_us / 1000000ULL, rtc_wake_count);
-    ESP_LOGI(TAG, "DEBUG: Timer microseconds = %llu", sleep_duration_us);
+    ESP_LOGI(TAG, "DEBUG: Timer microseconds = %" PRIu64, sleep_duration_us);
 
     if (rtc_nrf_power_off_active) {
-        ESP_LOGI(TAG, "nRF52 has been off for %llu ms total", rtc_nrf_off_total_ms);
+        ESP_LOGI(TAG, "nRF52 has been off for %" PRIu64 " ms total", rtc_nrf_off_total_ms);
     }
 
-    esp_sleep_enable_timer_wakeup(sleep_duration_us);
+    // nRF52 still powered: crossing its cut-off also needs the app
+    if (rtc_nrf_power_state && ENABLE_BATTERY_PROTECTION && band_min < NRF52_POWER_OFF_VOLTAGE &&
+        voltage >= NRF52_POWER_OFF_VOLTAGE) {
+        band_min = NRF52_POWER_OFF_VOLTAGE;
+    }
+    // Only the first timer is certain; the stub's slots are added back at wake
+    rtc_last_sleep_us = power_wake_stub_arm(sleep_duration_us, WAKE_STUB_SLOT_SEC,
+                                            voltage, band_min, band_max);
+    power_energy_sleep(rtc_last_sleep_us);
     ESP_LOGI(TAG, "DEBUG: Timer configured, entering sleep NOW");
 
     esp_deep_sleep_start();
@@ -580,6 +757,11 @@ esp_err_t power_enter_adaptive_deep_sleep(void) {
 esp_err_t power_restore_from_deep_sleep(void) {
     esp_sleep_wakeup_cause_t wake_cause = esp_sleep_get_wakeup_cause();
 
+    // Only the first timer was booked before sleeping
+    uint64_t stub_slept_us = power_wake_stub_collect();
+    rtc_last_sleep_us += stub_slept_us;
+    power_energy_book_sleep(stub_slept_us);
+
     if (wake_cause == ESP_SLEEP_WAKEUP_UNDEFINED) {
         ESP_LOGI(TAG, "Fresh boot detected - initializing RTC variables");
         rtc_wake_count = 0;
@@ -595,11 +777,11 @@ esp_err_t power_restore_from_deep_sleep(void) {
 
     ESP_LOGI(TAG, "=== Wake from Deep Sleep ===");
     ESP_LOGI(TAG, "Wake cause: %d", wake_cause);
-    ESP_LOGI(TAG, "Wake count: %lu", rtc_wake_count);
+    ESP_LOGI(TAG, "Wake count: %" PRIu32, rtc_wake_count);
     ESP_LOGI(TAG, "Last battery: %.2fV", rtc_last_battery_voltage);
     ESP_LOGI(TAG, "Expected sleep: %llu seconds", rtc_last_sleep_us / 1000000ULL);
-    ESP_LOGI(TAG, "Actual wake time: %llu us since boot", actual_wake_time_us);
-    ESP_LOGI(TAG, "DEBUG: Configured sleep was %llu us", rtc_last_sleep_us);
+    ESP_LOGI(TAG, "Actual wake time: %" PRIu64 " us since boot", actual_wake_time_us);
+    ESP_LOGI(TAG, "DEBUG: Configured sleep was %" PRIu64 " us", rtc_last_sleep_us);
     ESP_LOGI(TAG, "NRF52 state in RTC: %s", rtc_nrf_power_state ? "ON" : "OFF");
 
     uint64_t current_time_sec = esp_timer_get_time() / 1000000ULL;
@@ -610,14 +792,14 @@ esp_err_t power_restore_from_deep_sleep(void) {
     if (power_config.enable_absolute_timer) {
         uint64_t accumulated_min = rtc_accumulated_awake_sec / 60;
         uint64_t limit_min = power_config.absolute_reboot_interval_sec / 60;
-        ESP_LOGI(TAG, "Absolute timer: %llu/%lu min awake (resuming tracking)",
+        ESP_LOGI(TAG, "Absolute timer: %" PRIu64 "/%lu min awake (resuming tracking)",
                 accumulated_min, limit_min);
     }
 
     if (rtc_nrf_power_off_active) {
         rtc_nrf_off_total_ms += rtc_last_sleep_us / 1000ULL;
-        ESP_LOGI(TAG, "nRF52 total off time: %llu ms (%llu hours)",
-                rtc_nrf_off_total_ms, rtc_nrf_off_total_ms / 3600000ULL);
+        ESP_LOGI(TAG, "nRF52 total off time: %" PRIu64 " ms (%" PRIu64 " hours)",
+                rtc_nrf_off_total_ms, rtc_nrf_off_total_ms / 3600000);
     }
 
     if (power_config.target_power_gpio >= 0) {
@@ -660,7 +842,7 @@ esp_err_t power_restore_from_deep_sleep(void) {
                 ESP_LOGI(TAG, "Starting nRF52 power-off protection period");
             }
         } else {
-            ESP_LOGI(TAG, "Battery still low (%.2fV) - keeping nRF52 OFF (off for %llu ms)",
+            ESP_LOGI(TAG, "Battery still low (%.2fV) - keeping nRF52 OFF (off for %" PRIu64 " ms)",
                     battery.voltage, rtc_nrf_off_total_ms);
         }
     } else if (rtc_nrf_power_off_active && !power_state) {
@@ -675,14 +857,14 @@ esp_err_t power_restore_from_deep_sleep(void) {
         ESP_LOGI(TAG, "NRF52 Recovery Check:");
         ESP_LOGI(TAG, "  Battery: %.2fV (need %.2fV) %s",
                 battery.voltage, turn_on_threshold, voltage_good ? "✓" : "✗");
-        ESP_LOGI(TAG, "  Min time: %llu/%lu ms %s",
+        ESP_LOGI(TAG, "  Min time: %" PRIu64 "/%" PRIu32 " ms %s",
                 rtc_nrf_off_total_ms, min_off_time_ms, min_time_elapsed ? "✓" : "✗");
-        ESP_LOGI(TAG, "  Max time: %llu/%lu ms %s",
+        ESP_LOGI(TAG, "  Max time: %" PRIu64 "/%" PRIu32 " ms %s",
                 rtc_nrf_off_total_ms, max_off_time_ms, max_time_exceeded ? "(exceeded)" : "");
 
         if ((voltage_good && min_time_elapsed) || max_time_exceeded) {
             if (max_time_exceeded && !voltage_good) {
-                ESP_LOGW(TAG, "Maximum off time (%lu sec) exceeded - attempting turn-on despite marginal voltage",
+                ESP_LOGW(TAG, "Maximum off time (%d sec) exceeded - attempting turn-on despite marginal voltage",
                         NRF52_MAX_OFF_TIME_SEC);
             }
 
@@ -704,7 +886,7 @@ esp_err_t power_restore_from_deep_sleep(void) {
             }
             if (!min_time_elapsed) {
                 uint32_t remaining_ms = min_off_time_ms - rtc_nrf_off_total_ms;
-                ESP_LOGI(TAG, "  Waiting for minimum time: %lu seconds remaining",
+                ESP_LOGI(TAG, "  Waiting for minimum time: %" PRIu32 " seconds remaining",
                         remaining_ms / 1000);
             }
         }
@@ -0,0 +1,116 @@
+// power_pm.c - Runtime power management for the active window
+//
+// While awake with WiFi up the device mostly waits for a browser. ESP-IDF
+// power management scales the CPU down and enters automatic light sleep
+// whenever no task is runnable; WiFi modem sleep lets the radio doze between
+// beacons. Anything latency or throughput sensitive (SWD jobs, uploads,
+// boot) holds a refcounted performance lock that pins the CPU at full speed,
+// blocks light sleep and turns modem sleep off.
+#include "power_mgmt.h"
+#include "config.h"
+#include "esp_log.h"
+#include "esp_pm.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "POWER_PM";
+
+static esp_pm_lock_handle_t perf_cpu_lock = NULL;
+static esp_pm_lock_handle_t perf_sleep_lock = NULL;
+static SemaphoreHandle_t perf_mutex = NULL;
+static uint32_t perf_refcount = 0;
+static bool pm_enabled = false;
+
+// Caller must hold perf_mutex
+static void apply_wifi_ps(void) {
+    wifi_ps_type_t ps = WIFI_PS_NONE;
+
+    // LR links were unstable with power save - keep them at PS_NONE unless allowed
+    if (perf_refcount == 0 && WIFI_IDLE_MODEM_SLEEP &&
+        (!power_get_wifi_is_lr() || WIFI_LR_MODEM_SLEEP)) {
+        ps = WIFI_PS_MIN_MODEM;
+    }
+
+    wifi_ps_type_t current;
+    if (esp_wifi_get_ps(&current) == ESP_OK && current == ps) {
+        return;
+    }
+    if (esp_wifi_set_ps(ps) == ESP_OK) {
+        ESP_LOGI(TAG, "WiFi power save: %s", ps == WIFI_PS_NONE ? "off" : "modem sleep");
+    }
+}
+
+esp_err_t power_pm_init(void) {
+    if (perf_mutex) {
+        return ESP_OK;
+    }
+
+    perf_mutex = xSemaphoreCreateMutex();
+    if (!perf_mutex) {
+        return ESP_ERR_NO_MEM;
+    }
+
+#if ENABLE_DYNAMIC_PM
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = PM_MAX_CPU_FREQ_MHZ,
+        .min_freq_mhz = PM_MIN_CPU_FREQ_MHZ,
+        .light_sleep_enable = PM_LIGHT_SLEEP_ENABLE
+    };
+
+    esp_err_t ret = esp_pm_configure(&pm_config);
+    if (ret != ESP_OK) {
+        // CONFIG_PM_ENABLE missing - run at fixed clock, locks become no-ops
+        ESP_LOGW(TAG, "Power management unavailable: %s", esp_err_to_name(ret));
+        return ESP_OK;
+    }
+
+    esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "perf_cpu", &perf_cpu_lock);
+    esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "perf_sleep", &perf_sleep_lock);
+    pm_enabled = true;
+
+    ESP_LOGI(TAG, "Dynamic PM: %d-%d MHz, light sleep %s",
+            PM_MIN_CPU_FREQ_MHZ, PM_MAX_CPU_FREQ_MHZ,
+            PM_LIGHT_SLEEP_ENABLE ? "enabled" : "disabled");
+#else
+    ESP_LOGI(TAG, "Dynamic PM disabled in config");
+#endif
+
+    return ESP_OK;
+}
+
+void power_perf_acquire(void) {
+    if (!perf_mutex) {
+        return;
+    }
+
+    xSemaphoreTake(perf_mutex, portMAX_DELAY);
+    if (perf_refcount++ == 0) {
+        if (pm_enabled) {
+            esp_pm_lock_acquire(perf_cpu_lock);
+            esp_pm_lock_acquire(perf_sleep_lock);
+        }
+        apply_wifi_ps();
+    }
+    xSemaphoreGive(perf_mutex);
+}
+
+void power_perf_release(void) {
+    if (!perf_mutex) {
+        return;
+    }
+
+    xSemaphoreTake(perf_mutex, portMAX_DELAY);
+    if (perf_refcount > 0 && --perf_refcount == 0) {
+        apply_wifi_ps();
+        if (pm_enabled) {
+            esp_pm_lock_release(perf_sleep_lock);
+            esp_pm_lock_release(perf_cpu_lock);
+        }
+    }
+    xSemaphoreGive(perf_mutex);
+}
+
+bool power_perf_active(void) {
+    return perf_refcount > 0;
+}
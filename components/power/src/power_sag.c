@@ -0,0 +1,96 @@
+// power_sag.c - Keep SWD jobs inside what a tired battery can deliver
+//
+// Page erases and WiFi TX bursts during a flash job draw enough current to
+// pull a weak cell down to the BMS cutoff, which leaves the nRF52 with half
+// an image. The flash pipeline calls power_sag_guard() between pages; it
+// reads the filtered voltage (a new burst when it is older than
+// SAG_SAMPLE_MAX_AGE_MS) and, below SAG_THROTTLE_VOLTAGE,
+// lowers WiFi TX power and spaces pages out. Below SAG_PAUSE_VOLTAGE it stops
+// the job until the cell recovers. Hysteresis (SAG_RESUME_VOLTAGE) keeps it
+// from toggling on every page.
+#include "power_mgmt.h"
+#include "config.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "POWER_SAG";
+
+static bool sag_throttled = false;
+static int8_t saved_tx_power = 0;
+static bool tx_power_saved = false;
+
+static float sag_voltage(void) {
+    battery_status_t battery;
+    power_battery_refresh(SAG_SAMPLE_MAX_AGE_MS);
+    if (power_get_battery_status(&battery) != ESP_OK) {
+        return 0.0f;
+    }
+    return battery.voltage;
+}
+
+static void sag_enter_throttle(float voltage) {
+    sag_throttled = true;
+    tx_power_saved = esp_wifi_get_max_tx_power(&saved_tx_power) == ESP_OK;
+    if (tx_power_saved && saved_tx_power > SAG_WIFI_TX_POWER) {
+        esp_wifi_set_max_tx_power(SAG_WIFI_TX_POWER);
+    }
+    ESP_LOGW(TAG, "Battery sagging (%.2fV) - throttling job, TX power %.1f dBm",
+             voltage, SAG_WIFI_TX_POWER / 4.0f);
+}
+
+static void sag_leave_throttle(float voltage) {
+    sag_throttled = false;
+    if (tx_power_saved) {
+        esp_wifi_set_max_tx_power(saved_tx_power);
+        tx_power_saved = false;
+    }
+    ESP_LOGI(TAG, "Battery recovered (%.2fV) - full speed", voltage);
+}
+
+esp_err_t power_sag_guard(void) {
+    float voltage = sag_voltage();
+    if (voltage <= 0.0f) {
+        return ESP_OK;  // No reading - nothing to go on
+    }
+
+    if (!sag_throttled) {
+        if (voltage >= SAG_THROTTLE_VOLTAGE) {
+            return ESP_OK;
+        }
+        sag_enter_throttle(voltage);
+    } else if (voltage >= SAG_RESUME_VOLTAGE) {
+        sag_leave_throttle(voltage);
+        return ESP_OK;
+    }
+
+    if (voltage >= SAG_PAUSE_VOLTAGE) {
+        // Lower duty: give the cell time between page operations
+        vTaskDelay(pdMS_TO_TICKS(SAG_PAGE_GAP_MS));
+        return ESP_OK;
+    }
+
+    ESP_LOGW(TAG, "Battery at %.2fV - pausing job until %.2fV", voltage, SAG_RESUME_VOLTAGE);
+    int64_t start_us = esp_timer_get_time();
+    while (voltage < SAG_RESUME_VOLTAGE) {
+        if (esp_timer_get_time() - start_us >= (int64_t)SAG_MAX_PAUSE_MS * 1000) {
+            ESP_LOGW(TAG, "No recovery after %d ms (%.2fV)", SAG_MAX_PAUSE_MS, voltage);
+            return ESP_ERR_TIMEOUT;
+        }
+        vTaskDelay(pdMS_TO_TICKS(SAG_POLL_MS));
+        voltage = sag_voltage();
+    }
+
+    ESP_LOGI(TAG, "Resumed after %" PRId64 " ms pause",
+             (esp_timer_get_time() - start_us) / 1000);
+    sag_leave_throttle(voltage);
+    return ESP_OK;
+}
+
+void power_sag_end(void) {
+    if (sag_throttled) {
+        sag_leave_throttle(sag_voltage());
+    }
+}
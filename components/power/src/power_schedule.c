@@ -0,0 +1,287 @@
+// power_schedule.c - Wake schedule learned from operator connection times
+//
+// Every wake where a client loads the web interface adds to a 48-bin
+// time-of-day histogram (exponentially decayed, so the schedule follows
+// changing habits). When a sleep interval is chosen, the battery-band
+// interval B becomes a base wake rate 1/B that is modulated by the smoothed
+// histogram: rate(t) = g(t) / B with g averaging 1 over the day. The next
+// wake is where the integral of rate(t) reaches one wake, so the number of
+// wakes per day - and the energy spent - stays the same while wakes cluster
+// around likely connection windows.
+//
+// The clock is the RTC-backed system time, which keeps running through deep
+// sleep. Until /time_sync sets it, bins are relative to power-on; the first
+// sync rotates them into real time so they survive later power loss.
+#include "power_schedule.h"
+#include "config.h"
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include <sys/time.h>
+#include <string.h>
+
+static const char *TAG = "POWER_SCHED";
+
+#define SCHEDULE_MAGIC          0x53434844  // "SCHD"
+#define SCHEDULE_NVS_NAMESPACE  "power_sched"
+#define SCHEDULE_NVS_KEY        "hist"
+#define SCHEDULE_SYNCED_EPOCH   1700000000  // Anything later is real time
+#define SCHEDULE_HIT_WEIGHT     256
+#define SCHEDULE_DECAY_SHIFT    4           // Keep 15/16 per recorded client wake
+
+typedef struct {
+    uint32_t magic;
+    uint8_t hist_synced;
+    uint8_t reserved;
+    uint16_t samples;
+    uint16_t bins[SCHEDULE_BINS];
+} schedule_state_t;
+
+RTC_DATA_ATTR static schedule_state_t rtc_schedule;
+
+static portMUX_TYPE schedule_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool client_recorded = false;
+
+static int64_t schedule_now_sec(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec;
+}
+
+static bool schedule_clock_synced(void) {
+    return schedule_now_sec() > SCHEDULE_SYNCED_EPOCH;
+}
+
+static uint32_t schedule_time_of_day(void) {
+    int64_t now = schedule_now_sec();
+    return now < 0 ? 0 : (uint32_t)(now % 86400);
+}
+
+// Bins only mean something if they were collected against the same clock
+static bool schedule_clock_matches(void) {
+    return schedule_clock_synced() == (rtc_schedule.hist_synced != 0);
+}
+
+static void schedule_reset(schedule_state_t *state) {
+    memset(state, 0, sizeof(*state));
+    state->magic = SCHEDULE_MAGIC;
+}
+
+static esp_err_t schedule_save(void) {
+    schedule_state_t snapshot;
+    portENTER_CRITICAL(&schedule_lock);
+    snapshot = rtc_schedule;
+    portEXIT_CRITICAL(&schedule_lock);
+
+    nvs_handle_t handle;
+    esp_err_t ret = nvs_open(SCHEDULE_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    ret = nvs_set_blob(handle, SCHEDULE_NVS_KEY, &snapshot, sizeof(snapshot));
+    if (ret == ESP_OK) {
+        ret = nvs_commit(handle);
+    }
+    nvs_close(handle);
+
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Schedule save failed: %s", esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+static esp_err_t schedule_load(schedule_state_t *state) {
+    nvs_handle_t handle;
+    esp_err_t ret = nvs_open(SCHEDULE_NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    size_t len = sizeof(*state);
+    ret = nvs_get_blob(handle, SCHEDULE_NVS_KEY, state, &len);
+    nvs_close(handle);
+
+    if (ret == ESP_OK && (len != sizeof(*state) || state->magic != SCHEDULE_MAGIC)) {
+        ret = ESP_ERR_INVALID_SIZE;
+    }
+    return ret;
+}
+
+// Relative wake density per bin, mean 1.0, clamped to the configured range
+static void schedule_weights(const uint16_t *bins, float *weights) {
+    uint32_t smoothed[SCHEDULE_BINS];
+    uint32_t total = 0;
+
+    for (int i = 0; i < SCHEDULE_BINS; i++) {
+        // [1 2 1] kernel - a visit at 10:25 also favours 10:00-11:00
+        smoothed[i] = bins[(i + SCHEDULE_BINS - 1) % SCHEDULE_BINS] +
+                      2 * bins[i] +
+                      bins[(i + 1) % SCHEDULE_BINS];
+        total += smoothed[i];
+    }
+
+    float mean = (float)total / SCHEDULE_BINS;
+    float strength = ADAPTIVE_SCHEDULE_STRENGTH_PCT / 100.0f;
+    float max_factor = ADAPTIVE_SCHEDULE_MAX_FACTOR;
+    float sum = 0.0f;
+
+    for (int i = 0; i < SCHEDULE_BINS; i++) {
+        float g = 1.0f;
+        if (mean > 0.0f) {
+            g = (1.0f - strength) + strength * smoothed[i] / mean;
+        }
+        if (g < 1.0f / max_factor) g = 1.0f / max_factor;
+        if (g > max_factor) g = max_factor;
+        weights[i] = g;
+        sum += g;
+    }
+
+    // Clamping moved the mean - renormalise so wakes/day stays unchanged
+    for (int i = 0; i < SCHEDULE_BINS; i++) {
+        weights[i] *= SCHEDULE_BINS / sum;
+    }
+}
+
+static bool schedule_active(void) {
+    return ADAPTIVE_SCHEDULE_ENABLE &&
+           rtc_schedule.samples >= ADAPTIVE_SCHEDULE_MIN_SAMPLES &&
+           schedule_clock_matches();
+}
+
+esp_err_t power_schedule_init(void) {
+    if (rtc_schedule.magic == SCHEDULE_MAGIC) {
+        return ESP_OK;
+    }
+
+    // Power loss: a histogram is only reusable if it was aligned to real time
+    schedule_state_t restored;
+    esp_err_t ret = schedule_load(&restored);
+    if (ret == ESP_OK && restored.hist_synced) {
+        rtc_schedule = restored;
+        ESP_LOGI(TAG, "Schedule restored from NVS (%u client wakes)%s", restored.samples,
+                schedule_clock_synced() ? "" : " - paused until /time_sync");
+    } else {
+        schedule_reset(&rtc_schedule);
+        ESP_LOGI(TAG, "Schedule started fresh");
+    }
+    return ESP_OK;
+}
+
+void power_schedule_record_client(void) {
+    if (client_recorded || !schedule_clock_matches()) {
+        return;
+    }
+    client_recorded = true;
+
+    uint32_t bin = schedule_time_of_day() / SCHEDULE_BIN_SEC;
+
+    portENTER_CRITICAL(&schedule_lock);
+    for (int i = 0; i < SCHEDULE_BINS; i++) {
+        rtc_schedule.bins[i] -= rtc_schedule.bins[i] >> SCHEDULE_DECAY_SHIFT;
+    }
+    rtc_schedule.bins[bin] += SCHEDULE_HIT_WEIGHT;
+    if (rtc_schedule.samples < UINT16_MAX) {
+        rtc_schedule.samples++;
+    }
+    portEXIT_CRITICAL(&schedule_lock);
+
+    ESP_LOGI(TAG, "Client wake recorded at %02" PRIu32 ":%02" PRIu32 " (bin %" PRIu32 ", %u total)",
+             bin * SCHEDULE_BIN_SEC / 3600, (bin * SCHEDULE_BIN_SEC % 3600) / 60,
+             bin, rtc_schedule.samples);
+
+    // Client wakes are rare - persisting each one costs nothing noticeable
+    schedule_save();
+}
+
+uint64_t power_schedule_adjust_us(uint64_t base_us) {
+    if (!schedule_active() || base_us == 0) {
+        return base_us;
+    }
+
+    uint16_t bins[SCHEDULE_BINS];
+    float weights[SCHEDULE_BINS];
+    portENTER_CRITICAL(&schedule_lock);
+    memcpy(bins, rtc_schedule.bins, sizeof(bins));
+    portEXIT_CRITICAL(&schedule_lock);
+    schedule_weights(bins, weights);
+
+    // Walk forward bin by bin until one wake's worth of rate has accumulated
+    float base_sec = base_us / 1000000.0f;
+    float quota = 1.0f;
+    float elapsed = 0.0f;
+    uint32_t tod = schedule_time_of_day();
+
+    while (quota > 0.0f) {
+        uint32_t bin = (tod / SCHEDULE_BIN_SEC) % SCHEDULE_BINS;
+        float segment = SCHEDULE_BIN_SEC - (tod % SCHEDULE_BIN_SEC);
+        float rate = weights[bin] / base_sec;
+
+        if (rate * segment >= quota) {
+            elapsed += quota / rate;
+            break;
+        }
+        quota -= rate * segment;
+        elapsed += segment;
+        tod = (tod + (uint32_t)segment) % 86400;
+    }
+
+    uint64_t adjusted_us = (uint64_t)(elapsed * 1000000.0f);
+    ESP_LOGI(TAG, "Learned schedule: interval %llu s -> %llu s",
+             base_us / 1000000ULL, adjusted_us / 1000000ULL);
+    return adjusted_us;
+}
+
+esp_err_t power_schedule_time_sync(int64_t epoch_sec) {
+    if (epoch_sec <= SCHEDULE_SYNCED_EPOCH) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    int64_t old_sec = schedule_now_sec();
+    struct timeval tv = { .tv_sec = epoch_sec, .tv_usec = 0 };
+    if (settimeofday(&tv, NULL) != 0) {
+        return ESP_FAIL;
+    }
+
+    bool realigned = false;
+    portENTER_CRITICAL(&schedule_lock);
+    if (!rtc_schedule.hist_synced) {
+        // Shift bins collected on the free-running clock into real time
+        int64_t delta = ((epoch_sec - old_sec) % 86400 + 86400) % 86400;
+        uint32_t shift = (uint32_t)((delta + SCHEDULE_BIN_SEC / 2) / SCHEDULE_BIN_SEC) % SCHEDULE_BINS;
+        uint16_t rotated[SCHEDULE_BINS];
+        for (int i = 0; i < SCHEDULE_BINS; i++) {
+            rotated[(i + shift) % SCHEDULE_BINS] = rtc_schedule.bins[i];
+        }
+        memcpy(rtc_schedule.bins, rotated, sizeof(rotated));
+        rtc_schedule.hist_synced = 1;
+        realigned = true;
+    }
+    portEXIT_CRITICAL(&schedule_lock);
+
+    ESP_LOGI(TAG, "Clock set to %" PRId64 " (was %" PRId64 ")", epoch_sec, old_sec);
+
+    // Every page load syncs - only write flash when the bins moved
+    return realigned ? schedule_save() : ESP_OK;
+}
+
+void power_schedule_get_info(schedule_info_t *info) {
+    uint16_t bins[SCHEDULE_BINS];
+    float weights[SCHEDULE_BINS];
+
+    portENTER_CRITICAL(&schedule_lock);
+    memcpy(bins, rtc_schedule.bins, sizeof(bins));
+    info->hist_synced = rtc_schedule.hist_synced;
+    info->samples = rtc_schedule.samples;
+    portEXIT_CRITICAL(&schedule_lock);
+
+    schedule_weights(bins, weights);
+
+    info->clock_synced = schedule_clock_synced();
+    info->active = schedule_active();
+    info->time_of_day_sec = schedule_time_of_day();
+    for (int i = 0; i < SCHEDULE_BINS; i++) {
+        info->weight_pct[i] = (uint16_t)(weights[i] * 100.0f + 0.5f);
+    }
+}
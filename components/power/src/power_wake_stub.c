@@ -0,0 +1,205 @@
+// power_wake_stub.c - RTC-resident deep sleep wake stub
+//
+// The stub runs from RTC fast memory before the bootloader loads the app.
+// It may only touch RTC_DATA_ATTR variables and ROM / RTC_IRAM_ATTR code,
+// so the battery check is one ADC1 conversion driven by register writes
+// (deep sleep reset the SAR ADC, and no driver code is resident). The
+// result is a raw code: the app converts its band limits into the stub's
+// own raw scale from the sample taken at the wake that armed the sleep, so
+// no calibration is needed here.
+#include "power_wake_stub.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+#include "esp_wake_stub.h"
+#include "esp_attr.h"
+#include "esp_rom_sys.h"
+#include "soc/soc.h"
+#include "soc/system_reg.h"
+#include "soc/apb_saradc_reg.h"
+#include "soc/regi2c_defs.h"
+
+static const char *TAG = "WAKE_STUB";
+
+#define WAKE_SCHEDULE_MAGIC     0x5354554B  // "STUK"
+#define STUB_ADC_CHANNEL        2           // ADC1 channel of the battery divider (power_mgmt.c)
+#define STUB_ADC_ATTEN          3           // 12 dB, as the app samples
+#define STUB_ADC_TIMEOUT_US     100
+#define STUB_HYSTERESIS_V       0.05f       // Margin outside the band before booting early
+
+typedef struct {
+    uint32_t magic;
+    uint32_t skip_slots;    // Slots the stub still has to sleep through
+    uint32_t slept_slots;   // Slots skipped by the stub during this sleep
+    uint32_t total_skipped; // Skipped wakes since power-on
+    uint64_t slot_us;       // Length of each remaining slot
+    uint32_t boot_below;    // Boot early below / above these raw codes (0 = no limit)
+    uint32_t boot_above;
+    uint32_t last_raw;      // Stub sample at the last wake (0 = none)
+    bool check;             // Battery check armed (the limits are known)
+    bool early;             // Last wake left the schedule: battery out of band
+} wake_schedule_t;
+
+RTC_DATA_ATTR static wake_schedule_t rtc_schedule;
+
+static uint32_t last_skipped = 0;
+static uint32_t boot_raw = 0;
+static bool woke_early = false;
+
+// One ADC1 one-shot conversion, as adc_oneshot does it. Returns 0 when the
+// conversion did not finish, which the stub treats as "boot the app".
+static uint32_t RTC_IRAM_ATTR stub_adc_sample(void) {
+    SET_PERI_REG_MASK(SYSTEM_PERIP_CLK_EN0_REG, SYSTEM_APB_SARADC_CLK_EN);
+    CLEAR_PERI_REG_MASK(SYSTEM_PERIP_RST_EN0_REG, SYSTEM_APB_SARADC_RST);
+    SET_PERI_REG_MASK(APB_SARADC_APB_ADC_CLKM_CONF_REG, APB_SARADC_CLK_EN);
+
+    // Analog side: SAR reachable over regi2c and forced powered up
+    CLEAR_PERI_REG_MASK(ANA_CONFIG_REG, ANA_I2C_SAR_FORCE_PD);
+    SET_PERI_REG_MASK(ANA_CONFIG2_REG, ANA_I2C_SAR_FORCE_PU);
+    SET_PERI_REG_MASK(APB_SARADC_CTRL_REG, APB_SARADC_SAR_CLK_GATED);
+    REG_SET_FIELD(APB_SARADC_CTRL_REG, APB_SARADC_XPD_SAR_FORCE, 3);
+
+    REG_SET_FIELD(APB_SARADC_ONETIME_SAMPLE_REG, APB_SARADC_ONETIME_CHANNEL, STUB_ADC_CHANNEL);
+    REG_SET_FIELD(APB_SARADC_ONETIME_SAMPLE_REG, APB_SARADC_ONETIME_ATTEN, STUB_ADC_ATTEN);
+    SET_PERI_REG_MASK(APB_SARADC_ONETIME_SAMPLE_REG, APB_SARADC1_ONETIME_SAMPLE);
+    WRITE_PERI_REG(APB_SARADC_INT_CLR_REG, APB_SARADC_ADC1_DONE_INT_CLR);
+    SET_PERI_REG_MASK(APB_SARADC_ONETIME_SAMPLE_REG, APB_SARADC_ONETIME_START);
+
+    uint32_t raw = 0;
+    for (int us = 0; us < STUB_ADC_TIMEOUT_US; us++) {
+        if (REG_GET_BIT(APB_SARADC_INT_RAW_REG, APB_SARADC_ADC1_DONE_INT_RAW)) {
+            raw = REG_GET_FIELD(APB_SARADC_1_DATA_STATUS_REG, APB_SARADC_ADC1_DATA) & 0xFFF;
+            break;
+        }
+        esp_rom_delay_us(1);
+    }
+
+    CLEAR_PERI_REG_MASK(APB_SARADC_ONETIME_SAMPLE_REG,
+                        APB_SARADC_ONETIME_START | APB_SARADC1_ONETIME_SAMPLE);
+    REG_SET_FIELD(APB_SARADC_CTRL_REG, APB_SARADC_XPD_SAR_FORCE, 0);
+    CLEAR_PERI_REG_MASK(SYSTEM_PERIP_CLK_EN0_REG, SYSTEM_APB_SARADC_CLK_EN);
+    return raw;
+}
+
+static void RTC_IRAM_ATTR power_wake_stub(void) {
+    esp_default_wake_deep_sleep();
+
+    if (rtc_schedule.magic != WAKE_SCHEDULE_MAGIC) {
+        return;
+    }
+
+    // Sampled on the connect wake too: the app derives the next limits from it
+    uint32_t raw = stub_adc_sample();
+    rtc_schedule.last_raw = raw;
+
+    if (rtc_schedule.skip_slots == 0) {
+        return;  // Connect slot - continue into the app
+    }
+    if (rtc_schedule.check &&
+        (raw == 0 || raw < rtc_schedule.boot_below ||
+         (rtc_schedule.boot_above != 0 && raw >= rtc_schedule.boot_above))) {
+        rtc_schedule.early = true;
+        return;  // Battery left the band the sleep was planned for - re-plan
+    }
+
+    rtc_schedule.skip_slots--;
+    rtc_schedule.slept_slots++;
+    rtc_schedule.total_skipped++;
+
+    esp_wake_stub_set_wakeup_time(rtc_schedule.slot_us);
+    esp_wake_stub_sleep(&power_wake_stub);
+    // Never returns
+}
+
+// A voltage limit in the stub's raw scale, from this wake's stub sample
+static uint32_t limit_raw(float limit_v, float battery_v) {
+    if (limit_v <= 0.0f || boot_raw == 0 || battery_v <= 0.0f) {
+        return 0;
+    }
+    uint32_t raw = (uint32_t)(limit_v * boot_raw / battery_v + 0.5f);
+    return raw > 0 ? raw : 1;
+}
+
+uint64_t power_wake_stub_arm(uint64_t total_us, uint32_t slot_sec,
+                             float battery_v, float min_v, float max_v) {
+    uint64_t slot_us = (uint64_t)slot_sec * 1000000ULL;
+    uint32_t slots = 1;
+    uint64_t first_us = total_us;
+
+    if (slot_us > 0 && total_us > slot_us) {
+        slots = (uint32_t)(total_us / slot_us);
+        // The remainder goes into the first slot so the total is exact
+        first_us = total_us - (uint64_t)(slots - 1) * slot_us;
+    }
+
+    if (rtc_schedule.magic != WAKE_SCHEDULE_MAGIC) {
+        rtc_schedule.total_skipped = 0;
+    }
+    rtc_schedule.magic = WAKE_SCHEDULE_MAGIC;
+    rtc_schedule.skip_slots = slots - 1;
+    rtc_schedule.slept_slots = 0;
+    rtc_schedule.slot_us = slot_us;
+    rtc_schedule.early = false;
+
+    // Without a stub sample from this wake (power-on) the stub only keeps time
+    rtc_schedule.check = boot_raw != 0 && battery_v > 0.0f;
+    rtc_schedule.boot_below = limit_raw(min_v > 0.0f ? min_v - STUB_HYSTERESIS_V : 0.0f,
+                                        battery_v);
+    rtc_schedule.boot_above = limit_raw(max_v > 0.0f ? max_v + STUB_HYSTERESIS_V : 0.0f,
+                                        battery_v);
+
+    esp_set_deep_sleep_wake_stub(&power_wake_stub);
+    if (slots > 1) {
+        ESP_LOGI(TAG, "Sleep split into %" PRIu32 " slots of %" PRIu32 " s, battery check %s (raw %" PRIu32 "..%" PRIu32 ")",
+                slots, slot_sec, rtc_schedule.check ? "on" : "off",
+                rtc_schedule.boot_below, rtc_schedule.boot_above);
+    }
+
+    esp_sleep_enable_timer_wakeup(first_us);
+    return first_us;
+}
+
+uint64_t power_wake_stub_collect(void) {
+    if (rtc_schedule.magic != WAKE_SCHEDULE_MAGIC) {
+        last_skipped = 0;
+        boot_raw = 0;
+        woke_early = false;
+        return 0;
+    }
+
+    last_skipped = rtc_schedule.slept_slots;
+    boot_raw = rtc_schedule.last_raw;
+    woke_early = rtc_schedule.early;
+    if (woke_early) {
+        ESP_LOGW(TAG, "Battery left the planned band (raw %" PRIu32 ") - woke %" PRIu32 " slot(s) early",
+                boot_raw, rtc_schedule.skip_slots);
+    } else if (rtc_schedule.skip_slots != 0) {
+        // Woke before the schedule finished (reset or other wake source)
+        ESP_LOGW(TAG, "Schedule interrupted with %" PRIu32 " slots left", rtc_schedule.skip_slots);
+    }
+    if (last_skipped > 0) {
+        ESP_LOGI(TAG, "Stub slept through %" PRIu32 " slot(s) (%" PRIu32 " total since power-on)",
+                last_skipped, rtc_schedule.total_skipped);
+    }
+
+    uint64_t slept_us = (uint64_t)last_skipped * rtc_schedule.slot_us;
+    rtc_schedule.skip_slots = 0;
+    rtc_schedule.slept_slots = 0;
+    rtc_schedule.early = false;
+    return slept_us;
+}
+
+uint32_t power_wake_stub_last_skipped(void) {
+    return last_skipped;
+}
+
+uint32_t power_wake_stub_total_skipped(void) {
+    return rtc_schedule.magic == WAKE_SCHEDULE_MAGIC ? rtc_schedule.total_skipped : 0;
+}
+
+bool power_wake_stub_woke_early(void) {
+    return woke_early;
+}
+
+uint32_t power_wake_stub_battery_raw(void) {
+    return boot_raw;
+}
@@ -3,6 +3,9 @@
 
 #include <stdint.h>
 
+// Core clock (HFCLK, fixed)
+#define NRF52_CPU_FREQ_MHZ  64
+
 // Memory map
 //#define NRF52_FLASH_BASE    0x00000000
 //#define NRF52_FLASH_SIZE    (1024 * 1024)  // 1MB
@@ -0,0 +1,24 @@
+// swd_boot.h - Target boot-time measurement with the DWT cycle counter
+#ifndef SWD_BOOT_H
+#define SWD_BOOT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+typedef struct {
+    uint32_t cycles;        // CYCCNT from the reset vector to the stop
+    uint32_t us;            // cycles at NRF52_CPU_FREQ_MHZ
+    uint32_t pc;            // Where the core stopped
+    bool watchpoint;        // Stopped by a DWT data watchpoint, not the FPB
+} swd_boot_run_t;
+
+// One run: halt-on-reset, zero CYCCNT at the reset vector, then resume to
+// stop_addr - an FPB breakpoint for a code address (e.g. main) or a DWT
+// write watchpoint for a RAM address (e.g. a ready flag). Needs a connected
+// interface and leaves the core halted with comparators cleared.
+// CYCCNT does not count while the core sleeps (WFI/WFE), so boots that wait
+// on events with the CPU asleep read short.
+esp_err_t swd_boot_measure(uint32_t stop_addr, uint32_t timeout_ms, swd_boot_run_t *run);
+
+#endif // SWD_BOOT_H
@@ -5,6 +5,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "esp_err.h"
+#include "swd_mem.h"
 
 
 // SWD timing configuration
@@ -15,13 +16,16 @@
 #define SWD_FLASH_ERASE_INITIAL_MS  500     // Initial wait for erase before polling
 #define SWD_FLASH_ERASE_POLL_MS     100     // Poll interval during erase (from pyOCD)
 #define SWD_POST_ERASE_STABLE_MS    100     // Stabilization time after erase
+#define SWD_PROBE_POWERUP_US        200     // Probe: max spin for debug power-up ack
+#define SWD_PROBE_WAIT_RETRIES      8       // Probe: WAIT acks retried back to back
 
 // SWD Configuration
 typedef struct {
     int pin_swclk;
     int pin_swdio;
     int pin_reset;  // -1 if not used
-    int delay_cycles;  // Clock delay (0 for fastest)
+    uint32_t swclk_khz;  // SWCLK to hold (0 = SWD_TARGET_KHZ) - the delay is
+                         // recomputed from the actual clock so it does not follow DFS
 } swd_config_t;
 
 // SWD ACK responses
@@ -73,6 +77,23 @@ esp_err_t swd_clear_errors(void);
 
 // Utility
 uint32_t swd_get_idcode(void);
+uint32_t swd_get_transfer_count(void);  // Raw transfers since boot, retries included
+const swd_config_t *swd_get_config(void);
 esp_err_t swd_power_up(void);
 
+// Power management: hold around SWD work - pins the CPU at its maximum clock
+// and blocks light sleep while held (refcounted). Outside of it DFS is free
+// to run the CPU slow; transfers still work, just at a lower bit rate.
+void swd_busy_begin(void);
+void swd_busy_end(void);
+bool swd_is_busy(void);
+
+// Quick look at a running target while no job owns the interface: wake the
+// DP, power up debug, run the word accesses through the MEM-AP, power debug
+// down and leave the DP dormant. Never halts or resets the core and never
+// sleeps, so it takes well under a millisecond. ESP_ERR_INVALID_STATE if
+// the interface is initialized for a job.
+esp_err_t swd_probe(const swd_config_t *cfg, swd_mem_op_t *ops, int count,
+                    uint32_t *elapsed_us);
+
 #endif // SWD_CORE_H
\ No newline at end of file
@@ -0,0 +1,60 @@
+// swd_debug.h - Hardware breakpoints and watchpoints (FPB / DWT comparators)
+#ifndef SWD_DEBUG_H
+#define SWD_DEBUG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#define SWD_DEBUG_MAX_CODE      8       // FPB code comparators tracked
+#define SWD_DEBUG_MAX_WATCH     4       // DWT comparators tracked
+#define SWD_DEBUG_SPIN_MS       20      // Busy DHCSR polling before 1-tick sleeps
+#define SWD_DEBUG_REG_COUNT     17      // R0-R12, SP, LR, PC, xPSR
+
+// DWT FUNCTION values for a halting data watchpoint
+typedef enum {
+    SWD_WATCH_READ = 0x5,
+    SWD_WATCH_WRITE = 0x6,
+    SWD_WATCH_ACCESS = 0x7,
+} swd_watch_type_t;
+
+typedef struct {
+    uint32_t fpb_base;          // From the ROM table
+    uint32_t dwt_base;
+    uint8_t fpb_rev;            // 0 = FPBv1 (code region only), 1 = FPBv2
+    uint8_t num_code;
+    uint8_t num_watch;
+    uint8_t code_used;          // Bitmask of allocated comparators
+    uint8_t watch_used;
+} swd_debug_info_t;
+
+typedef struct {
+    uint32_t dfsr;              // Halt reason (DFSR_* bits)
+    int breakpoint;             // Comparator that matched, -1 if none
+    int watchpoint;
+    uint32_t wait_us;           // Run to halt, as seen by the poll loop
+    uint32_t regs[SWD_DEBUG_REG_COUNT];
+} swd_debug_halt_t;
+
+// Find FPB and DWT through the AHB-AP ROM table and read comparator counts.
+// Called by the functions below when needed; needs a connected interface.
+esp_err_t swd_debug_discover(swd_debug_info_t *info);
+
+// Allocate a comparator (nothing is written to the target until run)
+esp_err_t swd_debug_add_breakpoint(uint32_t addr, int *id);
+esp_err_t swd_debug_add_watchpoint(uint32_t addr, uint32_t size,
+                                   swd_watch_type_t type, int *id);
+esp_err_t swd_debug_remove(bool watchpoint, int id);
+void swd_debug_clear(void);
+
+// Write every comparator, clear DFSR and resume - one batched transfer.
+// A core halted on one of our breakpoints is stepped past it first.
+esp_err_t swd_debug_run(void);
+
+// Poll DHCSR until the core halts, then snapshot the reason and registers
+esp_err_t swd_debug_wait_halt(uint32_t timeout_ms, swd_debug_halt_t *halt);
+
+// Disable all comparators on the target (allocations are kept)
+esp_err_t swd_debug_disarm(void);
+
+#endif // SWD_DEBUG_H
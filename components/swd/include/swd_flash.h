@@ -30,6 +30,12 @@
 #define NVMC_ERASEALL      (NVMC_BASE + 0x50CU)
 #define NVMC_ERASEUICR     (NVMC_BASE + 0x514U)
 #define NVMC_ICACHECNF     (NVMC_BASE + 0x540U)
+#define NVMC_IHIT          (NVMC_BASE + 0x548U)
+#define NVMC_IMISS         (NVMC_BASE + 0x54CU)
+
+// NVMC ICACHECNF bits
+#define NVMC_ICACHECNF_CACHEEN      (1U << 0)
+#define NVMC_ICACHECNF_CACHEPROFEN  (1U << 8)
 
 // NVMC CONFIG values
 #define NVMC_CONFIG_REN    0x00  // Read-only
@@ -51,4 +57,10 @@ esp_err_t swd_flash_disable_approtect(void);
 // Reset and run
 esp_err_t swd_flash_reset_and_run(void);
 
+// Instruction cache profiling: counters on and zeroed, later read and the
+// previous ICACHECNF restored. Neither call halts the core.
+esp_err_t swd_flash_cache_profile_start(uint32_t *saved_icachecnf);
+esp_err_t swd_flash_cache_profile_stop(uint32_t saved_icachecnf,
+                                       uint32_t *hits, uint32_t *misses);
+
 #endif // SWD_FLASH_H
\ No newline at end of file
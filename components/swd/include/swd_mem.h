@@ -36,11 +36,67 @@ esp_err_t swd_mem_read_buffer(uint32_t addr, uint8_t *buffer, uint32_t size);
 // Block write for optimized flash programming
 esp_err_t swd_mem_write_block32(uint32_t addr, const uint32_t *data, uint32_t count);
 
+// One word access for swd_mem_batch() and swd_probe(); reads fill in value
+typedef struct {
+    uint32_t addr;
+    uint32_t value;
+    bool write;
+} swd_mem_op_t;
+
+// Run a list of word accesses with one CSW setup: TAR is written only when
+// the address changes and writes share a single closing RDBUFF read
+esp_err_t swd_mem_batch(swd_mem_op_t *ops, int count);
+
+// Core register access through DCRSR/DCRDR (core must be halted)
+esp_err_t swd_core_reg_read(uint8_t reg, uint32_t *value);
+esp_err_t swd_core_reg_write(uint8_t reg, uint32_t value);
+
+// Block read (auto-increment, one TAR write per 1KB) - half the transfers
+// of swd_mem_read_buffer
+esp_err_t swd_mem_read_block32(uint32_t addr, uint32_t *data, uint32_t count);
+
 // System control registers
 #define DHCSR_ADDR      0xE000EDF0  // Debug Halting Control and Status
 #define DCRSR_ADDR      0xE000EDF4  // Debug Core Register Selector
 #define DCRDR_ADDR      0xE000EDF8  // Debug Core Register Data
 #define DEMCR_ADDR      0xE000EDFC  // Debug Exception and Monitor Control
+#define DFSR_ADDR       0xE000ED30  // Debug Fault Status
+
+// DEMCR bits
+#define DEMCR_TRCENA        (1 << 24)
+#define DEMCR_VC_CORERESET  (1 << 0)
+
+// DFSR bits (write 1 to clear)
+#define DFSR_VCATCH     (1 << 3)
+#define DFSR_DWTTRAP    (1 << 2)
+#define DFSR_BKPT       (1 << 1)
+#define DFSR_HALTED     (1 << 0)
+#define DFSR_ALL        0x1F
+
+// DWT (cycle counter, watchpoint comparator 0)
+#define DWT_CTRL_ADDR       0xE0001000
+#define DWT_CYCCNT_ADDR     0xE0001004
+#define DWT_COMP0_ADDR      0xE0001020
+#define DWT_MASK0_ADDR      0xE0001024
+#define DWT_FUNCTION0_ADDR  0xE0001028
+#define DWT_CTRL_CYCCNTENA  (1 << 0)
+#define DWT_FUNCTION_WRITE  0x6         // Halt on data write to COMP
+
+// FPB (flash patch and breakpoint, v1: code region below 0x20000000)
+#define FP_CTRL_ADDR        0xE0002000
+#define FP_COMP0_ADDR       0xE0002008
+#define FP_CTRL_KEY         (1 << 1)
+#define FP_CTRL_ENABLE      (1 << 0)
+#define FP_COMP_ENABLE      (1 << 0)
+#define FP_COMP_BKPT_LOW    0x40000000  // Break on the lower halfword
+#define FP_COMP_BKPT_HIGH   0x80000000  // Break on the upper halfword
+#define FP_CODE_LIMIT       0x20000000
+
+// Core register numbers for DCRSR
+#define CORE_REG_SP     13
+#define CORE_REG_LR     14
+#define CORE_REG_PC     15
+#define DCRSR_REGWNR    (1 << 16)
 
 // DHCSR bits
 #define DHCSR_DBGKEY    (0xA05F << 16)
@@ -0,0 +1,43 @@
+// swd_sim.h - Simulated nRF52840 behind the SWD transfer layer
+#ifndef SWD_SIM_H
+#define SWD_SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "swd_core.h"
+
+#define SWD_SIM_IDCODE      0x2BA01477      // SW-DP of the nRF52840
+#define SWD_SIM_DIR         "/storage/sim"  // One file per non-erased page
+#define SWD_SIM_RAM_SIZE    4096            // RAM modelled from 0x20000000
+#define SWD_SIM_MAX_REGS    64              // Other registers remembered
+
+// Timing model (nRF52840 datasheet typicals); SWCLK is SWD_SIM_SWCLK_KHZ
+#define SWD_SIM_TRANSFER_CLOCKS     48      // Request, ACK, data, parity, idle
+#define SWD_SIM_ERASE_PAGE_US       85000
+#define SWD_SIM_ERASE_ALL_US        173000
+#define SWD_SIM_PROGRAM_WORD_US     41
+
+typedef struct {
+    uint32_t transfers;         // DP and AP
+    uint32_t ap_reads;
+    uint32_t ap_writes;
+    uint32_t nvmc_stalls;       // Accesses that had to wait for the NVMC
+    uint32_t pages_erased;
+    uint32_t words_programmed;
+    uint64_t wire_us;           // Modelled SWCLK time of all transfers
+    uint64_t model_us;          // Wire time plus NVMC waits: the target side
+                                // of a job on real hardware, as a lower bound
+} swd_sim_stats_t;
+
+// Answer one transfer as the target would (same contract as
+// swd_transfer_raw(): AP reads are posted, the data arrives from RDBUFF)
+swd_ack_t swd_sim_transfer(uint8_t addr, bool ap, bool read, uint32_t *data);
+
+// System reset (nRST or SYSRESETREQ): NVMC read-only, SP/PC from the vector
+// table, halt on exit if reset vector catch is armed
+void swd_sim_reset(void);
+
+// Running totals since boot; false if the simulator is not in use
+bool swd_sim_get_stats(swd_sim_stats_t *stats);
+
+#endif // SWD_SIM_H
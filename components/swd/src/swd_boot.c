@@ -0,0 +1,151 @@
+// swd_boot.c - Target boot-time measurement with the DWT cycle counter
+#include "swd_boot.h"
+#include "swd_core.h"
+#include "swd_mem.h"
+#include "nrf52_hal.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "SWD_BOOT";
+
+#define BOOT_HALT_TIMEOUT_MS    100     // Halt request / reset vector catch
+
+// Poll DHCSR until the core reports halted. With need_reset the halt only
+// counts once S_RESET_ST (cleared on read, hence accumulated) was seen.
+static esp_err_t wait_halt(uint32_t timeout_ms, bool need_reset) {
+    int64_t deadline_us = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    bool reset_seen = !need_reset;
+
+    do {
+        uint32_t dhcsr = 0;
+        esp_err_t ret = swd_mem_read32(DHCSR_ADDR, &dhcsr);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        if (dhcsr & DHCSR_S_RESET) {
+            reset_seen = true;
+        }
+        if (reset_seen && (dhcsr & DHCSR_S_HALT)) {
+            return ESP_OK;
+        }
+        vTaskDelay(1);
+    } while (esp_timer_get_time() < deadline_us);
+
+    return ESP_ERR_TIMEOUT;
+}
+
+// Comparators off, vector catch back as it was - the firmware must not trip
+// over them. demcr is the value read before the run; only TRCENA stays set.
+static esp_err_t clear_stops(uint32_t demcr) {
+    swd_mem_op_t ops[] = {
+        { .addr = FP_COMP0_ADDR, .value = 0, .write = true },
+        { .addr = FP_CTRL_ADDR, .value = FP_CTRL_KEY, .write = true },
+        { .addr = DWT_FUNCTION0_ADDR, .value = 0, .write = true },
+        { .addr = DEMCR_ADDR, .value = demcr | DEMCR_TRCENA, .write = true },
+    };
+    return swd_mem_batch(ops, sizeof(ops) / sizeof(ops[0]));
+}
+
+esp_err_t swd_boot_measure(uint32_t stop_addr, uint32_t timeout_ms, swd_boot_run_t *run) {
+    if (!run) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!swd_is_connected()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    run->watchpoint = stop_addr >= FP_CODE_LIMIT;
+    run->cycles = 0;
+    run->us = 0;
+    run->pc = 0;
+
+    // 1. Halt, arm the reset vector catch and reset the system. DEMCR keeps
+    // whatever else is set in it (other vector catches, monitor bits), and
+    // survives the system reset.
+    uint32_t demcr = 0;
+    esp_err_t ret = swd_mem_read32(DEMCR_ADDR, &demcr);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    swd_mem_op_t reset_ops[] = {
+        { .addr = DHCSR_ADDR, .value = DHCSR_DBGKEY | DHCSR_C_DEBUGEN | DHCSR_C_HALT, .write = true },
+        { .addr = DEMCR_ADDR, .value = demcr | DEMCR_TRCENA | DEMCR_VC_CORERESET, .write = true },
+        { .addr = NRF52_AIRCR, .value = 0x05FA0004, .write = true },  // SYSRESETREQ
+    };
+    ret = swd_mem_batch(reset_ops, sizeof(reset_ops) / sizeof(reset_ops[0]));
+    if (ret == ESP_OK) {
+        ret = wait_halt(BOOT_HALT_TIMEOUT_MS, true);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "No halt at the reset vector: %s", esp_err_to_name(ret));
+        clear_stops(demcr);
+        return ret;
+    }
+
+    // 2. Counter from zero, stop condition armed, resume - in one batch
+    uint32_t dwt_ctrl = 0;
+    ret = swd_mem_read32(DWT_CTRL_ADDR, &dwt_ctrl);
+    if (ret != ESP_OK) {
+        clear_stops(demcr);
+        return ret;
+    }
+
+    swd_mem_op_t run_ops[8];
+    int n = 0;
+    run_ops[n++] = (swd_mem_op_t){ .addr = DWT_CYCCNT_ADDR, .value = 0, .write = true };
+    run_ops[n++] = (swd_mem_op_t){ .addr = DWT_CTRL_ADDR, .value = dwt_ctrl | DWT_CTRL_CYCCNTENA, .write = true };
+    if (run->watchpoint) {
+        run_ops[n++] = (swd_mem_op_t){ .addr = DWT_COMP0_ADDR, .value = stop_addr, .write = true };
+        run_ops[n++] = (swd_mem_op_t){ .addr = DWT_MASK0_ADDR, .value = 0, .write = true };
+        run_ops[n++] = (swd_mem_op_t){ .addr = DWT_FUNCTION0_ADDR, .value = DWT_FUNCTION_WRITE, .write = true };
+    } else {
+        uint32_t comp = (stop_addr & 0x1FFFFFFC) | FP_COMP_ENABLE |
+                        ((stop_addr & 0x2) ? FP_COMP_BKPT_HIGH : FP_COMP_BKPT_LOW);
+        run_ops[n++] = (swd_mem_op_t){ .addr = FP_COMP0_ADDR, .value = comp, .write = true };
+        run_ops[n++] = (swd_mem_op_t){ .addr = FP_CTRL_ADDR, .value = FP_CTRL_KEY | FP_CTRL_ENABLE, .write = true };
+    }
+    run_ops[n++] = (swd_mem_op_t){ .addr = DFSR_ADDR, .value = DFSR_ALL, .write = true };
+    run_ops[n++] = (swd_mem_op_t){ .addr = DHCSR_ADDR, .value = DHCSR_DBGKEY | DHCSR_C_DEBUGEN, .write = true };
+
+    ret = swd_mem_batch(run_ops, n);
+    if (ret != ESP_OK) {
+        clear_stops(demcr);
+        return ret;
+    }
+
+    // 3. The counter stops with the core, so poll latency does not matter
+    ret = wait_halt(timeout_ms, false);
+    if (ret == ESP_ERR_TIMEOUT) {
+        ESP_LOGW(TAG, "0x%08" PRIX32 " not reached within %" PRIu32 " ms", stop_addr, timeout_ms);
+        swd_mem_write32(DHCSR_ADDR, DHCSR_DBGKEY | DHCSR_C_DEBUGEN | DHCSR_C_HALT);
+        wait_halt(BOOT_HALT_TIMEOUT_MS, false);
+    }
+
+    if (ret == ESP_OK) {
+        swd_mem_op_t result_ops[] = {
+            { .addr = DWT_CYCCNT_ADDR },
+            { .addr = DFSR_ADDR },
+        };
+        ret = swd_mem_batch(result_ops, 2);
+        if (ret == ESP_OK) {
+            ret = swd_core_reg_read(CORE_REG_PC, &run->pc);
+        }
+        if (ret == ESP_OK && !(result_ops[1].value & (DFSR_BKPT | DFSR_DWTTRAP))) {
+            ESP_LOGW(TAG, "Core halted for another reason (DFSR 0x%02" PRIX32 ", PC 0x%08" PRIX32 ")",
+                     result_ops[1].value, run->pc);
+            ret = ESP_ERR_INVALID_STATE;
+        }
+        run->cycles = result_ops[0].value;
+        run->us = run->cycles / NRF52_CPU_FREQ_MHZ;
+    }
+
+    esp_err_t clear_ret = clear_stops(demcr);
+    if (ret == ESP_OK) {
+        ret = clear_ret;
+        ESP_LOGI(TAG, "Boot to 0x%08" PRIX32 ": %" PRIu32 " cycles (%" PRIu32 " us), PC 0x%08" PRIX32,
+                 stop_addr, run->cycles, run->us, run->pc);
+    }
+    return ret;
+}
@@ -1,8 +1,14 @@
 // swd_core.c - Complete SWD Protocol Implementation
 #include "swd_core.h"
 #include "swd_mem.h"
+#include "swd_debug.h"
+#include "swd_sim.h"
 #include "nrf52_hal.h"
+#include "config.h"
 #include "esp_log.h"
+#include "esp_pm.h"
+#include "esp_rom_sys.h"
+#include "esp_timer.h"
 #include "driver/gpio.h"
 #include "soc/gpio_struct.h"
 #ifdef CONFIG_IDF_TARGET_ESP32C3
@@ -30,15 +36,60 @@ static swd_config_t config = {0};
 static bool initialized = false;
 static bool connected = false;
 static bool drive_phase = true;
+static uint32_t transfer_count = 0;
 static portMUX_TYPE swd_mutex = portMUX_INITIALIZER_UNLOCKED;
 
+// Power management: the bit engine runs at whatever clock DFS has picked, so
+// the delay loop is recomputed from the actual CPU frequency before each
+// transfer and SWCLK stays at swclk_khz at any clock. A half clock costs the
+// GPIO write and bit handling plus the loop; a clock too slow for the target
+// runs with no delay at all.
+#define SWD_HALF_CLOCK_OVERHEAD_CYCLES  12
+#define SWD_DELAY_LOOP_CYCLES           3
+static esp_pm_lock_handle_t swd_cpu_lock = NULL;
+static esp_pm_lock_handle_t swd_sleep_lock = NULL;
+static uint32_t busy_depth = 0;
+static uint32_t calib_mhz = 0;
+static int delay_loops = 0;
+
 // Timing delay
 static inline void swd_delay(void) {
-    for (int i = 0; i < config.delay_cycles; i++) {
+    for (int i = 0; i < delay_loops; i++) {
         __asm__ __volatile__("nop");
     }
 }
 
+// Recompute the delay loop count if the CPU clock changed since last time
+static void swd_calibrate(void) {
+    uint32_t mhz = esp_rom_get_cpu_ticks_per_us();
+    if (mhz == calib_mhz) {
+        return;
+    }
+
+    calib_mhz = mhz;
+    if (config.swclk_khz == 0) {
+        config.swclk_khz = SWD_TARGET_KHZ;
+    }
+    uint32_t khz = config.swclk_khz;
+    int half_cycles = (int)(mhz * 1000 / (2 * khz));
+    delay_loops = half_cycles > SWD_HALF_CLOCK_OVERHEAD_CYCLES ?
+        (half_cycles - SWD_HALF_CLOCK_OVERHEAD_CYCLES) / SWD_DELAY_LOOP_CYCLES : 0;
+    ESP_LOGD(TAG, "CPU at %" PRIu32 " MHz: %d delay loops per half clock for %" PRIu32 " kHz",
+             mhz, delay_loops, khz);
+}
+
+// Locks are no-ops (left NULL) when CONFIG_PM_ENABLE is off
+static void swd_pm_init(void) {
+    if (swd_cpu_lock) {
+        return;
+    }
+    if (esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "swd_cpu", &swd_cpu_lock) != ESP_OK ||
+        esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "swd_sleep", &swd_sleep_lock) != ESP_OK) {
+        swd_cpu_lock = NULL;
+        swd_sleep_lock = NULL;
+    }
+}
+
 // Clock pulse
 static inline void clock_pulse(void) {
     SWCLK_H();
@@ -47,6 +98,10 @@ static inline void clock_pulse(void) {
     swd_delay();
 }
 
+#if !SWD_SIM_ENABLE
+// The simulator answers transfers itself: only the hardware path of
+// swd_transfer_raw() shifts bits on the wire
+
 // Calculate parity
 static inline bool parity32(uint32_t x) {
     x ^= x >> 16;
@@ -132,6 +187,7 @@ static void write_parking(void) {
     SWDIO_L();
     clock_pulse();
 }
+#endif
 
 // Line reset (50+ clocks high)
 static void line_reset(void) {
@@ -209,6 +265,27 @@ static void dormant_wakeup(void) {
     line_reset();
 }
 
+// Line reset followed by the SWD-to-dormant sequence
+static void enter_dormant(void) {
+    // 50+ clocks with SWDIO high
+    SWDIO_DRIVE();
+    SWDIO_H();
+    for (int i = 0; i < 60; i++) {
+        clock_pulse();
+    }
+
+    // SWD-to-dormant pattern
+    uint32_t dormant_seq = 0xE3BC;
+    for (int i = 0; i < 16; i++) {
+        if (dormant_seq & (1 << i)) {
+            SWDIO_H();
+        } else {
+            SWDIO_L();
+        }
+        clock_pulse();
+    }
+}
+
 // Initialize SWD interface
 esp_err_t swd_init(const swd_config_t *cfg) {
     if (!cfg) {
@@ -216,6 +293,9 @@ esp_err_t swd_init(const swd_config_t *cfg) {
     }
     
     config = *cfg;
+    calib_mhz = 0;
+    swd_calibrate();
+    swd_pm_init();
     
     // Initialize GPIOs
     gpio_reset_pin((gpio_num_t)config.pin_swclk);
@@ -248,6 +328,11 @@ esp_err_t swd_init(const swd_config_t *cfg) {
 
 // Raw SWD transfer
 swd_ack_t swd_transfer_raw(uint8_t addr, bool ap, bool read, uint32_t *data) {
+    transfer_count++;
+#if SWD_SIM_ENABLE
+    return swd_sim_transfer(addr, ap, read, data);
+#else
+    swd_calibrate();
     portENTER_CRITICAL(&swd_mutex);
     
     // Send request
@@ -300,6 +385,7 @@ swd_ack_t swd_transfer_raw(uint8_t addr, bool ap, bool read, uint32_t *data) {
     }
     
     return (swd_ack_t)ack;
+#endif
 }
 
 // DP read with retry
@@ -343,7 +429,7 @@ esp_err_t swd_dp_write(uint8_t addr, uint32_t data) {
         }
     }
     
-    ESP_LOGE(TAG, "DP write failed: addr=0x%02X data=0x%08lX", addr, data);
+    ESP_LOGE(TAG, "DP write failed: addr=0x%02X data=0x%08" PRIX32, addr, data);
     return ESP_FAIL;
 }
 
@@ -370,25 +456,8 @@ esp_err_t swd_dp_disconnect(void) {
         vTaskDelay(pdMS_TO_TICKS(10));
     }
 
-    // 3. Send disconnect sequence (50+ clocks with SWDIO high)
-    // This is the JTAG-to-dormant sequence that puts the DP in dormant state
-    SWDIO_DRIVE();
-    SWDIO_H();
-    for (int i = 0; i < 60; i++) {
-        clock_pulse();
-    }
-
-    // 4. Send SWD-to-dormant sequence (specific pattern)
-    // This ensures the DP is fully dormant
-    uint32_t dormant_seq = 0xE3BC;  // SWD to dormant
-    for (int i = 0; i < 16; i++) {
-        if (dormant_seq & (1 << i)) {
-            SWDIO_H();
-        } else {
-            SWDIO_L();
-        }
-        clock_pulse();
-    }
+    // 3. Disconnect sequence - puts the DP in dormant state
+    enter_dormant();
 
     ESP_LOGI(TAG, "DP disconnect complete");
     return ESP_OK;
@@ -435,7 +504,7 @@ esp_err_t swd_ap_write(uint8_t addr, uint32_t data) {
         }
     }
     
-    ESP_LOGE(TAG, "AP write failed: addr=0x%02X data=0x%08lX", addr, data);
+    ESP_LOGE(TAG, "AP write failed: addr=0x%02X data=0x%08" PRIX32, addr, data);
     return ESP_FAIL;
 }
 
@@ -446,6 +515,7 @@ esp_err_t swd_connect(void) {
     }
     
     ESP_LOGI(TAG, "Attempting SWD connection...");
+    swd_calibrate();
     
     // Try dormant wakeup first
     dormant_wakeup();
@@ -467,7 +537,7 @@ esp_err_t swd_connect(void) {
         }
     }
     
-    ESP_LOGI(TAG, "Connected: IDCODE=0x%08lX", idcode);
+    ESP_LOGI(TAG, "Connected: IDCODE=0x%08" PRIX32, idcode);
     
     // Power up debug domain
     ret = swd_power_up();
@@ -523,6 +593,9 @@ esp_err_t swd_reset_target(void) {
     gpio_set_level((gpio_num_t)config.pin_reset, 0);  // LOW = Reset asserted
     vTaskDelay(pdMS_TO_TICKS(10));  // Hold reset for 10ms
     gpio_set_level((gpio_num_t)config.pin_reset, 1);  // HIGH = Release reset
+#if SWD_SIM_ENABLE
+    swd_sim_reset();
+#endif
 
     // CRITICAL: Wait for target to complete reset sequence
     // Don't poll during this time - target is not responding
@@ -542,10 +615,10 @@ esp_err_t swd_reset_target(void) {
     }
 
     if (ret == ESP_OK && idcode != 0 && idcode != 0xFFFFFFFF) {
-        ESP_LOGI(TAG, "Target reset complete, IDCODE: 0x%08lX", idcode);
+        ESP_LOGI(TAG, "Target reset complete, IDCODE: 0x%08" PRIX32, idcode);
         return ESP_OK;
     } else {
-        ESP_LOGE(TAG, "Target not responding after reset (IDCODE: 0x%08lX)", idcode);
+        ESP_LOGE(TAG, "Target not responding after reset (IDCODE: 0x%08" PRIX32 ")", idcode);
         return ESP_FAIL;
     }
 }
@@ -558,6 +631,14 @@ esp_err_t swd_clear_errors(void) {
     return swd_dp_write(DP_ABORT, abort_val);
 }
 
+const swd_config_t *swd_get_config(void) {
+    return &config;
+}
+
+uint32_t swd_get_transfer_count(void) {
+    return transfer_count;
+}
+
 // Get IDCODE
 uint32_t swd_get_idcode(void) {
     uint32_t idcode = 0;
@@ -604,7 +685,7 @@ esp_err_t swd_power_up(void) {
         bool csys_up = (status & 0x80000000) != 0;
 
         if (cdbg_up && csys_up) {
-            ESP_LOGI(TAG, "Debug powered up: status=0x%08lX", status);
+            ESP_LOGI(TAG, "Debug powered up: status=0x%08" PRIX32, status);
 
             // Clear any sticky errors that might have occurred during power-up
             swd_clear_errors();
@@ -615,13 +696,13 @@ esp_err_t swd_power_up(void) {
         uint32_t delay_ms = 5 << (retry / 4);  // Increases every 4 retries
         if (delay_ms > 100) delay_ms = 100;    // Cap at 100ms
 
-        ESP_LOGD(TAG, "Waiting for power-up ack (retry %d, delay %lums): CDBG=%d CSYS=%d",
+        ESP_LOGD(TAG, "Waiting for power-up ack (retry %d, delay %" PRIu32 "ms): CDBG=%d CSYS=%d",
                 retry, delay_ms, cdbg_up, csys_up);
 
         vTaskDelay(pdMS_TO_TICKS(delay_ms));
     }
 
-    ESP_LOGE(TAG, "Debug power-up timeout (final status: 0x%08lX)", status);
+    ESP_LOGE(TAG, "Debug power-up timeout (final status: 0x%08" PRIX32 ")", status);
     return ESP_ERR_TIMEOUT;
 }
 
@@ -640,9 +721,16 @@ esp_err_t swd_release_target(void) {
 
     ESP_LOGI(TAG, "Releasing target from debug mode...");
 
+    // 0. FPB/DWT survive a system reset - an armed breakpoint would
+    //    HardFault the firmware once DEBUGEN is off
+    esp_err_t ret = swd_debug_disarm();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to disarm comparators");
+    }
+
     // 1. Resume core if halted
     uint32_t dhcsr;
-    esp_err_t ret = swd_mem_read32(DHCSR_ADDR, &dhcsr);
+    ret = swd_mem_read32(DHCSR_ADDR, &dhcsr);
     if (ret == ESP_OK && (dhcsr & DHCSR_S_HALT)) {
         ESP_LOGI(TAG, "Core is halted, resuming...");
         ret = swd_mem_write32(DHCSR_ADDR, DHCSR_DBGKEY | DHCSR_C_DEBUGEN);
@@ -668,6 +756,9 @@ esp_err_t swd_release_target(void) {
         gpio_set_level((gpio_num_t)config.pin_reset, 0);
         vTaskDelay(pdMS_TO_TICKS(100));
         gpio_set_level((gpio_num_t)config.pin_reset, 1);
+#if SWD_SIM_ENABLE
+        swd_sim_reset();
+#endif
         vTaskDelay(pdMS_TO_TICKS(100));
     } else {
         ESP_LOGI(TAG, "Performing software reset via AIRCR...");
@@ -752,4 +843,144 @@ esp_err_t swd_reinit(void) {
     }
     
     return swd_init(&config);
+}
+
+void swd_busy_begin(void) {
+    swd_pm_init();
+    if (swd_cpu_lock) {
+        esp_pm_lock_acquire(swd_cpu_lock);
+        esp_pm_lock_acquire(swd_sleep_lock);
+    }
+
+    portENTER_CRITICAL(&swd_mutex);
+    busy_depth++;
+    portEXIT_CRITICAL(&swd_mutex);
+
+    swd_calibrate();
+}
+
+void swd_busy_end(void) {
+    portENTER_CRITICAL(&swd_mutex);
+    bool held = busy_depth > 0;
+    if (held) {
+        busy_depth--;
+    }
+    portEXIT_CRITICAL(&swd_mutex);
+
+    if (held && swd_cpu_lock) {
+        esp_pm_lock_release(swd_sleep_lock);
+        esp_pm_lock_release(swd_cpu_lock);
+    }
+}
+
+bool swd_is_busy(void) {
+    return busy_depth > 0;
+}
+
+// Raw transfer, retrying WAIT without sleeping (probe path only)
+static swd_ack_t probe_transfer(uint8_t addr, bool ap, bool read, uint32_t *data) {
+    swd_ack_t ack = SWD_ACK_WAIT;
+    for (int i = 0; i < SWD_PROBE_WAIT_RETRIES && ack == SWD_ACK_WAIT; i++) {
+        ack = swd_transfer_raw(addr, ap, read, data);
+    }
+    return ack;
+}
+
+static esp_err_t probe_run(swd_mem_op_t *ops, int count) {
+    uint32_t value = 0;
+
+    // Wake from dormant (our own probes leave it there), JTAG-to-SWD fallback
+    dormant_wakeup();
+    if (probe_transfer(DP_IDCODE, false, true, &value) != SWD_ACK_OK) {
+        line_reset();
+        jtag_to_swd();
+        if (probe_transfer(DP_IDCODE, false, true, &value) != SWD_ACK_OK) {
+            return ESP_ERR_NOT_FOUND;
+        }
+    }
+
+    value = 0x1E;  // Clear sticky errors
+    probe_transfer(DP_ABORT, false, false, &value);
+
+    // Debug power: spin on CTRL/STAT instead of the scheduler-paced swd_power_up
+    value = 0x50000000;
+    if (probe_transfer(DP_CTRL_STAT, false, false, &value) != SWD_ACK_OK) {
+        return ESP_FAIL;
+    }
+    int64_t deadline_us = esp_timer_get_time() + SWD_PROBE_POWERUP_US;
+    do {
+        if (probe_transfer(DP_CTRL_STAT, false, true, &value) != SWD_ACK_OK) {
+            return ESP_FAIL;
+        }
+    } while ((value & 0xA0000000) != 0xA0000000 && esp_timer_get_time() < deadline_us);
+
+    esp_err_t ret = (value & 0xA0000000) == 0xA0000000 ? ESP_OK : ESP_ERR_TIMEOUT;
+
+    if (ret == ESP_OK) {
+        // AP 0, bank 0; word access without auto-increment
+        value = 0;
+        uint32_t csw = CSW_SIZE_32BIT | CSW_DEVICE_EN | CSW_MASTER_DBG | CSW_HPROT;
+        if (probe_transfer(DP_SELECT, false, false, &value) != SWD_ACK_OK ||
+            probe_transfer(AP_CSW, true, false, &csw) != SWD_ACK_OK) {
+            ret = ESP_FAIL;
+        }
+
+        for (int i = 0; i < count && ret == ESP_OK; i++) {
+            uint32_t addr = ops[i].addr;
+            if (probe_transfer(AP_TAR, true, false, &addr) != SWD_ACK_OK) {
+                ret = ESP_FAIL;
+            } else if (ops[i].write) {
+                if (probe_transfer(AP_DRW, true, false, &ops[i].value) != SWD_ACK_OK) {
+                    ret = ESP_FAIL;
+                }
+            } else if (probe_transfer(AP_DRW, true, true, &value) != SWD_ACK_OK ||
+                       probe_transfer(DP_RDBUFF, false, true, &ops[i].value) != SWD_ACK_OK) {
+                ret = ESP_FAIL;
+            }
+        }
+    }
+
+    // Drop debug power again - a powered debug domain costs the target current
+    value = 0;
+    probe_transfer(DP_CTRL_STAT, false, false, &value);
+    return ret;
+}
+
+esp_err_t swd_probe(const swd_config_t *cfg, swd_mem_op_t *ops, int count,
+                    uint32_t *elapsed_us) {
+    if (!cfg || (!ops && count > 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (initialized) {
+        return ESP_ERR_INVALID_STATE;  // A job owns the interface
+    }
+
+    config = *cfg;
+    calib_mhz = 0;
+    swd_calibrate();
+
+    int64_t start_us = esp_timer_get_time();
+
+    // Claim SWCLK/SWDIO only; nRST is left alone so the target never resets
+    gpio_set_direction((gpio_num_t)config.pin_swclk, GPIO_MODE_OUTPUT);
+    gpio_set_direction((gpio_num_t)config.pin_swdio, GPIO_MODE_INPUT_OUTPUT);
+    gpio_set_pull_mode((gpio_num_t)config.pin_swdio, GPIO_PULLUP_ONLY);
+    SWCLK_L();
+    SWDIO_H();
+    SWDIO_DRIVE();
+    drive_phase = true;
+
+    esp_err_t ret = probe_run(ops, count);
+
+    enter_dormant();
+    gpio_set_direction((gpio_num_t)config.pin_swclk, GPIO_MODE_INPUT);
+    gpio_set_direction((gpio_num_t)config.pin_swdio, GPIO_MODE_INPUT);
+    gpio_set_pull_mode((gpio_num_t)config.pin_swclk, GPIO_FLOATING);
+    gpio_set_pull_mode((gpio_num_t)config.pin_swdio, GPIO_FLOATING);
+    drive_phase = true;
+
+    if (elapsed_us) {
+        *elapsed_us = (uint32_t)(esp_timer_get_time() - start_us);
+    }
+    return ret;
 }
\ No newline at end of file
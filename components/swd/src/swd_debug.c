@@ -0,0 +1,403 @@
+// swd_debug.c - Hardware breakpoints and watchpoints (FPB / DWT comparators)
+//
+// Comparators are allocated here and only written to the target by
+// swd_debug_run(), together with the enables, the DFSR clear and the resume,
+// as a single swd_mem_batch(). FPB and DWT are located through the AHB-AP
+// ROM table rather than assumed at their Cortex-M4 addresses.
+#include "swd_debug.h"
+#include "swd_core.h"
+#include "swd_mem.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <string.h>
+
+static const char *TAG = "SWD_DEBUG";
+
+// AHB-AP BASE register: AP 0, bank 0xF, offset 0x8
+#define AP_BASE_SELECT      0x000000F0
+#define AP_BASE_REG         0x08
+
+// CoreSight component identification
+#define ROM_MAX_ENTRIES     32
+#define PIDR0_OFFSET        0xFE0
+#define PIDR1_OFFSET        0xFE4
+#define PART_DWT            0x002
+#define PART_FPB_V1         0x003
+#define PART_FPB_V2         0x00E
+
+// Offsets from the discovered bases
+#define FPB_CTRL            0x000
+#define FPB_COMP(n)         (0x008 + 4 * (n))
+#define DWT_CTRL            0x000
+#define DWT_COMP(n)         (0x020 + 16 * (n))
+#define DWT_MASK(n)         (0x024 + 16 * (n))
+#define DWT_FUNCTION(n)     (0x028 + 16 * (n))
+#define DWT_FUNCTION_MATCHED (1UL << 24)
+
+#define STEP_TIMEOUT_MS     100
+#define POLL_BATCH          8
+
+typedef struct {
+    uint32_t addr;
+    uint32_t mask;              // log2 of the watched size
+    swd_watch_type_t type;
+} watch_slot_t;
+
+static swd_debug_info_t dbg;
+static bool discovered = false;
+static uint32_t code_addr[SWD_DEBUG_MAX_CODE];
+static watch_slot_t watch[SWD_DEBUG_MAX_WATCH];
+
+static esp_err_t read_rom_base(uint32_t *base) {
+    esp_err_t ret = swd_dp_write(DP_SELECT, AP_BASE_SELECT);
+    if (ret == ESP_OK) {
+        ret = swd_ap_read(AP_BASE_REG, base);
+    }
+    esp_err_t select_ret = swd_dp_write(DP_SELECT, 0x00000000);
+    return ret != ESP_OK ? ret : select_ret;
+}
+
+esp_err_t swd_debug_discover(swd_debug_info_t *info) {
+    if (!swd_is_connected()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (!discovered) {
+        uint32_t base = 0;
+        esp_err_t ret = read_rom_base(&base);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        if (base == 0xFFFFFFFF || !(base & 0x1)) {
+            ESP_LOGE(TAG, "No ROM table (BASE 0x%08" PRIX32 ")", base);
+            return ESP_ERR_NOT_FOUND;
+        }
+
+        uint32_t rom = base & 0xFFFFF000;
+        uint32_t fpb = 0;
+        uint32_t dwt = 0;
+
+        for (int i = 0; i < ROM_MAX_ENTRIES; i++) {
+            uint32_t entry = 0;
+            ret = swd_mem_read32(rom + 4 * i, &entry);
+            if (ret != ESP_OK) {
+                return ret;
+            }
+            if (entry == 0) {
+                break;
+            }
+            if (!(entry & 0x1)) {
+                continue;  // Not present
+            }
+
+            // Offset is two's complement - unsigned wrap-around does the sign
+            uint32_t component = rom + (entry & 0xFFFFF000);
+            swd_mem_op_t pid[2] = {
+                { .addr = component + PIDR0_OFFSET },
+                { .addr = component + PIDR1_OFFSET },
+            };
+            if (swd_mem_batch(pid, 2) != ESP_OK) {
+                continue;
+            }
+
+            uint32_t part = (pid[0].value & 0xFF) | ((pid[1].value & 0xF) << 8);
+            if (part == PART_DWT) {
+                dwt = component;
+            } else if (part == PART_FPB_V1 || part == PART_FPB_V2) {
+                fpb = component;
+            }
+        }
+
+        if (!fpb || !dwt) {
+            ESP_LOGE(TAG, "ROM table at 0x%08" PRIX32 " lists FPB 0x%08" PRIX32 ", DWT 0x%08" PRIX32,
+                     rom, fpb, dwt);
+            return ESP_ERR_NOT_FOUND;
+        }
+
+        swd_mem_op_t ctrl[2] = {
+            { .addr = fpb + FPB_CTRL },
+            { .addr = dwt + DWT_CTRL },
+        };
+        ret = swd_mem_batch(ctrl, 2);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+
+        uint32_t num_code = ((ctrl[0].value >> 4) & 0xF) | (((ctrl[0].value >> 12) & 0x7) << 4);
+        uint32_t num_watch = ctrl[1].value >> 28;
+
+        dbg.fpb_base = fpb;
+        dbg.dwt_base = dwt;
+        dbg.fpb_rev = ctrl[0].value >> 28;
+        dbg.num_code = num_code > SWD_DEBUG_MAX_CODE ? SWD_DEBUG_MAX_CODE : num_code;
+        dbg.num_watch = num_watch > SWD_DEBUG_MAX_WATCH ? SWD_DEBUG_MAX_WATCH : num_watch;
+        discovered = true;
+
+        ESP_LOGI(TAG, "FPB at 0x%08" PRIX32 " (rev %u, %u code), DWT at 0x%08" PRIX32 " (%u comparators)",
+                 fpb, dbg.fpb_rev, dbg.num_code, dwt, dbg.num_watch);
+    }
+
+    if (info) {
+        *info = dbg;
+    }
+    return ESP_OK;
+}
+
+esp_err_t swd_debug_add_breakpoint(uint32_t addr, int *id) {
+    esp_err_t ret = swd_debug_discover(NULL);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (dbg.fpb_rev == 0 && addr >= FP_CODE_LIMIT) {
+        return ESP_ERR_INVALID_ARG;  // FPBv1 only matches the code region
+    }
+
+    for (int i = 0; i < dbg.num_code; i++) {
+        if (!(dbg.code_used & (1 << i))) {
+            dbg.code_used |= 1 << i;
+            code_addr[i] = addr & ~0x1;  // Thumb bit
+            if (id) *id = i;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+esp_err_t swd_debug_add_watchpoint(uint32_t addr, uint32_t size,
+                                   swd_watch_type_t type, int *id) {
+    esp_err_t ret = swd_debug_discover(NULL);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    // DWT matches a naturally aligned power-of-two range
+    uint32_t mask = 0;
+    while ((1UL << mask) < size && mask < 15) {
+        mask++;
+    }
+    if (size == 0 || (1UL << mask) != size || (addr & (size - 1))) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (type != SWD_WATCH_READ && type != SWD_WATCH_WRITE && type != SWD_WATCH_ACCESS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    for (int i = 0; i < dbg.num_watch; i++) {
+        if (!(dbg.watch_used & (1 << i))) {
+            dbg.watch_used |= 1 << i;
+            watch[i] = (watch_slot_t){ .addr = addr, .mask = mask, .type = type };
+            if (id) *id = i;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+esp_err_t swd_debug_remove(bool watchpoint, int id) {
+    uint8_t *used = watchpoint ? &dbg.watch_used : &dbg.code_used;
+    if (id < 0 || id >= 8 || !(*used & (1 << id))) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    *used &= ~(1 << id);
+    return ESP_OK;
+}
+
+void swd_debug_clear(void) {
+    dbg.code_used = 0;
+    dbg.watch_used = 0;
+}
+
+static uint32_t fpb_comp_value(uint32_t addr) {
+    if (dbg.fpb_rev == 0) {
+        return (addr & 0x1FFFFFFC) | FP_COMP_ENABLE |
+               ((addr & 0x2) ? FP_COMP_BKPT_HIGH : FP_COMP_BKPT_LOW);
+    }
+    return addr | FP_COMP_ENABLE;  // FPBv2: plain address, BE in bit 0
+}
+
+static esp_err_t wait_halted(uint32_t timeout_ms, uint32_t *elapsed_us) {
+    swd_mem_op_t polls[POLL_BATCH];
+    for (int i = 0; i < POLL_BATCH; i++) {
+        polls[i] = (swd_mem_op_t){ .addr = DHCSR_ADDR };
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    for (;;) {
+        // TAR stays on DHCSR, so each poll is a single AP read
+        esp_err_t ret = swd_mem_batch(polls, POLL_BATCH);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+
+        int64_t elapsed = esp_timer_get_time() - start_us;
+        for (int i = 0; i < POLL_BATCH; i++) {
+            if (polls[i].value & DHCSR_S_HALT) {
+                if (elapsed_us) *elapsed_us = (uint32_t)elapsed;
+                return ESP_OK;
+            }
+        }
+
+        if (elapsed >= (int64_t)timeout_ms * 1000) {
+            return ESP_ERR_TIMEOUT;
+        }
+        if (elapsed > SWD_DEBUG_SPIN_MS * 1000) {
+            vTaskDelay(1);
+        }
+    }
+}
+
+// Resuming on an armed breakpoint would halt again at once: step one
+// instruction with the FPB off and interrupts masked. C_MASKINTS may only
+// change while halted, so it is cleared again before swd_debug_run resumes.
+static esp_err_t step_off_breakpoint(void) {
+    uint32_t dhcsr = 0;
+    esp_err_t ret = swd_mem_read32(DHCSR_ADDR, &dhcsr);
+    if (ret != ESP_OK || !(dhcsr & DHCSR_S_HALT) || !dbg.code_used) {
+        return ret;
+    }
+
+    uint32_t pc = 0;
+    ret = swd_core_reg_read(CORE_REG_PC, &pc);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    bool on_breakpoint = false;
+    for (int i = 0; i < dbg.num_code; i++) {
+        if ((dbg.code_used & (1 << i)) && code_addr[i] == pc) {
+            on_breakpoint = true;
+        }
+    }
+    if (!on_breakpoint) {
+        return ESP_OK;
+    }
+
+    swd_mem_op_t ops[] = {
+        { .addr = dbg.fpb_base + FPB_CTRL, .value = FP_CTRL_KEY, .write = true },
+        { .addr = DHCSR_ADDR, .value = DHCSR_DBGKEY | DHCSR_C_DEBUGEN | DHCSR_C_HALT | DHCSR_C_MASKINTS, .write = true },
+        { .addr = DHCSR_ADDR, .value = DHCSR_DBGKEY | DHCSR_C_DEBUGEN | DHCSR_C_STEP | DHCSR_C_MASKINTS, .write = true },
+    };
+    ret = swd_mem_batch(ops, 3);
+    if (ret == ESP_OK) {
+        ret = wait_halted(STEP_TIMEOUT_MS, NULL);
+    }
+    if (ret == ESP_OK) {
+        ret = swd_mem_write32(DHCSR_ADDR, DHCSR_DBGKEY | DHCSR_C_DEBUGEN | DHCSR_C_HALT);
+    }
+    return ret;
+}
+
+esp_err_t swd_debug_run(void) {
+    esp_err_t ret = swd_debug_discover(NULL);
+    if (ret == ESP_OK) {
+        ret = step_off_breakpoint();
+    }
+    // DWT needs TRCENA; the rest of DEMCR (vector catches) is the debugger's
+    uint32_t demcr = 0;
+    if (ret == ESP_OK) {
+        ret = swd_mem_read32(DEMCR_ADDR, &demcr);
+    }
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    swd_mem_op_t ops[4 + SWD_DEBUG_MAX_CODE + 3 * SWD_DEBUG_MAX_WATCH];
+    int n = 0;
+
+    ops[n++] = (swd_mem_op_t){ .addr = DEMCR_ADDR, .value = demcr | DEMCR_TRCENA, .write = true };
+    ops[n++] = (swd_mem_op_t){ .addr = dbg.fpb_base + FPB_CTRL, .write = true,
+                               .value = FP_CTRL_KEY | (dbg.code_used ? FP_CTRL_ENABLE : 0) };
+    for (int i = 0; i < dbg.num_code; i++) {
+        bool used = dbg.code_used & (1 << i);
+        ops[n++] = (swd_mem_op_t){ .addr = dbg.fpb_base + FPB_COMP(i), .write = true,
+                                   .value = used ? fpb_comp_value(code_addr[i]) : 0 };
+    }
+    for (int i = 0; i < dbg.num_watch; i++) {
+        if (dbg.watch_used & (1 << i)) {
+            ops[n++] = (swd_mem_op_t){ .addr = dbg.dwt_base + DWT_COMP(i), .value = watch[i].addr, .write = true };
+            ops[n++] = (swd_mem_op_t){ .addr = dbg.dwt_base + DWT_MASK(i), .value = watch[i].mask, .write = true };
+        }
+        ops[n++] = (swd_mem_op_t){ .addr = dbg.dwt_base + DWT_FUNCTION(i), .write = true,
+                                   .value = (dbg.watch_used & (1 << i)) ? watch[i].type : 0 };
+    }
+    ops[n++] = (swd_mem_op_t){ .addr = DFSR_ADDR, .value = DFSR_ALL, .write = true };
+    ops[n++] = (swd_mem_op_t){ .addr = DHCSR_ADDR, .value = DHCSR_DBGKEY | DHCSR_C_DEBUGEN, .write = true };
+
+    ret = swd_mem_batch(ops, n);
+    if (ret == ESP_OK) {
+        ESP_LOGI(TAG, "Running with breakpoints 0x%02X, watchpoints 0x%02X",
+                 dbg.code_used, dbg.watch_used);
+    }
+    return ret;
+}
+
+esp_err_t swd_debug_wait_halt(uint32_t timeout_ms, swd_debug_halt_t *halt) {
+    if (!halt) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(halt, 0, sizeof(*halt));
+    halt->breakpoint = -1;
+    halt->watchpoint = -1;
+
+    esp_err_t ret = wait_halted(timeout_ms, &halt->wait_us);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    // MATCHED clears on read - collect it with DFSR in one go
+    swd_mem_op_t ops[1 + SWD_DEBUG_MAX_WATCH];
+    int n = 0;
+    ops[n++] = (swd_mem_op_t){ .addr = DFSR_ADDR };
+    for (int i = 0; i < dbg.num_watch; i++) {
+        ops[n++] = (swd_mem_op_t){ .addr = dbg.dwt_base + DWT_FUNCTION(i) };
+    }
+    ret = swd_mem_batch(ops, n);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    halt->dfsr = ops[0].value;
+    for (int i = 0; i < dbg.num_watch; i++) {
+        if ((dbg.watch_used & (1 << i)) && (ops[1 + i].value & DWT_FUNCTION_MATCHED)) {
+            halt->watchpoint = i;
+            break;
+        }
+    }
+
+    for (int r = 0; r < SWD_DEBUG_REG_COUNT && ret == ESP_OK; r++) {
+        ret = swd_core_reg_read(r, &halt->regs[r]);
+    }
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    uint32_t pc = halt->regs[CORE_REG_PC];
+    for (int i = 0; i < dbg.num_code; i++) {
+        if ((dbg.code_used & (1 << i)) && code_addr[i] == pc) {
+            halt->breakpoint = i;
+            break;
+        }
+    }
+
+    ESP_LOGI(TAG, "Halted at PC 0x%08" PRIX32 " after %" PRIu32 " us (DFSR 0x%02" PRIX32 ", bp %d, wp %d)",
+             pc, halt->wait_us, halt->dfsr, halt->breakpoint, halt->watchpoint);
+    return ESP_OK;
+}
+
+esp_err_t swd_debug_disarm(void) {
+    if (!discovered) {
+        return ESP_OK;  // Nothing of ours on the target
+    }
+
+    swd_mem_op_t ops[1 + SWD_DEBUG_MAX_CODE + SWD_DEBUG_MAX_WATCH];
+    int n = 0;
+    ops[n++] = (swd_mem_op_t){ .addr = dbg.fpb_base + FPB_CTRL, .value = FP_CTRL_KEY, .write = true };
+    for (int i = 0; i < dbg.num_code; i++) {
+        ops[n++] = (swd_mem_op_t){ .addr = dbg.fpb_base + FPB_COMP(i), .value = 0, .write = true };
+    }
+    for (int i = 0; i < dbg.num_watch; i++) {
+        ops[n++] = (swd_mem_op_t){ .addr = dbg.dwt_base + DWT_FUNCTION(i), .value = 0, .write = true };
+    }
+    return swd_mem_batch(ops, n);
+}
@@ -3,6 +3,7 @@
 #include "swd_core.h"
 #include "swd_mem.h"
 #include "esp_log.h"
+#include "binlog.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "nrf52_hal.h"
@@ -41,7 +42,7 @@ static esp_err_t wait_nvmc_ready(uint32_t timeout_ms) {
         vTaskDelay(pdMS_TO_TICKS(1));
     }
     
-    ESP_LOGE(TAG, "NVMC timeout (ready=0x%08lX)", ready);
+    ESP_LOGE(TAG, "NVMC timeout (ready=0x%08" PRIX32 ")", ready);
     return ESP_ERR_TIMEOUT;
 }
 
@@ -59,7 +60,7 @@ static esp_err_t set_nvmc_config(uint32_t mode) {
     if (ret != ESP_OK) return ret;
     
     if ((config & 0x3) != mode) {
-        ESP_LOGE(TAG, "Failed to set NVMC mode %lu", mode);
+        ESP_LOGE(TAG, "Failed to set NVMC mode %" PRIu32, mode);
         return ESP_FAIL;
     }
     
@@ -70,14 +71,14 @@ static esp_err_t set_nvmc_config(uint32_t mode) {
 esp_err_t swd_flash_erase_page(uint32_t addr) {
     // New (correct) - UICR is at 0x10001000 and is valid
     if (addr >= NRF52_FLASH_SIZE && addr != 0x10001000) {
-        ESP_LOGE(TAG, "Address 0x%08lX out of range", addr);
+        ESP_LOGE(TAG, "Address 0x%08" PRIX32 " out of range", addr);
         return ESP_ERR_INVALID_ARG;
     }
     
     // Align to page boundary
     addr &= ~(NRF52_FLASH_PAGE_SIZE - 1);
     
-    ESP_LOGI(TAG, "Erasing page at 0x%08lX", addr);
+    binlog_write(BINLOG_FLASH_ERASE_PAGE, addr, 0, 0);
     
     // Wait for NVMC to be ready before starting
     esp_err_t ret = wait_nvmc_ready(500);
@@ -97,7 +98,7 @@ esp_err_t swd_flash_erase_page(uint32_t addr) {
     uint32_t config;
     ret = swd_mem_read32(NVMC_CONFIG, &config);
     if (ret != ESP_OK || (config & 0x3) != NVMC_CONFIG_EEN) {
-        ESP_LOGE(TAG, "Erase mode not properly set (config=0x%08lX)", config);
+        ESP_LOGE(TAG, "Erase mode not properly set (config=0x%08" PRIX32 ")", config);
         set_nvmc_config(NVMC_CONFIG_REN);
         return ESP_FAIL;
     }
@@ -126,7 +127,7 @@ esp_err_t swd_flash_erase_page(uint32_t addr) {
         }
         
         if (ready & 0x1) {
-            ESP_LOGD(TAG, "Erase complete after %lu ms", elapsed_ms);
+            binlog_write(BINLOG_FLASH_ERASE_DONE, elapsed_ms, 0, 0);
             break;
         }
         
@@ -135,7 +136,7 @@ esp_err_t swd_flash_erase_page(uint32_t addr) {
     }
     
     if (elapsed_ms >= timeout_ms) {
-        ESP_LOGE(TAG, "Erase timeout after %lu ms", elapsed_ms);
+        ESP_LOGE(TAG, "Erase timeout after %" PRIu32 " ms", elapsed_ms);
         ret = ESP_ERR_TIMEOUT;
         goto cleanup;
     }
@@ -159,7 +160,7 @@ esp_err_t swd_flash_erase_page(uint32_t addr) {
         // Read twice to ensure consistency (cache bypass)
         ret = swd_mem_read32(check_addr, &sample);
         if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to read for verification at 0x%08lX", check_addr);
+            ESP_LOGE(TAG, "Failed to read for verification at 0x%08" PRIX32, check_addr);
             goto cleanup;
         }
         
@@ -168,12 +169,12 @@ esp_err_t swd_flash_erase_page(uint32_t addr) {
             vTaskDelay(pdMS_TO_TICKS(1));
             ret = swd_mem_read32(check_addr, &sample);
             if (ret != ESP_OK) {
-                ESP_LOGE(TAG, "Failed to re-read for verification at 0x%08lX", check_addr);
+                ESP_LOGE(TAG, "Failed to re-read for verification at 0x%08" PRIX32, check_addr);
                 goto cleanup;
             }
             
             if (sample != 0xFFFFFFFF) {
-                ESP_LOGE(TAG, "Erase verification failed at 0x%08lX: 0x%08lX (expected 0xFFFFFFFF)", 
+                ESP_LOGE(TAG, "Erase verification failed at 0x%08" PRIX32 ": 0x%08" PRIX32 " (expected 0xFFFFFFFF)", 
                         check_addr, sample);
                 ret = ESP_FAIL;
                 goto cleanup;
@@ -181,7 +182,7 @@ esp_err_t swd_flash_erase_page(uint32_t addr) {
         }
     }
     
-    ESP_LOGI(TAG, "Page at 0x%08lX erased successfully", addr);
+    binlog_write(BINLOG_FLASH_ERASED, addr, 0, 0);
     return ESP_OK;
     
 cleanup:
@@ -197,7 +198,7 @@ esp_err_t swd_flash_write_buffer(uint32_t addr, const uint8_t *data, uint32_t si
         return ESP_ERR_INVALID_ARG;
     }
     
-    ESP_LOGI(TAG, "Writing %lu bytes to 0x%08lX", size, addr);
+    binlog_write(BINLOG_FLASH_WRITE, size, addr, 0);
     uint32_t start_tick = xTaskGetTickCount();
     
     esp_err_t ret;
@@ -259,7 +260,7 @@ esp_err_t swd_flash_write_buffer(uint32_t addr, const uint8_t *data, uint32_t si
         // This is the key optimization - writes many words in one transaction
         ret = swd_mem_write_block32(addr, word_buffer, words_in_chunk);
         if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "Block write failed at 0x%08lX", addr);
+            ESP_LOGE(TAG, "Block write failed at 0x%08" PRIX32, addr);
             free(word_buffer);
             goto cleanup;
         }
@@ -299,9 +300,8 @@ cleanup:
     swd_mem_write32(NVMC_CONFIG, NVMC_CONFIG_REN);
     
     uint32_t elapsed_ms = (xTaskGetTickCount() - start_tick) * portTICK_PERIOD_MS;
-    float speed_kbps = elapsed_ms > 0 ? (float)(written * 1000) / (elapsed_ms * 1024) : 0;
-    ESP_LOGI(TAG, "Write complete: %lu bytes in %lu ms (%.1f KB/s)", 
-            written, elapsed_ms, speed_kbps);
+    uint32_t speed_kbps = elapsed_ms > 0 ? (written * 1000) / (elapsed_ms * 1024) : 0;
+    binlog_write(BINLOG_FLASH_WRITE_DONE, written, elapsed_ms, speed_kbps);
     
     return ret;
 }
@@ -341,10 +341,10 @@ esp_err_t swd_flash_disable_approtect(void) {
     
     uint32_t idcode = swd_get_idcode();
     if (idcode == 0 || idcode == 0xFFFFFFFF) {
-        ESP_LOGE(TAG, "Invalid IDCODE: 0x%08lX", idcode);
+        ESP_LOGE(TAG, "Invalid IDCODE: 0x%08" PRIX32, idcode);
         return ESP_ERR_INVALID_STATE;
     }
-    ESP_LOGI(TAG, "DP IDCODE: 0x%08lX", idcode);
+    ESP_LOGI(TAG, "DP IDCODE: 0x%08" PRIX32, idcode);
     
     esp_err_t ret;
     uint32_t value;
@@ -375,11 +375,11 @@ esp_err_t swd_flash_disable_approtect(void) {
         return ret;
     }
     
-    ESP_LOGI(TAG, "CTRL-AP IDR = 0x%08lX", value);
+    ESP_LOGI(TAG, "CTRL-AP IDR = 0x%08" PRIX32, value);
     
     // Check if this is a Nordic CTRL-AP (mask out version bits)
     if ((value & 0x0FFFFFFF) != 0x02880000) {
-        ESP_LOGE(TAG, "Not a Nordic CTRL-AP! Expected 0x02880000, got 0x%08lX", value);
+        ESP_LOGE(TAG, "Not a Nordic CTRL-AP! Expected 0x02880000, got 0x%08" PRIX32, value);
         return ESP_ERR_NOT_FOUND;
     }
     
@@ -395,7 +395,7 @@ esp_err_t swd_flash_disable_approtect(void) {
     // Step 4: Read APPROTECTSTATUS
     ret = swd_ap_read(0x0C, &value);  // CTRL_AP_APPROTECTSTATUS
     if (ret == ESP_OK) {
-        ESP_LOGI(TAG, "APPROTECTSTATUS = 0x%08lX (%s)", value,
+        ESP_LOGI(TAG, "APPROTECTSTATUS = 0x%08" PRIX32 " (%s)", value,
                 value == 0 ? "Protected" : "Not Protected");
     }
     
@@ -428,14 +428,14 @@ esp_err_t swd_flash_disable_approtect(void) {
         }
         
         if (value == 0) {  // CTRL_AP_ERASEALLSTATUS_READY
-            ESP_LOGI(TAG, "✓ Mass erase complete in %lu ms!", elapsed_ms);
+            ESP_LOGI(TAG, "✓ Mass erase complete in %" PRIu32 " ms!", elapsed_ms);
             complete = true;
             break;
         }
         
         // Log progress periodically
         if ((elapsed_ms % 1000) == 0) {
-            ESP_LOGI(TAG, "Erasing... %lu ms elapsed (status=0x%08lX)", elapsed_ms, value);
+            ESP_LOGI(TAG, "Erasing... %" PRIu32 " ms elapsed (status=0x%08" PRIX32 ")", elapsed_ms, value);
         }
         
         vTaskDelay(pdMS_TO_TICKS(100));  // Poll every 100ms like pyOCD
@@ -486,13 +486,13 @@ esp_err_t swd_flash_disable_approtect(void) {
     uint32_t val;
     ret = swd_mem_read32(0x00000000, &val);
     if (ret == ESP_OK) {
-        ESP_LOGI(TAG, "Flash[0x0] = 0x%08lX %s", val, 
+        ESP_LOGI(TAG, "Flash[0x0] = 0x%08" PRIX32 " %s", val, 
                 (val == 0xFFFFFFFF) ? "✓ ERASED" : "✗ NOT ERASED");
     }
     
     ret = swd_mem_read32(0x10001208, &val);  // UICR.APPROTECT
     if (ret == ESP_OK) {
-        ESP_LOGI(TAG, "APPROTECT = 0x%08lX %s", val,
+        ESP_LOGI(TAG, "APPROTECT = 0x%08" PRIX32 " %s", val,
                 (val == 0xFFFFFFFF) ? "✓ ERASED" : "✗ NOT ERASED");
     }
     
@@ -530,4 +530,47 @@ esp_err_t swd_flash_reset_and_run(void) {
 
     // 6. Release and reset the target with full DP disconnect
     return swd_release_target();
+}
+
+esp_err_t swd_flash_cache_profile_start(uint32_t *saved_icachecnf) {
+    if (!saved_icachecnf) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t ret = swd_mem_read32(NVMC_ICACHECNF, saved_icachecnf);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    // Leave CACHEEN as the firmware set it - only the counters are ours
+    swd_mem_op_t ops[] = {
+        { .addr = NVMC_ICACHECNF, .value = *saved_icachecnf | NVMC_ICACHECNF_CACHEPROFEN, .write = true },
+        { .addr = NVMC_IHIT, .value = 0, .write = true },
+        { .addr = NVMC_IMISS, .value = 0, .write = true },
+    };
+    ret = swd_mem_batch(ops, 3);
+    if (ret == ESP_OK) {
+        ESP_LOGI(TAG, "Cache profiling started (ICACHECNF 0x%08" PRIX32 ")", *saved_icachecnf);
+    }
+    return ret;
+}
+
+esp_err_t swd_flash_cache_profile_stop(uint32_t saved_icachecnf,
+                                       uint32_t *hits, uint32_t *misses) {
+    if (!hits || !misses) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    swd_mem_op_t ops[] = {
+        { .addr = NVMC_IHIT },
+        { .addr = NVMC_IMISS },
+        { .addr = NVMC_ICACHECNF, .value = saved_icachecnf, .write = true },
+    };
+    esp_err_t ret = swd_mem_batch(ops, 3);
+    if (ret == ESP_OK) {
+        *hits = ops[0].value;
+        *misses = ops[1].value;
+        ESP_LOGI(TAG, "Cache profile: %" PRIu32 " hits, %" PRIu32 " misses", *hits, *misses);
+    }
+    return ret;
 }
\ No newline at end of file
@@ -50,7 +50,7 @@ esp_err_t swd_mem_read32(uint32_t addr, uint32_t *data) {
     // Read actual data from RDBUFF
     ret = swd_dp_read(DP_RDBUFF, data);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to read from 0x%08lX", addr);
+        ESP_LOGE(TAG, "Failed to read from 0x%08" PRIX32, addr);
     }
     
     return ret;
@@ -67,7 +67,7 @@ esp_err_t swd_mem_write32(uint32_t addr, uint32_t data) {
     // Write data
     ret = swd_ap_write(AP_DRW, data);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to write 0x%08lX to 0x%08lX", data, addr);
+        ESP_LOGE(TAG, "Failed to write 0x%08" PRIX32 " to 0x%08" PRIX32, data, addr);
         return ret;
     }
     
@@ -188,3 +188,124 @@ esp_err_t swd_mem_write_block32(uint32_t addr, const uint32_t *data, uint32_t co
 
     return ESP_OK;
 }
+
+esp_err_t swd_mem_read_block32(uint32_t addr, uint32_t *data, uint32_t count) {
+    if (!data || count == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Must be word-aligned
+    if (addr & 0x3) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint32_t csw_value = CSW_ADDRINC_ON | CSW_SIZE_32BIT | CSW_DEVICE_EN | CSW_MASTER_DBG;
+    esp_err_t ret = swd_ap_write(AP_CSW, csw_value);
+    if (ret != ESP_OK) return ret;
+
+    // Same 1KB auto-increment boundary as the block write
+    uint32_t auto_inc_size = 0x400;
+
+    while (count > 0) {
+        uint32_t offset_in_page = addr & (auto_inc_size - 1);
+        uint32_t words_in_page = (auto_inc_size - offset_in_page) / 4;
+        if (words_in_page > count) {
+            words_in_page = count;
+        }
+
+        ret = swd_ap_write(AP_TAR, addr);
+        if (ret != ESP_OK) return ret;
+
+        // swd_ap_read() collects each word from RDBUFF, which does not start
+        // another AP access - TAR advances exactly once per word
+        for (uint32_t i = 0; i < words_in_page; i++) {
+            ret = swd_ap_read(AP_DRW, &data[i]);
+            if (ret != ESP_OK) {
+                ESP_LOGE(TAG, "Block read failed at 0x%08" PRIX32, addr + i * 4);
+                return ret;
+            }
+        }
+
+        addr += words_in_page * 4;
+        data += words_in_page;
+        count -= words_in_page;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t swd_mem_batch(swd_mem_op_t *ops, int count) {
+    if (!ops || count <= 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // No auto-increment, so a repeated address (polling) needs no new TAR
+    uint32_t csw_value = CSW_SIZE_32BIT | CSW_DEVICE_EN | CSW_MASTER_DBG | CSW_HPROT;
+    esp_err_t ret = swd_ap_write(AP_CSW, csw_value);
+    if (ret != ESP_OK) return ret;
+
+    bool tar_valid = false;
+    uint32_t tar = 0;
+    bool write_pending = false;
+
+    for (int i = 0; i < count && ret == ESP_OK; i++) {
+        if (!tar_valid || tar != ops[i].addr) {
+            ret = swd_ap_write(AP_TAR, ops[i].addr);
+            if (ret != ESP_OK) break;
+            tar = ops[i].addr;
+            tar_valid = true;
+        }
+
+        if (ops[i].write) {
+            ret = swd_ap_write(AP_DRW, ops[i].value);
+            write_pending = true;
+        } else {
+            // swd_ap_read() collects the result from RDBUFF, which also
+            // completes any write before it
+            ret = swd_ap_read(AP_DRW, &ops[i].value);
+            write_pending = false;
+        }
+    }
+
+    if (ret == ESP_OK && write_pending) {
+        uint32_t dummy;
+        ret = swd_dp_read(DP_RDBUFF, &dummy);
+    }
+
+    // Back to the default for the single-word helpers
+    esp_err_t csw_ret = swd_ap_write(AP_CSW, CSW_DEFAULT);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Batch of %d accesses failed", count);
+        return ret;
+    }
+    return csw_ret;
+}
+
+static esp_err_t core_reg_wait_ready(void) {
+    for (int i = 0; i < 10; i++) {
+        uint32_t dhcsr = 0;
+        esp_err_t ret = swd_mem_read32(DHCSR_ADDR, &dhcsr);
+        if (ret != ESP_OK) return ret;
+        if (dhcsr & DHCSR_S_REGRDY) return ESP_OK;
+    }
+    return ESP_ERR_TIMEOUT;
+}
+
+esp_err_t swd_core_reg_read(uint8_t reg, uint32_t *value) {
+    if (!value) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t ret = swd_mem_write32(DCRSR_ADDR, reg);
+    if (ret == ESP_OK) ret = core_reg_wait_ready();
+    if (ret == ESP_OK) ret = swd_mem_read32(DCRDR_ADDR, value);
+    return ret;
+}
+
+esp_err_t swd_core_reg_write(uint8_t reg, uint32_t value) {
+    esp_err_t ret = swd_mem_write32(DCRDR_ADDR, value);
+    if (ret == ESP_OK) ret = swd_mem_write32(DCRSR_ADDR, DCRSR_REGWNR | reg);
+    if (ret == ESP_OK) ret = core_reg_wait_ready();
+    return ret;
+}
+
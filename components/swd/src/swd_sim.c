@@ -0,0 +1,565 @@
+// swd_sim.c - Simulated nRF52840 behind the SWD transfer layer
+//
+// With SWD_SIM_ENABLE, swd_transfer_raw() hands every request to
+// swd_sim_transfer() instead of the pins. The model covers what the flasher
+// touches: SW-DP power handshake and posted AP reads, the AHB-AP (CSW/TAR/DRW
+// with 1KB auto-increment wrap), Nordic's CTRL-AP, the NVMC, FICR, the debug
+// registers and a ROM table pointing at DWT/FPB. Flash and UICR live in a
+// one-page write-back cache over files in SWD_SIM_DIR; everything else that
+// is written is kept in a small register file. Accesses are always 32-bit.
+//
+// Time is modelled, not spent: every transfer costs SWD_SIM_TRANSFER_CLOCKS
+// at SWD_SIM_SWCLK_KHZ, erases and word programs keep the NVMC busy, and
+// an access that arrives while it is busy (the AHB stall a real target
+// answers with WAIT) moves the model clock to the end of the operation.
+// NVMC_READY therefore always reads 1 - the wait is charged, not polled.
+#include "swd_sim.h"
+#include "swd_mem.h"
+#include "swd_flash.h"
+#include "swd_debug.h"
+#include "nrf52_hal.h"
+#include "esp_log.h"
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+
+static const char *TAG = "SWD_SIM";
+
+#define SIM_PAGE_SIZE       NRF52_FLASH_PAGE_SIZE
+#define SIM_ROM_BASE        0xE00FF000
+#define SIM_AP_BASE         (SIM_ROM_BASE | 0x3)    // ROM table present
+#define SIM_MEM_AP_IDR      0x24770011              // AHB-AP, Cortex-M4
+#define SIM_FP_CTRL         ((2 << 8) | (6 << 4))   // FPBv1: 6 code, 2 literal
+#define SIM_DWT_CTRL        (4UL << 28)             // 4 comparators
+#define SIM_CSW_ADDRINC     0x30
+#define SIM_AIRCR_RESET     0x05FA0004              // VECTKEY | SYSRESETREQ
+
+// ROM table entries, relative to SIM_ROM_BASE
+static const uint32_t rom_table[] = {
+    0xFFF0F003,     // SCS  0xE000E000
+    0xFFF02003,     // DWT  0xE0001000
+    0xFFF03003,     // FPB  0xE0002000
+    0xFFF01003,     // ITM  0xE0000000
+    0xFFF41003,     // TPIU 0xE0040000
+    0xFFF42003,     // ETM  0xE0041000
+    0x00000000,
+};
+
+typedef struct {
+    uint32_t addr;
+    uint32_t value;
+} sim_reg_t;
+
+static struct {
+    bool ready;
+    // SW-DP
+    uint32_t ctrl_stat;
+    uint32_t select;
+    uint32_t rdbuff;
+    // AHB-AP
+    uint32_t csw;
+    uint32_t tar;
+    // CTRL-AP
+    uint32_t ctrl_ap_reset;
+    uint32_t ctrl_ap_eraseall;
+    // Core debug
+    uint32_t dhcsr;             // C_* bits as last written with the key
+    uint32_t dfsr;
+    uint32_t dcrdr;
+    uint32_t core[SWD_DEBUG_REG_COUNT];
+    uint32_t nvmc_config;
+    sim_reg_t regs[SWD_SIM_MAX_REGS];
+    int reg_count;
+    uint8_t *ram;
+    // Flash / UICR page cache
+    uint8_t *page;
+    uint32_t page_base;
+    bool page_valid;
+    bool page_dirty;
+    // Timing model, in ns
+    uint64_t model_ns;
+    uint64_t wire_ns;
+    uint64_t nvmc_busy_until_ns;
+    swd_sim_stats_t stats;
+} sim;
+
+static bool sim_init(void) {
+    if (sim.ready) {
+        return true;
+    }
+
+    sim.ram = calloc(1, SWD_SIM_RAM_SIZE);
+    sim.page = malloc(SIM_PAGE_SIZE);
+    if (!sim.ram || !sim.page) {
+        ESP_LOGE(TAG, "Out of memory for the simulated target");
+        free(sim.ram);
+        free(sim.page);
+        sim.ram = NULL;
+        sim.page = NULL;
+        return false;
+    }
+
+    sim.ready = true;
+    ESP_LOGW(TAG, "SWD simulator active - no target is driven (flash in %s)", SWD_SIM_DIR);
+    swd_sim_reset();
+    return true;
+}
+
+// ============================================================================
+// Register file for everything without behaviour of its own
+// ============================================================================
+
+static uint32_t reg_get(uint32_t addr) {
+    for (int i = 0; i < sim.reg_count; i++) {
+        if (sim.regs[i].addr == addr) {
+            return sim.regs[i].value;
+        }
+    }
+    return 0;
+}
+
+static void reg_set(uint32_t addr, uint32_t value) {
+    for (int i = 0; i < sim.reg_count; i++) {
+        if (sim.regs[i].addr == addr) {
+            sim.regs[i].value = value;
+            return;
+        }
+    }
+    if (sim.reg_count < SWD_SIM_MAX_REGS) {
+        sim.regs[sim.reg_count++] = (sim_reg_t){ .addr = addr, .value = value };
+    } else {
+        ESP_LOGW(TAG, "Register file full - write to 0x%08" PRIX32 " dropped", addr);
+    }
+}
+
+// ============================================================================
+// Timing model
+// ============================================================================
+
+static void nvmc_start(uint32_t us) {
+    sim.nvmc_busy_until_ns = sim.model_ns + (uint64_t)us * 1000;
+}
+
+// A bus access while the NVMC works waits for it to finish
+static void nvmc_wait(void) {
+    if (sim.model_ns < sim.nvmc_busy_until_ns) {
+        sim.model_ns = sim.nvmc_busy_until_ns;
+        sim.stats.nvmc_stalls++;
+    }
+}
+
+// ============================================================================
+// Flash and UICR, one file per non-erased page
+// ============================================================================
+
+static bool is_nvm(uint32_t addr) {
+    return addr < NRF52_FLASH_SIZE ||
+           (addr >= UICR_BASE && addr < UICR_BASE + SIM_PAGE_SIZE);
+}
+
+static void page_path(char *path, size_t len, uint32_t base) {
+    snprintf(path, len, SWD_SIM_DIR "/%08" PRIx32, base);
+}
+
+static void page_flush(void) {
+    if (!sim.page_valid || !sim.page_dirty) {
+        return;
+    }
+    sim.page_dirty = false;
+
+    char path[32];
+    page_path(path, sizeof(path), sim.page_base);
+
+    bool erased = true;
+    for (uint32_t i = 0; i < SIM_PAGE_SIZE && erased; i++) {
+        erased = sim.page[i] == 0xFF;
+    }
+    if (erased) {
+        unlink(path);
+        return;
+    }
+
+    FILE *f = fopen(path, "wb");
+    bool ok = f && fwrite(sim.page, 1, SIM_PAGE_SIZE, f) == SIM_PAGE_SIZE;
+    if (f) {
+        ok = fclose(f) == 0 && ok;
+    }
+    if (!ok) {
+        ESP_LOGW(TAG, "Failed to store page 0x%08" PRIX32, sim.page_base);
+    }
+}
+
+static uint8_t *page_get(uint32_t addr) {
+    uint32_t base = addr & ~(SIM_PAGE_SIZE - 1);
+    if (sim.page_valid && sim.page_base == base) {
+        return sim.page;
+    }
+
+    page_flush();
+    memset(sim.page, 0xFF, SIM_PAGE_SIZE);
+
+    char path[32];
+    page_path(path, sizeof(path), base);
+    FILE *f = fopen(path, "rb");
+    if (f) {
+        fread(sim.page, 1, SIM_PAGE_SIZE, f);
+        fclose(f);
+    }
+
+    sim.page_base = base;
+    sim.page_valid = true;
+    sim.page_dirty = false;
+    return sim.page;
+}
+
+static void page_erase(uint32_t addr) {
+    uint32_t base = addr & ~(SIM_PAGE_SIZE - 1);
+    if (sim.page_valid && sim.page_base == base) {
+        memset(sim.page, 0xFF, SIM_PAGE_SIZE);
+        sim.page_dirty = false;
+    }
+
+    char path[32];
+    page_path(path, sizeof(path), base);
+    unlink(path);
+}
+
+static void erase_all(void) {
+    sim.page_valid = false;
+    sim.page_dirty = false;
+
+    DIR *dir = opendir(SWD_SIM_DIR);
+    if (!dir) {
+        return;
+    }
+
+    struct dirent *de;
+    while ((de = readdir(dir)) != NULL) {
+        const char *slash = strrchr(de->d_name, '/');
+        char path[48];
+        // SPIFFS object names are at most 32 bytes
+        snprintf(path, sizeof(path), SWD_SIM_DIR "/%.32s", slash ? slash + 1 : de->d_name);
+        unlink(path);
+    }
+    closedir(dir);
+    ESP_LOGI(TAG, "Simulated flash and UICR erased");
+}
+
+// ============================================================================
+// Memory map
+// ============================================================================
+
+static uint32_t ficr_read(uint32_t addr) {
+    switch (addr) {
+        case FICR_CODEPAGESIZE: return SIM_PAGE_SIZE;
+        case FICR_CODESIZE:     return NRF52_FLASH_SIZE / SIM_PAGE_SIZE;
+        case FICR_INFO_PART:    return 0x00052840;
+        case FICR_INFO_VARIANT: return 0x41414430;  // "AAD0"
+        case FICR_INFO_RAM:     return NRF52_SRAM_SIZE / 1024;
+        case FICR_INFO_FLASH:   return NRF52_FLASH_SIZE / 1024;
+        default:                return 0xFFFFFFFF;
+    }
+}
+
+static uint32_t mem_read(uint32_t addr) {
+    uint32_t value = 0;
+
+    if (is_nvm(addr)) {
+        memcpy(&value, page_get(addr) + (addr & (SIM_PAGE_SIZE - 1)), 4);
+        return value;
+    }
+    if (addr >= NRF52_SRAM_BASE && addr < NRF52_SRAM_BASE + SWD_SIM_RAM_SIZE) {
+        memcpy(&value, sim.ram + (addr - NRF52_SRAM_BASE), 4);
+        return value;
+    }
+    if (addr >= FICR_BASE && addr < UICR_BASE) {
+        return ficr_read(addr);
+    }
+    if (addr >= SIM_ROM_BASE && addr < SIM_ROM_BASE + sizeof(rom_table)) {
+        return rom_table[(addr - SIM_ROM_BASE) / 4];
+    }
+
+    switch (addr) {
+        case NVMC_READY:
+        case NVMC_READYNEXT:
+            return 1;
+        case NVMC_CONFIG:
+            return sim.nvmc_config;
+        case DHCSR_ADDR:
+            return DHCSR_S_REGRDY | sim.dhcsr |
+                   ((sim.dhcsr & DHCSR_C_HALT) ? DHCSR_S_HALT : 0);
+        case DFSR_ADDR:
+            return sim.dfsr;
+        case DCRDR_ADDR:
+            return sim.dcrdr;
+        case FP_CTRL_ADDR:
+            return SIM_FP_CTRL | (reg_get(addr) & FP_CTRL_ENABLE);
+        case DWT_CTRL_ADDR:
+            return SIM_DWT_CTRL | (reg_get(addr) & 0x0FFFFFFF);
+        case DWT_CTRL_ADDR + 0xFE0:     // DWT PIDR0/1: part 0x002
+            return 0x02;
+        case FP_CTRL_ADDR + 0xFE0:      // FPB PIDR0/1: part 0x003
+            return 0x03;
+        case DWT_CTRL_ADDR + 0xFE4:
+        case FP_CTRL_ADDR + 0xFE4:
+            return 0xB0;
+        default:
+            return reg_get(addr);
+    }
+}
+
+static void mem_write(uint32_t addr, uint32_t value) {
+    if (is_nvm(addr)) {
+        // Programming only clears bits; without WEN the write is lost
+        if (sim.nvmc_config == NVMC_CONFIG_WEN) {
+            uint8_t *word = page_get(addr) + (addr & (SIM_PAGE_SIZE - 1));
+            uint32_t old;
+            memcpy(&old, word, 4);
+            old &= value;
+            memcpy(word, &old, 4);
+            sim.page_dirty = true;
+            sim.stats.words_programmed++;
+            nvmc_start(SWD_SIM_PROGRAM_WORD_US);
+        }
+        return;
+    }
+    if (addr >= NRF52_SRAM_BASE && addr < NRF52_SRAM_BASE + SWD_SIM_RAM_SIZE) {
+        memcpy(sim.ram + (addr - NRF52_SRAM_BASE), &value, 4);
+        return;
+    }
+
+    switch (addr) {
+        case NVMC_CONFIG:
+            sim.nvmc_config = value & 0x3;
+            if (sim.nvmc_config == NVMC_CONFIG_REN) {
+                page_flush();  // End of a program or erase sequence
+            }
+            break;
+        case NVMC_ERASEPAGE:
+            if (sim.nvmc_config == NVMC_CONFIG_EEN && is_nvm(value)) {
+                page_erase(value);
+                sim.stats.pages_erased++;
+                nvmc_start(SWD_SIM_ERASE_PAGE_US);
+            }
+            break;
+        case NVMC_ERASEALL:
+            if (sim.nvmc_config == NVMC_CONFIG_EEN && (value & 0x1)) {
+                erase_all();
+                nvmc_start(SWD_SIM_ERASE_ALL_US);
+            }
+            break;
+        case NVMC_ERASEUICR:
+            if (sim.nvmc_config == NVMC_CONFIG_EEN && (value & 0x1)) {
+                page_erase(UICR_BASE);
+                sim.stats.pages_erased++;
+                nvmc_start(SWD_SIM_ERASE_PAGE_US);
+            }
+            break;
+        case DHCSR_ADDR:
+            if ((value & 0xFFFF0000) == DHCSR_DBGKEY) {
+                sim.dhcsr = value & 0xFFFF;
+                if (value & DHCSR_C_STEP) {
+                    sim.dhcsr |= DHCSR_C_HALT;  // One instruction, then halted
+                }
+            }
+            break;
+        case DFSR_ADDR:
+            sim.dfsr &= ~value;
+            break;
+        case DCRSR_ADDR: {
+            uint32_t sel = value & 0x1F;
+            if (sel < SWD_DEBUG_REG_COUNT) {
+                if (value & DCRSR_REGWNR) {
+                    sim.core[sel] = sim.dcrdr;
+                } else {
+                    sim.dcrdr = sim.core[sel];
+                }
+            }
+            break;
+        }
+        case DCRDR_ADDR:
+            sim.dcrdr = value;
+            break;
+        case NRF52_AIRCR:
+            if (value == SIM_AIRCR_RESET) {
+                swd_sim_reset();
+            }
+            break;
+        default:
+            reg_set(addr, value);
+            break;
+    }
+}
+
+// ============================================================================
+// Access ports
+// ============================================================================
+
+static void tar_advance(void) {
+    if ((sim.csw & SIM_CSW_ADDRINC) == CSW_ADDRINC_ON) {
+        sim.tar = (sim.tar & ~0x3FF) | ((sim.tar + 4) & 0x3FF);
+    }
+}
+
+static uint32_t ap_read(uint8_t addr) {
+    uint8_t apsel = sim.select >> 24;
+    uint8_t reg = (sim.select & 0xF0) | (addr & 0x0C);
+
+    if (apsel == 1) {
+        switch (reg) {
+            case CTRL_AP_RESET:             return sim.ctrl_ap_reset;
+            case CTRL_AP_ERASEALL:          return sim.ctrl_ap_eraseall;
+            case CTRL_AP_ERASEALLSTATUS:    return 0;   // Ready
+            case CTRL_AP_APPROTECTSTATUS:   return 1;   // Not protected
+            case CTRL_AP_IDR:               return NORDIC_CTRL_AP_IDR;
+            default:                        return 0;
+        }
+    }
+    if (apsel != 0) {
+        return 0;
+    }
+
+    switch (reg) {
+        case AP_CSW:    return sim.csw;
+        case AP_TAR:    return sim.tar;
+        case AP_DRW: {
+            nvmc_wait();
+            uint32_t value = mem_read(sim.tar & ~0x3);
+            tar_advance();
+            return value;
+        }
+        case 0xF8:      return SIM_AP_BASE;
+        case AP_IDR:    return SIM_MEM_AP_IDR;
+        default:        return 0;
+    }
+}
+
+static void ap_write(uint8_t addr, uint32_t value) {
+    uint8_t apsel = sim.select >> 24;
+    uint8_t reg = (sim.select & 0xF0) | (addr & 0x0C);
+
+    if (apsel == 1) {
+        if (reg == CTRL_AP_RESET) {
+            if (sim.ctrl_ap_reset && !value) {
+                swd_sim_reset();  // Released from reset
+            }
+            sim.ctrl_ap_reset = value;
+        } else if (reg == CTRL_AP_ERASEALL) {
+            if (value & 0x1) {
+                erase_all();
+                nvmc_start(SWD_SIM_ERASE_ALL_US);
+            }
+            sim.ctrl_ap_eraseall = value;
+        }
+        return;
+    }
+    if (apsel != 0) {
+        return;
+    }
+
+    switch (reg) {
+        case AP_CSW:
+            sim.csw = value;
+            break;
+        case AP_TAR:
+            sim.tar = value;
+            break;
+        case AP_DRW:
+            nvmc_wait();
+            mem_write(sim.tar & ~0x3, value);
+            tar_advance();
+            break;
+        default:
+            break;
+    }
+}
+
+// ============================================================================
+// Public interface
+// ============================================================================
+
+void swd_sim_reset(void) {
+    if (!sim.ready) {
+        return;
+    }
+
+    sim.nvmc_config = NVMC_CONFIG_REN;
+    page_flush();
+
+    // DHCSR and DEMCR are debug-reset only and survive a system reset
+    bool vector_catch = (sim.dhcsr & DHCSR_C_DEBUGEN) &&
+                        (reg_get(DEMCR_ADDR) & DEMCR_VC_CORERESET);
+    if (vector_catch) {
+        sim.dhcsr |= DHCSR_C_HALT;
+        sim.dfsr |= DFSR_VCATCH;
+    } else {
+        sim.dhcsr &= ~DHCSR_C_HALT;
+    }
+
+    memset(sim.core, 0, sizeof(sim.core));
+    sim.core[CORE_REG_SP] = mem_read(0x00000000);
+    sim.core[CORE_REG_PC] = mem_read(0x00000004) & ~0x1;
+    sim.core[CORE_REG_LR] = 0xFFFFFFFF;
+    sim.core[16] = 0x01000000;  // xPSR: Thumb
+}
+
+swd_ack_t swd_sim_transfer(uint8_t addr, bool ap, bool read, uint32_t *data) {
+    if (!sim_init()) {
+        return SWD_ACK_FAULT;
+    }
+
+    uint64_t transfer_ns = SWD_SIM_TRANSFER_CLOCKS * 1000000ULL / SWD_SIM_SWCLK_KHZ;
+    sim.model_ns += transfer_ns;
+    sim.wire_ns += transfer_ns;
+    sim.stats.transfers++;
+
+    if (ap) {
+        if (read) {
+            // Posted: this read returns the previous AP result
+            uint32_t value = ap_read(addr);
+            *data = sim.rdbuff;
+            sim.rdbuff = value;
+            sim.stats.ap_reads++;
+        } else {
+            ap_write(addr, *data);
+            sim.stats.ap_writes++;
+        }
+        return SWD_ACK_OK;
+    }
+
+    if (read) {
+        switch (addr) {
+            case DP_IDCODE:
+                *data = SWD_SIM_IDCODE;
+                break;
+            case DP_CTRL_STAT:
+                // Power-up requests (bits 28, 30) acknowledged at once (29, 31)
+                *data = sim.ctrl_stat | ((sim.ctrl_stat & 0x50000000) << 1);
+                break;
+            case DP_SELECT:
+                *data = sim.select;
+                break;
+            default:
+                *data = sim.rdbuff;
+                break;
+        }
+    } else if (addr == DP_CTRL_STAT) {
+        sim.ctrl_stat = *data & 0x50000000;
+    } else if (addr == DP_SELECT) {
+        sim.select = *data;
+    }
+    return SWD_ACK_OK;
+}
+
+bool swd_sim_get_stats(swd_sim_stats_t *stats) {
+    if (!sim.ready || !stats) {
+        return false;
+    }
+    *stats = sim.stats;
+    stats->wire_us = sim.wire_ns / 1000;
+    stats->model_us = sim.model_ns / 1000;
+    return true;
+}
@@ -0,0 +1,67 @@
+// telemetry.h - Long-term time-series store in the "telemetry" flash partition
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Series ids are stored in flash - append only, never renumber
+typedef enum {
+    TELEM_BATTERY_MV = 0,       // Battery voltage at the end of each wake
+    TELEM_RSSI_DBM,             // AP signal after connecting
+    TELEM_WAKE_OUTCOME,         // history_outcome_t of each wake
+    TELEM_AWAKE_SEC,            // Time spent awake per wake
+    TELEM_JOB_RESULT,           // esp_err_t of each SWD job (0 = success)
+    TELEM_GOLDEN_MISMATCH,      // Pages found differing from the golden image
+    TELEM_SERIES_COUNT
+} telemetry_series_t;
+
+typedef struct {
+    uint32_t count;
+    int32_t min;
+    int32_t max;
+    int64_t sum;
+} telemetry_bucket_t;
+
+typedef struct {
+    uint32_t samples;           // Samples that landed in a bucket
+    uint32_t blocks_read;       // Blocks decoded
+    uint32_t blocks_skipped;    // Blocks rejected from their header alone
+    uint32_t sectors_skipped;   // Sectors rejected from their header alone
+} telemetry_query_stats_t;
+
+typedef struct {
+    uint32_t capacity_bytes;    // Partition size
+    uint32_t used_bytes;        // Sectors holding data (incl. the open one)
+    uint32_t sectors;
+    uint32_t head_sector;
+    uint32_t head_seq;          // Sectors opened since the log was created
+    uint32_t buffered_bytes;    // Encoded samples waiting in RTC memory
+    uint32_t dropped;           // Samples lost to a full buffer
+    uint32_t oldest_sec;        // Start of the oldest sector, 0 if empty
+} telemetry_info_t;
+
+// Find the partition; after power loss, locate the log head by sector sequence
+esp_err_t telemetry_init(void);
+
+// Append one sample (timestamped with the system clock) to the RTC buffer
+void telemetry_record(telemetry_series_t series, int32_t value);
+
+// End of a wake: write the buffer to flash once it is worth a block.
+// force writes whatever is buffered (e.g. before an expected power loss)
+esp_err_t telemetry_flush(bool force);
+
+// Downsample [from_sec, to_sec] of one series into count equal-width buckets
+esp_err_t telemetry_query(telemetry_series_t series, uint32_t from_sec, uint32_t to_sec,
+                          telemetry_bucket_t *buckets, uint16_t count,
+                          telemetry_query_stats_t *stats);
+
+void telemetry_get_info(telemetry_info_t *info);
+
+const char* telemetry_series_name(telemetry_series_t series);
+
+// Returns TELEM_SERIES_COUNT for unknown names
+telemetry_series_t telemetry_series_from_name(const char *name);
+
+#endif // TELEMETRY_H
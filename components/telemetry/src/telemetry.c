@@ -0,0 +1,537 @@
+// telemetry.c - Log-structured time-series store
+//
+// Samples are encoded into a block buffer in RTC memory, so it survives deep
+// sleep and fills across many wakes. Once a block is worth writing it is
+// appended to the "telemetry" partition - at most one flash write per wake.
+//
+// Flash layout: the partition is a ring of 4 KB sectors written strictly in
+// order. Each sector starts with a header carrying a sequence number (the
+// highest one is the head after power loss) and the time of its first block.
+// When the head sector is full the next one is erased and opened, so every
+// sector sees one erase per lap of the ring and the oldest data is dropped.
+//
+//   sector: [magic seq t_start] [block] [block] ... (0xFF)
+//   block:  [magic len t_start t_end crc32] payload (padded to 4 bytes)
+//
+// Payload encoding, per sample:
+//   tag     series id (bits 0-4), bit 7 set when the time equals the previous
+//   dt      varint seconds since the previous sample (omitted with bit 7)
+//   value   zigzag varint delta from this series' previous value in the block
+// Deltas restart in every block, so any block decodes on its own and a query
+// only reads the blocks whose header time range overlaps what was asked.
+// A typical wake (battery, outcome, awake time, same second) costs 6-8 bytes.
+#include "telemetry.h"
+#include "config.h"
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <sys/time.h>
+#include <string.h>
+
+static const char *TAG = "TELEMETRY";
+
+#define TELEM_RTC_MAGIC         0x54454C4D  // "TELM"
+#define TELEM_SECTOR_MAGIC      0x544C4D53  // "TLMS"
+#define TELEM_BLOCK_MAGIC       0x7E1B
+#define TELEM_SECTOR_SIZE       4096
+#define TELEM_MAX_SECTORS       256
+#define TELEM_TAG_SERIES_MASK   0x1F
+#define TELEM_TAG_SAME_TIME     0x80
+#define TELEM_SAMPLE_MAX        11          // tag + two 5-byte varints
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t t_start;
+    uint32_t reserved;
+} telem_sector_hdr_t;
+
+typedef struct {
+    uint16_t magic;
+    uint16_t len;
+    uint32_t t_start;
+    uint32_t t_end;
+    uint32_t crc;
+} telem_block_hdr_t;
+
+#define TELEM_BLOCK_MAX_LEN     (TELEM_SECTOR_SIZE - sizeof(telem_sector_hdr_t) - sizeof(telem_block_hdr_t))
+
+_Static_assert(TELEMETRY_BUFFER_BYTES <= TELEM_BLOCK_MAX_LEN, "TELEMETRY_BUFFER_BYTES exceeds a sector");
+
+typedef struct {
+    uint32_t magic;
+    uint32_t head_seq;          // 0 until the first sector is opened
+    uint32_t head_sector;
+    uint32_t head_offset;       // Next write position in the head sector
+    uint32_t t_start;           // Open block: time of its first sample
+    uint32_t t_last;            // Open block: time of its last sample
+    int32_t last_value[TELEM_SERIES_COUNT];
+    uint32_t dropped;
+    uint16_t len;
+    uint8_t buf[TELEMETRY_BUFFER_BYTES];
+} telem_rtc_t;
+
+RTC_DATA_ATTR static telem_rtc_t rtc_telem;
+
+static const esp_partition_t *telem_partition = NULL;
+static uint32_t telem_sectors = 0;
+static SemaphoreHandle_t telem_mutex = NULL;
+static bool flushed_this_wake = false;
+
+static const char *series_names[TELEM_SERIES_COUNT] = {
+    [TELEM_BATTERY_MV]      = "battery_mv",
+    [TELEM_RSSI_DBM]        = "rssi_dbm",
+    [TELEM_WAKE_OUTCOME]    = "wake_outcome",
+    [TELEM_AWAKE_SEC]       = "awake_sec",
+    [TELEM_JOB_RESULT]      = "job_result",
+    [TELEM_GOLDEN_MISMATCH] = "golden_mismatch",
+};
+
+static uint32_t telem_now(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec < 0 ? 0 : (uint32_t)tv.tv_sec;
+}
+
+static uint32_t align4(uint32_t n) {
+    return (n + 3) & ~3U;
+}
+
+static size_t varint_put(uint8_t *out, uint32_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        out[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (uint8_t)v;
+    return n;
+}
+
+static bool varint_get(const uint8_t *in, size_t len, size_t *pos, uint32_t *v) {
+    uint32_t result = 0;
+    for (int shift = 0; shift < 35 && *pos < len; shift += 7) {
+        uint8_t byte = in[(*pos)++];
+        result |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *v = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Deltas wrap modulo 2^32, so any int32 pair round-trips
+static uint32_t zigzag(int32_t v) {
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static int32_t unzigzag(uint32_t v) {
+    return (int32_t)((v >> 1) ^ (0U - (v & 1)));
+}
+
+static void block_reset_locked(void) {
+    rtc_telem.len = 0;
+    memset(rtc_telem.last_value, 0, sizeof(rtc_telem.last_value));
+}
+
+static bool append_locked(telemetry_series_t series, int32_t value, uint32_t now) {
+    uint8_t sample[TELEM_SAMPLE_MAX];
+    size_t n = 0;
+
+    if (rtc_telem.len == 0) {
+        rtc_telem.t_start = now;
+        rtc_telem.t_last = now;
+    }
+
+    // A clock stepped backwards is booked at the previous sample's time
+    uint32_t dt = now > rtc_telem.t_last ? now - rtc_telem.t_last : 0;
+    sample[n++] = (uint8_t)series | (dt == 0 ? TELEM_TAG_SAME_TIME : 0);
+    if (dt != 0) {
+        n += varint_put(&sample[n], dt);
+    }
+    n += varint_put(&sample[n], zigzag((int32_t)((uint32_t)value -
+                                       (uint32_t)rtc_telem.last_value[series])));
+
+    if (rtc_telem.len + n > TELEMETRY_BUFFER_BYTES) {
+        return false;
+    }
+
+    memcpy(&rtc_telem.buf[rtc_telem.len], sample, n);
+    rtc_telem.len += n;
+    rtc_telem.t_last += dt;
+    rtc_telem.last_value[series] = value;
+    return true;
+}
+
+static bool read_sector_hdr(uint32_t sector, telem_sector_hdr_t *hdr) {
+    if (esp_partition_read(telem_partition, sector * TELEM_SECTOR_SIZE, hdr, sizeof(*hdr)) != ESP_OK) {
+        return false;
+    }
+    return hdr->magic == TELEM_SECTOR_MAGIC && hdr->seq != 0 && hdr->seq != UINT32_MAX;
+}
+
+// Erase the next sector of the ring and make it the head
+static esp_err_t open_next_sector_locked(uint32_t t_start) {
+    uint32_t sector = rtc_telem.head_seq == 0 ? 0 : (rtc_telem.head_sector + 1) % telem_sectors;
+    uint32_t addr = sector * TELEM_SECTOR_SIZE;
+
+    esp_err_t ret = esp_partition_erase_range(telem_partition, addr, TELEM_SECTOR_SIZE);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    telem_sector_hdr_t hdr = {
+        .magic = TELEM_SECTOR_MAGIC,
+        .seq = rtc_telem.head_seq + 1,
+        .t_start = t_start,
+        .reserved = UINT32_MAX
+    };
+    ret = esp_partition_write(telem_partition, addr, &hdr, sizeof(hdr));
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    rtc_telem.head_sector = sector;
+    rtc_telem.head_seq = hdr.seq;
+    rtc_telem.head_offset = sizeof(hdr);
+    ESP_LOGI(TAG, "Opened sector %" PRIu32 " (seq %" PRIu32 ")", sector, hdr.seq);
+    return ESP_OK;
+}
+
+static esp_err_t flush_locked(void) {
+    if (rtc_telem.len == 0) {
+        return ESP_OK;
+    }
+
+    // Counted even on failure - a bad partition must not cost a write per sample
+    flushed_this_wake = true;
+
+    uint32_t stored = align4(sizeof(telem_block_hdr_t) + rtc_telem.len);
+    esp_err_t ret = ESP_OK;
+    if (rtc_telem.head_seq == 0 || rtc_telem.head_offset + stored > TELEM_SECTOR_SIZE) {
+        ret = open_next_sector_locked(rtc_telem.t_start);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "Sector open failed: %s", esp_err_to_name(ret));
+            return ret;
+        }
+    }
+
+    uint8_t block[sizeof(telem_block_hdr_t) + TELEMETRY_BUFFER_BYTES + 3];
+    telem_block_hdr_t hdr = {
+        .magic = TELEM_BLOCK_MAGIC,
+        .len = rtc_telem.len,
+        .t_start = rtc_telem.t_start,
+        .t_end = rtc_telem.t_last,
+        .crc = esp_rom_crc32_le(0, rtc_telem.buf, rtc_telem.len)
+    };
+    memset(block, 0xFF, stored);
+    memcpy(block, &hdr, sizeof(hdr));
+    memcpy(block + sizeof(hdr), rtc_telem.buf, rtc_telem.len);
+
+    uint32_t addr = rtc_telem.head_sector * TELEM_SECTOR_SIZE + rtc_telem.head_offset;
+    ret = esp_partition_write(telem_partition, addr, block, stored);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Block write failed: %s", esp_err_to_name(ret));
+        // Never write over a partially programmed region
+        rtc_telem.head_offset = TELEM_SECTOR_SIZE;
+        return ret;
+    }
+
+    ESP_LOGI(TAG, "Flushed %u bytes to sector %" PRIu32 " @%" PRIu32, rtc_telem.len,
+             rtc_telem.head_sector, rtc_telem.head_offset);
+    rtc_telem.head_offset += stored;
+    block_reset_locked();
+    return ESP_OK;
+}
+
+// Power loss: newest sector by sequence, then walk its blocks to the end
+static void locate_head(void) {
+    telem_sector_hdr_t hdr;
+    uint32_t head_seq = 0;
+    uint32_t head_sector = 0;
+
+    for (uint32_t s = 0; s < telem_sectors; s++) {
+        if (read_sector_hdr(s, &hdr) && hdr.seq > head_seq) {
+            head_seq = hdr.seq;
+            head_sector = s;
+        }
+    }
+
+    rtc_telem.head_seq = head_seq;
+    rtc_telem.head_sector = head_sector;
+    rtc_telem.head_offset = TELEM_SECTOR_SIZE;
+    if (head_seq == 0) {
+        ESP_LOGI(TAG, "No log found - starting fresh");
+        return;
+    }
+
+    uint32_t offset = sizeof(telem_sector_hdr_t);
+    while (offset + sizeof(telem_block_hdr_t) <= TELEM_SECTOR_SIZE) {
+        telem_block_hdr_t block;
+        if (esp_partition_read(telem_partition, head_sector * TELEM_SECTOR_SIZE + offset,
+                               &block, sizeof(block)) != ESP_OK) {
+            break;
+        }
+        if (block.magic == 0xFFFF && block.len == 0xFFFF) {
+            rtc_telem.head_offset = offset;
+            break;
+        }
+        if (block.magic != TELEM_BLOCK_MAGIC || block.len > TELEM_BLOCK_MAX_LEN) {
+            // Torn write - leave the rest of this sector alone
+            break;
+        }
+        offset += align4(sizeof(block) + block.len);
+    }
+
+    ESP_LOGI(TAG, "Log head: sector %" PRIu32 " (seq %" PRIu32 ") offset %" PRIu32, head_sector, head_seq,
+             rtc_telem.head_offset);
+}
+
+esp_err_t telemetry_init(void) {
+    telem_partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                               TELEMETRY_PARTITION_SUBTYPE,
+                                               TELEMETRY_PARTITION_LABEL);
+    if (telem_partition == NULL) {
+        ESP_LOGW(TAG, "No '%s' partition - telemetry disabled", TELEMETRY_PARTITION_LABEL);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    telem_sectors = telem_partition->size / TELEM_SECTOR_SIZE;
+    if (telem_sectors > TELEM_MAX_SECTORS) {
+        telem_sectors = TELEM_MAX_SECTORS;
+    }
+    if (telem_sectors < 2) {
+        ESP_LOGW(TAG, "Partition too small for a ring");
+        telem_partition = NULL;
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    telem_mutex = xSemaphoreCreateMutex();
+    if (telem_mutex == NULL) {
+        telem_partition = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (rtc_telem.magic == TELEM_RTC_MAGIC && rtc_telem.head_sector < telem_sectors &&
+        rtc_telem.len <= TELEMETRY_BUFFER_BYTES) {
+        ESP_LOGI(TAG, "Resumed: %u bytes buffered, head sector %" PRIu32,
+                 rtc_telem.len, rtc_telem.head_sector);
+        return ESP_OK;
+    }
+
+    memset(&rtc_telem, 0, sizeof(rtc_telem));
+    locate_head();
+    rtc_telem.magic = TELEM_RTC_MAGIC;
+    return ESP_OK;
+}
+
+void telemetry_record(telemetry_series_t series, int32_t value) {
+    if (telem_mutex == NULL || series >= TELEM_SERIES_COUNT) {
+        return;
+    }
+
+    uint32_t now = telem_now();
+    xSemaphoreTake(telem_mutex, portMAX_DELAY);
+    if (!append_locked(series, value, now)) {
+        // Buffer full: use this wake's flush early, otherwise the sample is lost
+        if (!flushed_this_wake && flush_locked() == ESP_OK) {
+            append_locked(series, value, now);
+        } else {
+            rtc_telem.dropped++;
+        }
+    }
+    xSemaphoreGive(telem_mutex);
+}
+
+esp_err_t telemetry_flush(bool force) {
+    if (telem_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t ret = ESP_OK;
+    xSemaphoreTake(telem_mutex, portMAX_DELAY);
+    if (!flushed_this_wake && (force || rtc_telem.len >= TELEMETRY_FLUSH_THRESHOLD)) {
+        ret = flush_locked();
+    }
+    xSemaphoreGive(telem_mutex);
+    return ret;
+}
+
+typedef struct {
+    telemetry_series_t series;
+    uint32_t from;
+    uint32_t to;
+    telemetry_bucket_t *buckets;
+    uint16_t count;
+    telemetry_query_stats_t *stats;
+} telem_query_t;
+
+static void accumulate(telem_query_t *q, uint32_t t, int32_t value) {
+    if (t < q->from || t > q->to) {
+        return;
+    }
+
+    uint64_t span = (uint64_t)q->to - q->from + 1;
+    telemetry_bucket_t *b = &q->buckets[(uint64_t)(t - q->from) * q->count / span];
+    if (b->count == 0 || value < b->min) b->min = value;
+    if (b->count == 0 || value > b->max) b->max = value;
+    b->sum += value;
+    b->count++;
+    q->stats->samples++;
+}
+
+static void decode_block(telem_query_t *q, const uint8_t *payload, size_t len, uint32_t t) {
+    int32_t last[TELEM_SERIES_COUNT] = {0};
+    size_t pos = 0;
+
+    while (pos < len) {
+        uint8_t tag = payload[pos++];
+        uint32_t series = tag & TELEM_TAG_SERIES_MASK;
+        uint32_t dt = 0;
+        uint32_t delta;
+
+        if (!(tag & TELEM_TAG_SAME_TIME) && !varint_get(payload, len, &pos, &dt)) {
+            return;
+        }
+        if (!varint_get(payload, len, &pos, &delta) || series >= TELEM_SERIES_COUNT) {
+            // Truncated, or a series added by newer firmware - deltas are lost
+            return;
+        }
+
+        t += dt;
+        last[series] = (int32_t)((uint32_t)last[series] + (uint32_t)unzigzag(delta));
+        if (series == (uint32_t)q->series) {
+            accumulate(q, t, last[series]);
+        }
+    }
+}
+
+static void scan_sector(telem_query_t *q, uint32_t sector) {
+    uint8_t payload[TELEMETRY_BUFFER_BYTES];
+    uint32_t addr = sector * TELEM_SECTOR_SIZE + sizeof(telem_sector_hdr_t);
+    uint32_t end = (sector + 1) * TELEM_SECTOR_SIZE;
+
+    while (addr + sizeof(telem_block_hdr_t) <= end) {
+        telem_block_hdr_t block;
+        if (esp_partition_read(telem_partition, addr, &block, sizeof(block)) != ESP_OK ||
+            block.magic != TELEM_BLOCK_MAGIC || block.len > TELEM_BLOCK_MAX_LEN) {
+            return;
+        }
+        uint32_t payload_addr = addr + sizeof(block);
+        addr += align4(sizeof(block) + block.len);
+
+        if (block.t_end < q->from || block.t_start > q->to) {
+            q->stats->blocks_skipped++;
+            continue;
+        }
+        // Blocks larger than this build's buffer come from another build
+        if (block.len > sizeof(payload) ||
+            esp_partition_read(telem_partition, payload_addr, payload, block.len) != ESP_OK ||
+            esp_rom_crc32_le(0, payload, block.len) != block.crc) {
+            continue;
+        }
+        decode_block(q, payload, block.len, block.t_start);
+        q->stats->blocks_read++;
+    }
+}
+
+esp_err_t telemetry_query(telemetry_series_t series, uint32_t from_sec, uint32_t to_sec,
+                          telemetry_bucket_t *buckets, uint16_t count,
+                          telemetry_query_stats_t *stats) {
+    if (series >= TELEM_SERIES_COUNT || count == 0 || from_sec > to_sec) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (telem_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    memset(buckets, 0, count * sizeof(*buckets));
+    memset(stats, 0, sizeof(*stats));
+    telem_query_t q = {
+        .series = series, .from = from_sec, .to = to_sec,
+        .buckets = buckets, .count = count, .stats = stats
+    };
+
+    xSemaphoreTake(telem_mutex, portMAX_DELAY);
+
+    // Oldest to newest. A sector ends where the next one starts, so headers
+    // alone rule out sectors that lie entirely before or after the range
+    int32_t pending = -1;
+    for (uint32_t i = 1; i <= telem_sectors && rtc_telem.head_seq != 0; i++) {
+        uint32_t sector = (rtc_telem.head_sector + i) % telem_sectors;
+        telem_sector_hdr_t hdr;
+        if (!read_sector_hdr(sector, &hdr) || hdr.seq > rtc_telem.head_seq ||
+            rtc_telem.head_seq - hdr.seq >= telem_sectors) {
+            continue;
+        }
+
+        if (pending >= 0) {
+            if (hdr.t_start < from_sec) {
+                stats->sectors_skipped++;
+            } else {
+                scan_sector(&q, (uint32_t)pending);
+            }
+        }
+        if (hdr.t_start > to_sec) {
+            // Everything from here on is newer than the range
+            stats->sectors_skipped++;
+            pending = -1;
+            break;
+        }
+        pending = (int32_t)sector;
+    }
+    if (pending >= 0) {
+        scan_sector(&q, (uint32_t)pending);
+    }
+
+    // Samples still waiting in RTC memory
+    if (rtc_telem.len > 0 && rtc_telem.t_last >= from_sec && rtc_telem.t_start <= to_sec) {
+        decode_block(&q, rtc_telem.buf, rtc_telem.len, rtc_telem.t_start);
+        stats->blocks_read++;
+    }
+
+    xSemaphoreGive(telem_mutex);
+    return ESP_OK;
+}
+
+void telemetry_get_info(telemetry_info_t *info) {
+    memset(info, 0, sizeof(*info));
+    if (telem_mutex == NULL) {
+        return;
+    }
+
+    xSemaphoreTake(telem_mutex, portMAX_DELAY);
+    uint32_t used = rtc_telem.head_seq < telem_sectors ? rtc_telem.head_seq : telem_sectors;
+    info->capacity_bytes = telem_partition->size;
+    info->sectors = telem_sectors;
+    info->used_bytes = used * TELEM_SECTOR_SIZE;
+    info->head_sector = rtc_telem.head_sector;
+    info->head_seq = rtc_telem.head_seq;
+    info->buffered_bytes = rtc_telem.len;
+    info->dropped = rtc_telem.dropped;
+
+    if (used > 0) {
+        telem_sector_hdr_t hdr;
+        uint32_t oldest = (rtc_telem.head_sector + telem_sectors - used + 1) % telem_sectors;
+        if (read_sector_hdr(oldest, &hdr)) {
+            info->oldest_sec = hdr.t_start;
+        }
+    }
+    xSemaphoreGive(telem_mutex);
+}
+
+const char* telemetry_series_name(telemetry_series_t series) {
+    return series < TELEM_SERIES_COUNT ? series_names[series] : "unknown";
+}
+
+telemetry_series_t telemetry_series_from_name(const char *name) {
+    for (int i = 0; i < TELEM_SERIES_COUNT; i++) {
+        if (strcmp(name, series_names[i]) == 0) {
+            return (telemetry_series_t)i;
+        }
+    }
+    return TELEM_SERIES_COUNT;
+}
@@ -7,4 +7,22 @@ esp_err_t register_upload_handlers(httpd_handle_t server);
 esp_err_t mass_erase_handler(httpd_req_t *req);  // Add this line
 esp_err_t check_swd_handler(httpd_req_t *req);   // Add this line too
 
+// Init and connect the SWD interface if needed (shared by the job handlers)
+esp_err_t ensure_swd_ready(void);
+
+// Flash job guards shared with /upload: refuse a job the battery cannot
+// finish (sends the error response), and throttle or pause between pages
+bool job_energy_ok(httpd_req_t *req, uint32_t payload_bytes);
+void page_sag_guard(void);
+
+// Instruction cache profiling, results kept per firmware build
+esp_err_t register_profile_handlers(httpd_handle_t server);
+void cache_profile_set_build(uint32_t build);
+
+// Hardware breakpoints / watchpoints on /debug
+esp_err_t register_debug_handlers(httpd_handle_t server);
+
+// SWD, NVMC and hex parser microbenchmarks on /bench
+esp_err_t register_bench_handlers(httpd_handle_t server);
+
 #endif
\ No newline at end of file
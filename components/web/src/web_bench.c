@@ -0,0 +1,272 @@
+// web_bench.c - On-target microbenchmarks for the SWD path
+//
+// /bench runs a fixed set of measurements against the attached radio and
+// returns CPU cycle counts with the derived rates: DP reads, AP writes,
+// 4KB block write and read to target RAM, and hex parsing of a built-in
+// sample. Page erase and program only run with nvmc_page=<hex>: that page
+// is read first and programmed back with its own content, which is the
+// program measurement, under the same battery guards as /upload. The core is halted for the run and the RAM window
+// restored before it resumes.
+#include "web_upload.h"
+#include "swd_core.h"
+#include "swd_mem.h"
+#include "swd_flash.h"
+#include "swd_sim.h"
+#include "hex_parser.h"
+#include "esp_log.h"
+#include "esp_cpu.h"
+#include "esp_rom_sys.h"
+#include "cJSON.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+static const char *TAG = "WEB_BENCH";
+
+#define BENCH_DP_READS      1000
+#define BENCH_AP_WRITES     1000
+#define BENCH_RAM_ADDR      0x20000000
+#define BENCH_BLOCK_WORDS   1024            // 4KB
+#define BENCH_HEX_RECORDS   512             // 8KB of data, 22KB of text
+#define BENCH_HEX_PASSES    4
+#define BENCH_HEX_LINE_LEN  44              // ":10AAAA00" + 32 data + checksum + "\n"
+
+static uint32_t bench_mhz = 0;
+
+static void add_result(cJSON *json, const char *name, uint32_t ops, uint32_t bytes,
+                       uint32_t cycles) {
+    cJSON *item = cJSON_AddObjectToObject(json, name);
+    double us = (double)cycles / bench_mhz;
+
+    cJSON_AddNumberToObject(item, "cycles", cycles);
+    cJSON_AddNumberToObject(item, "us", us);
+    if (ops > 0) {
+        cJSON_AddNumberToObject(item, "ops", ops);
+        cJSON_AddNumberToObject(item, "cycles_per_op", cycles / ops);
+        cJSON_AddNumberToObject(item, "ops_per_s", us > 0 ? ops * 1000000.0 / us : 0);
+    }
+    if (bytes > 0) {
+        cJSON_AddNumberToObject(item, "bytes", bytes);
+        cJSON_AddNumberToObject(item, "kb_s", us > 0 ? bytes * 1000000.0 / us / 1024.0 : 0);
+    }
+}
+
+// Data records only: EOF and address records would log from the parser
+static char *hex_sample(size_t *len) {
+    char *buf = malloc(BENCH_HEX_RECORDS * BENCH_HEX_LINE_LEN + 1);
+    if (!buf) {
+        return NULL;
+    }
+
+    size_t n = 0;
+    for (int r = 0; r < BENCH_HEX_RECORDS; r++) {
+        uint16_t addr = r * 16;
+        uint8_t sum = 0x10 + (addr >> 8) + (addr & 0xFF);
+        n += sprintf(buf + n, ":10%04X00", addr);
+        for (int i = 0; i < 16; i++) {
+            uint8_t b = (uint8_t)(r * 31 + i * 7);
+            sum += b;
+            n += sprintf(buf + n, "%02X", b);
+        }
+        n += sprintf(buf + n, "%02X\n", (uint8_t)(-sum));
+    }
+    *len = n;
+    return buf;
+}
+
+static void count_bytes_callback(hex_record_t *record, uint32_t abs_addr, void *ctx) {
+    *(uint32_t *)ctx += record->byte_count;
+}
+
+static esp_err_t bench_hex_parse(cJSON *json) {
+    size_t len = 0;
+    char *sample = hex_sample(&len);
+    if (!sample) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    uint32_t data_bytes = 0;
+    hex_stream_parser_t *parser = hex_stream_create(count_bytes_callback, &data_bytes);
+    if (!parser) {
+        free(sample);
+        return ESP_ERR_NO_MEM;
+    }
+
+    uint32_t start = esp_cpu_get_cycle_count();
+    for (int pass = 0; pass < BENCH_HEX_PASSES; pass++) {
+        hex_stream_parse(parser, (const uint8_t *)sample, len);
+    }
+    uint32_t cycles = esp_cpu_get_cycle_count() - start;
+
+    hex_stream_free(parser);
+    free(sample);
+
+    add_result(json, "hex_parse", BENCH_HEX_PASSES * BENCH_HEX_RECORDS,
+               BENCH_HEX_PASSES * len, cycles);
+    return data_bytes == BENCH_HEX_PASSES * BENCH_HEX_RECORDS * 16 ? ESP_OK : ESP_ERR_INVALID_CRC;
+}
+
+static esp_err_t bench_nvmc(cJSON *json, uint32_t page, uint32_t *save, uint32_t *check) {
+    esp_err_t ret = swd_mem_read_block32(page, save, BENCH_BLOCK_WORDS);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    page_sag_guard();
+
+    uint32_t start = esp_cpu_get_cycle_count();
+    ret = swd_flash_erase_page(page);
+    add_result(json, "page_erase", 1, 0, esp_cpu_get_cycle_count() - start);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    start = esp_cpu_get_cycle_count();
+    ret = swd_flash_write_buffer(page, (const uint8_t *)save, BENCH_BLOCK_WORDS * 4);
+    add_result(json, "page_program", 1, BENCH_BLOCK_WORDS * 4, esp_cpu_get_cycle_count() - start);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    ret = swd_mem_read_block32(page, check, BENCH_BLOCK_WORDS);
+    bool restored = ret == ESP_OK && memcmp(save, check, BENCH_BLOCK_WORDS * 4) == 0;
+    cJSON_AddBoolToObject(json, "page_restored", restored);
+    if (!restored) {
+        ESP_LOGE(TAG, "Page 0x%08" PRIX32 " differs after the program benchmark", page);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t bench_swd(cJSON *json, uint32_t nvmc_page) {
+    uint32_t *save = malloc(BENCH_BLOCK_WORDS * 4);
+    uint32_t *pattern = malloc(BENCH_BLOCK_WORDS * 4);
+    if (!save || !pattern) {
+        free(save);
+        free(pattern);
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t ret = ESP_OK;
+    uint32_t value = 0;
+
+    uint32_t start = esp_cpu_get_cycle_count();
+    for (int i = 0; i < BENCH_DP_READS && ret == ESP_OK; i++) {
+        ret = swd_dp_read(DP_IDCODE, &value);
+    }
+    add_result(json, "dp_read", BENCH_DP_READS, 0, esp_cpu_get_cycle_count() - start);
+
+    // TAR writes: an AP write that starts no bus access
+    start = esp_cpu_get_cycle_count();
+    for (int i = 0; i < BENCH_AP_WRITES && ret == ESP_OK; i++) {
+        ret = swd_ap_write(AP_TAR, BENCH_RAM_ADDR);
+    }
+    add_result(json, "ap_write", BENCH_AP_WRITES, 0, esp_cpu_get_cycle_count() - start);
+
+    uint32_t dhcsr = 0;
+    if (ret == ESP_OK) {
+        ret = swd_mem_read32(DHCSR_ADDR, &dhcsr);
+    }
+    bool halted_here = ret == ESP_OK && !(dhcsr & DHCSR_S_HALT);
+    if (halted_here) {
+        ret = swd_mem_write32(DHCSR_ADDR, DHCSR_DBGKEY | DHCSR_C_DEBUGEN | DHCSR_C_HALT);
+    }
+
+    if (ret == ESP_OK) {
+        // The read doubles as the save of the RAM window
+        start = esp_cpu_get_cycle_count();
+        ret = swd_mem_read_block32(BENCH_RAM_ADDR, save, BENCH_BLOCK_WORDS);
+        add_result(json, "block_read", 0, BENCH_BLOCK_WORDS * 4, esp_cpu_get_cycle_count() - start);
+    }
+    if (ret == ESP_OK) {
+        for (int i = 0; i < BENCH_BLOCK_WORDS; i++) {
+            pattern[i] = 0xA5000000 | i;
+        }
+        start = esp_cpu_get_cycle_count();
+        ret = swd_mem_write_block32(BENCH_RAM_ADDR, pattern, BENCH_BLOCK_WORDS);
+        add_result(json, "block_write", 0, BENCH_BLOCK_WORDS * 4, esp_cpu_get_cycle_count() - start);
+
+        esp_err_t restore_ret = swd_mem_write_block32(BENCH_RAM_ADDR, save, BENCH_BLOCK_WORDS);
+        if (ret == ESP_OK) {
+            ret = restore_ret;
+        }
+    }
+
+    if (ret == ESP_OK && nvmc_page != UINT32_MAX) {
+        ret = bench_nvmc(json, nvmc_page, save, pattern);
+    }
+
+    if (halted_here) {
+        swd_mem_write32(DHCSR_ADDR, DHCSR_DBGKEY | DHCSR_C_DEBUGEN);
+    }
+
+    free(save);
+    free(pattern);
+    return ret;
+}
+
+static esp_err_t bench_handler(httpd_req_t *req) {
+    char query[64] = {0};
+    char param[16] = {0};
+    uint32_t nvmc_page = UINT32_MAX;
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "nvmc_page", param, sizeof(param)) == ESP_OK) {
+        nvmc_page = strtoul(param, NULL, 16);
+        if ((nvmc_page & (NRF52_FLASH_PAGE_SIZE - 1)) || nvmc_page >= NRF52_FLASH_SIZE) {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "nvmc_page must be a flash page address");
+            return ESP_FAIL;
+        }
+        // The erase and program are a flash job like /upload
+        if (!job_energy_ok(req, NRF52_FLASH_PAGE_SIZE)) {
+            return ESP_FAIL;
+        }
+    }
+
+    cJSON *json = cJSON_CreateObject();
+
+    swd_busy_begin();
+    bench_mhz = esp_rom_get_cpu_ticks_per_us();
+
+    swd_sim_stats_t sim;
+    esp_err_t ret = bench_hex_parse(json);
+    esp_err_t swd_ret = ensure_swd_ready();
+    if (swd_ret == ESP_OK) {
+        swd_ret = bench_swd(json, nvmc_page);
+    }
+    if (ret == ESP_OK) {
+        ret = swd_ret;
+    }
+
+    cJSON_AddStringToObject(json, "backend", swd_sim_get_stats(&sim) ? "simulator" : "gpio");
+    cJSON_AddNumberToObject(json, "cpu_mhz", bench_mhz);
+    cJSON_AddNumberToObject(json, "swclk_khz", swd_get_config()->swclk_khz);
+
+    swd_shutdown();
+    swd_busy_end();
+
+    cJSON_AddBoolToObject(json, "success", ret == ESP_OK);
+    if (ret != ESP_OK) {
+        cJSON_AddStringToObject(json, "message", esp_err_to_name(ret));
+    }
+
+    char *json_string = cJSON_PrintUnformatted(json);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, json_string, strlen(json_string));
+
+    free(json_string);
+    cJSON_Delete(json);
+    return ESP_OK;
+}
+
+esp_err_t register_bench_handlers(httpd_handle_t server) {
+    httpd_uri_t bench_uri = {
+        .uri = "/bench",
+        .method = HTTP_GET,
+        .handler = bench_handler,
+        .user_ctx = NULL
+    };
+
+    ESP_ERROR_CHECK(httpd_register_uri_handler(server, &bench_uri));
+    return ESP_OK;
+}
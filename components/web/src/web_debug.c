@@ -0,0 +1,188 @@
+// web_debug.c - Hardware breakpoints and watchpoints for scripted HIL checks
+//
+// One endpoint, /debug?op=<op>, so a script can drive a session:
+//   info                               comparators found via the ROM table
+//   break&addr=<hex>                   allocate an FPB code comparator
+//   watch&addr=<hex>&size=<n>&type=read|write|access
+//   remove&kind=break|watch&id=<n>     free one comparator
+//   clear                              free all comparators
+//   run&timeout_ms=<ms>                arm, resume and wait for the halt
+//   wait&timeout_ms=<ms>               keep waiting after a timed-out run
+//   release                            disarm and hand the target back
+// SWD stays connected between requests until release (or /release_swd).
+#include "web_upload.h"
+#include "swd_core.h"
+#include "swd_mem.h"
+#include "swd_debug.h"
+#include "esp_log.h"
+#include "cJSON.h"
+#include <string.h>
+#include <stdlib.h>
+
+static const char *TAG = "WEB_DEBUG";
+
+#define DEBUG_DEFAULT_TIMEOUT_MS    5000
+#define DEBUG_MAX_TIMEOUT_MS        60000
+
+static void add_hex(cJSON *json, const char *name, uint32_t value) {
+    char hex[12];
+    snprintf(hex, sizeof(hex), "0x%08" PRIx32, value);
+    cJSON_AddStringToObject(json, name, hex);
+}
+
+static void add_info(cJSON *json) {
+    swd_debug_info_t info;
+    if (swd_debug_discover(&info) != ESP_OK) {
+        return;
+    }
+    add_hex(json, "fpb_base", info.fpb_base);
+    add_hex(json, "dwt_base", info.dwt_base);
+    cJSON_AddNumberToObject(json, "fpb_version", info.fpb_rev + 1);
+    cJSON_AddNumberToObject(json, "breakpoints", info.num_code);
+    cJSON_AddNumberToObject(json, "watchpoints", info.num_watch);
+    cJSON_AddNumberToObject(json, "breakpoints_used", info.code_used);
+    cJSON_AddNumberToObject(json, "watchpoints_used", info.watch_used);
+}
+
+static void add_halt(cJSON *json, const swd_debug_halt_t *halt) {
+    add_hex(json, "pc", halt->regs[CORE_REG_PC]);
+    add_hex(json, "dfsr", halt->dfsr);
+    cJSON_AddNumberToObject(json, "breakpoint", halt->breakpoint);
+    cJSON_AddNumberToObject(json, "watchpoint", halt->watchpoint);
+    cJSON_AddNumberToObject(json, "wait_us", halt->wait_us);
+
+    cJSON *regs = cJSON_AddArrayToObject(json, "regs");  // R0-R15, xPSR
+    for (int i = 0; i < SWD_DEBUG_REG_COUNT; i++) {
+        cJSON_AddItemToArray(regs, cJSON_CreateNumber(halt->regs[i]));
+    }
+}
+
+static swd_watch_type_t parse_watch_type(const char *type) {
+    if (strcmp(type, "read") == 0) return SWD_WATCH_READ;
+    if (strcmp(type, "access") == 0) return SWD_WATCH_ACCESS;
+    return SWD_WATCH_WRITE;
+}
+
+static esp_err_t debug_op(const char *op, const char *query, cJSON *json) {
+    char param[16] = {0};
+    uint32_t timeout_ms = DEBUG_DEFAULT_TIMEOUT_MS;
+    int id = -1;
+    esp_err_t ret;
+
+    if (strcmp(op, "release") == 0) {
+        swd_debug_clear();
+        if (!swd_is_connected()) {
+            return ESP_OK;
+        }
+        ret = swd_release_target();
+        swd_shutdown();
+        return ret;
+    }
+
+    ret = ensure_swd_ready();
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    if (httpd_query_key_value(query, "timeout_ms", param, sizeof(param)) == ESP_OK) {
+        timeout_ms = strtoul(param, NULL, 10);
+        if (timeout_ms > DEBUG_MAX_TIMEOUT_MS) timeout_ms = DEBUG_MAX_TIMEOUT_MS;
+    }
+
+    if (strcmp(op, "info") == 0) {
+        ret = swd_debug_discover(NULL);
+    } else if (strcmp(op, "break") == 0 || strcmp(op, "watch") == 0) {
+        if (httpd_query_key_value(query, "addr", param, sizeof(param)) != ESP_OK) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        uint32_t addr = strtoul(param, NULL, 16);
+
+        if (op[0] == 'b') {
+            ret = swd_debug_add_breakpoint(addr, &id);
+        } else {
+            uint32_t size = 4;
+            swd_watch_type_t type = SWD_WATCH_WRITE;
+            if (httpd_query_key_value(query, "size", param, sizeof(param)) == ESP_OK) {
+                size = strtoul(param, NULL, 10);
+            }
+            if (httpd_query_key_value(query, "type", param, sizeof(param)) == ESP_OK) {
+                type = parse_watch_type(param);
+            }
+            ret = swd_debug_add_watchpoint(addr, size, type, &id);
+        }
+        if (ret == ESP_OK) {
+            cJSON_AddNumberToObject(json, "id", id);
+        }
+    } else if (strcmp(op, "remove") == 0) {
+        bool watchpoint = httpd_query_key_value(query, "kind", param, sizeof(param)) == ESP_OK &&
+                          strcmp(param, "watch") == 0;
+        if (httpd_query_key_value(query, "id", param, sizeof(param)) != ESP_OK) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        ret = swd_debug_remove(watchpoint, atoi(param));
+    } else if (strcmp(op, "clear") == 0) {
+        swd_debug_clear();
+        ret = swd_debug_disarm();
+    } else if (strcmp(op, "run") == 0 || strcmp(op, "wait") == 0) {
+        swd_debug_halt_t halt;
+        ret = op[0] == 'r' ? swd_debug_run() : ESP_OK;
+        if (ret == ESP_OK) {
+            ret = swd_debug_wait_halt(timeout_ms, &halt);
+        }
+        cJSON_AddBoolToObject(json, "halted", ret == ESP_OK);
+        if (ret == ESP_OK) {
+            add_halt(json, &halt);
+        } else if (ret == ESP_ERR_TIMEOUT) {
+            ret = ESP_OK;  // Still running - a script may wait again
+        }
+    } else {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    if (ret == ESP_OK) {
+        add_info(json);
+    }
+    return ret;
+}
+
+static esp_err_t debug_handler(httpd_req_t *req) {
+    char query[160] = {0};
+    char op[16] = "info";
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        httpd_query_key_value(query, "op", op, sizeof(op));
+    }
+
+    cJSON *json = cJSON_CreateObject();
+    cJSON_AddStringToObject(json, "op", op);
+
+    swd_busy_begin();
+    esp_err_t ret = debug_op(op, query, json);
+    swd_busy_end();
+
+    cJSON_AddBoolToObject(json, "success", ret == ESP_OK);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "op=%s failed: %s", op, esp_err_to_name(ret));
+        cJSON_AddStringToObject(json, "message", esp_err_to_name(ret));
+    }
+
+    char *json_string = cJSON_PrintUnformatted(json);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, json_string, strlen(json_string));
+
+    free(json_string);
+    cJSON_Delete(json);
+    return ESP_OK;
+}
+
+esp_err_t register_debug_handlers(httpd_handle_t server) {
+    httpd_uri_t debug_uri = {
+        .uri = "/debug",
+        .method = HTTP_GET,
+        .handler = debug_handler,
+        .user_ctx = NULL
+    };
+
+    ESP_ERROR_CHECK(httpd_register_uri_handler(server, &debug_uri));
+    return ESP_OK;
+}
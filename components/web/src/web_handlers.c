@@ -1,11 +1,19 @@
 #include "web_server.h"
 #include "esp_log.h"
 #include "power_mgmt.h"
+#include "power_history.h"
+#include "power_wake_stub.h"
+#include "power_energy.h"
+#include "power_schedule.h"
+#include "telemetry.h"
+#include "binlog.h"
 #include "cJSON.h"
 #include "esp_wifi.h"
 #include "esp_netif.h"
 #include "esp_timer.h"
 #include <string.h>
+#include <stdlib.h>
+#include <time.h>
 
 static const char *TAG = "WEB_HANDLERS";
 
@@ -45,6 +53,7 @@ static esp_err_t battery_status_handler(httpd_req_t *req) {
         cJSON_AddBoolToObject(json, "is_low", battery.is_low);
         cJSON_AddBoolToObject(json, "is_critical", battery.is_critical);
         cJSON_AddNumberToObject(json, "samples", battery.samples_count);
+        cJSON_AddNumberToObject(json, "age_ms", battery.age_ms);
         const char *status_text = "Normal";
         if (battery.is_critical) status_text = "Critical";
         else if (battery.is_low) status_text = "Low";
@@ -280,7 +289,7 @@ static esp_err_t power_cycle_handler(httpd_req_t *req) {
         }
     }
 
-    ESP_LOGI(TAG, "Power cycling for %lu ms", off_time);
+    ESP_LOGI(TAG, "Power cycling for %" PRIu32 " ms", off_time);
     esp_err_t ret = power_target_cycle(off_time);
 
     cJSON *json = cJSON_CreateObject();
@@ -302,6 +311,300 @@ static esp_err_t power_cycle_handler(httpd_req_t *req) {
     return ESP_OK;
 }
 
+// Wake history from the RTC ring buffer (oldest first)
+static esp_err_t history_handler(httpd_req_t *req) {
+    cJSON *json = cJSON_CreateObject();
+    uint16_t count = power_history_count();
+
+    cJSON_AddBoolToObject(json, "success", true);
+    cJSON_AddNumberToObject(json, "count", count);
+    cJSON_AddNumberToObject(json, "capacity", power_history_capacity());
+    cJSON_AddNumberToObject(json, "wake_count", power_get_wake_count());
+    cJSON_AddNumberToObject(json, "stub_skipped_last", power_wake_stub_last_skipped());
+    cJSON_AddNumberToObject(json, "stub_skipped_total", power_wake_stub_total_skipped());
+    cJSON_AddBoolToObject(json, "stub_woke_early", power_wake_stub_woke_early());
+    cJSON_AddNumberToObject(json, "stub_battery_raw", power_wake_stub_battery_raw());
+
+    cJSON *entries = cJSON_AddArrayToObject(json, "entries");
+    for (uint16_t i = 0; i < count; i++) {
+        history_entry_t entry;
+        if (!power_history_get(i, &entry)) {
+            break;
+        }
+
+        cJSON *item = cJSON_CreateObject();
+        cJSON_AddNumberToObject(item, "voltage", entry.voltage);
+        cJSON_AddNumberToObject(item, "awake_sec", entry.awake_sec);
+        cJSON_AddNumberToObject(item, "sleep_sec", entry.sleep_sec);
+        cJSON_AddStringToObject(item, "wake", power_history_wake_reason_name(entry.wake_reason));
+        cJSON_AddStringToObject(item, "wifi", power_history_wifi_mode_name(entry.wifi_mode));
+        cJSON_AddStringToObject(item, "outcome", power_history_outcome_name(entry.outcome));
+        cJSON_AddItemToArray(entries, item);
+    }
+
+    // Unformatted - a full ring is ~128 objects
+    char *json_string = cJSON_PrintUnformatted(json);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, json_string, strlen(json_string));
+
+    free(json_string);
+    cJSON_Delete(json);
+    return ESP_OK;
+}
+
+// Estimated charge per power state, from the RTC energy accountant
+static esp_err_t energy_handler(httpd_req_t *req) {
+    energy_report_t report;
+    energy_coeffs_t coeffs;
+    power_energy_get_report(&report);
+    power_energy_get_coeffs(&coeffs);
+
+    cJSON *json = cJSON_CreateObject();
+    cJSON_AddBoolToObject(json, "success", true);
+    cJSON_AddNumberToObject(json, "observed_hours", report.observed_ms / 3600000.0);
+    cJSON_AddNumberToObject(json, "total_mah", report.total_mah);
+    cJSON_AddNumberToObject(json, "mah_per_day", report.total_mah_per_day);
+    cJSON_AddNumberToObject(json, "avg_current_ma", report.avg_current_ma);
+    if (report.total_mah_per_day > 0) {
+        cJSON_AddNumberToObject(json, "battery_days",
+                                power_energy_battery_capacity_mah() / report.total_mah_per_day);
+    }
+
+    cJSON *categories = cJSON_AddArrayToObject(json, "categories");
+    for (int i = 0; i < ENERGY_CAT_COUNT; i++) {
+        cJSON *item = cJSON_CreateObject();
+        cJSON_AddStringToObject(item, "name", energy_category_name((energy_category_t)i));
+        cJSON_AddNumberToObject(item, "current_ua", coeffs.current_ua[i]);
+        cJSON_AddNumberToObject(item, "mah", report.mah[i]);
+        cJSON_AddNumberToObject(item, "mah_per_day", report.mah_per_day[i]);
+        cJSON_AddItemToArray(categories, item);
+    }
+
+    char *json_string = cJSON_PrintUnformatted(json);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, json_string, strlen(json_string));
+
+    free(json_string);
+    cJSON_Delete(json);
+    return ESP_OK;
+}
+
+// Learned wake schedule: relative wake density per 30 minute bin
+static esp_err_t schedule_handler(httpd_req_t *req) {
+    schedule_info_t info;
+    power_schedule_get_info(&info);
+
+    cJSON *json = cJSON_CreateObject();
+    cJSON_AddBoolToObject(json, "success", true);
+    cJSON_AddBoolToObject(json, "active", info.active);
+    cJSON_AddBoolToObject(json, "clock_synced", info.clock_synced);
+    cJSON_AddBoolToObject(json, "hist_synced", info.hist_synced);
+    cJSON_AddNumberToObject(json, "samples", info.samples);
+    cJSON_AddNumberToObject(json, "time_of_day_sec", info.time_of_day_sec);
+    cJSON_AddNumberToObject(json, "bin_sec", SCHEDULE_BIN_SEC);
+
+    cJSON *weights = cJSON_AddArrayToObject(json, "weight_pct");
+    for (int i = 0; i < SCHEDULE_BINS; i++) {
+        cJSON_AddItemToArray(weights, cJSON_CreateNumber(info.weight_pct[i]));
+    }
+
+    char *json_string = cJSON_PrintUnformatted(json);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, json_string, strlen(json_string));
+
+    free(json_string);
+    cJSON_Delete(json);
+    return ESP_OK;
+}
+
+// Set the device clock: POST /time_sync?epoch=<unix seconds>
+static esp_err_t time_sync_handler(httpd_req_t *req) {
+    char query[64] = {0};
+    char param[24] = {0};
+    esp_err_t ret = ESP_ERR_INVALID_ARG;
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "epoch", param, sizeof(param)) == ESP_OK) {
+        ret = power_schedule_time_sync(strtoll(param, NULL, 10));
+    }
+
+    cJSON *json = cJSON_CreateObject();
+    cJSON_AddBoolToObject(json, "success", ret == ESP_OK);
+    if (ret != ESP_OK) {
+        cJSON_AddStringToObject(json, "message", esp_err_to_name(ret));
+    }
+
+    char *json_string = cJSON_Print(json);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, json_string, strlen(json_string));
+
+    free(json_string);
+    cJSON_Delete(json);
+    return ESP_OK;
+}
+
+// Flash telemetry log. Without series: log status. With series: downsampled
+// /telemetry?series=battery_mv&from=<unix>&to=<unix>&points=<n>
+// (defaults: the last 7 days in 48 points; empty buckets are omitted)
+static esp_err_t telemetry_handler(httpd_req_t *req) {
+    char query[128] = {0};
+    char param[24] = {0};
+    telemetry_series_t series = TELEM_SERIES_COUNT;
+    bool have_query = httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK;
+
+    if (have_query && httpd_query_key_value(query, "series", param, sizeof(param)) == ESP_OK) {
+        series = telemetry_series_from_name(param);
+        if (series == TELEM_SERIES_COUNT) {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Unknown series");
+            return ESP_FAIL;
+        }
+    }
+
+    cJSON *json = cJSON_CreateObject();
+
+    if (series == TELEM_SERIES_COUNT) {
+        telemetry_info_t info;
+        telemetry_get_info(&info);
+        cJSON_AddBoolToObject(json, "success", info.capacity_bytes > 0);
+        cJSON_AddNumberToObject(json, "capacity_bytes", info.capacity_bytes);
+        cJSON_AddNumberToObject(json, "used_bytes", info.used_bytes);
+        cJSON_AddNumberToObject(json, "sectors", info.sectors);
+        cJSON_AddNumberToObject(json, "head_sector", info.head_sector);
+        cJSON_AddNumberToObject(json, "head_seq", info.head_seq);
+        cJSON_AddNumberToObject(json, "buffered_bytes", info.buffered_bytes);
+        cJSON_AddNumberToObject(json, "dropped", info.dropped);
+        cJSON_AddNumberToObject(json, "oldest", info.oldest_sec);
+
+        cJSON *names = cJSON_AddArrayToObject(json, "series");
+        for (int i = 0; i < TELEM_SERIES_COUNT; i++) {
+            cJSON_AddItemToArray(names, cJSON_CreateString(telemetry_series_name(i)));
+        }
+    } else {
+        uint32_t to = (uint32_t)time(NULL);
+        uint32_t from = to > 7 * 86400 ? to - 7 * 86400 : 0;
+        uint32_t points = 48;
+
+        if (httpd_query_key_value(query, "to", param, sizeof(param)) == ESP_OK) {
+            to = strtoul(param, NULL, 10);
+        }
+        if (httpd_query_key_value(query, "from", param, sizeof(param)) == ESP_OK) {
+            from = strtoul(param, NULL, 10);
+        }
+        if (httpd_query_key_value(query, "points", param, sizeof(param)) == ESP_OK) {
+            points = strtoul(param, NULL, 10);
+        }
+        if (points < 1) points = 1;
+        if (points > 240) points = 240;
+
+        telemetry_bucket_t *buckets = malloc(points * sizeof(telemetry_bucket_t));
+        telemetry_query_stats_t stats;
+        esp_err_t ret = buckets ? telemetry_query(series, from, to, buckets, points, &stats)
+                                : ESP_ERR_NO_MEM;
+
+        cJSON_AddBoolToObject(json, "success", ret == ESP_OK);
+        cJSON_AddStringToObject(json, "series", telemetry_series_name(series));
+        if (ret != ESP_OK) {
+            cJSON_AddStringToObject(json, "message", esp_err_to_name(ret));
+        } else {
+            double bucket_sec = ((double)to - from + 1) / points;
+            cJSON_AddNumberToObject(json, "from", from);
+            cJSON_AddNumberToObject(json, "to", to);
+            cJSON_AddNumberToObject(json, "bucket_sec", bucket_sec);
+            cJSON_AddNumberToObject(json, "samples", stats.samples);
+            cJSON_AddNumberToObject(json, "blocks_read", stats.blocks_read);
+            cJSON_AddNumberToObject(json, "blocks_skipped", stats.blocks_skipped);
+            cJSON_AddNumberToObject(json, "sectors_skipped", stats.sectors_skipped);
+
+            cJSON *data = cJSON_AddArrayToObject(json, "points");
+            for (uint32_t i = 0; i < points; i++) {
+                if (buckets[i].count == 0) {
+                    continue;
+                }
+                cJSON *point = cJSON_CreateObject();
+                cJSON_AddNumberToObject(point, "t", from + (uint32_t)(i * bucket_sec));
+                cJSON_AddNumberToObject(point, "n", buckets[i].count);
+                cJSON_AddNumberToObject(point, "avg", (double)buckets[i].sum / buckets[i].count);
+                cJSON_AddNumberToObject(point, "min", buckets[i].min);
+                cJSON_AddNumberToObject(point, "max", buckets[i].max);
+                cJSON_AddItemToArray(data, point);
+            }
+        }
+        free(buckets);
+    }
+
+    char *json_string = cJSON_PrintUnformatted(json);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, json_string, strlen(json_string));
+
+    free(json_string);
+    cJSON_Delete(json);
+    return ESP_OK;
+}
+
+// Deferred hot path log: /binlog[?deferred=0|1][&dump=1]
+// deferred switches formatting between the drain task and the caller (for
+// A/B timing of a flash); dump takes pending entries off the ring raw as
+// [timestamp_ms, id, a0, a1, a2] - formats lists the strings to decode them
+static esp_err_t binlog_handler(httpd_req_t *req) {
+    char query[64] = {0};
+    char param[8] = {0};
+    bool dump = false;
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        if (httpd_query_key_value(query, "deferred", param, sizeof(param)) == ESP_OK) {
+            binlog_set_deferred(atoi(param) != 0);
+        }
+        if (httpd_query_key_value(query, "dump", param, sizeof(param)) == ESP_OK) {
+            dump = atoi(param) != 0;
+        }
+    }
+
+    binlog_stats_t stats;
+    binlog_get_stats(&stats);
+
+    cJSON *json = cJSON_CreateObject();
+    cJSON_AddBoolToObject(json, "deferred", stats.deferred);
+    cJSON_AddNumberToObject(json, "recorded", stats.recorded);
+    cJSON_AddNumberToObject(json, "dropped", stats.dropped);
+    cJSON_AddNumberToObject(json, "drained", stats.drained);
+    cJSON_AddNumberToObject(json, "pending", stats.pending);
+    cJSON_AddNumberToObject(json, "write_ms", stats.write_ns / 1e6);
+    cJSON_AddNumberToObject(json, "drain_ms", stats.drain_ns / 1e6);
+    cJSON_AddNumberToObject(json, "write_us_avg", stats.recorded ?
+                            stats.write_ns / 1e3 / stats.recorded : 0);
+
+    if (dump) {
+        cJSON *formats = cJSON_AddArrayToObject(json, "formats");
+        for (int id = 0; id < BINLOG_MSG_COUNT; id++) {
+            cJSON *format = cJSON_CreateObject();
+            cJSON_AddStringToObject(format, "tag", binlog_tag(id));
+            cJSON_AddNumberToObject(format, "level", binlog_level(id));
+            cJSON_AddStringToObject(format, "format", binlog_format(id));
+            cJSON_AddItemToArray(formats, format);
+        }
+
+        cJSON *entries = cJSON_AddArrayToObject(json, "entries");
+        binlog_entry_t batch[16];
+        int count;
+        while ((count = binlog_read(batch, 16)) > 0) {
+            for (int i = 0; i < count; i++) {
+                double values[5] = {
+                    batch[i].timestamp_ms, batch[i].id,
+                    batch[i].args[0], batch[i].args[1], batch[i].args[2]
+                };
+                cJSON_AddItemToArray(entries, cJSON_CreateDoubleArray(values, 5));
+            }
+        }
+    }
+
+    char *json_string = cJSON_PrintUnformatted(json);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, json_string, strlen(json_string));
+
+    free(json_string);
+    cJSON_Delete(json);
+    return ESP_OK;
+}
 
 esp_err_t register_power_handlers(httpd_handle_t server) {
     httpd_uri_t power_status_uri = {
@@ -353,7 +656,55 @@ esp_err_t register_power_handlers(httpd_handle_t server) {
         .user_ctx = NULL
     };
 
+    httpd_uri_t history_uri = {
+        .uri = "/history",
+        .method = HTTP_GET,
+        .handler = history_handler,
+        .user_ctx = NULL
+    };
+
+    httpd_uri_t energy_uri = {
+        .uri = "/energy",
+        .method = HTTP_GET,
+        .handler = energy_handler,
+        .user_ctx = NULL
+    };
+
+    httpd_uri_t schedule_uri = {
+        .uri = "/schedule",
+        .method = HTTP_GET,
+        .handler = schedule_handler,
+        .user_ctx = NULL
+    };
+
+    httpd_uri_t time_sync_uri = {
+        .uri = "/time_sync",
+        .method = HTTP_POST,
+        .handler = time_sync_handler,
+        .user_ctx = NULL
+    };
+
+    httpd_uri_t telemetry_uri = {
+        .uri = "/telemetry",
+        .method = HTTP_GET,
+        .handler = telemetry_handler,
+        .user_ctx = NULL
+    };
+
+    httpd_uri_t binlog_uri = {
+        .uri = "/binlog",
+        .method = HTTP_GET,
+        .handler = binlog_handler,
+        .user_ctx = NULL
+    };
+
     ESP_ERROR_CHECK(httpd_register_uri_handler(server, &battery_status_uri));
+    ESP_ERROR_CHECK(httpd_register_uri_handler(server, &history_uri));
+    ESP_ERROR_CHECK(httpd_register_uri_handler(server, &energy_uri));
+    ESP_ERROR_CHECK(httpd_register_uri_handler(server, &schedule_uri));
+    ESP_ERROR_CHECK(httpd_register_uri_handler(server, &time_sync_uri));
+    ESP_ERROR_CHECK(httpd_register_uri_handler(server, &telemetry_uri));
+    ESP_ERROR_CHECK(httpd_register_uri_handler(server, &binlog_uri));
     ESP_ERROR_CHECK(httpd_register_uri_handler(server, &wifi_status_uri));
 
     ESP_ERROR_CHECK(httpd_register_uri_handler(server, &power_status_uri));
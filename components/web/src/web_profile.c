@@ -0,0 +1,243 @@
+// web_profile.c - nRF52 instruction cache profiling, tracked per firmware build
+//
+// /cache_profile?window_ms=<ms> turns on the NVMC IHIT/IMISS counters, lets
+// the firmware run untouched for the window (SWD released meanwhile, core
+// never halted) and reads the counts back. Results accumulate per firmware
+// build in NVS so the effect of code placement shows up between builds.
+// The build id is a CRC32 of the last uploaded image, or build=<hex> for
+// firmware that arrived another way. Without window_ms only the history is
+// returned.
+#include "web_upload.h"
+#include "swd_core.h"
+#include "swd_flash.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include "cJSON.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+static const char *TAG = "WEB_PROFILE";
+
+#define PROFILE_NVS_NAMESPACE   "cache_prof"
+#define PROFILE_NVS_BUILDS      "builds_v2"     // v2: eviction by last_seq
+#define PROFILE_NVS_CURRENT     "build"
+#define PROFILE_MAX_BUILDS      8
+#define PROFILE_MIN_WINDOW_MS   100
+#define PROFILE_MAX_WINDOW_MS   30000   // 32-bit counters at 64 MHz fetch rate
+
+typedef struct {
+    uint32_t build;
+    uint32_t runs;
+    uint64_t hits;
+    uint64_t misses;
+    uint32_t last_hits;
+    uint32_t last_misses;
+    uint32_t last_window_ms;
+    uint32_t last_time;         // Wall clock, for display - may be unsynced
+    uint32_t last_seq;          // Recording order, for eviction
+    uint32_t reserved;
+} profile_build_t;
+
+static double hit_rate(uint64_t hits, uint64_t misses) {
+    return hits + misses > 0 ? (double)hits / (hits + misses) : 0.0;
+}
+
+static size_t profile_load(profile_build_t *builds) {
+    nvs_handle_t handle;
+    if (nvs_open(PROFILE_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return 0;
+    }
+    size_t len = PROFILE_MAX_BUILDS * sizeof(profile_build_t);
+    esp_err_t ret = nvs_get_blob(handle, PROFILE_NVS_BUILDS, builds, &len);
+    nvs_close(handle);
+    return ret == ESP_OK ? len / sizeof(profile_build_t) : 0;
+}
+
+static esp_err_t profile_save(const profile_build_t *builds, size_t count) {
+    nvs_handle_t handle;
+    esp_err_t ret = nvs_open(PROFILE_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = nvs_set_blob(handle, PROFILE_NVS_BUILDS, builds, count * sizeof(profile_build_t));
+    if (ret == ESP_OK) {
+        ret = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    return ret;
+}
+
+void cache_profile_set_build(uint32_t build) {
+    nvs_handle_t handle;
+    if (nvs_open(PROFILE_NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+        return;
+    }
+    if (nvs_set_u32(handle, PROFILE_NVS_CURRENT, build) == ESP_OK) {
+        nvs_commit(handle);
+    }
+    nvs_close(handle);
+}
+
+static uint32_t profile_current_build(void) {
+    uint32_t build = 0;
+    nvs_handle_t handle;
+    if (nvs_open(PROFILE_NVS_NAMESPACE, NVS_READONLY, &handle) == ESP_OK) {
+        nvs_get_u32(handle, PROFILE_NVS_CURRENT, &build);
+        nvs_close(handle);
+    }
+    return build;
+}
+
+// Fold one window into its build; a new build evicts the least recent one
+static void profile_record(uint32_t build, uint32_t hits, uint32_t misses, uint32_t window_ms) {
+    profile_build_t builds[PROFILE_MAX_BUILDS];
+    size_t count = profile_load(builds);
+
+    size_t slot = count;
+    uint32_t seq = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (builds[i].build == build) {
+            slot = i;
+        }
+        if (builds[i].last_seq > seq) {
+            seq = builds[i].last_seq;
+        }
+    }
+    if (slot == count) {
+        if (count < PROFILE_MAX_BUILDS) {
+            count++;
+        } else {
+            slot = 0;
+            for (size_t i = 1; i < count; i++) {
+                if (builds[i].last_seq < builds[slot].last_seq) {
+                    slot = i;
+                }
+            }
+        }
+        memset(&builds[slot], 0, sizeof(builds[slot]));
+        builds[slot].build = build;
+    }
+
+    profile_build_t *b = &builds[slot];
+    b->runs++;
+    b->hits += hits;
+    b->misses += misses;
+    b->last_hits = hits;
+    b->last_misses = misses;
+    b->last_window_ms = window_ms;
+    b->last_time = (uint32_t)time(NULL);
+    b->last_seq = seq + 1;
+
+    if (profile_save(builds, count) != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to save cache profile");
+    }
+}
+
+// One SWD burst; the caller holds swd_busy across the whole window
+static esp_err_t profile_swd(bool start, uint32_t *icachecnf, uint32_t *hits, uint32_t *misses) {
+    swd_busy_begin();
+    esp_err_t ret = ensure_swd_ready();
+    if (ret == ESP_OK) {
+        ret = start ? swd_flash_cache_profile_start(icachecnf)
+                    : swd_flash_cache_profile_stop(*icachecnf, hits, misses);
+    }
+    swd_shutdown();
+    swd_busy_end();
+    return ret;
+}
+
+static esp_err_t cache_profile_handler(httpd_req_t *req) {
+    char query[96] = {0};
+    char param[16] = {0};
+    uint32_t window_ms = 0;
+    uint32_t build = profile_current_build();
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        if (httpd_query_key_value(query, "window_ms", param, sizeof(param)) == ESP_OK) {
+            window_ms = strtoul(param, NULL, 10);
+        }
+        if (httpd_query_key_value(query, "build", param, sizeof(param)) == ESP_OK) {
+            build = strtoul(param, NULL, 16);
+        }
+    }
+
+    cJSON *json = cJSON_CreateObject();
+    char build_str[12];
+    esp_err_t ret = ESP_OK;
+
+    if (window_ms > 0) {
+        if (window_ms < PROFILE_MIN_WINDOW_MS) window_ms = PROFILE_MIN_WINDOW_MS;
+        if (window_ms > PROFILE_MAX_WINDOW_MS) window_ms = PROFILE_MAX_WINDOW_MS;
+
+        uint32_t icachecnf = 0;
+        uint32_t hits = 0;
+        uint32_t misses = 0;
+        // The counters run on the target for the whole window, so the
+        // failsafe, sleep and the target monitor must treat it as a job
+        swd_busy_begin();
+        ret = profile_swd(true, &icachecnf, NULL, NULL);
+        if (ret == ESP_OK) {
+            vTaskDelay(pdMS_TO_TICKS(window_ms));
+            ret = profile_swd(false, &icachecnf, &hits, &misses);
+        }
+        swd_busy_end();
+
+        cJSON_AddBoolToObject(json, "success", ret == ESP_OK);
+        if (ret == ESP_OK) {
+            profile_record(build, hits, misses, window_ms);
+            cJSON_AddBoolToObject(json, "cache_enabled", icachecnf & NVMC_ICACHECNF_CACHEEN);
+            cJSON_AddNumberToObject(json, "window_ms", window_ms);
+            cJSON_AddNumberToObject(json, "hits", hits);
+            cJSON_AddNumberToObject(json, "misses", misses);
+            cJSON_AddNumberToObject(json, "hit_rate", hit_rate(hits, misses));
+        } else {
+            cJSON_AddStringToObject(json, "message", esp_err_to_name(ret));
+        }
+    } else {
+        cJSON_AddBoolToObject(json, "success", true);
+    }
+
+    snprintf(build_str, sizeof(build_str), "%08" PRIx32, build);
+    cJSON_AddStringToObject(json, "build", build_str);
+
+    profile_build_t builds[PROFILE_MAX_BUILDS];
+    size_t count = profile_load(builds);
+    cJSON *list = cJSON_AddArrayToObject(json, "builds");
+    for (size_t i = 0; i < count; i++) {
+        cJSON *item = cJSON_CreateObject();
+        snprintf(build_str, sizeof(build_str), "%08" PRIx32, builds[i].build);
+        cJSON_AddStringToObject(item, "build", build_str);
+        cJSON_AddNumberToObject(item, "runs", builds[i].runs);
+        cJSON_AddNumberToObject(item, "hits", (double)builds[i].hits);
+        cJSON_AddNumberToObject(item, "misses", (double)builds[i].misses);
+        cJSON_AddNumberToObject(item, "hit_rate", hit_rate(builds[i].hits, builds[i].misses));
+        cJSON_AddNumberToObject(item, "last_hit_rate",
+                                hit_rate(builds[i].last_hits, builds[i].last_misses));
+        cJSON_AddNumberToObject(item, "last_window_ms", builds[i].last_window_ms);
+        cJSON_AddNumberToObject(item, "last_time", builds[i].last_time);
+        cJSON_AddItemToArray(list, item);
+    }
+
+    char *json_string = cJSON_PrintUnformatted(json);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, json_string, strlen(json_string));
+
+    free(json_string);
+    cJSON_Delete(json);
+    return ESP_OK;
+}
+
+esp_err_t register_profile_handlers(httpd_handle_t server) {
+    httpd_uri_t cache_profile_uri = {
+        .uri = "/cache_profile",
+        .method = HTTP_GET,
+        .handler = cache_profile_handler,
+        .user_ctx = NULL
+    };
+
+    ESP_ERROR_CHECK(httpd_register_uri_handler(server, &cache_profile_uri));
+    return ESP_OK;
+}
@@ -5,8 +5,18 @@
 #include "swd_flash.h"
 #include "swd_mem.h"
 #include "swd_core.h"
+#include "swd_boot.h"
+#include "swd_sim.h"
 #include "nrf52_hal.h"
 #include "power_mgmt.h"
+#include "power_energy.h"
+#include "telemetry.h"
+#include "golden.h"
+#include "binlog.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "sdkconfig.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include <string.h>
@@ -15,10 +25,29 @@
 #include <netinet/tcp.h>
 #include <sys/stat.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
 
 static const char *TAG = "WEB_UPLOAD";
 
 #define NRF52_PAGE_SIZE 4096
+#define BOOT_MEASURE_MAX_RUNS       20
+#define BOOT_MEASURE_TIMEOUT_MS     5000
+#define BOOT_MEASURE_MAX_TIMEOUT_MS 10000
+#define BOOT_MEASURE_MAX_TOTAL_MS   60000   // All runs - the failsafe waits while SWD is busy
+#define SINK_BUF_DEFAULT            1024    // Same as the upload recv buffer
+#define SINK_BUF_MIN                128
+#define SINK_BUF_MAX                16384
+#define RECV_STALL_BUCKETS          8
+
+#ifdef CONFIG_LWIP_TCP_WND_DEFAULT
+#define SINK_TCP_WND                CONFIG_LWIP_TCP_WND_DEFAULT
+#else
+#define SINK_TCP_WND                0
+#endif
+
+// Upper bounds (ms) of the recv histogram buckets; the last is open
+static const uint16_t recv_stall_ms[RECV_STALL_BUCKETS - 1] = {1, 2, 5, 10, 20, 50, 100};
 
 #ifndef MIN
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
@@ -27,8 +56,47 @@ static const char *TAG = "WEB_UPLOAD";
 // Flash status tracking - only g_mass_erased is actually used
 static bool g_mass_erased = false;
 
+// CRC32 over the addresses and data of the running upload - the build id
+static uint32_t g_upload_crc = 0;
+
+// Per-phase accounting of the running upload, returned with the response:
+// time on the C3, raw SWD transfers and, on the simulator, modelled target
+// time. Nested phases (the hex callback inside parse) are switched, not
+// stacked, so the phases add up to the whole job.
+typedef enum {
+    UPLOAD_RECEIVE = 0,     // httpd_req_recv
+    UPLOAD_PARSE,           // hex_stream_parse, callbacks excluded
+    UPLOAD_ASSEMBLE,        // Page buffer fill, sag throttling
+    UPLOAD_ERASE,
+    UPLOAD_PROGRAM,
+    UPLOAD_FINISH,          // Golden capture, reset and release
+    UPLOAD_PHASE_COUNT
+} upload_phase_t;
+
+static const char *upload_phase_names[UPLOAD_PHASE_COUNT] = {
+    "receive", "parse", "assemble", "erase", "program", "finish"
+};
+
+typedef struct {
+    int64_t us;
+    uint32_t bytes;
+    uint32_t transfers;
+    uint64_t model_us;
+} upload_phase_stats_t;
+
+static upload_phase_stats_t g_phases[UPLOAD_PHASE_COUNT];
+static int g_phase = -1;
+static int64_t g_phase_start_us = 0;
+static uint32_t g_phase_transfers = 0;
+static uint64_t g_phase_model_us = 0;
+
+// Hot path logging cost of the running upload: binlog_write() on the upload
+// path plus the drain task's formatting, so deferred and immediate mode are
+// charged the same work
+static uint64_t g_log_ns_start = 0;
+
 // Helper function to ensure SWD is ready
-static esp_err_t ensure_swd_ready(void) {
+esp_err_t ensure_swd_ready(void) {
     if (!swd_is_initialized()) {
         ESP_LOGI(TAG, "Reinitializing SWD for operation...");
 
@@ -36,7 +104,7 @@ static esp_err_t ensure_swd_ready(void) {
             .pin_swclk = 4,  // ESP32C3 GPIO4
             .pin_swdio = 3,  // ESP32C3 GPIO3
             .pin_reset = 5,  // ESP32C3 GPIO5
-            .delay_cycles = 0
+            .swclk_khz = 0   // SWD_TARGET_KHZ
         };
 
         esp_err_t ret = swd_init(&swd_cfg);
@@ -68,16 +136,207 @@ static esp_err_t ensure_swd_ready(void) {
 // Hex record callback for live streaming upload
 static void hex_flash_callback(hex_record_t *record, uint32_t abs_addr, void *ctx);
 
+// Refuse a job the battery is not predicted to finish. Sends the error
+// response itself; returns false if the job must not start.
+bool job_energy_ok(httpd_req_t *req, uint32_t payload_bytes) {
+    float predicted_mah = 0.0f;
+    float margin_mah = 0.0f;
+    if (power_energy_check_job(payload_bytes, &predicted_mah, &margin_mah) == ESP_OK) {
+        return true;
+    }
+
+    char msg[96];
+    snprintf(msg, sizeof(msg), "Battery too low: job needs ~%.1f mAh, %.1f mAh available",
+             predicted_mah, margin_mah);
+    httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, msg);
+    return false;
+}
+
+// Between pages: let the sag guard throttle or pause. A pause that times out
+// carries on throttled - stopping halfway would leave a broken image anyway.
+void page_sag_guard(void) {
+    if (power_sag_guard() == ESP_ERR_TIMEOUT) {
+        ESP_LOGW(TAG, "Battery still sagging - continuing throttled");
+    }
+}
+
+static uint64_t sim_model_us(void) {
+    swd_sim_stats_t sim;
+    return swd_sim_get_stats(&sim) ? sim.model_us : 0;
+}
+
+// Book everything since the last switch to the running phase and start
+// another (-1 = none); returns the phase that was running
+static int upload_phase_enter(int phase) {
+    int64_t now_us = esp_timer_get_time();
+    uint32_t transfers = swd_get_transfer_count();
+    uint64_t model_us = sim_model_us();
+
+    if (g_phase >= 0) {
+        g_phases[g_phase].us += now_us - g_phase_start_us;
+        g_phases[g_phase].transfers += transfers - g_phase_transfers;
+        g_phases[g_phase].model_us += model_us - g_phase_model_us;
+    }
+
+    int previous = g_phase;
+    g_phase = phase;
+    g_phase_start_us = now_us;
+    g_phase_transfers = transfers;
+    g_phase_model_us = model_us;
+    return previous;
+}
+
+static int upload_phase_json(char *buf, size_t size, int received) {
+    swd_sim_stats_t sim;
+    bool simulated = swd_sim_get_stats(&sim);
+    int64_t total_us = 0;
+    for (int i = 0; i < UPLOAD_PHASE_COUNT; i++) {
+        total_us += g_phases[i].us;
+    }
+
+    binlog_stats_t log;
+    binlog_get_stats(&log);
+    double log_ms = (log.write_ns + log.drain_ns - g_log_ns_start) / 1e6;
+
+    int len = snprintf(buf, size,
+        "{\"success\":true,\"message\":\"Upload complete\",\"bytes\":%d,"
+        "\"total_ms\":%.1f,\"simulated\":%s,\"log_ms\":%.2f,\"log_deferred\":%s,"
+        "\"log_pending\":%" PRIu32 ",\"phases\":{",
+        received, total_us / 1000.0, simulated ? "true" : "false",
+        log_ms, log.deferred ? "true" : "false", log.pending);
+
+    for (int i = 0; i < UPLOAD_PHASE_COUNT && len < (int)size; i++) {
+        const upload_phase_stats_t *p = &g_phases[i];
+        len += snprintf(buf + len, size - len,
+            "%s\"%s\":{\"ms\":%.1f,\"bytes\":%" PRIu32 ",\"kb_s\":%.1f,"
+            "\"transfers\":%" PRIu32 ",\"model_ms\":%.1f}",
+            i > 0 ? "," : "",
+            upload_phase_names[i],
+            p->us / 1000.0,
+            p->bytes,
+            p->us > 0 ? p->bytes * 1000000.0 / p->us / 1024.0 : 0.0,
+            p->transfers,
+            p->model_us / 1000.0);
+    }
+
+    if (len < (int)size) {
+        len += snprintf(buf + len, size - len, "}}");
+    }
+    return len;
+}
+
+// Called with each chunk of a request body as it arrives
+typedef esp_err_t (*body_chunk_fn)(const uint8_t *data, int len, void *ctx);
+
+typedef struct {
+    int received;
+    int last_recv;                  // httpd_req_recv() result that ended the loop
+    uint32_t calls;
+    int64_t recv_us;                // Time blocked in httpd_req_recv
+    int64_t max_recv_us;
+    int64_t yield_us;               // Time given away by the per-chunk yield
+    uint32_t stalls[RECV_STALL_BUCKETS];
+} body_recv_stats_t;
+
+// The recv loop of /upload and /sink: reads the whole body in chunks of at
+// most buf_size, hands each to chunk and yields a tick after it unless told
+// not to. Returns ESP_FAIL on a receive error (stats->last_recv <= 0), the
+// callback's error if it fails, else ESP_OK.
+static esp_err_t recv_body(httpd_req_t *req, uint8_t *buf, int buf_size, bool yield,
+                           body_chunk_fn chunk, void *ctx, body_recv_stats_t *stats) {
+    int remaining = req->content_len;
+
+    memset(stats, 0, sizeof(*stats));
+    while (remaining > 0) {
+        int64_t t0 = esp_timer_get_time();
+        int recv_len = httpd_req_recv(req, (char *)buf, MIN(remaining, buf_size));
+        int64_t blocked = esp_timer_get_time() - t0;
+
+        stats->last_recv = recv_len;
+        if (recv_len <= 0) {
+            return ESP_FAIL;
+        }
+
+        stats->calls++;
+        stats->recv_us += blocked;
+        if (blocked > stats->max_recv_us) {
+            stats->max_recv_us = blocked;
+        }
+        int bucket = 0;
+        while (bucket < RECV_STALL_BUCKETS - 1 && blocked >= recv_stall_ms[bucket] * 1000) {
+            bucket++;
+        }
+        stats->stalls[bucket]++;
+
+        esp_err_t ret = chunk(buf, recv_len, ctx);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+
+        stats->received += recv_len;
+        remaining -= recv_len;
+
+        // Yield to prevent watchdog. A whole tick per chunk: with 1 KB
+        // chunks this alone caps the loop near 100 KB/s
+        if (yield) {
+            int64_t y0 = esp_timer_get_time();
+            vTaskDelay(1);
+            stats->yield_us += esp_timer_get_time() - y0;
+        }
+    }
+    return ESP_OK;
+}
+
+typedef struct {
+    hex_stream_parser_t *parser;
+    int received;
+    int total;
+} upload_ctx_t;
+
+static esp_err_t upload_chunk(const uint8_t *data, int len, void *ctx) {
+    upload_ctx_t *upload = ctx;
+
+    g_phases[UPLOAD_RECEIVE].bytes += len;
+
+    // Parse this chunk
+    upload_phase_enter(UPLOAD_PARSE);
+    g_phases[UPLOAD_PARSE].bytes += len;
+    esp_err_t ret = hex_stream_parse(upload->parser, data, len);
+    upload_phase_enter(UPLOAD_RECEIVE);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    upload->received += len;
+
+    // Log progress every 50KB
+    if ((upload->received % 51200) == 0 || upload->received == upload->total) {
+        int percent = (upload->received * 100) / upload->total;
+        ESP_LOGI(TAG, "Upload progress: %d%% (%d/%d bytes)",
+                percent, upload->received, upload->total);
+    }
+    return ESP_OK;
+}
+
+// /sink keeps nothing of the body
+static esp_err_t discard_chunk(const uint8_t *data, int len, void *ctx) {
+    return ESP_OK;
+}
+
 // Live upload handler - streams hex file directly to flash
 static esp_err_t upload_handler(httpd_req_t *req) {
     ESP_LOGI(TAG, "=== Streaming Firmware Upload Started ===");
-    ESP_LOGI(TAG, "Content length: %d bytes", req->content_len);
+    ESP_LOGI(TAG, "Content length: %zu bytes", req->content_len);
 
     if (req->content_len == 0) {
         httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Empty file");
         return ESP_FAIL;
     }
 
+    if (!job_energy_ok(req, req->content_len)) {
+        return ESP_FAIL;
+    }
+
     // Initialize SWD
     esp_err_t ret = ensure_swd_ready();
     if (ret != ESP_OK) {
@@ -88,6 +347,15 @@ static esp_err_t upload_handler(httpd_req_t *req) {
         return ESP_FAIL;  // Won't reach here
     }
 
+    golden_capture_begin();
+    g_upload_crc = 0;
+    memset(g_phases, 0, sizeof(g_phases));
+    g_phase = -1;
+
+    binlog_stats_t log;
+    binlog_get_stats(&log);
+    g_log_ns_start = log.write_ns + log.drain_ns;
+
     // Create hex parser
     hex_stream_parser_t *parser = hex_stream_create(hex_flash_callback, NULL);
     if (!parser) {
@@ -101,79 +369,92 @@ static esp_err_t upload_handler(httpd_req_t *req) {
 
     // Receive and parse hex data in chunks
     uint8_t buf[1024];
-    int remaining = req->content_len;
-    int received = 0;
+    upload_ctx_t upload = { .parser = parser, .total = req->content_len };
+    body_recv_stats_t recv_stats;
 
     ESP_LOGI(TAG, "Streaming upload in progress...");
+    upload_phase_enter(UPLOAD_RECEIVE);
 
-    while (remaining > 0) {
-        int recv_len = httpd_req_recv(req, (char*)buf, MIN(remaining, sizeof(buf)));
-
-        // ANY receive error = immediate reboot (NO RETRIES, NO CONTINUE)
-        if (recv_len <= 0) {
-            ESP_LOGE(TAG, "❌ Upload failed: recv=%d - REBOOTING in 2 seconds", recv_len);
-            hex_stream_free(parser);
-            swd_shutdown();
-            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Upload failed");
-            vTaskDelay(pdMS_TO_TICKS(2000));
-            esp_restart();  // ← IMMEDIATE REBOOT
-            return ESP_FAIL;  // Won't reach here
-        }
-
-        // Parse this chunk
-        ret = hex_stream_parse(parser, buf, recv_len);
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "Parse error at byte %d - rebooting in 2 seconds", received);
-            hex_stream_free(parser);
-            swd_shutdown();
-            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Parse error");
-            vTaskDelay(pdMS_TO_TICKS(2000));
-            esp_restart();  // ← IMMEDIATE REBOOT
-            return ESP_FAIL;  // Won't reach here
-        }
-
-        received += recv_len;
-        remaining -= recv_len;
+    ret = recv_body(req, buf, sizeof(buf), true, upload_chunk, &upload, &recv_stats);
 
-        // Log progress every 50KB
-        if ((received % 51200) == 0 || remaining == 0) {
-            int percent = (received * 100) / req->content_len;
-            ESP_LOGI(TAG, "Upload progress: %d%% (%d/%d bytes)",
-                    percent, received, req->content_len);
+    // ANY receive or parse error = immediate reboot (NO RETRIES, NO CONTINUE)
+    if (ret != ESP_OK) {
+        if (recv_stats.last_recv <= 0) {
+            ESP_LOGE(TAG, "❌ Upload failed: recv=%d - REBOOTING in 2 seconds", recv_stats.last_recv);
+        } else {
+            ESP_LOGE(TAG, "Parse error at byte %d - rebooting in 2 seconds", recv_stats.received);
         }
-
-        // Yield to prevent watchdog
-        vTaskDelay(1);
+        hex_stream_free(parser);
+        swd_shutdown();
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR,
+                            recv_stats.last_recv <= 0 ? "Upload failed" : "Parse error");
+        vTaskDelay(pdMS_TO_TICKS(2000));
+        esp_restart();  // ← IMMEDIATE REBOOT
+        return ESP_FAIL;  // Won't reach here
     }
+    int received = recv_stats.received;
 
     // SUCCESS PATH
-    ESP_LOGI(TAG, "✓ Upload complete: %d bytes received", received);
+    ESP_LOGI(TAG, "✓ Upload complete: %d bytes received (%" PRId64 " ms in per-chunk yields)",
+             received, recv_stats.yield_us / 1000);
 
     // Cleanup
+    upload_phase_enter(UPLOAD_FINISH);
     hex_stream_free(parser);
 
+    // Keep what landed on the target as the reference for wake checks
+    golden_capture_commit();
+    cache_profile_set_build(g_upload_crc);
+
     // Reset and release target
     ESP_LOGI(TAG, "Resetting target...");
     swd_flash_reset_and_run();
     swd_shutdown();
+    power_sag_end();
+    upload_phase_enter(-1);
 
-    // Send success response
+    // Send success response with the phase breakdown
+    char resp[1024];
+    int resp_len = upload_phase_json(resp, sizeof(resp), received);
     httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, "{\"success\":true,\"message\":\"Upload complete\"}",
-                   HTTPD_RESP_USE_STRLEN);
+    httpd_resp_send(req, resp, MIN(resp_len, (int)sizeof(resp) - 1));
 
     ESP_LOGI(TAG, "=== Upload Successful ===");
     return ESP_OK;
 }
 
-// Callback for flashing hex records
-static void hex_flash_callback(hex_record_t *record, uint32_t abs_addr, void *ctx) {
+// Erase (unless mass erased) and program one assembled page buffer
+static void flush_page_buffer(uint32_t start_addr, const uint8_t *data, uint32_t len) {
+    page_sag_guard();
+
+    if (!g_mass_erased) {
+        uint32_t page_addr = start_addr & ~(NRF52_PAGE_SIZE - 1);
+        binlog_write(BINLOG_UPLOAD_ERASE, page_addr, 0, 0);
+        upload_phase_enter(UPLOAD_ERASE);
+        swd_flash_erase_page(page_addr);
+        g_phases[UPLOAD_ERASE].bytes += NRF52_PAGE_SIZE;
+    }
+
+    binlog_write(BINLOG_UPLOAD_WRITE, len, start_addr, 0);
+    upload_phase_enter(UPLOAD_PROGRAM);
+    swd_flash_write_buffer(start_addr, data, len);
+    g_phases[UPLOAD_PROGRAM].bytes += len;
+    upload_phase_enter(UPLOAD_ASSEMBLE);
+
+    golden_capture_note(start_addr, len);
+}
+
+// Page assembly for flashing hex records
+static void hex_flash_record(hex_record_t *record, uint32_t abs_addr) {
     static uint8_t page_buffer[4096];
     static uint32_t buffer_start_addr = 0xFFFFFFFF;
     static uint32_t buffer_data_len = 0;
 
     switch (record->type) {
         case HEX_TYPE_DATA: {
+            g_upload_crc = esp_rom_crc32_le(g_upload_crc, (const uint8_t *)&abs_addr, sizeof(abs_addr));
+            g_upload_crc = esp_rom_crc32_le(g_upload_crc, record->data, record->byte_count);
+
             // Check if this data fits in current buffer
             uint32_t offset_in_buffer = abs_addr - buffer_start_addr;
 
@@ -186,17 +467,7 @@ static void hex_flash_callback(hex_record_t *record, uint32_t abs_addr, void *ct
                       offset_in_buffer + record->byte_count > sizeof(page_buffer)) {
                 // Data doesn't fit - flush current buffer
                 if (buffer_data_len > 0) {
-                    // Erase page if not mass erased
-                    if (!g_mass_erased) {
-                        uint32_t page_addr = buffer_start_addr & ~(NRF52_PAGE_SIZE - 1);
-                        ESP_LOGI(TAG, "Erasing page 0x%08lX", page_addr);
-                        swd_flash_erase_page(page_addr);
-                    }
-
-                    // Write buffer
-                    ESP_LOGI(TAG, "Writing %lu bytes to 0x%08lX",
-                            buffer_data_len, buffer_start_addr);
-                    swd_flash_write_buffer(buffer_start_addr, page_buffer, buffer_data_len);
+                    flush_page_buffer(buffer_start_addr, page_buffer, buffer_data_len);
                 }
 
                 buffer_start_addr = abs_addr;
@@ -207,6 +478,7 @@ static void hex_flash_callback(hex_record_t *record, uint32_t abs_addr, void *ct
 
             // Copy data to buffer
             memcpy(page_buffer + offset_in_buffer, record->data, record->byte_count);
+            g_phases[UPLOAD_ASSEMBLE].bytes += record->byte_count;
 
             // Update buffer length
             uint32_t new_end = offset_in_buffer + record->byte_count;
@@ -219,15 +491,7 @@ static void hex_flash_callback(hex_record_t *record, uint32_t abs_addr, void *ct
         case HEX_TYPE_EOF:
             // Flush remaining data
             if (buffer_data_len > 0) {
-                if (!g_mass_erased) {
-                    uint32_t page_addr = buffer_start_addr & ~(NRF52_PAGE_SIZE - 1);
-                    ESP_LOGI(TAG, "Erasing page 0x%08lX", page_addr);
-                    swd_flash_erase_page(page_addr);
-                }
-
-                ESP_LOGI(TAG, "Writing final %lu bytes to 0x%08lX",
-                        buffer_data_len, buffer_start_addr);
-                swd_flash_write_buffer(buffer_start_addr, page_buffer, buffer_data_len);
+                flush_page_buffer(buffer_start_addr, page_buffer, buffer_data_len);
             }
 
             g_mass_erased = false;  // Clear flag
@@ -241,12 +505,7 @@ static void hex_flash_callback(hex_record_t *record, uint32_t abs_addr, void *ct
         case HEX_TYPE_EXT_LIN_ADDR:
             // Flush buffer before address change
             if (buffer_data_len > 0) {
-                if (!g_mass_erased) {
-                    uint32_t page_addr = buffer_start_addr & ~(NRF52_PAGE_SIZE - 1);
-                    swd_flash_erase_page(page_addr);
-                }
-
-                swd_flash_write_buffer(buffer_start_addr, page_buffer, buffer_data_len);
+                flush_page_buffer(buffer_start_addr, page_buffer, buffer_data_len);
                 buffer_data_len = 0;
                 buffer_start_addr = 0xFFFFFFFF;
             }
@@ -254,6 +513,13 @@ static void hex_flash_callback(hex_record_t *record, uint32_t abs_addr, void *ct
     }
 }
 
+// Callback for flashing hex records
+static void hex_flash_callback(hex_record_t *record, uint32_t abs_addr, void *ctx) {
+    int previous = upload_phase_enter(UPLOAD_ASSEMBLE);
+    hex_flash_record(record, abs_addr);
+    upload_phase_enter(previous);
+}
+
 // Check SWD connection handler
 esp_err_t check_swd_handler(httpd_req_t *req) {
     char resp[4096];
@@ -277,68 +543,68 @@ esp_err_t check_swd_handler(httpd_req_t *req) {
 
         // NVMC registers
         swd_mem_read32(NVMC_READY, &nvmc_ready);
-        ESP_LOGI(TAG, "NVMC_READY: 0x%08lX", nvmc_ready);
+        ESP_LOGI(TAG, "NVMC_READY: 0x%08" PRIX32, nvmc_ready);
 
         swd_mem_read32(NVMC_READYNEXT, &nvmc_readynext);
-        ESP_LOGI(TAG, "NVMC_READYNEXT: 0x%08lX", nvmc_readynext);
+        ESP_LOGI(TAG, "NVMC_READYNEXT: 0x%08" PRIX32, nvmc_readynext);
 
         swd_mem_read32(NVMC_CONFIG, &nvmc_config);
-        ESP_LOGI(TAG, "NVMC_CONFIG: 0x%08lX", nvmc_config);
+        ESP_LOGI(TAG, "NVMC_CONFIG: 0x%08" PRIX32, nvmc_config);
 
         // UICR registers
         swd_mem_read32(UICR_APPROTECT, &approtect);
-        ESP_LOGI(TAG, "UICR_APPROTECT: 0x%08lX", approtect);
+        ESP_LOGI(TAG, "UICR_APPROTECT: 0x%08" PRIX32, approtect);
 
         swd_mem_read32(UICR_BOOTLOADERADDR, &bootloader_addr);
-        ESP_LOGI(TAG, "UICR_BOOTLOADERADDR: 0x%08lX", bootloader_addr);
+        ESP_LOGI(TAG, "UICR_BOOTLOADERADDR: 0x%08" PRIX32, bootloader_addr);
 
         swd_mem_read32(UICR_NRFFW0, &nrffw0);
-        ESP_LOGI(TAG, "UICR_NRFFW0: 0x%08lX", nrffw0);
+        ESP_LOGI(TAG, "UICR_NRFFW0: 0x%08" PRIX32, nrffw0);
 
         swd_mem_read32(UICR_NRFFW1, &nrffw1);
-        ESP_LOGI(TAG, "UICR_NRFFW1: 0x%08lX", nrffw1);
+        ESP_LOGI(TAG, "UICR_NRFFW1: 0x%08" PRIX32, nrffw1);
 
         // FICR registers
         swd_mem_read32(FICR_CODEPAGESIZE, &codepagesize);
-        ESP_LOGI(TAG, "FICR_CODEPAGESIZE: 0x%08lX", codepagesize);
+        ESP_LOGI(TAG, "FICR_CODEPAGESIZE: 0x%08" PRIX32, codepagesize);
 
         swd_mem_read32(FICR_CODESIZE, &codesize);
-        ESP_LOGI(TAG, "FICR_CODESIZE: 0x%08lX", codesize);
+        ESP_LOGI(TAG, "FICR_CODESIZE: 0x%08" PRIX32, codesize);
 
         swd_mem_read32(FICR_DEVICEID0, &deviceid0);
-        ESP_LOGI(TAG, "FICR_DEVICEID0: 0x%08lX", deviceid0);
+        ESP_LOGI(TAG, "FICR_DEVICEID0: 0x%08" PRIX32, deviceid0);
 
         swd_mem_read32(FICR_DEVICEID1, &deviceid1);
-        ESP_LOGI(TAG, "FICR_DEVICEID1: 0x%08lX", deviceid1);
+        ESP_LOGI(TAG, "FICR_DEVICEID1: 0x%08" PRIX32, deviceid1);
 
         swd_mem_read32(FICR_INFO_PART, &info_part);
-        ESP_LOGI(TAG, "FICR_INFO_PART: 0x%08lX", info_part);
+        ESP_LOGI(TAG, "FICR_INFO_PART: 0x%08" PRIX32, info_part);
 
         swd_mem_read32(FICR_INFO_VARIANT, &info_variant);
-        ESP_LOGI(TAG, "FICR_INFO_VARIANT: 0x%08lX", info_variant);
+        ESP_LOGI(TAG, "FICR_INFO_VARIANT: 0x%08" PRIX32, info_variant);
 
         swd_mem_read32(FICR_INFO_RAM, &info_ram);
-        ESP_LOGI(TAG, "FICR_INFO_RAM: 0x%08lX", info_ram);
+        ESP_LOGI(TAG, "FICR_INFO_RAM: 0x%08" PRIX32, info_ram);
 
         swd_mem_read32(FICR_INFO_FLASH, &info_flash);
-        ESP_LOGI(TAG, "FICR_INFO_FLASH: 0x%08lX", info_flash);
+        ESP_LOGI(TAG, "FICR_INFO_FLASH: 0x%08" PRIX32, info_flash);
 
         // Debug registers
         swd_mem_read32(DHCSR_ADDR, &dhcsr);
-        ESP_LOGI(TAG, "DHCSR: 0x%08lX", dhcsr);
+        ESP_LOGI(TAG, "DHCSR: 0x%08" PRIX32, dhcsr);
 
         swd_mem_read32(DEMCR_ADDR, &demcr);
-        ESP_LOGI(TAG, "DEMCR: 0x%08lX", demcr);
+        ESP_LOGI(TAG, "DEMCR: 0x%08" PRIX32, demcr);
 
         // Flash content samples
         swd_mem_read32(0x00000000, &flash_0x0);
-        ESP_LOGI(TAG, "Flash[0x0000]: 0x%08lX", flash_0x0);
+        ESP_LOGI(TAG, "Flash[0x0000]: 0x%08" PRIX32, flash_0x0);
 
         swd_mem_read32(0x00001000, &flash_0x1000);
-        ESP_LOGI(TAG, "Flash[0x1000]: 0x%08lX", flash_0x1000);
+        ESP_LOGI(TAG, "Flash[0x1000]: 0x%08" PRIX32, flash_0x1000);
 
         swd_mem_read32(0x000F4000, &flash_0xF4000);
-        ESP_LOGI(TAG, "Flash[0xF4000]: 0x%08lX", flash_0xF4000);
+        ESP_LOGI(TAG, "Flash[0xF4000]: 0x%08" PRIX32, flash_0xF4000);
 
         ESP_LOGI(TAG, "=== Register Dump Complete ===");
 
@@ -374,36 +640,36 @@ esp_err_t check_swd_handler(httpd_req_t *req) {
             "{"
             "\"connected\":true,"
             "\"status\":\"Connected\","
-            "\"approtect\":\"0x%08lX\","
+            "\"approtect\":\"0x%08" PRIX32 "\","
             "\"approtect_status\":\"%s\","
             "\"nvmc_ready\":%s,"
             "\"nvmc_state\":\"%s\","
             "\"core_halted\":%s,"
-            "\"bootloader_addr\":\"0x%08lX\","
-            "\"device_id\":\"0x%08lX%08lX\","
+            "\"bootloader_addr\":\"0x%08" PRIX32 "\","
+            "\"device_id\":\"0x%08" PRIX32 "%08" PRIX32 "\","
             "\"flash_size\":%lu,"
             "\"ram_size\":%lu,"
             "\"registers\":{"
-                "\"nvmc_ready\":\"0x%08lX\","
-                "\"nvmc_readynext\":\"0x%08lX\","
-                "\"nvmc_config\":\"0x%08lX\","
-                "\"approtect\":\"0x%08lX\","
-                "\"bootloader_addr\":\"0x%08lX\","
-                "\"nrffw0\":\"0x%08lX\","
-                "\"nrffw1\":\"0x%08lX\","
-                "\"codepagesize\":\"0x%08lX\","
-                "\"codesize\":\"0x%08lX\","
-                "\"deviceid0\":\"0x%08lX\","
-                "\"deviceid1\":\"0x%08lX\","
-                "\"info_part\":\"0x%08lX\","
-                "\"info_variant\":\"0x%08lX\","
-                "\"info_ram\":\"0x%08lX\","
-                "\"info_flash\":\"0x%08lX\","
-                "\"dhcsr\":\"0x%08lX\","
-                "\"demcr\":\"0x%08lX\","
-                "\"flash_0x0\":\"0x%08lX\","
-                "\"flash_0x1000\":\"0x%08lX\","
-                "\"flash_0xF4000\":\"0x%08lX\""
+                "\"nvmc_ready\":\"0x%08" PRIX32 "\","
+                "\"nvmc_readynext\":\"0x%08" PRIX32 "\","
+                "\"nvmc_config\":\"0x%08" PRIX32 "\","
+                "\"approtect\":\"0x%08" PRIX32 "\","
+                "\"bootloader_addr\":\"0x%08" PRIX32 "\","
+                "\"nrffw0\":\"0x%08" PRIX32 "\","
+                "\"nrffw1\":\"0x%08" PRIX32 "\","
+                "\"codepagesize\":\"0x%08" PRIX32 "\","
+                "\"codesize\":\"0x%08" PRIX32 "\","
+                "\"deviceid0\":\"0x%08" PRIX32 "\","
+                "\"deviceid1\":\"0x%08" PRIX32 "\","
+                "\"info_part\":\"0x%08" PRIX32 "\","
+                "\"info_variant\":\"0x%08" PRIX32 "\","
+                "\"info_ram\":\"0x%08" PRIX32 "\","
+                "\"info_flash\":\"0x%08" PRIX32 "\","
+                "\"dhcsr\":\"0x%08" PRIX32 "\","
+                "\"demcr\":\"0x%08" PRIX32 "\","
+                "\"flash_0x0\":\"0x%08" PRIX32 "\","
+                "\"flash_0x1000\":\"0x%08" PRIX32 "\","
+                "\"flash_0xF4000\":\"0x%08" PRIX32 "\""
             "}"
             "}",
             approtect,
@@ -462,9 +728,16 @@ esp_err_t mass_erase_handler(httpd_req_t *req) {
 
     char resp[256];
 
+    if (!job_energy_ok(req, 0)) {
+        return ESP_FAIL;
+    }
+
     // First check SWD connection
     esp_err_t ret = ensure_swd_ready();
 
+    // Mass erase is the heaviest single load - start it on a recovered cell
+    page_sag_guard();
+
     // Perform mass erase (which also handles APPROTECT)
     ret = swd_flash_disable_approtect();
 
@@ -482,6 +755,7 @@ esp_err_t mass_erase_handler(httpd_req_t *req) {
     ESP_LOGI(TAG, "Mass erase complete, releasing target...");
     swd_release_target();
     swd_shutdown();
+    power_sag_end();
 
     httpd_resp_set_type(req, "application/json");
     httpd_resp_send(req, resp, strlen(resp));
@@ -510,33 +784,311 @@ static esp_err_t reset_target_handler(httpd_req_t *req) {
     return ESP_OK;
 }
 
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Reset-to-breakpoint timing: /measure_boot?addr=<hex>&runs=<n>[&timeout_ms=<ms>]
+// addr is a code address (FPB breakpoint, e.g. main) or a RAM address
+// (DWT write watchpoint, e.g. a ready flag)
+static esp_err_t measure_boot_handler(httpd_req_t *req) {
+    char query[96] = {0};
+    char param[16] = {0};
+    uint32_t addr = 0;
+    uint32_t runs = 5;
+    uint32_t timeout_ms = BOOT_MEASURE_TIMEOUT_MS;
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK ||
+        httpd_query_key_value(query, "addr", param, sizeof(param)) != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "addr required");
+        return ESP_FAIL;
+    }
+    addr = strtoul(param, NULL, 16);
+    if (httpd_query_key_value(query, "runs", param, sizeof(param)) == ESP_OK) {
+        runs = strtoul(param, NULL, 10);
+    }
+    if (httpd_query_key_value(query, "timeout_ms", param, sizeof(param)) == ESP_OK) {
+        timeout_ms = strtoul(param, NULL, 10);
+    }
+    if (timeout_ms < 1) timeout_ms = 1;
+    if (timeout_ms > BOOT_MEASURE_MAX_TIMEOUT_MS) timeout_ms = BOOT_MEASURE_MAX_TIMEOUT_MS;
+    if (runs < 1) runs = 1;
+    if (runs > BOOT_MEASURE_MAX_RUNS) runs = BOOT_MEASURE_MAX_RUNS;
+    if (runs > BOOT_MEASURE_MAX_TOTAL_MS / timeout_ms) runs = BOOT_MEASURE_MAX_TOTAL_MS / timeout_ms;
+
+    esp_err_t ret = ensure_swd_ready();
+    if (ret != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "SWD connect failed");
+        return ESP_FAIL;
+    }
+
+    uint32_t cycles[BOOT_MEASURE_MAX_RUNS];
+    swd_boot_run_t run = {0};
+    uint32_t done = 0;
+    for (uint32_t i = 0; i < runs; i++) {
+        ret = swd_boot_measure(addr, timeout_ms, &run);
+        if (ret != ESP_OK) {
+            break;
+        }
+        cycles[done++] = run.cycles;
+    }
+
+    // Let the firmware boot normally again
+    swd_release_target();
+    swd_shutdown();
+
+    char resp[1024];
+    int len = snprintf(resp, sizeof(resp),
+        "{\"success\":%s,\"addr\":\"0x%08" PRIX32 "\",\"stop\":\"%s\",\"cpu_mhz\":%d,"
+        "\"runs\":%" PRIu32,
+        done > 0 ? "true" : "false", addr, run.watchpoint ? "watchpoint" : "breakpoint",
+        NRF52_CPU_FREQ_MHZ, done);
+    if (ret != ESP_OK) {
+        len += snprintf(resp + len, sizeof(resp) - len, ",\"error\":\"%s\"",
+                        esp_err_to_name(ret));
+    }
+
+    if (done > 0) {
+        double sum = 0.0;
+        len += snprintf(resp + len, sizeof(resp) - len, ",\"cycles\":[");
+        for (uint32_t i = 0; i < done; i++) {
+            sum += cycles[i];
+            len += snprintf(resp + len, sizeof(resp) - len, "%s%" PRIu32, i ? "," : "", cycles[i]);
+        }
+        double mean = sum / done;
+        double var = 0.0;
+        for (uint32_t i = 0; i < done; i++) {
+            var += (cycles[i] - mean) * (cycles[i] - mean);
+        }
+        qsort(cycles, done, sizeof(cycles[0]), compare_u32);
+
+        len += snprintf(resp + len, sizeof(resp) - len,
+            "],\"min_us\":%.2f,\"median_us\":%.2f,\"mean_us\":%.2f,"
+            "\"max_us\":%.2f,\"stddev_us\":%.2f,\"last_pc\":\"0x%08" PRIX32 "\"",
+            (double)cycles[0] / NRF52_CPU_FREQ_MHZ,
+            (double)cycles[done / 2] / NRF52_CPU_FREQ_MHZ,
+            mean / NRF52_CPU_FREQ_MHZ,
+            (double)cycles[done - 1] / NRF52_CPU_FREQ_MHZ,
+            sqrt(var / done) / NRF52_CPU_FREQ_MHZ,
+            run.pc);
+    }
+    snprintf(resp + len, sizeof(resp) - len, "}");
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, resp, strlen(resp));
+    return done > 0 ? ESP_OK : ret;
+}
+
+// Golden image and wake-check counters
+static esp_err_t golden_status_handler(httpd_req_t *req) {
+    char resp[320];
+    golden_info_t info;
+    golden_get_info(&info);
+
+    snprintf(resp, sizeof(resp),
+        "{\"enabled\":%s,\"pages\":%" PRIu32 ",\"cursor\":%" PRIu32 ",\"checks\":%" PRIu32 ","
+        "\"pages_checked\":%" PRIu32 ",\"mismatches\":%" PRIu32 ",\"repaired\":%" PRIu32 ","
+        "\"repair_failures\":%" PRIu32 ",\"last_check_ms\":%" PRIu32 "}",
+        info.enabled ? "true" : "false",
+        info.pages, info.cursor, info.checks,
+        info.pages_checked, info.mismatches, info.repaired,
+        info.repair_failures, info.last_check_us / 1000);
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, resp, strlen(resp));
+    return ESP_OK;
+}
+
+// Network ingest benchmark: /sink[?buf=<bytes>][&yield=1][&sockbuf=<bytes>]
+// Runs /upload's recv loop (performance lock, recv_body()) and discards the
+// body, so its MB/s is the ceiling the link and lwIP leave for flashing.
+// The per-chunk tick yield /upload does is off unless yield=1, and its
+// time is reported apart as yield_ms. buf is the recv buffer
+// (upload uses 1024), sockbuf sets SO_RCVBUF where lwIP has it built in.
+// Every recv call lands in a histogram by how long it blocked.
+static esp_err_t sink_handler(httpd_req_t *req) {
+    char query[96] = {0};
+    char param[16] = {0};
+    int buf_size = SINK_BUF_DEFAULT;
+    bool yield = false;
+    int sockbuf = 0;
+    bool sockbuf_applied = false;
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        if (httpd_query_key_value(query, "buf", param, sizeof(param)) == ESP_OK) {
+            buf_size = strtol(param, NULL, 10);
+        }
+        if (httpd_query_key_value(query, "yield", param, sizeof(param)) == ESP_OK) {
+            yield = strtol(param, NULL, 10) != 0;
+        }
+        if (httpd_query_key_value(query, "sockbuf", param, sizeof(param)) == ESP_OK) {
+            sockbuf = strtol(param, NULL, 10);
+        }
+    }
+    if (buf_size < SINK_BUF_MIN) buf_size = SINK_BUF_MIN;
+    if (buf_size > SINK_BUF_MAX) buf_size = SINK_BUF_MAX;
+
+    if (req->content_len == 0) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Empty body");
+        return ESP_FAIL;
+    }
+
+    uint8_t *buf = malloc(buf_size);
+    if (!buf) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+        return ESP_FAIL;
+    }
+
+#if CONFIG_LWIP_SO_RCVBUF
+    if (sockbuf > 0) {
+        sockbuf_applied = setsockopt(httpd_req_to_sockfd(req), SOL_SOCKET, SO_RCVBUF,
+                                     &sockbuf, sizeof(sockbuf)) == 0;
+    }
+#endif
+
+    body_recv_stats_t st;
+    int64_t start = esp_timer_get_time();
+    esp_err_t ret = recv_body(req, buf, buf_size, yield, discard_chunk, NULL, &st);
+    int64_t total_us = esp_timer_get_time() - start;
+    free(buf);
+
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Sink: recv=%d after %d of %zu bytes", st.last_recv, st.received, req->content_len);
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Receive failed");
+        return ESP_FAIL;
+    }
+
+    wifi_ap_record_t ap = {0};
+    bool linked = esp_wifi_sta_get_ap_info(&ap) == ESP_OK;
+
+    char resp[640];
+    int len = snprintf(resp, sizeof(resp),
+        "{\"success\":true,\"bytes\":%d,\"total_ms\":%.1f,\"mb_s\":%.3f,"
+        "\"recv_ms\":%.1f,\"yield_ms\":%.1f,\"recv_calls\":%" PRIu32 ",\"avg_recv_bytes\":%" PRIu32 ",\"max_recv_ms\":%.1f,"
+        "\"buf\":%d,\"yield\":%s,\"sockbuf\":%d,\"sockbuf_applied\":%s,\"tcp_wnd\":%d,"
+        "\"link\":{\"connected\":%s,\"lr\":%s,\"rssi\":%d,\"channel\":%d},\"stall_ms\":[",
+        st.received, total_us / 1000.0,
+        total_us > 0 ? st.received / (double)total_us : 0.0,
+        st.recv_us / 1000.0, st.yield_us / 1000.0, st.calls, st.calls ? st.received / st.calls : 0,
+        st.max_recv_us / 1000.0,
+        buf_size, yield ? "true" : "false", sockbuf, sockbuf_applied ? "true" : "false",
+        SINK_TCP_WND,
+        linked ? "true" : "false", linked && ap.phy_lr ? "true" : "false",
+        linked ? ap.rssi : 0, linked ? ap.primary : 0);
+    for (int i = 0; i < RECV_STALL_BUCKETS - 1 && len < (int)sizeof(resp); i++) {
+        len += snprintf(resp + len, sizeof(resp) - len, "%s%u", i ? "," : "", recv_stall_ms[i]);
+    }
+    for (int i = 0; i < RECV_STALL_BUCKETS && len < (int)sizeof(resp); i++) {
+        len += snprintf(resp + len, sizeof(resp) - len, "%s%" PRIu32,
+                        i ? "," : "],\"stalls\":[", st.stalls[i]);
+    }
+    if (len < (int)sizeof(resp)) {
+        snprintf(resp + len, sizeof(resp) - len, "]}");
+    }
+
+    ESP_LOGI(TAG, "Sink: %d bytes in %" PRId64 " ms (%.3f MB/s), %" PRIu32 " recv calls",
+             st.received, total_us / 1000, total_us > 0 ? st.received / (double)total_us : 0.0,
+             st.calls);
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, resp, strlen(resp));
+    return ESP_OK;
+}
+
+// Runs the upload pipeline (passed in user_ctx) with the performance lock
+// held: full CPU clock, no light sleep and no WiFi modem sleep throughout
+static esp_err_t perf_job_handler(httpd_req_t *req) {
+    esp_err_t (*job)(httpd_req_t *req) = req->user_ctx;
+
+    power_perf_acquire();
+    energy_category_t previous = power_energy_enter(ENERGY_SWD_JOB);
+    esp_err_t ret = job(req);
+    power_energy_enter(previous);
+    power_perf_release();
+
+    telemetry_record(TELEM_JOB_RESULT, ret);
+
+    return ret;
+}
+
+// The performance lock alone, for /sink: it measures the link, so it is
+// neither booked as SWD job energy nor recorded as a job result
+static esp_err_t perf_handler(httpd_req_t *req) {
+    esp_err_t (*handler)(httpd_req_t *req) = req->user_ctx;
+
+    power_perf_acquire();
+    esp_err_t ret = handler(req);
+    power_perf_release();
+
+    return ret;
+}
+
+// Runs an SWD-only job with the SWD engine's own lock: full CPU clock for
+// the bit-banging, WiFi left in modem sleep (the response is tiny)
+static esp_err_t swd_job_handler(httpd_req_t *req) {
+    esp_err_t (*job)(httpd_req_t *req) = req->user_ctx;
+
+    swd_busy_begin();
+    energy_category_t previous = power_energy_enter(ENERGY_SWD_JOB);
+    esp_err_t ret = job(req);
+    power_energy_enter(previous);
+    swd_busy_end();
+
+    telemetry_record(TELEM_JOB_RESULT, ret);
+
+    return ret;
+}
+
 // Register all handlers
 esp_err_t register_upload_handlers(httpd_handle_t server) {
     httpd_uri_t upload_uri = {
         .uri = "/upload",
         .method = HTTP_POST,
-        .handler = upload_handler,
-        .user_ctx = NULL
+        .handler = perf_job_handler,
+        .user_ctx = upload_handler
     };
 
     httpd_uri_t check_swd_uri = {
         .uri = "/check_swd",
         .method = HTTP_GET,
-        .handler = check_swd_handler,
-        .user_ctx = NULL
+        .handler = swd_job_handler,
+        .user_ctx = check_swd_handler
     };
 
     httpd_uri_t mass_erase_uri = {
         .uri = "/mass_erase",
         .method = HTTP_GET,
-        .handler = mass_erase_handler,
-        .user_ctx = NULL
+        .handler = swd_job_handler,
+        .user_ctx = mass_erase_handler
     };
 
     httpd_uri_t reset_uri = {
         .uri = "/reset_target",
         .method = HTTP_POST,
-        .handler = reset_target_handler,
+        .handler = swd_job_handler,
+        .user_ctx = reset_target_handler
+    };
+
+    httpd_uri_t measure_boot_uri = {
+        .uri = "/measure_boot",
+        .method = HTTP_GET,
+        .handler = swd_job_handler,
+        .user_ctx = measure_boot_handler
+    };
+
+    httpd_uri_t sink_uri = {
+        .uri = "/sink",
+        .method = HTTP_POST,
+        .handler = perf_handler,
+        .user_ctx = sink_handler
+    };
+
+    httpd_uri_t golden_uri = {
+        .uri = "/golden",
+        .method = HTTP_GET,
+        .handler = golden_status_handler,
         .user_ctx = NULL
     };
 
@@ -544,6 +1096,9 @@ esp_err_t register_upload_handlers(httpd_handle_t server) {
     ESP_ERROR_CHECK(httpd_register_uri_handler(server, &check_swd_uri));
     ESP_ERROR_CHECK(httpd_register_uri_handler(server, &mass_erase_uri));
     ESP_ERROR_CHECK(httpd_register_uri_handler(server, &reset_uri));
+    ESP_ERROR_CHECK(httpd_register_uri_handler(server, &golden_uri));
+    ESP_ERROR_CHECK(httpd_register_uri_handler(server, &measure_boot_uri));
+    ESP_ERROR_CHECK(httpd_register_uri_handler(server, &sink_uri));
 
     ESP_LOGI(TAG, "Upload handlers registered");
     return ESP_OK;
@@ -0,0 +1,173 @@
+// energy_sim.c - Compares deep sleep schedules with the device's energy model
+//
+// Feeds simulated wake/sleep cycles through components/power/src/energy_model.c
+// with the coefficients from config.h, and prints mAh/day per category for
+// each candidate sleep period. A cycle is one unattended wake: boot, WiFi
+// connect, the failsafe idle window (no client shows up), then deep sleep,
+// which the wake stub splits into WAKE_STUB_SLOT_SEC slots with a short
+// stub wake between them.
+#include "energy_model.h"
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MAX_CANDIDATES  16
+#define SIM_DAYS        7
+
+typedef struct {
+    uint32_t boot_ms;
+    uint32_t connect_ms;
+    uint32_t idle_ms;
+    uint32_t stub_ms;           // Stub wake between slots, booked as boot
+    uint32_t slot_sec;          // 0 = one timer for the whole sleep
+    bool nrf52_on;
+    uint32_t days;
+} sim_params_t;
+
+static const energy_coeffs_t coeffs = {
+    .current_ua = {
+        [ENERGY_DEEP_SLEEP]     = ENERGY_DEEP_SLEEP_UA,
+        [ENERGY_BOOT]           = ENERGY_BOOT_UA,
+        [ENERGY_WIFI_CONNECT]   = ENERGY_WIFI_CONNECT_UA,
+        [ENERGY_ACTIVE_IDLE]    = ENERGY_ACTIVE_IDLE_UA,
+        [ENERGY_SWD_JOB]        = ENERGY_SWD_JOB_UA,
+        [ENERGY_NRF52_ON]       = ENERGY_NRF52_ON_UA,
+        [ENERGY_NRF52_OFF]      = ENERGY_NRF52_OFF_UA,
+    }
+};
+
+// Run whole cycles for params->days of simulated time and report
+static uint32_t simulate(const sim_params_t *params, uint32_t sleep_sec,
+                         energy_report_t *report) {
+    energy_account_t acc;
+    uint64_t now_ms = 0;
+    uint64_t end_ms = (uint64_t)params->days * 86400000ULL;
+    uint64_t sleep_ms = (uint64_t)sleep_sec * 1000ULL;
+    uint64_t slot_ms = (uint64_t)params->slot_sec * 1000ULL;
+    uint32_t wakes = 0;
+
+    energy_account_reset(&acc, ENERGY_BOOT, params->nrf52_on, 0);
+    while (now_ms < end_ms) {
+        energy_account_set_state(&acc, ENERGY_BOOT, now_ms);
+        now_ms += params->boot_ms;
+        energy_account_set_state(&acc, ENERGY_WIFI_CONNECT, now_ms);
+        now_ms += params->connect_ms;
+        energy_account_set_state(&acc, ENERGY_ACTIVE_IDLE, now_ms);
+        now_ms += params->idle_ms;
+        wakes++;
+
+        // The stub wakes at the end of every slot but the last; those wakes
+        // come out of the sleep and are booked with the next boot
+        uint64_t stub_ms = 0;
+        if (slot_ms > 0 && sleep_ms > slot_ms) {
+            stub_ms = (sleep_ms / slot_ms - 1) * params->stub_ms;
+        }
+        energy_account_set_state(&acc, ENERGY_DEEP_SLEEP, now_ms);
+        now_ms += sleep_ms - stub_ms;
+        energy_account_set_state(&acc, ENERGY_BOOT, now_ms);
+        now_ms += stub_ms;
+    }
+    energy_account_sync(&acc, now_ms);
+
+    energy_model_report(&acc, &coeffs, report);
+    return wakes;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [options] [sleep_sec ...]\n"
+            "  --boot-ms N     Reset to WiFi start (default 1500)\n"
+            "  --connect-ms N  Scan, associate, DHCP (default 3000)\n"
+            "  --idle-s N      Awake with no client (default FAILSAFE_IDLE_SEC, %d)\n"
+            "  --slot-s N      Wake stub slot, 0 = none (default WAKE_STUB_SLOT_SEC, %d)\n"
+            "  --stub-ms N     Length of one stub wake (default 2)\n"
+            "  --nrf52-off     nRF52 powered off during the whole cycle\n"
+            "  --days N        Simulated time per candidate (default %d)\n"
+            "Without sleep_sec, compares the DEEP_SLEEP_*_SEC values from config.h.\n",
+            prog, FAILSAFE_IDLE_SEC, WAKE_STUB_SLOT_SEC, SIM_DAYS);
+}
+
+int main(int argc, char **argv) {
+    static const struct option options[] = {
+        { "boot-ms", required_argument, NULL, 'b' },
+        { "connect-ms", required_argument, NULL, 'c' },
+        { "idle-s", required_argument, NULL, 'i' },
+        { "slot-s", required_argument, NULL, 's' },
+        { "stub-ms", required_argument, NULL, 'w' },
+        { "nrf52-off", no_argument, NULL, 'n' },
+        { "days", required_argument, NULL, 'd' },
+        { "help", no_argument, NULL, 'H' },
+        { NULL, 0, NULL, 0 }
+    };
+    sim_params_t params = {
+        .boot_ms = 1500,
+        .connect_ms = 3000,
+        .idle_ms = FAILSAFE_IDLE_SEC * 1000,
+        .stub_ms = 2,
+        .slot_sec = WAKE_STUB_SLOT_SEC,
+        .nrf52_on = true,
+        .days = SIM_DAYS,
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", options, NULL)) != -1) {
+        switch (opt) {
+        case 'b': params.boot_ms = strtoul(optarg, NULL, 10); break;
+        case 'c': params.connect_ms = strtoul(optarg, NULL, 10); break;
+        case 'i': params.idle_ms = strtoul(optarg, NULL, 10) * 1000; break;
+        case 's': params.slot_sec = strtoul(optarg, NULL, 10); break;
+        case 'w': params.stub_ms = strtoul(optarg, NULL, 10); break;
+        case 'n': params.nrf52_on = false; break;
+        case 'd': params.days = strtoul(optarg, NULL, 10); break;
+        default:
+            usage(argv[0]);
+            return opt == 'H' ? 0 : 1;
+        }
+    }
+    if (params.days == 0) {
+        params.days = 1;
+    }
+
+    uint32_t candidates[MAX_CANDIDATES];
+    int count = 0;
+    for (int i = optind; i < argc && count < MAX_CANDIDATES; i++) {
+        uint32_t sec = strtoul(argv[i], NULL, 10);
+        if (sec > 0) {
+            candidates[count++] = sec;
+        }
+    }
+    if (count == 0) {
+        candidates[count++] = DEEP_SLEEP_HIGH_BATTERY_SEC;
+        candidates[count++] = DEEP_SLEEP_MEDIUM_BATTERY_SEC;
+        candidates[count++] = DEEP_SLEEP_LOW_BATTERY_SEC;
+        candidates[count++] = DEEP_SLEEP_CRITICAL_SEC;
+    }
+
+    printf("Cycle: boot %lu ms, connect %lu ms, idle %lu s, stub slot %lu s (%lu ms), "
+           "nRF52 %s, %lu day(s)\n\n",
+           (unsigned long)params.boot_ms, (unsigned long)params.connect_ms,
+           (unsigned long)params.idle_ms / 1000, (unsigned long)params.slot_sec,
+           (unsigned long)params.stub_ms, params.nrf52_on ? "on" : "off",
+           (unsigned long)params.days);
+
+    printf("%9s %9s", "sleep_s", "wakes/d");
+    for (int cat = 0; cat < ENERGY_CAT_COUNT; cat++) {
+        printf(" %12s", energy_category_name((energy_category_t)cat));
+    }
+    printf(" %10s %8s %8s\n", "mAh/day", "avg_mA", "days");
+
+    for (int i = 0; i < count; i++) {
+        energy_report_t report;
+        uint32_t wakes = simulate(&params, candidates[i], &report);
+        double days = report.observed_ms / 86400000.0;
+
+        printf("%9lu %9.1f", (unsigned long)candidates[i], wakes / days);
+        for (int cat = 0; cat < ENERGY_CAT_COUNT; cat++) {
+            printf(" %12.2f", report.mah_per_day[cat]);
+        }
+        printf(" %10.2f %8.3f %8.1f\n", report.total_mah_per_day, report.avg_current_ma,
+               report.total_mah_per_day > 0 ?
+                   ENERGY_BATTERY_CAPACITY_MAH / report.total_mah_per_day : 0.0);
+    }
+    return 0;
+}
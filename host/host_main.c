@@ -0,0 +1,72 @@
+// host_main.c - Runs the flasher firmware as a Linux process
+//
+// The firmware sources build unmodified against the shims in shim/: the
+// web server listens on a host port, storage lives in a data directory and
+// the SWD simulator stands in for the radio. See README.md, "Host build".
+#include "shim_internal.h"
+#include "esp_log.h"
+#include <getopt.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+void app_main(void);
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --port N        HTTP port (default %u; the device uses 80)\n"
+            "  --data DIR      NVS, partition and SPIFFS files (default %s)\n"
+            "  --battery-mv N  Battery voltage the ADC reads (default %lu)\n"
+            "  --heap-kb N     Free heap at boot to report (default %lu)\n",
+            prog, shim_options.http_port, shim_options.data_dir,
+            (unsigned long)shim_options.battery_mv, (unsigned long)shim_options.heap_kb);
+}
+
+int main(int argc, char **argv) {
+    static const struct option options[] = {
+        { "port", required_argument, NULL, 'p' },
+        { "data", required_argument, NULL, 'd' },
+        { "battery-mv", required_argument, NULL, 'b' },
+        { "heap-kb", required_argument, NULL, 'h' },
+        { "help", no_argument, NULL, 'H' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", options, NULL)) != -1) {
+        switch (opt) {
+            case 'p': shim_options.http_port = (uint16_t)strtoul(optarg, NULL, 10); break;
+            case 'd': shim_options.data_dir = optarg; break;
+            case 'b': shim_options.battery_mv = strtoul(optarg, NULL, 10); break;
+            case 'h': shim_options.heap_kb = strtoul(optarg, NULL, 10); break;
+            case 'H':
+                usage(argv[0]);
+                return 0;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    shim_options.argv = argv;
+
+    // Absolute, so a restart's re-exec finds the same files
+    static char data_dir[PATH_MAX];
+    if (shim_mkdirs(shim_options.data_dir, true) != 0 ||
+        !realpath(shim_options.data_dir, data_dir)) {
+        perror(shim_options.data_dir);
+        return 1;
+    }
+    shim_options.data_dir = data_dir;
+
+    signal(SIGPIPE, SIG_IGN);
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    shim_system_init();
+    app_main();
+
+    // As on the device, the tasks app_main started keep running after it returns
+    pthread_exit(NULL);
+}
@@ -0,0 +1,12 @@
+// adc_cali.h - Host shim: ADC calibration handle
+#ifndef SHIM_ADC_CALI_H
+#define SHIM_ADC_CALI_H
+
+#include "esp_err.h"
+#include "esp_adc/adc_continuous.h"
+
+typedef struct adc_cali_scheme_t *adc_cali_handle_t;
+
+esp_err_t adc_cali_raw_to_voltage(adc_cali_handle_t handle, int raw, int *voltage);
+
+#endif // SHIM_ADC_CALI_H
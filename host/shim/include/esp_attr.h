@@ -0,0 +1,22 @@
+// esp_attr.h - Host shim: placement attributes
+//
+// RTC slow memory is a linker section of its own, so the shim can save it
+// across a simulated deep sleep (see esp_sleep.h) and start it fresh on
+// any other reset, as the bootloader does.
+#ifndef SHIM_ESP_ATTR_H
+#define SHIM_ESP_ATTR_H
+
+#include "esp_bit_defs.h"
+
+#define RTC_DATA_ATTR       __attribute__((section("shim_rtc_data")))
+#define RTC_NOINIT_ATTR     __attribute__((section("shim_rtc_data")))
+#define RTC_FAST_ATTR
+#define RTC_SLOW_ATTR       RTC_DATA_ATTR
+#define RTC_IRAM_ATTR
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define EXT_RAM_BSS_ATTR
+#define NOINLINE_ATTR       __attribute__((noinline))
+#define FORCE_INLINE_ATTR   static inline __attribute__((always_inline))
+
+#endif // SHIM_ESP_ATTR_H
@@ -0,0 +1,12 @@
+// esp_cpu.h - Host shim: cycle counter at the modelled CPU clock
+#ifndef SHIM_ESP_CPU_H
+#define SHIM_ESP_CPU_H
+
+#include <stdint.h>
+
+typedef uint32_t esp_cpu_cycle_count_t;
+
+// Wall time scaled to esp_rom_get_cpu_ticks_per_us(), wrapping like CCOUNT
+esp_cpu_cycle_count_t esp_cpu_get_cycle_count(void);
+
+#endif // SHIM_ESP_CPU_H
@@ -0,0 +1,58 @@
+// esp_log.h - Host shim: ESP_LOGx on stdout, same line format as the device
+#ifndef SHIM_ESP_LOG_H
+#define SHIM_ESP_LOG_H
+
+#include <stdint.h>
+#include <inttypes.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+
+typedef enum {
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE
+} esp_log_level_t;
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+    __attribute__((format(printf, 3, 4)));
+void esp_log_level_set(const char *tag, esp_log_level_t level);
+esp_log_level_t esp_log_level_get(const char *tag);
+uint32_t esp_log_timestamp(void);
+
+#ifndef LOG_LOCAL_LEVEL
+#define LOG_LOCAL_LEVEL CONFIG_LOG_MAXIMUM_LEVEL
+#endif
+
+// As in IDF, the line prefix is part of the format, so esp_log_write()
+// gets one format string and an empty firmware format is still valid
+#define LOG_FORMAT(letter, format) #letter " (%" PRIu32 ") %s: " format "\n"
+
+#define ESP_LOG_LEVEL(level, tag, format, ...) do { \
+        if (level == ESP_LOG_ERROR) { \
+            esp_log_write(ESP_LOG_ERROR, tag, LOG_FORMAT(E, format), \
+                          esp_log_timestamp(), tag, ##__VA_ARGS__); \
+        } else if (level == ESP_LOG_WARN) { \
+            esp_log_write(ESP_LOG_WARN, tag, LOG_FORMAT(W, format), \
+                          esp_log_timestamp(), tag, ##__VA_ARGS__); \
+        } else if (level == ESP_LOG_DEBUG) { \
+            esp_log_write(ESP_LOG_DEBUG, tag, LOG_FORMAT(D, format), \
+                          esp_log_timestamp(), tag, ##__VA_ARGS__); \
+        } else if (level == ESP_LOG_VERBOSE) { \
+            esp_log_write(ESP_LOG_VERBOSE, tag, LOG_FORMAT(V, format), \
+                          esp_log_timestamp(), tag, ##__VA_ARGS__); \
+        } else { \
+            esp_log_write(ESP_LOG_INFO, tag, LOG_FORMAT(I, format), \
+                          esp_log_timestamp(), tag, ##__VA_ARGS__); \
+        } \
+    } while (0)
+
+#define ESP_LOGE(tag, format, ...) ESP_LOG_LEVEL(ESP_LOG_ERROR,   tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) ESP_LOG_LEVEL(ESP_LOG_WARN,    tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) ESP_LOG_LEVEL(ESP_LOG_INFO,    tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) ESP_LOG_LEVEL(ESP_LOG_DEBUG,   tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) ESP_LOG_LEVEL(ESP_LOG_VERBOSE, tag, format, ##__VA_ARGS__)
+
+#endif // SHIM_ESP_LOG_H
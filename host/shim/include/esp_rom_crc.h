@@ -0,0 +1,10 @@
+// esp_rom_crc.h - Host shim: ROM CRC routines
+#ifndef SHIM_ESP_ROM_CRC_H
+#define SHIM_ESP_ROM_CRC_H
+
+#include <stdint.h>
+
+// CRC-32 (IEEE 802.3), reflected; crc is the previous result, 0 to start
+uint32_t esp_rom_crc32_le(uint32_t crc, uint8_t const *buf, uint32_t len);
+
+#endif // SHIM_ESP_ROM_CRC_H
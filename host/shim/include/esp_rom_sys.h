@@ -0,0 +1,14 @@
+// esp_rom_sys.h - Host shim: ROM delay and clock helpers
+#ifndef SHIM_ESP_ROM_SYS_H
+#define SHIM_ESP_ROM_SYS_H
+
+#include <stdint.h>
+
+void esp_rom_delay_us(uint32_t us);
+
+// CPU_FREQ_MHZ of the PM configuration in force (max while a lock is held)
+uint32_t esp_rom_get_cpu_ticks_per_us(void);
+
+int esp_rom_printf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+#endif // SHIM_ESP_ROM_SYS_H
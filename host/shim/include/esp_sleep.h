@@ -0,0 +1,34 @@
+// esp_sleep.h - Host shim: deep sleep as a timed re-exec
+//
+// esp_deep_sleep_start() stops serving for the armed time and re-executes
+// the binary, which then reports a timer wake with RTC memory restored.
+// A wake stub runs at the end of each timer first, in the sleeping
+// process; when it sleeps again the loop waits once more. Without a wake
+// source the process exits.
+#ifndef SHIM_ESP_SLEEP_H
+#define SHIM_ESP_SLEEP_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef enum {
+    ESP_SLEEP_WAKEUP_UNDEFINED,
+    ESP_SLEEP_WAKEUP_ALL,
+    ESP_SLEEP_WAKEUP_EXT0,
+    ESP_SLEEP_WAKEUP_EXT1,
+    ESP_SLEEP_WAKEUP_TIMER,
+    ESP_SLEEP_WAKEUP_TOUCHPAD,
+    ESP_SLEEP_WAKEUP_ULP,
+    ESP_SLEEP_WAKEUP_GPIO,
+    ESP_SLEEP_WAKEUP_UART,
+} esp_sleep_wakeup_cause_t;
+
+typedef void (*esp_deep_sleep_wake_stub_fn_t)(void);
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_in_us);
+void esp_set_deep_sleep_wake_stub(esp_deep_sleep_wake_stub_fn_t new_stub);
+void esp_default_wake_deep_sleep(void);
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause(void);
+void esp_deep_sleep_start(void) __attribute__((noreturn));
+
+#endif // SHIM_ESP_SLEEP_H
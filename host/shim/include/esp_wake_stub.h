@@ -0,0 +1,14 @@
+// esp_wake_stub.h - Host shim: what a deep sleep wake stub may call
+//
+// esp_wake_stub_sleep() returns to the shim's sleep loop, which sleeps
+// again for the time set here and runs the stub once more (see esp_sleep.h).
+#ifndef SHIM_ESP_WAKE_STUB_H
+#define SHIM_ESP_WAKE_STUB_H
+
+#include <stdint.h>
+#include "esp_sleep.h"
+
+void esp_wake_stub_set_wakeup_time(uint64_t time_in_us);
+void esp_wake_stub_sleep(esp_deep_sleep_wake_stub_fn_t new_stub) __attribute__((noreturn));
+
+#endif // SHIM_ESP_WAKE_STUB_H
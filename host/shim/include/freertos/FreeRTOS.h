@@ -0,0 +1,66 @@
+// FreeRTOS.h - Host shim: FreeRTOS kernel types over POSIX threads
+//
+// Tasks are threads, ticks are CONFIG_FREERTOS_HZ of CLOCK_MONOTONIC.
+// Priorities are recorded but not enforced - the host scheduler decides.
+// A critical section masks interrupts on the single-core C3, which stops
+// every other task; here all portMUX locks share one recursive mutex so
+// critical sections exclude each other across threads the same way.
+#ifndef SHIM_FREERTOS_H
+#define SHIM_FREERTOS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "esp_attr.h"
+#include "esp_err.h"
+// The IDF port headers pull these in; firmware sources rely on it
+#include "esp_system.h"
+#include "esp_timer.h"
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint32_t StackType_t;
+
+#define pdFALSE                 ((BaseType_t)0)
+#define pdTRUE                  ((BaseType_t)1)
+#define pdPASS                  pdTRUE
+#define pdFAIL                  pdFALSE
+#define errQUEUE_EMPTY          ((BaseType_t)0)
+#define errQUEUE_FULL           ((BaseType_t)0)
+
+#define configTICK_RATE_HZ      CONFIG_FREERTOS_HZ
+#define configMAX_PRIORITIES    25
+#define tskIDLE_PRIORITY        ((UBaseType_t)0)
+#define tskNO_AFFINITY          0x7FFFFFFF
+#define portTICK_PERIOD_MS      ((TickType_t)1000 / configTICK_RATE_HZ)
+#define portMAX_DELAY           ((TickType_t)0xffffffffUL)
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000U))
+#define pdTICKS_TO_MS(ticks)    ((uint32_t)(((uint64_t)(ticks) * 1000U) / configTICK_RATE_HZ))
+
+typedef struct {
+    uint32_t unused;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED    { 0 }
+
+void shim_enter_critical(void);
+void shim_exit_critical(void);
+
+#define portENTER_CRITICAL(mux)         ((void)(mux), shim_enter_critical())
+#define portEXIT_CRITICAL(mux)          ((void)(mux), shim_exit_critical())
+#define portENTER_CRITICAL_ISR(mux)     portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux)      portEXIT_CRITICAL(mux)
+#define portENTER_CRITICAL_SAFE(mux)    portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_SAFE(mux)     portEXIT_CRITICAL(mux)
+#define taskENTER_CRITICAL(mux)         portENTER_CRITICAL(mux)
+#define taskEXIT_CRITICAL(mux)          portEXIT_CRITICAL(mux)
+#define spinlock_initialize(mux)        ((void)(mux))
+#define portMUX_INITIALIZE(mux)         ((void)(mux))
+
+#define portYIELD_FROM_ISR(...)         ((void)0)
+#define portNUM_PROCESSORS              1
+
+#endif // SHIM_FREERTOS_H
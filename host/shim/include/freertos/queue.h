@@ -0,0 +1,21 @@
+// queue.h - Host shim: fixed-size item queues
+#ifndef SHIM_FREERTOS_QUEUE_H
+#define SHIM_FREERTOS_QUEUE_H
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct shim_queue *QueueHandle_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t uxQueueLength, UBaseType_t uxItemSize);
+void vQueueDelete(QueueHandle_t xQueue);
+BaseType_t xQueueSend(QueueHandle_t xQueue, const void *pvItemToQueue, TickType_t xTicksToWait);
+BaseType_t xQueueSendToFront(QueueHandle_t xQueue, const void *pvItemToQueue, TickType_t xTicksToWait);
+BaseType_t xQueueReceive(QueueHandle_t xQueue, void *pvBuffer, TickType_t xTicksToWait);
+BaseType_t xQueueReset(QueueHandle_t xQueue);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t xQueue);
+
+#define xQueueSendToBack(q, item, ticks)        xQueueSend(q, item, ticks)
+#define xQueueSendFromISR(q, item, woken)       ((void)(woken), xQueueSend(q, item, 0))
+#define xQueueReceiveFromISR(q, buf, woken)     ((void)(woken), xQueueReceive(q, buf, 0))
+
+#endif // SHIM_FREERTOS_QUEUE_H
@@ -0,0 +1,24 @@
+// semphr.h - Host shim: binary, counting and mutex semaphores
+//
+// All three are a counter with a ceiling; a mutex starts given and, unlike
+// FreeRTOS, has no priority inheritance.
+#ifndef SHIM_FREERTOS_SEMPHR_H
+#define SHIM_FREERTOS_SEMPHR_H
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct shim_semaphore *SemaphoreHandle_t;
+
+SemaphoreHandle_t shim_semaphore_create(UBaseType_t max_count, UBaseType_t initial_count);
+void vSemaphoreDelete(SemaphoreHandle_t xSemaphore);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t xSemaphore, TickType_t xBlockTime);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t xSemaphore);
+UBaseType_t uxSemaphoreGetCount(SemaphoreHandle_t xSemaphore);
+
+#define xSemaphoreCreateBinary()                shim_semaphore_create(1, 0)
+#define xSemaphoreCreateMutex()                 shim_semaphore_create(1, 1)
+#define xSemaphoreCreateCounting(max, initial)  shim_semaphore_create(max, initial)
+#define xSemaphoreGiveFromISR(sem, woken)       ((void)(woken), xSemaphoreGive(sem))
+#define xSemaphoreTakeFromISR(sem, woken)       ((void)(woken), xSemaphoreTake(sem, 0))
+
+#endif // SHIM_FREERTOS_SEMPHR_H
@@ -0,0 +1,10 @@
+// sha256.h - Host shim: the one-shot mbedtls SHA-256 call
+#ifndef SHIM_MBEDTLS_SHA256_H
+#define SHIM_MBEDTLS_SHA256_H
+
+#include <stddef.h>
+
+// is224 must be 0 - SHA-224 is not provided
+int mbedtls_sha256(const unsigned char *input, size_t ilen, unsigned char output[32], int is224);
+
+#endif // SHIM_MBEDTLS_SHA256_H
@@ -0,0 +1,10 @@
+// nvs_flash.h - Host shim: NVS init and erase
+#ifndef SHIM_NVS_FLASH_H
+#define SHIM_NVS_FLASH_H
+
+#include "nvs.h"
+
+esp_err_t nvs_flash_init(void);
+esp_err_t nvs_flash_erase(void);
+
+#endif // SHIM_NVS_FLASH_H
@@ -0,0 +1,36 @@
+// apb_saradc_reg.h - Host shim: the SAR ADC one-shot registers
+//
+// A one-shot start on ADC1 completes at once with the raw code of the
+// --battery-mv voltage, as long as the ADC's clock is enabled.
+#ifndef SHIM_SOC_APB_SARADC_REG_H
+#define SHIM_SOC_APB_SARADC_REG_H
+
+#include "soc/soc.h"
+
+#define APB_SARADC_CTRL_REG                 (DR_REG_APB_SARADC_BASE + 0x00)
+#define APB_SARADC_SAR_CLK_GATED            BIT(6)
+#define APB_SARADC_XPD_SAR_FORCE_V          0x3
+#define APB_SARADC_XPD_SAR_FORCE_S          27
+
+#define APB_SARADC_ONETIME_SAMPLE_REG       (DR_REG_APB_SARADC_BASE + 0x20)
+#define APB_SARADC1_ONETIME_SAMPLE          BIT(31)
+#define APB_SARADC2_ONETIME_SAMPLE          BIT(30)
+#define APB_SARADC_ONETIME_START            BIT(29)
+#define APB_SARADC_ONETIME_CHANNEL_V        0xF
+#define APB_SARADC_ONETIME_CHANNEL_S        25
+#define APB_SARADC_ONETIME_ATTEN_V          0x3
+#define APB_SARADC_ONETIME_ATTEN_S          23
+
+#define APB_SARADC_1_DATA_STATUS_REG        (DR_REG_APB_SARADC_BASE + 0x2C)
+#define APB_SARADC_ADC1_DATA_V              0x1FFFF
+#define APB_SARADC_ADC1_DATA_S              0
+
+#define APB_SARADC_INT_RAW_REG              (DR_REG_APB_SARADC_BASE + 0x44)
+#define APB_SARADC_ADC1_DONE_INT_RAW        BIT(31)
+#define APB_SARADC_INT_CLR_REG              (DR_REG_APB_SARADC_BASE + 0x4C)
+#define APB_SARADC_ADC1_DONE_INT_CLR        BIT(31)
+
+#define APB_SARADC_APB_ADC_CLKM_CONF_REG    (DR_REG_APB_SARADC_BASE + 0x54)
+#define APB_SARADC_CLK_EN                   BIT(20)
+
+#endif // SHIM_SOC_APB_SARADC_REG_H
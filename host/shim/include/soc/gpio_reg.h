@@ -0,0 +1,19 @@
+// gpio_reg.h - Host shim: the GPIO registers the bit-banged SWD path touches
+//
+// Writes to the W1TS/W1TC registers set and clear bits of OUT and ENABLE as
+// on the chip. Nothing is wired to the pins, so IN reads back the driven
+// level; only the simulator (SWD_SIM_ENABLE) answers as a target.
+#ifndef SHIM_SOC_GPIO_REG_H
+#define SHIM_SOC_GPIO_REG_H
+
+#include "soc/soc.h"
+
+#define GPIO_OUT_REG            (DR_REG_GPIO_BASE + 0x04)
+#define GPIO_OUT_W1TS_REG       (DR_REG_GPIO_BASE + 0x08)
+#define GPIO_OUT_W1TC_REG       (DR_REG_GPIO_BASE + 0x0C)
+#define GPIO_ENABLE_REG         (DR_REG_GPIO_BASE + 0x20)
+#define GPIO_ENABLE_W1TS_REG    (DR_REG_GPIO_BASE + 0x24)
+#define GPIO_ENABLE_W1TC_REG    (DR_REG_GPIO_BASE + 0x28)
+#define GPIO_IN_REG             (DR_REG_GPIO_BASE + 0x3C)
+
+#endif // SHIM_SOC_GPIO_REG_H
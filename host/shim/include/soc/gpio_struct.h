@@ -0,0 +1,7 @@
+// gpio_struct.h - Host shim: GPIO register block (see gpio_reg.h)
+#ifndef SHIM_SOC_GPIO_STRUCT_H
+#define SHIM_SOC_GPIO_STRUCT_H
+
+#include <stdint.h>
+
+#endif // SHIM_SOC_GPIO_STRUCT_H
@@ -0,0 +1,12 @@
+// regi2c_defs.h - Host shim: analog (regi2c) power controls of the SAR ADC
+#ifndef SHIM_SOC_REGI2C_DEFS_H
+#define SHIM_SOC_REGI2C_DEFS_H
+
+#include "soc/soc.h"
+
+#define ANA_CONFIG_REG              0x6000E044
+#define ANA_I2C_SAR_FORCE_PD        BIT(18)
+#define ANA_CONFIG2_REG             0x6000E048
+#define ANA_I2C_SAR_FORCE_PU        BIT(16)
+
+#endif // SHIM_SOC_REGI2C_DEFS_H
@@ -0,0 +1,34 @@
+// soc.h - Host shim: peripheral register access
+//
+// The register macros go through shim_reg_read()/shim_reg_write(), which
+// emulate the few blocks the firmware drives directly: GPIO for the
+// bit-banged SWD path and the SAR ADC for the wake stub's battery sample.
+// Any other register is plain storage.
+#ifndef SHIM_SOC_SOC_H
+#define SHIM_SOC_SOC_H
+
+#include <stdint.h>
+#include "esp_bit_defs.h"
+
+#define DR_REG_SYSTEM_BASE          0x600C0000
+#define DR_REG_GPIO_BASE            0x60004000
+#define DR_REG_APB_SARADC_BASE      0x60040000
+
+uint32_t shim_reg_read(uint32_t addr);
+void shim_reg_write(uint32_t addr, uint32_t val);
+
+#define REG_WRITE(reg, val)             shim_reg_write((reg), (uint32_t)(val))
+#define REG_READ(reg)                   shim_reg_read(reg)
+#define WRITE_PERI_REG(reg, val)        REG_WRITE(reg, val)
+#define READ_PERI_REG(reg)              REG_READ(reg)
+#define SET_PERI_REG_MASK(reg, mask)    REG_WRITE(reg, REG_READ(reg) | (mask))
+#define CLEAR_PERI_REG_MASK(reg, mask)  REG_WRITE(reg, REG_READ(reg) & ~(uint32_t)(mask))
+#define REG_SET_BIT(reg, bit)           SET_PERI_REG_MASK(reg, bit)
+#define REG_CLR_BIT(reg, bit)           CLEAR_PERI_REG_MASK(reg, bit)
+#define REG_GET_BIT(reg, bit)           (REG_READ(reg) & (bit))
+#define REG_GET_FIELD(reg, field)       ((REG_READ(reg) >> (field##_S)) & (field##_V))
+#define REG_SET_FIELD(reg, field, val) \
+    REG_WRITE(reg, (REG_READ(reg) & ~((uint32_t)(field##_V) << (field##_S))) | \
+                   (((uint32_t)(val) & (field##_V)) << (field##_S)))
+
+#endif // SHIM_SOC_SOC_H
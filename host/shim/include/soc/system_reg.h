@@ -0,0 +1,12 @@
+// system_reg.h - Host shim: peripheral clock and reset enables
+#ifndef SHIM_SOC_SYSTEM_REG_H
+#define SHIM_SOC_SYSTEM_REG_H
+
+#include "soc/soc.h"
+
+#define SYSTEM_PERIP_CLK_EN0_REG    (DR_REG_SYSTEM_BASE + 0x10)
+#define SYSTEM_APB_SARADC_CLK_EN    BIT(28)
+#define SYSTEM_PERIP_RST_EN0_REG    (DR_REG_SYSTEM_BASE + 0x18)
+#define SYSTEM_APB_SARADC_RST       BIT(28)
+
+#endif // SHIM_SOC_SYSTEM_REG_H
@@ -0,0 +1,234 @@
+// esp_partition.c - Host shim: the firmware's partition table over image files
+#include "esp_partition.h"
+#include "esp_log.h"
+#include "shim_internal.h"
+#include <ctype.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PARTITION_MAX   16
+
+static const char *TAG = "HOST_PART";
+
+static esp_partition_t partitions[PARTITION_MAX];
+static int partition_count = 0;
+static pthread_once_t table_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t flash_lock = PTHREAD_MUTEX_INITIALIZER;
+
+typedef struct {
+    const char *name;
+    int value;
+} name_value_t;
+
+static const name_value_t type_names[] = {
+    { "app", ESP_PARTITION_TYPE_APP },
+    { "data", ESP_PARTITION_TYPE_DATA },
+};
+
+static const name_value_t subtype_names[] = {
+    { "factory", ESP_PARTITION_SUBTYPE_APP_FACTORY },
+    { "phy", ESP_PARTITION_SUBTYPE_DATA_PHY },
+    { "nvs", ESP_PARTITION_SUBTYPE_DATA_NVS },
+    { "spiffs", ESP_PARTITION_SUBTYPE_DATA_SPIFFS },
+};
+
+static char *trim(char *s) {
+    while (isspace((unsigned char)*s)) {
+        s++;
+    }
+    char *end = s + strlen(s);
+    while (end > s && isspace((unsigned char)end[-1])) {
+        *--end = '\0';
+    }
+    return s;
+}
+
+static int parse_name(const char *s, const name_value_t *names, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (strcmp(s, names[i].name) == 0) {
+            return names[i].value;
+        }
+    }
+    return (int)strtol(s, NULL, 0);
+}
+
+// gen_esp32part.py sizes: plain or 0x numbers with an optional K or M
+static uint32_t parse_size(const char *s) {
+    char *end;
+    uint32_t value = strtoul(s, &end, 0);
+    if (*end == 'K' || *end == 'k') {
+        value *= 1024;
+    } else if (*end == 'M' || *end == 'm') {
+        value *= 1024 * 1024;
+    }
+    return value;
+}
+
+static void table_load(void) {
+    FILE *f = fopen(PARTITION_TABLE_CSV, "r");
+    if (!f) {
+        ESP_LOGE(TAG, "Cannot read %s", PARTITION_TABLE_CSV);
+        return;
+    }
+
+    char line[256];
+    while (fgets(line, sizeof(line), f) && partition_count < PARTITION_MAX) {
+        char *hash = strchr(line, '#');
+        if (hash) {
+            *hash = '\0';
+        }
+        char *fields[5] = {0};
+        int n = 0;
+        for (char *tok = strtok(line, ","); tok && n < 5; tok = strtok(NULL, ",")) {
+            fields[n++] = trim(tok);
+        }
+        if (n < 5 || fields[0][0] == '\0') {
+            continue;
+        }
+
+        esp_partition_t *p = &partitions[partition_count++];
+        snprintf(p->label, sizeof(p->label), "%s", fields[0]);
+        p->type = parse_name(fields[1], type_names, sizeof(type_names) / sizeof(type_names[0]));
+        p->subtype = parse_name(fields[2], subtype_names,
+                                sizeof(subtype_names) / sizeof(subtype_names[0]));
+        p->address = parse_size(fields[3]);
+        p->size = parse_size(fields[4]);
+        p->erase_size = SPI_FLASH_SEC_SIZE;
+    }
+    fclose(f);
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type,
+                                                esp_partition_subtype_t subtype,
+                                                const char *label) {
+    pthread_once(&table_once, table_load);
+    for (int i = 0; i < partition_count; i++) {
+        const esp_partition_t *p = &partitions[i];
+        if ((type == ESP_PARTITION_TYPE_ANY || p->type == type) &&
+            (subtype == ESP_PARTITION_SUBTYPE_ANY || p->subtype == subtype) &&
+            (!label || strcmp(p->label, label) == 0)) {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+// Image file of a partition, created erased (all 0xFF) on first use
+static FILE *image_open(const esp_partition_t *partition) {
+    char name[64], path[256];
+    snprintf(name, sizeof(name), "partitions/%s.bin", partition->label);
+    shim_data_path(path, sizeof(path), name);
+
+    FILE *f = fopen(path, "r+b");
+    if (f) {
+        return f;
+    }
+    f = fopen(path, "w+b");
+    if (!f) {
+        return NULL;
+    }
+    uint8_t erased[SPI_FLASH_SEC_SIZE];
+    memset(erased, 0xFF, sizeof(erased));
+    for (uint32_t off = 0; off < partition->size; off += sizeof(erased)) {
+        fwrite(erased, 1, sizeof(erased), f);
+    }
+    fflush(f);
+    return f;
+}
+
+static esp_err_t check_range(const esp_partition_t *partition, size_t offset, size_t size) {
+    if (!partition) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (offset > partition->size || size > partition->size - offset) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset,
+                             void *dst, size_t size) {
+    esp_err_t ret = check_range(partition, src_offset, size);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    pthread_mutex_lock(&flash_lock);
+    FILE *f = image_open(partition);
+    if (!f) {
+        ret = ESP_FAIL;
+    } else {
+        if (fseek(f, src_offset, SEEK_SET) != 0 || fread(dst, 1, size, f) != size) {
+            ret = ESP_FAIL;
+        }
+        fclose(f);
+    }
+    pthread_mutex_unlock(&flash_lock);
+    return ret;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset,
+                              const void *src, size_t size) {
+    esp_err_t ret = check_range(partition, dst_offset, size);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    uint8_t *merged = malloc(size);
+    if (!merged) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    pthread_mutex_lock(&flash_lock);
+    FILE *f = image_open(partition);
+    if (!f) {
+        ret = ESP_FAIL;
+    } else {
+        // NOR flash: programming only clears bits
+        if (fseek(f, dst_offset, SEEK_SET) != 0 || fread(merged, 1, size, f) != size) {
+            ret = ESP_FAIL;
+        } else {
+            for (size_t i = 0; i < size; i++) {
+                merged[i] &= ((const uint8_t *)src)[i];
+            }
+            if (fseek(f, dst_offset, SEEK_SET) != 0 || fwrite(merged, 1, size, f) != size) {
+                ret = ESP_FAIL;
+            }
+        }
+        fclose(f);
+    }
+    pthread_mutex_unlock(&flash_lock);
+    free(merged);
+    return ret;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size) {
+    esp_err_t ret = check_range(partition, offset, size);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (offset % SPI_FLASH_SEC_SIZE || size % SPI_FLASH_SEC_SIZE) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint8_t erased[SPI_FLASH_SEC_SIZE];
+    memset(erased, 0xFF, sizeof(erased));
+
+    pthread_mutex_lock(&flash_lock);
+    FILE *f = image_open(partition);
+    if (!f) {
+        ret = ESP_FAIL;
+    } else {
+        if (fseek(f, offset, SEEK_SET) != 0) {
+            ret = ESP_FAIL;
+        }
+        for (size_t done = 0; ret == ESP_OK && done < size; done += sizeof(erased)) {
+            if (fwrite(erased, 1, sizeof(erased), f) != sizeof(erased)) {
+                ret = ESP_FAIL;
+            }
+        }
+        fclose(f);
+    }
+    pthread_mutex_unlock(&flash_lock);
+    return ret;
+}
@@ -0,0 +1,489 @@
+// esp_system.c - Host shim: logging, resets, RTC memory, sleep, PM and clocks
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_sleep.h"
+#include "esp_wake_stub.h"
+#include "esp_pm.h"
+#include "esp_cpu.h"
+#include "esp_mac.h"
+#include "esp_rom_sys.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "esp_http_server.h"
+#include "nvs.h"
+#include "shim_internal.h"
+#include <limits.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RESET_ENV       "FLASHER_HOST_RESET"
+#define RTC_IMAGE       "rtc_memory.bin"
+
+shim_options_t shim_options = {
+    .http_port = 8080,
+    .data_dir = "flasher_host_data",
+    .battery_mv = 4000,
+    .heap_kb = 200,
+};
+
+static const char *TAG = "HOST";
+
+// ---- Errors ----
+
+typedef struct {
+    esp_err_t code;
+    const char *name;
+} err_name_t;
+
+#define ERR_NAME(code) { code, #code }
+
+static const err_name_t err_names[] = {
+    ERR_NAME(ESP_OK),
+    ERR_NAME(ESP_FAIL),
+    ERR_NAME(ESP_ERR_NO_MEM),
+    ERR_NAME(ESP_ERR_INVALID_ARG),
+    ERR_NAME(ESP_ERR_INVALID_STATE),
+    ERR_NAME(ESP_ERR_INVALID_SIZE),
+    ERR_NAME(ESP_ERR_NOT_FOUND),
+    ERR_NAME(ESP_ERR_NOT_SUPPORTED),
+    ERR_NAME(ESP_ERR_TIMEOUT),
+    ERR_NAME(ESP_ERR_INVALID_RESPONSE),
+    ERR_NAME(ESP_ERR_INVALID_CRC),
+    ERR_NAME(ESP_ERR_INVALID_VERSION),
+    ERR_NAME(ESP_ERR_INVALID_MAC),
+    ERR_NAME(ESP_ERR_NOT_FINISHED),
+    ERR_NAME(ESP_ERR_NOT_ALLOWED),
+    ERR_NAME(ESP_ERR_WIFI_NOT_INIT),
+    ERR_NAME(ESP_ERR_WIFI_NOT_STARTED),
+    ERR_NAME(ESP_ERR_WIFI_NOT_STOPPED),
+    ERR_NAME(ESP_ERR_WIFI_MODE),
+    ERR_NAME(ESP_ERR_WIFI_STATE),
+    ERR_NAME(ESP_ERR_WIFI_CONN),
+    ERR_NAME(ESP_ERR_WIFI_NOT_CONNECT),
+    ERR_NAME(ESP_ERR_HTTPD_HANDLERS_FULL),
+    ERR_NAME(ESP_ERR_HTTPD_HANDLER_EXISTS),
+    ERR_NAME(ESP_ERR_HTTPD_INVALID_REQ),
+    ERR_NAME(ESP_ERR_HTTPD_RESULT_TRUNC),
+    ERR_NAME(ESP_ERR_HTTPD_RESP_HDR),
+    ERR_NAME(ESP_ERR_HTTPD_RESP_SEND),
+    ERR_NAME(ESP_ERR_HTTPD_ALLOC_MEM),
+    ERR_NAME(ESP_ERR_HTTPD_TASK),
+    ERR_NAME(ESP_ERR_NVS_NOT_INITIALIZED),
+    ERR_NAME(ESP_ERR_NVS_NOT_FOUND),
+    ERR_NAME(ESP_ERR_NVS_TYPE_MISMATCH),
+    ERR_NAME(ESP_ERR_NVS_READ_ONLY),
+    ERR_NAME(ESP_ERR_NVS_NOT_ENOUGH_SPACE),
+    ERR_NAME(ESP_ERR_NVS_INVALID_NAME),
+    ERR_NAME(ESP_ERR_NVS_INVALID_HANDLE),
+    ERR_NAME(ESP_ERR_NVS_KEY_TOO_LONG),
+    ERR_NAME(ESP_ERR_NVS_INVALID_LENGTH),
+    ERR_NAME(ESP_ERR_NVS_NO_FREE_PAGES),
+    ERR_NAME(ESP_ERR_NVS_NEW_VERSION_FOUND),
+};
+
+const char *esp_err_to_name(esp_err_t code) {
+    for (size_t i = 0; i < sizeof(err_names) / sizeof(err_names[0]); i++) {
+        if (err_names[i].code == code) {
+            return err_names[i].name;
+        }
+    }
+    return "UNKNOWN ERROR";
+}
+
+void shim_error_check_failed(esp_err_t rc, const char *file, int line,
+                             const char *function, const char *expression) {
+    fprintf(stderr, "ESP_ERROR_CHECK failed: esp_err_t 0x%x (%s) at %s:%d\n"
+            "func: %s\nexpression: %s\n", rc, esp_err_to_name(rc), file, line,
+            function, expression);
+    abort();
+}
+
+// ---- Logging ----
+
+#define LOG_TAG_LEVELS  16
+
+static struct {
+    const char *tag;
+    esp_log_level_t level;
+} tag_levels[LOG_TAG_LEVELS];
+static int tag_level_count = 0;
+static esp_log_level_t default_level = CONFIG_LOG_DEFAULT_LEVEL;
+
+static esp_log_level_t level_for(const char *tag) {
+    for (int i = 0; i < tag_level_count; i++) {
+        if (strcmp(tag_levels[i].tag, tag) == 0) {
+            return tag_levels[i].level;
+        }
+    }
+    return default_level;
+}
+
+void esp_log_level_set(const char *tag, esp_log_level_t level) {
+    if (strcmp(tag, "*") == 0) {
+        default_level = level;
+        return;
+    }
+    for (int i = 0; i < tag_level_count; i++) {
+        if (strcmp(tag_levels[i].tag, tag) == 0) {
+            tag_levels[i].level = level;
+            return;
+        }
+    }
+    if (tag_level_count < LOG_TAG_LEVELS) {
+        tag_levels[tag_level_count].tag = strdup(tag);
+        tag_levels[tag_level_count++].level = level;
+    }
+}
+
+esp_log_level_t esp_log_level_get(const char *tag) {
+    return level_for(tag);
+}
+
+uint32_t esp_log_timestamp(void) {
+    return (uint32_t)(shim_monotonic_us() / 1000);
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...) {
+    if (level > level_for(tag)) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    fflush(stdout);
+    va_end(args);
+}
+
+int esp_rom_printf(const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int n = vprintf(fmt, args);
+    va_end(args);
+    fflush(stdout);
+    return n;
+}
+
+// ---- Resets and RTC memory ----
+
+extern char __start_shim_rtc_data[] __attribute__((weak));
+extern char __stop_shim_rtc_data[] __attribute__((weak));
+
+static esp_reset_reason_t reset_reason = ESP_RST_POWERON;
+static esp_sleep_wakeup_cause_t wakeup_cause = ESP_SLEEP_WAKEUP_UNDEFINED;
+static uint64_t sleep_timer_us = 0;
+
+static size_t rtc_size(void) {
+    return __start_shim_rtc_data ? (size_t)(__stop_shim_rtc_data - __start_shim_rtc_data) : 0;
+}
+
+static bool rtc_restore(void) {
+    char path[256];
+    FILE *f = fopen(shim_data_path(path, sizeof(path), RTC_IMAGE), "rb");
+    if (!f) {
+        return false;
+    }
+    size_t n = fread(__start_shim_rtc_data, 1, rtc_size(), f);
+    fclose(f);
+    remove(path);
+    return n == rtc_size();
+}
+
+static void rtc_save(void) {
+    char path[256];
+    FILE *f = fopen(shim_data_path(path, sizeof(path), RTC_IMAGE), "wb");
+    if (f) {
+        fwrite(__start_shim_rtc_data, 1, rtc_size(), f);
+        fclose(f);
+    }
+}
+
+// Resolved once at start: /proc/self/exe itself is not always exec-able
+static char exe_path[PATH_MAX];
+
+void shim_system_init(void) {
+    ssize_t n = readlink("/proc/self/exe", exe_path, sizeof(exe_path) - 1);
+    if (n > 0) {
+        exe_path[n] = '\0';
+    } else {
+        snprintf(exe_path, sizeof(exe_path), "%s", shim_options.argv[0]);
+    }
+
+    const char *reset = getenv(RESET_ENV);
+    if (reset && strcmp(reset, "deepsleep") == 0) {
+        if (rtc_restore()) {
+            reset_reason = ESP_RST_DEEPSLEEP;
+            wakeup_cause = ESP_SLEEP_WAKEUP_TIMER;
+        } else {
+            ESP_LOGW(TAG, "No RTC memory image - starting as a power-on");
+        }
+    } else if (reset && strcmp(reset, "sw") == 0) {
+        reset_reason = ESP_RST_SW;
+    }
+    unsetenv(RESET_ENV);
+    esp_get_free_heap_size();
+}
+
+// Start over as the chip does after reset: same binary and arguments
+static void __attribute__((noreturn)) reexec(const char *reason) {
+    fflush(NULL);
+    setenv(RESET_ENV, reason, 1);
+    for (int fd = 3; fd < 1024; fd++) {
+        close(fd);
+    }
+    execv(exe_path, shim_options.argv);
+    perror("execv");
+    _exit(1);
+}
+
+void esp_restart(void) {
+    ESP_LOGI(TAG, "Restarting");
+    reexec("sw");
+}
+
+esp_reset_reason_t esp_reset_reason(void) {
+    return reset_reason;
+}
+
+// ---- Sleep ----
+
+static esp_deep_sleep_wake_stub_fn_t wake_stub = NULL;
+static jmp_buf wake_stub_return;
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_in_us) {
+    sleep_timer_us = time_in_us;
+    return ESP_OK;
+}
+
+void esp_set_deep_sleep_wake_stub(esp_deep_sleep_wake_stub_fn_t new_stub) {
+    wake_stub = new_stub;
+}
+
+void esp_default_wake_deep_sleep(void) {
+}
+
+void esp_wake_stub_set_wakeup_time(uint64_t time_in_us) {
+    sleep_timer_us = time_in_us;
+}
+
+// Back to the sleep loop in esp_deep_sleep_start()
+void esp_wake_stub_sleep(esp_deep_sleep_wake_stub_fn_t new_stub) {
+    wake_stub = new_stub;
+    longjmp(wake_stub_return, 1);
+}
+
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause(void) {
+    return wakeup_cause;
+}
+
+void esp_deep_sleep_start(void) {
+    if (sleep_timer_us == 0) {
+        ESP_LOGI(TAG, "Deep sleep without a wake source - exiting");
+        fflush(NULL);
+        _exit(0);
+    }
+    ESP_LOGI(TAG, "Deep sleep for %llu ms", (unsigned long long)(sleep_timer_us / 1000));
+
+    // Other threads keep running while this one sleeps, as they do until
+    // the power domains go down; nothing they do survives the re-exec.
+    // A stub that sleeps again jumps back here for another round.
+    setjmp(wake_stub_return);
+    struct timespec ts = {
+        .tv_sec = sleep_timer_us / 1000000,
+        .tv_nsec = (sleep_timer_us % 1000000) * 1000
+    };
+    while (nanosleep(&ts, &ts) != 0) {
+    }
+    if (wake_stub) {
+        wake_stub();
+    }
+    rtc_save();
+    reexec("deepsleep");
+}
+
+// ---- Heap ----
+
+static size_t heap_baseline = 0;
+static uint32_t heap_minimum = UINT32_MAX;
+
+uint32_t esp_get_free_heap_size(void) {
+    struct mallinfo2 info = mallinfo2();
+    if (heap_baseline == 0) {
+        heap_baseline = info.uordblks;
+    }
+    int64_t used = (int64_t)info.uordblks - (int64_t)heap_baseline;
+    int64_t free_bytes = (int64_t)shim_options.heap_kb * 1024 - (used > 0 ? used : 0);
+    uint32_t result = free_bytes > 0 ? (uint32_t)free_bytes : 0;
+    if (result < heap_minimum) {
+        heap_minimum = result;
+    }
+    return result;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void) {
+    esp_get_free_heap_size();
+    return heap_minimum;
+}
+
+// ---- Power management and the CPU clock ----
+
+struct esp_pm_lock {
+    esp_pm_lock_type_t type;
+    int count;
+};
+
+static pthread_mutex_t pm_lock = PTHREAD_MUTEX_INITIALIZER;
+static esp_pm_config_t pm_config;
+static bool pm_configured = false;
+static int cpu_max_locks = 0;
+
+// CCOUNT runs at whatever clock is current; keep it continuous across changes
+static uint32_t clock_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+static uint64_t cycles_base = 0;
+static int64_t cycles_base_us = 0;
+
+static uint64_t cycles_now_locked(void) {
+    return cycles_base + (uint64_t)(shim_monotonic_us() - cycles_base_us) * clock_mhz;
+}
+
+static void clock_update_locked(void) {
+    uint32_t mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+    if (pm_configured) {
+        mhz = cpu_max_locks > 0 ? pm_config.max_freq_mhz : pm_config.min_freq_mhz;
+    }
+    if (mhz != clock_mhz) {
+        cycles_base = cycles_now_locked();
+        cycles_base_us = shim_monotonic_us();
+        clock_mhz = mhz;
+    }
+}
+
+esp_err_t esp_pm_configure(const void *config) {
+    const esp_pm_config_t *cfg = config;
+    if (!cfg || cfg->min_freq_mhz > cfg->max_freq_mhz) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&pm_lock);
+    pm_config = *cfg;
+    pm_configured = true;
+    clock_update_locked();
+    pthread_mutex_unlock(&pm_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_get_configuration(void *config) {
+    pthread_mutex_lock(&pm_lock);
+    esp_err_t ret = pm_configured ? ESP_OK : ESP_ERR_INVALID_STATE;
+    if (pm_configured) {
+        *(esp_pm_config_t *)config = pm_config;
+    }
+    pthread_mutex_unlock(&pm_lock);
+    return ret;
+}
+
+esp_err_t esp_pm_lock_create(esp_pm_lock_type_t lock_type, int arg,
+                             const char *name, esp_pm_lock_handle_t *out_handle) {
+    struct esp_pm_lock *lock = calloc(1, sizeof(*lock));
+    if (!lock) {
+        return ESP_ERR_NO_MEM;
+    }
+    lock->type = lock_type;
+    *out_handle = lock;
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle) {
+    if (!handle) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&pm_lock);
+    if (handle->count++ == 0 && handle->type == ESP_PM_CPU_FREQ_MAX) {
+        cpu_max_locks++;
+        clock_update_locked();
+    }
+    pthread_mutex_unlock(&pm_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t handle) {
+    if (!handle) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t ret = ESP_OK;
+    pthread_mutex_lock(&pm_lock);
+    if (handle->count == 0) {
+        ret = ESP_ERR_INVALID_STATE;
+    } else if (--handle->count == 0 && handle->type == ESP_PM_CPU_FREQ_MAX) {
+        cpu_max_locks--;
+        clock_update_locked();
+    }
+    pthread_mutex_unlock(&pm_lock);
+    return ret;
+}
+
+esp_err_t esp_pm_lock_delete(esp_pm_lock_handle_t handle) {
+    if (!handle) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (handle->count > 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    free(handle);
+    return ESP_OK;
+}
+
+uint32_t esp_rom_get_cpu_ticks_per_us(void) {
+    pthread_mutex_lock(&pm_lock);
+    uint32_t mhz = clock_mhz;
+    pthread_mutex_unlock(&pm_lock);
+    return mhz;
+}
+
+esp_cpu_cycle_count_t esp_cpu_get_cycle_count(void) {
+    pthread_mutex_lock(&pm_lock);
+    uint64_t cycles = cycles_now_locked();
+    pthread_mutex_unlock(&pm_lock);
+    return (esp_cpu_cycle_count_t)cycles;
+}
+
+void esp_rom_delay_us(uint32_t us) {
+    // Spin for short waits, as the ROM does; sleep for long ones
+    if (us >= 1000) {
+        struct timespec ts = { .tv_sec = us / 1000000, .tv_nsec = (us % 1000000) * 1000L };
+        while (nanosleep(&ts, &ts) != 0) {
+        }
+        return;
+    }
+    int64_t end = shim_monotonic_us() + us;
+    while (shim_monotonic_us() < end) {
+    }
+}
+
+// ---- ROM CRC and MAC ----
+
+uint32_t esp_rom_crc32_le(uint32_t crc, uint8_t const *buf, uint32_t len) {
+    crc = ~crc;
+    while (len--) {
+        crc ^= *buf++;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+esp_err_t esp_read_mac(uint8_t *mac, esp_mac_type_t type) {
+    // Locally administered, fixed so the web UI shows a stable address
+    static const uint8_t base[6] = { 0x02, 0x00, 0x00, 0xC3, 0x00, 0x00 };
+    memcpy(mac, base, 6);
+    mac[5] += type;
+    return ESP_OK;
+}
@@ -0,0 +1,186 @@
+// esp_timer.c - Host shim: esp_timer on one dispatch thread
+#include "esp_timer.h"
+#include "shim_internal.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+struct esp_timer {
+    esp_timer_cb_t callback;
+    void *arg;
+    const char *name;
+    bool armed;
+    int64_t expiry_us;
+    uint64_t period_us;         // 0 for one-shot
+    struct esp_timer *next;     // Armed list, earliest first
+};
+
+static pthread_mutex_t timer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t timer_cond;
+static pthread_once_t timer_once = PTHREAD_ONCE_INIT;
+static struct esp_timer *armed_list = NULL;
+static struct timespec start_time;
+static pthread_once_t start_once = PTHREAD_ONCE_INIT;
+
+static void start_time_init(void) {
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+}
+
+int64_t shim_monotonic_us(void) {
+    pthread_once(&start_once, start_time_init);
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)(now.tv_sec - start_time.tv_sec) * 1000000 +
+           (now.tv_nsec - start_time.tv_nsec) / 1000;
+}
+
+int64_t esp_timer_get_time(void) {
+    return shim_monotonic_us();
+}
+
+static void list_remove(struct esp_timer *timer) {
+    for (struct esp_timer **p = &armed_list; *p; p = &(*p)->next) {
+        if (*p == timer) {
+            *p = timer->next;
+            break;
+        }
+    }
+    timer->next = NULL;
+    timer->armed = false;
+}
+
+static void list_insert(struct esp_timer *timer) {
+    struct esp_timer **p = &armed_list;
+    while (*p && (*p)->expiry_us <= timer->expiry_us) {
+        p = &(*p)->next;
+    }
+    timer->next = *p;
+    *p = timer;
+    timer->armed = true;
+}
+
+static void *timer_thread(void *arg) {
+    pthread_setname_np(pthread_self(), "esp_timer");
+    pthread_mutex_lock(&timer_lock);
+    while (1) {
+        if (!armed_list) {
+            pthread_cond_wait(&timer_cond, &timer_lock);
+            continue;
+        }
+        int64_t now = shim_monotonic_us();
+        struct esp_timer *timer = armed_list;
+        if (timer->expiry_us > now) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_MONOTONIC, &deadline);
+            int64_t ns = deadline.tv_nsec + (timer->expiry_us - now) * 1000;
+            deadline.tv_sec += ns / 1000000000;
+            deadline.tv_nsec = ns % 1000000000;
+            pthread_cond_timedwait(&timer_cond, &timer_lock, &deadline);
+            continue;
+        }
+
+        // Re-arm before the callback so it may stop or restart its own timer
+        list_remove(timer);
+        if (timer->period_us) {
+            timer->expiry_us += timer->period_us;
+            if (timer->expiry_us < now) {
+                timer->expiry_us = now + timer->period_us;
+            }
+            list_insert(timer);
+        }
+        esp_timer_cb_t callback = timer->callback;
+        void *cb_arg = timer->arg;
+
+        pthread_mutex_unlock(&timer_lock);
+        callback(cb_arg);
+        pthread_mutex_lock(&timer_lock);
+    }
+    return NULL;
+}
+
+static void timer_init(void) {
+    shim_cond_init(&timer_cond);
+    pthread_t thread;
+    pthread_create(&thread, NULL, timer_thread, NULL);
+    pthread_detach(thread);
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args, esp_timer_handle_t *out_handle) {
+    if (!create_args || !create_args->callback || !out_handle) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_once(&timer_once, timer_init);
+
+    struct esp_timer *timer = calloc(1, sizeof(*timer));
+    if (!timer) {
+        return ESP_ERR_NO_MEM;
+    }
+    timer->callback = create_args->callback;
+    timer->arg = create_args->arg;
+    timer->name = create_args->name;
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+static esp_err_t timer_start(esp_timer_handle_t timer, uint64_t timeout_us, uint64_t period_us) {
+    if (!timer) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t ret = ESP_OK;
+    pthread_mutex_lock(&timer_lock);
+    if (timer->armed) {
+        ret = ESP_ERR_INVALID_STATE;
+    } else {
+        timer->expiry_us = shim_monotonic_us() + timeout_us;
+        timer->period_us = period_us;
+        list_insert(timer);
+        pthread_cond_signal(&timer_cond);
+    }
+    pthread_mutex_unlock(&timer_lock);
+    return ret;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    return timer_start(timer, timeout_us, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period) {
+    return timer_start(timer, period, period);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    if (!timer) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t ret = ESP_OK;
+    pthread_mutex_lock(&timer_lock);
+    if (timer->armed) {
+        list_remove(timer);
+    } else {
+        ret = ESP_ERR_INVALID_STATE;
+    }
+    pthread_mutex_unlock(&timer_lock);
+    return ret;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+    if (!timer) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&timer_lock);
+    bool armed = timer->armed;
+    pthread_mutex_unlock(&timer_lock);
+    if (armed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    free(timer);
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer) {
+    pthread_mutex_lock(&timer_lock);
+    bool armed = timer && timer->armed;
+    pthread_mutex_unlock(&timer_lock);
+    return armed;
+}
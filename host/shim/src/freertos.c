@@ -0,0 +1,513 @@
+// freertos.c - Host shim: FreeRTOS tasks, queues, semaphores and event groups
+//
+// Every object is a pthread mutex and condition variable; timeouts are
+// absolute CLOCK_MONOTONIC deadlines so a wait never outlasts its ticks
+// because of wakeups in between.
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "shim_internal.h"
+#include <pthread.h>
+#include <sched.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Task stacks are painted so uxTaskGetStackHighWaterMark() reports real use.
+// x86 frames and glibc stdio are larger than on the C3, so every task gets
+// headroom on top of its configured depth and the mark is taken against the
+// configured depth: on the host it is an upper bound for the target.
+#define STACK_PAINT         0xA5
+#define STACK_HEADROOM      (256 * 1024)
+
+struct shim_task {
+    pthread_t thread;
+    char name[16];
+    UBaseType_t priority;
+    uint32_t stack_size;
+    uint8_t *stack;         // Painted pthread stack (NULL for adopted threads)
+    size_t stack_alloc;
+    TaskFunction_t code;
+    void *params;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t notify_count;
+};
+
+static __thread struct shim_task *current_task = NULL;
+static pthread_mutex_t critical_lock;
+static pthread_once_t critical_once = PTHREAD_ONCE_INIT;
+
+// ---- Time ----
+
+bool shim_deadline(TickType_t ticks, struct timespec *deadline) {
+    if (ticks == portMAX_DELAY) {
+        return false;
+    }
+    uint64_t ns = (uint64_t)ticks * 1000000000ULL / configTICK_RATE_HZ;
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    ns += deadline->tv_nsec;
+    deadline->tv_sec += ns / 1000000000ULL;
+    deadline->tv_nsec = ns % 1000000000ULL;
+    return true;
+}
+
+void shim_cond_init(pthread_cond_t *cond) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+// Wait on cond until predicate holds or the deadline passes; the caller
+// loops on its own predicate. Returns false once timed out.
+static bool cond_wait(pthread_cond_t *cond, pthread_mutex_t *lock, bool timed,
+                      const struct timespec *deadline) {
+    if (!timed) {
+        pthread_cond_wait(cond, lock);
+        return true;
+    }
+    return pthread_cond_timedwait(cond, lock, deadline) != ETIMEDOUT;
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return (TickType_t)(shim_monotonic_us() * configTICK_RATE_HZ / 1000000);
+}
+
+void vTaskDelay(TickType_t xTicksToDelay) {
+    if (xTicksToDelay == 0) {
+        sched_yield();
+        return;
+    }
+    struct timespec deadline;
+    shim_deadline(xTicksToDelay, &deadline);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR) {
+    }
+}
+
+// ---- Critical sections ----
+
+static void critical_init(void) {
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&critical_lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+void shim_enter_critical(void) {
+    pthread_once(&critical_once, critical_init);
+    pthread_mutex_lock(&critical_lock);
+}
+
+void shim_exit_critical(void) {
+    pthread_mutex_unlock(&critical_lock);
+}
+
+// ---- Tasks ----
+
+static struct shim_task *task_alloc(const char *name) {
+    struct shim_task *task = calloc(1, sizeof(*task));
+    if (!task) {
+        return NULL;
+    }
+    strncpy(task->name, name, sizeof(task->name) - 1);
+    pthread_mutex_init(&task->lock, NULL);
+    shim_cond_init(&task->cond);
+    return task;
+}
+
+static void *task_entry(void *arg) {
+    struct shim_task *task = arg;
+    current_task = task;
+    task->code(task->params);
+    // A FreeRTOS task must not return; treat it as deleting itself
+    vTaskDelete(NULL);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t pxTaskCode, const char *pcName,
+                       uint32_t usStackDepth, void *pvParameters,
+                       UBaseType_t uxPriority, TaskHandle_t *pxCreatedTask) {
+    struct shim_task *task = task_alloc(pcName ? pcName : "");
+    if (!task) {
+        return pdFAIL;
+    }
+    task->code = pxTaskCode;
+    task->params = pvParameters;
+    task->priority = uxPriority;
+    task->stack_size = usStackDepth;
+
+    // The handle must be valid before the task can run and notify itself
+    if (pxCreatedTask) {
+        *pxCreatedTask = task;
+    }
+
+    task->stack_alloc = ((size_t)usStackDepth + STACK_HEADROOM + 4095) & ~(size_t)4095;
+    task->stack = aligned_alloc(4096, task->stack_alloc);
+    if (!task->stack) {
+        free(task);
+        return pdFAIL;
+    }
+    memset(task->stack, STACK_PAINT, task->stack_alloc);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_attr_setstack(&attr, task->stack, task->stack_alloc);
+    int err = pthread_create(&task->thread, &attr, task_entry, task);
+    pthread_attr_destroy(&attr);
+    if (err != 0) {
+        if (pxCreatedTask) {
+            *pxCreatedTask = NULL;
+        }
+        free(task->stack);
+        free(task);
+        return pdFAIL;
+    }
+    return pdPASS;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    if (!current_task) {
+        // main() or a shim thread: give it a handle on first use
+        char name[16] = "main";
+        pthread_getname_np(pthread_self(), name, sizeof(name));
+        current_task = task_alloc(name);
+        if (current_task) {
+            current_task->thread = pthread_self();
+            current_task->priority = 1;
+        }
+    }
+    return current_task;
+}
+
+void vTaskDelete(TaskHandle_t xTaskToDelete) {
+    if (xTaskToDelete && xTaskToDelete != current_task) {
+        // Threads cannot be killed safely; nothing in the firmware needs it
+        abort();
+    }
+    // The handle stays allocated: other tasks may still hold and notify it
+    pthread_exit(NULL);
+}
+
+const char *pcTaskGetName(TaskHandle_t xTaskToQuery) {
+    TaskHandle_t task = xTaskToQuery ? xTaskToQuery : xTaskGetCurrentTaskHandle();
+    return task ? task->name : "";
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t xTask) {
+    TaskHandle_t task = xTask ? xTask : xTaskGetCurrentTaskHandle();
+    return task ? task->priority : 0;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t xTask) {
+    TaskHandle_t task = xTask ? xTask : xTaskGetCurrentTaskHandle();
+    if (!task || !task->stack) {
+        return task ? task->stack_size : 0;
+    }
+    // Stacks grow down: untouched paint at the low end is what was never used
+    size_t untouched = 0;
+    while (untouched < task->stack_alloc && task->stack[untouched] == STACK_PAINT) {
+        untouched++;
+    }
+    size_t used = task->stack_alloc - untouched;
+    return used < task->stack_size ? (UBaseType_t)(task->stack_size - used) : 0;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t xTaskToNotify) {
+    pthread_mutex_lock(&xTaskToNotify->lock);
+    xTaskToNotify->notify_count++;
+    pthread_cond_signal(&xTaskToNotify->cond);
+    pthread_mutex_unlock(&xTaskToNotify->lock);
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t xTaskToNotify, BaseType_t *pxHigherPriorityTaskWoken) {
+    xTaskNotifyGive(xTaskToNotify);
+    if (pxHigherPriorityTaskWoken) {
+        *pxHigherPriorityTaskWoken = pdFALSE;
+    }
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait) {
+    struct shim_task *task = xTaskGetCurrentTaskHandle();
+    struct timespec deadline;
+    bool timed = shim_deadline(xTicksToWait, &deadline);
+
+    pthread_mutex_lock(&task->lock);
+    while (task->notify_count == 0 && xTicksToWait != 0) {
+        if (!cond_wait(&task->cond, &task->lock, timed, &deadline)) {
+            break;
+        }
+    }
+    uint32_t count = task->notify_count;
+    if (count > 0) {
+        task->notify_count = xClearCountOnExit ? 0 : count - 1;
+    }
+    pthread_mutex_unlock(&task->lock);
+    return count;
+}
+
+// ---- Queues ----
+
+struct shim_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t head;           // Oldest item
+    UBaseType_t count;
+    uint8_t *storage;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t uxQueueLength, UBaseType_t uxItemSize) {
+    struct shim_queue *queue = calloc(1, sizeof(*queue));
+    if (!queue) {
+        return NULL;
+    }
+    queue->storage = malloc((size_t)uxQueueLength * uxItemSize);
+    if (!queue->storage) {
+        free(queue);
+        return NULL;
+    }
+    queue->length = uxQueueLength;
+    queue->item_size = uxItemSize;
+    pthread_mutex_init(&queue->lock, NULL);
+    shim_cond_init(&queue->not_empty);
+    shim_cond_init(&queue->not_full);
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t xQueue) {
+    if (xQueue) {
+        pthread_mutex_destroy(&xQueue->lock);
+        pthread_cond_destroy(&xQueue->not_empty);
+        pthread_cond_destroy(&xQueue->not_full);
+        free(xQueue->storage);
+        free(xQueue);
+    }
+}
+
+static BaseType_t queue_send(QueueHandle_t queue, const void *item, TickType_t ticks, bool front) {
+    struct timespec deadline;
+    bool timed = shim_deadline(ticks, &deadline);
+    BaseType_t ret = errQUEUE_FULL;
+
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == queue->length && ticks != 0) {
+        if (!cond_wait(&queue->not_full, &queue->lock, timed, &deadline)) {
+            break;
+        }
+    }
+    if (queue->count < queue->length) {
+        UBaseType_t slot;
+        if (front) {
+            queue->head = (queue->head + queue->length - 1) % queue->length;
+            slot = queue->head;
+        } else {
+            slot = (queue->head + queue->count) % queue->length;
+        }
+        memcpy(queue->storage + (size_t)slot * queue->item_size, item, queue->item_size);
+        queue->count++;
+        pthread_cond_signal(&queue->not_empty);
+        ret = pdPASS;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return ret;
+}
+
+BaseType_t xQueueSend(QueueHandle_t xQueue, const void *pvItemToQueue, TickType_t xTicksToWait) {
+    return queue_send(xQueue, pvItemToQueue, xTicksToWait, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t xQueue, const void *pvItemToQueue, TickType_t xTicksToWait) {
+    return queue_send(xQueue, pvItemToQueue, xTicksToWait, true);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t xQueue, void *pvBuffer, TickType_t xTicksToWait) {
+    struct timespec deadline;
+    bool timed = shim_deadline(xTicksToWait, &deadline);
+    BaseType_t ret = pdFALSE;
+
+    pthread_mutex_lock(&xQueue->lock);
+    while (xQueue->count == 0 && xTicksToWait != 0) {
+        if (!cond_wait(&xQueue->not_empty, &xQueue->lock, timed, &deadline)) {
+            break;
+        }
+    }
+    if (xQueue->count > 0) {
+        memcpy(pvBuffer, xQueue->storage + (size_t)xQueue->head * xQueue->item_size,
+               xQueue->item_size);
+        xQueue->head = (xQueue->head + 1) % xQueue->length;
+        xQueue->count--;
+        pthread_cond_signal(&xQueue->not_full);
+        ret = pdPASS;
+    }
+    pthread_mutex_unlock(&xQueue->lock);
+    return ret;
+}
+
+BaseType_t xQueueReset(QueueHandle_t xQueue) {
+    pthread_mutex_lock(&xQueue->lock);
+    xQueue->head = 0;
+    xQueue->count = 0;
+    pthread_cond_broadcast(&xQueue->not_full);
+    pthread_mutex_unlock(&xQueue->lock);
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t xQueue) {
+    pthread_mutex_lock(&xQueue->lock);
+    UBaseType_t count = xQueue->count;
+    pthread_mutex_unlock(&xQueue->lock);
+    return count;
+}
+
+// ---- Semaphores ----
+
+struct shim_semaphore {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    UBaseType_t count;
+    UBaseType_t max_count;
+};
+
+SemaphoreHandle_t shim_semaphore_create(UBaseType_t max_count, UBaseType_t initial_count) {
+    struct shim_semaphore *sem = calloc(1, sizeof(*sem));
+    if (!sem) {
+        return NULL;
+    }
+    sem->count = initial_count;
+    sem->max_count = max_count;
+    pthread_mutex_init(&sem->lock, NULL);
+    shim_cond_init(&sem->cond);
+    return sem;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t xSemaphore) {
+    if (xSemaphore) {
+        pthread_mutex_destroy(&xSemaphore->lock);
+        pthread_cond_destroy(&xSemaphore->cond);
+        free(xSemaphore);
+    }
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t xSemaphore, TickType_t xBlockTime) {
+    struct timespec deadline;
+    bool timed = shim_deadline(xBlockTime, &deadline);
+    BaseType_t ret = pdFALSE;
+
+    pthread_mutex_lock(&xSemaphore->lock);
+    while (xSemaphore->count == 0 && xBlockTime != 0) {
+        if (!cond_wait(&xSemaphore->cond, &xSemaphore->lock, timed, &deadline)) {
+            break;
+        }
+    }
+    if (xSemaphore->count > 0) {
+        xSemaphore->count--;
+        ret = pdTRUE;
+    }
+    pthread_mutex_unlock(&xSemaphore->lock);
+    return ret;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t xSemaphore) {
+    BaseType_t ret = pdFALSE;
+    pthread_mutex_lock(&xSemaphore->lock);
+    if (xSemaphore->count < xSemaphore->max_count) {
+        xSemaphore->count++;
+        pthread_cond_signal(&xSemaphore->cond);
+        ret = pdTRUE;
+    }
+    pthread_mutex_unlock(&xSemaphore->lock);
+    return ret;
+}
+
+UBaseType_t uxSemaphoreGetCount(SemaphoreHandle_t xSemaphore) {
+    pthread_mutex_lock(&xSemaphore->lock);
+    UBaseType_t count = xSemaphore->count;
+    pthread_mutex_unlock(&xSemaphore->lock);
+    return count;
+}
+
+// ---- Event groups ----
+
+struct shim_event_group {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    EventBits_t bits;
+};
+
+EventGroupHandle_t xEventGroupCreate(void) {
+    struct shim_event_group *group = calloc(1, sizeof(*group));
+    if (!group) {
+        return NULL;
+    }
+    pthread_mutex_init(&group->lock, NULL);
+    shim_cond_init(&group->cond);
+    return group;
+}
+
+void vEventGroupDelete(EventGroupHandle_t xEventGroup) {
+    if (xEventGroup) {
+        pthread_mutex_destroy(&xEventGroup->lock);
+        pthread_cond_destroy(&xEventGroup->cond);
+        free(xEventGroup);
+    }
+}
+
+static bool bits_satisfied(EventBits_t bits, EventBits_t wanted, bool all) {
+    return all ? (bits & wanted) == wanted : (bits & wanted) != 0;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t xEventGroup, const EventBits_t uxBitsToWaitFor,
+                                const BaseType_t xClearOnExit, const BaseType_t xWaitForAllBits,
+                                TickType_t xTicksToWait) {
+    struct timespec deadline;
+    bool timed = shim_deadline(xTicksToWait, &deadline);
+
+    pthread_mutex_lock(&xEventGroup->lock);
+    while (!bits_satisfied(xEventGroup->bits, uxBitsToWaitFor, xWaitForAllBits) &&
+           xTicksToWait != 0) {
+        if (!cond_wait(&xEventGroup->cond, &xEventGroup->lock, timed, &deadline)) {
+            break;
+        }
+    }
+    // Like FreeRTOS: the bits as they were, cleared only on success
+    EventBits_t bits = xEventGroup->bits;
+    if (xClearOnExit && bits_satisfied(bits, uxBitsToWaitFor, xWaitForAllBits)) {
+        xEventGroup->bits &= ~uxBitsToWaitFor;
+    }
+    pthread_mutex_unlock(&xEventGroup->lock);
+    return bits;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t xEventGroup, const EventBits_t uxBitsToSet) {
+    pthread_mutex_lock(&xEventGroup->lock);
+    xEventGroup->bits |= uxBitsToSet;
+    EventBits_t bits = xEventGroup->bits;
+    pthread_cond_broadcast(&xEventGroup->cond);
+    pthread_mutex_unlock(&xEventGroup->lock);
+    return bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t xEventGroup, const EventBits_t uxBitsToClear) {
+    pthread_mutex_lock(&xEventGroup->lock);
+    EventBits_t bits = xEventGroup->bits;
+    xEventGroup->bits &= ~uxBitsToClear;
+    pthread_mutex_unlock(&xEventGroup->lock);
+    return bits;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t xEventGroup) {
+    pthread_mutex_lock(&xEventGroup->lock);
+    EventBits_t bits = xEventGroup->bits;
+    pthread_mutex_unlock(&xEventGroup->lock);
+    return bits;
+}
@@ -0,0 +1,727 @@
+// http_server.c - Host shim: esp_http_server over POSIX sockets
+//
+// Mirrors the parts of the IDF server the handlers depend on: one thread
+// serving sessions in turn from a select() loop, URI matching through
+// uri_match_fn with 404/405 answers, httpd_req_recv() with the
+// recv_wait_timeout and its HTTPD_SOCK_ERR_* results, any unread body
+// discarded after the handler, and the session closed when a handler
+// fails. Responses carry Content-Length or use chunked encoding.
+#include "esp_http_server.h"
+#include "esp_log.h"
+#include "shim_internal.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define HDR_BUF_LEN     (CONFIG_HTTPD_MAX_URI_LEN + CONFIG_HTTPD_MAX_REQ_HDR_LEN + 64)
+
+static const char *TAG = "httpd";
+
+typedef struct {
+    int fd;
+    int64_t last_used_us;
+    size_t carry_len;           // Bytes of the next request already read
+    char carry[HDR_BUF_LEN];
+} session_t;
+
+typedef struct {
+    httpd_config_t config;
+    int listen_fd;
+    int ctrl_pipe[2];
+    pthread_t thread;
+    volatile bool stop_requested;
+    httpd_uri_t *handlers;
+    int handler_count;
+    session_t *sessions;
+} server_t;
+
+typedef struct {
+    const char *field;
+    const char *value;
+} resp_hdr_t;
+
+// Per request state behind httpd_req_t.aux
+typedef struct {
+    server_t *server;
+    session_t *session;
+    const char *body;           // Body bytes that came with the headers
+    size_t body_len;
+    size_t remaining;           // Body bytes not yet handed to the handler
+    const char *query;          // After '?', NULL if none
+    const char *status;
+    const char *content_type;
+    resp_hdr_t *resp_hdrs;
+    int resp_hdr_count;
+    bool chunked;               // Chunked response headers are out
+    bool keep_alive;
+} req_aux_t;
+
+typedef struct {
+    httpd_err_code_t code;
+    const char *status;
+    const char *msg;
+} err_status_t;
+
+static const err_status_t err_statuses[] = {
+    { HTTPD_500_INTERNAL_SERVER_ERROR, "500 Internal Server Error", "Server has encountered an unexpected error" },
+    { HTTPD_501_METHOD_NOT_IMPLEMENTED, "501 Method Not Implemented", "Server does not support this method" },
+    { HTTPD_505_VERSION_NOT_SUPPORTED, "505 Version Not Supported", "HTTP version not supported by server" },
+    { HTTPD_400_BAD_REQUEST, "400 Bad Request", "Bad request syntax" },
+    { HTTPD_401_UNAUTHORIZED, "401 Unauthorized", "No permission -- see authorization schemes" },
+    { HTTPD_403_FORBIDDEN, "403 Forbidden", "Request forbidden -- authorization will not help" },
+    { HTTPD_404_NOT_FOUND, "404 Not Found", "Nothing matches the given URI" },
+    { HTTPD_405_METHOD_NOT_ALLOWED, "405 Method Not Allowed", "Specified method is invalid for this resource" },
+    { HTTPD_408_REQ_TIMEOUT, "408 Request Timeout", "Server closed this connection" },
+    { HTTPD_411_LENGTH_REQUIRED, "411 Length Required", "Client must specify Content-Length" },
+    { HTTPD_414_URI_TOO_LONG, "414 URI Too Long", "URI is too long" },
+    { HTTPD_431_REQ_HDR_FIELDS_TOO_LARGE, "431 Request Header Fields Too Large", "Header fields are too long" },
+};
+
+static const char *method_names[] = {
+    [HTTP_DELETE] = "DELETE",
+    [HTTP_GET] = "GET",
+    [HTTP_HEAD] = "HEAD",
+    [HTTP_POST] = "POST",
+    [HTTP_PUT] = "PUT",
+};
+
+// ---- Socket I/O ----
+
+static bool send_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        buf += n;
+        len -= n;
+    }
+    return true;
+}
+
+static void set_timeouts(int fd, const httpd_config_t *config) {
+    struct timeval rcv = { .tv_sec = config->recv_wait_timeout };
+    struct timeval snd = { .tv_sec = config->send_wait_timeout };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &rcv, sizeof(rcv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &snd, sizeof(snd));
+}
+
+// ---- Request side ----
+
+int httpd_req_recv(httpd_req_t *r, char *buf, size_t buf_len) {
+    req_aux_t *aux = r->aux;
+    if (aux->remaining == 0) {
+        return 0;
+    }
+    if (buf_len > aux->remaining) {
+        buf_len = aux->remaining;
+    }
+
+    if (aux->body_len > 0) {
+        size_t n = buf_len < aux->body_len ? buf_len : aux->body_len;
+        memcpy(buf, aux->body, n);
+        aux->body += n;
+        aux->body_len -= n;
+        aux->remaining -= n;
+        return n;
+    }
+
+    ssize_t n;
+    do {
+        n = recv(aux->session->fd, buf, buf_len, 0);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) {
+        return errno == EAGAIN || errno == EWOULDBLOCK ? HTTPD_SOCK_ERR_TIMEOUT : HTTPD_SOCK_ERR_FAIL;
+    }
+    aux->remaining -= n;
+    return n;
+}
+
+int httpd_req_to_sockfd(httpd_req_t *r) {
+    return r ? ((req_aux_t *)r->aux)->session->fd : -1;
+}
+
+size_t httpd_req_get_url_query_len(httpd_req_t *r) {
+    req_aux_t *aux = r->aux;
+    return aux->query ? strcspn(aux->query, "#") : 0;
+}
+
+esp_err_t httpd_req_get_url_query_str(httpd_req_t *r, char *buf, size_t buf_len) {
+    req_aux_t *aux = r->aux;
+    if (!aux->query) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (!buf || buf_len == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    size_t len = httpd_req_get_url_query_len(r);
+    bool truncated = len >= buf_len;
+    if (truncated) {
+        len = buf_len - 1;
+    }
+    memcpy(buf, aux->query, len);
+    buf[len] = '\0';
+    return truncated ? ESP_ERR_HTTPD_RESULT_TRUNC : ESP_OK;
+}
+
+esp_err_t httpd_query_key_value(const char *qry, const char *key, char *val, size_t val_size) {
+    if (!qry || !key || !val || val_size == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    size_t key_len = strlen(key);
+    const char *p = qry;
+    while (*p) {
+        const char *end = p + strcspn(p, "&");
+        if ((size_t)(end - p) > key_len && strncmp(p, key, key_len) == 0 && p[key_len] == '=') {
+            const char *v = p + key_len + 1;
+            size_t len = end - v;
+            bool truncated = len >= val_size;
+            if (truncated) {
+                len = val_size - 1;
+            }
+            memcpy(val, v, len);
+            val[len] = '\0';
+            return truncated ? ESP_ERR_HTTPD_RESULT_TRUNC : ESP_OK;
+        }
+        p = *end ? end + 1 : end;
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+// ---- Response side ----
+
+esp_err_t httpd_resp_set_status(httpd_req_t *r, const char *status) {
+    ((req_aux_t *)r->aux)->status = status;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t *r, const char *type) {
+    ((req_aux_t *)r->aux)->content_type = type;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_hdr(httpd_req_t *r, const char *field, const char *value) {
+    req_aux_t *aux = r->aux;
+    if (aux->resp_hdr_count >= aux->server->config.max_resp_headers) {
+        return ESP_ERR_HTTPD_RESP_HDR;
+    }
+    aux->resp_hdrs[aux->resp_hdr_count].field = field;
+    aux->resp_hdrs[aux->resp_hdr_count++].value = value;
+    return ESP_OK;
+}
+
+// Status line and headers; content_len < 0 selects chunked encoding
+static esp_err_t send_headers(req_aux_t *aux, ssize_t content_len) {
+    char hdr[HDR_BUF_LEN];
+    int n = snprintf(hdr, sizeof(hdr), "HTTP/1.1 %s\r\nContent-Type: %s\r\n",
+                     aux->status, aux->content_type);
+    if (content_len < 0) {
+        n += snprintf(hdr + n, sizeof(hdr) - n, "Transfer-Encoding: chunked\r\n");
+    } else {
+        n += snprintf(hdr + n, sizeof(hdr) - n, "Content-Length: %zd\r\n", content_len);
+    }
+    if (!aux->keep_alive) {
+        n += snprintf(hdr + n, sizeof(hdr) - n, "Connection: close\r\n");
+    }
+    for (int i = 0; i < aux->resp_hdr_count && n < (int)sizeof(hdr); i++) {
+        n += snprintf(hdr + n, sizeof(hdr) - n, "%s: %s\r\n",
+                      aux->resp_hdrs[i].field, aux->resp_hdrs[i].value);
+    }
+    n += snprintf(hdr + n, sizeof(hdr) - n, "\r\n");
+    if (n >= (int)sizeof(hdr)) {
+        return ESP_ERR_HTTPD_RESP_HDR;
+    }
+    return send_all(aux->session->fd, hdr, n) ? ESP_OK : ESP_ERR_HTTPD_RESP_SEND;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t *r, const char *buf, ssize_t buf_len) {
+    req_aux_t *aux = r->aux;
+    if (buf_len == HTTPD_RESP_USE_STRLEN) {
+        buf_len = buf ? strlen(buf) : 0;
+    }
+    esp_err_t ret = send_headers(aux, buf_len);
+    if (ret == ESP_OK && buf_len > 0 && !send_all(aux->session->fd, buf, buf_len)) {
+        ret = ESP_ERR_HTTPD_RESP_SEND;
+    }
+    return ret;
+}
+
+esp_err_t httpd_resp_send_chunk(httpd_req_t *r, const char *buf, ssize_t buf_len) {
+    req_aux_t *aux = r->aux;
+    if (buf_len == HTTPD_RESP_USE_STRLEN) {
+        buf_len = buf ? strlen(buf) : 0;
+    }
+    if (!aux->chunked) {
+        esp_err_t ret = send_headers(aux, -1);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        aux->chunked = true;
+    }
+
+    char size_line[16];
+    int n = snprintf(size_line, sizeof(size_line), "%zx\r\n", buf_len > 0 ? buf_len : 0);
+    bool ok = send_all(aux->session->fd, size_line, n);
+    if (ok && buf_len > 0) {
+        ok = send_all(aux->session->fd, buf, buf_len);
+    }
+    ok = ok && send_all(aux->session->fd, "\r\n", 2);
+    return ok ? ESP_OK : ESP_ERR_HTTPD_RESP_SEND;
+}
+
+esp_err_t httpd_resp_send_err(httpd_req_t *req, httpd_err_code_t error, const char *msg) {
+    const err_status_t *e = &err_statuses[0];
+    for (size_t i = 0; i < sizeof(err_statuses) / sizeof(err_statuses[0]); i++) {
+        if (err_statuses[i].code == error) {
+            e = &err_statuses[i];
+            break;
+        }
+    }
+    httpd_resp_set_status(req, e->status);
+    httpd_resp_set_type(req, HTTPD_TYPE_TEXT);
+    return httpd_resp_send(req, msg ? msg : e->msg, HTTPD_RESP_USE_STRLEN);
+}
+
+// ---- URI matching ----
+
+bool httpd_uri_match_wildcard(const char *uri_template, const char *uri_to_match, size_t match_upto) {
+    size_t tpl_len = strlen(uri_template);
+    size_t exact_len = tpl_len;
+    bool prefix = false;        // Template ends in '*': any continuation
+    bool optional = false;      // Template ends in '?' or '?*': last char optional
+
+    if (tpl_len > 0 && uri_template[tpl_len - 1] == '*') {
+        prefix = true;
+        exact_len--;
+    }
+    if (exact_len > 0 && uri_template[exact_len - 1] == '?') {
+        optional = true;
+        exact_len--;
+    }
+
+    // "/path/?" matches "/path" too: the character before '?' may be absent
+    if (optional && match_upto == exact_len - 1 &&
+        strncmp(uri_template, uri_to_match, exact_len - 1) == 0) {
+        return true;
+    }
+    if (match_upto < exact_len || strncmp(uri_template, uri_to_match, exact_len) != 0) {
+        return false;
+    }
+    return prefix || match_upto == exact_len;
+}
+
+static bool uri_matches(server_t *server, const httpd_uri_t *h, const char *uri, size_t path_len) {
+    if (server->config.uri_match_fn) {
+        return server->config.uri_match_fn(h->uri, uri, path_len);
+    }
+    return strlen(h->uri) == path_len && strncmp(h->uri, uri, path_len) == 0;
+}
+
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t *uri_handler) {
+    server_t *server = handle;
+    if (!server || !uri_handler || !uri_handler->uri || !uri_handler->handler) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < server->handler_count; i++) {
+        if (server->handlers[i].method == uri_handler->method &&
+            strcmp(server->handlers[i].uri, uri_handler->uri) == 0) {
+            ESP_LOGW(TAG, "handler %s already exists", uri_handler->uri);
+            return ESP_ERR_HTTPD_HANDLER_EXISTS;
+        }
+    }
+    if (server->handler_count >= server->config.max_uri_handlers) {
+        ESP_LOGW(TAG, "no slots left for registering handler");
+        return ESP_ERR_HTTPD_HANDLERS_FULL;
+    }
+    server->handlers[server->handler_count++] = *uri_handler;
+    return ESP_OK;
+}
+
+// ---- Sessions ----
+
+static void session_close(session_t *session) {
+    if (session->fd >= 0) {
+        close(session->fd);
+    }
+    session->fd = -1;
+    session->carry_len = 0;
+}
+
+// Fill buf with a complete header block; returns its length (through the
+// blank line), 0 if the peer closed, -1 on error, -2 if it does not fit
+static int read_header_block(session_t *session, char *buf, size_t *filled) {
+    while (1) {
+        buf[*filled] = '\0';
+        char *end = strstr(buf, "\r\n\r\n");
+        if (end) {
+            return (int)(end + 4 - buf);
+        }
+        if (*filled >= HDR_BUF_LEN - 1) {
+            return -2;
+        }
+        ssize_t n = recv(session->fd, buf + *filled, HDR_BUF_LEN - 1 - *filled, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n == 0) {
+            return 0;
+        }
+        if (n < 0) {
+            return -1;
+        }
+        *filled += n;
+    }
+}
+
+static int parse_method(const char *name) {
+    for (size_t i = 0; i < sizeof(method_names) / sizeof(method_names[0]); i++) {
+        if (method_names[i] && strcmp(method_names[i], name) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static void send_early_err(server_t *server, session_t *session, httpd_err_code_t error) {
+    httpd_req_t req = {0};
+    req_aux_t aux = {
+        .server = server,
+        .session = session,
+        .status = HTTPD_200,
+        .content_type = HTTPD_TYPE_TEXT,
+        .keep_alive = false,
+    };
+    req.aux = &aux;
+    httpd_resp_send_err(&req, error, NULL);
+}
+
+// Serve one request; false closes the session
+static bool session_serve(server_t *server, session_t *session) {
+    char buf[HDR_BUF_LEN + 1];
+    size_t filled = session->carry_len;
+    memcpy(buf, session->carry, filled);
+    session->carry_len = 0;
+
+    int hdr_len = read_header_block(session, buf, &filled);
+    if (hdr_len == -2) {
+        send_early_err(server, session, HTTPD_431_REQ_HDR_FIELDS_TOO_LARGE);
+        return false;
+    }
+    if (hdr_len <= 0) {
+        return false;
+    }
+    buf[hdr_len - 2] = '\0';    // Header block ends with its last CRLF
+
+    // Request line
+    char *line_end = strstr(buf, "\r\n");
+    *line_end = '\0';
+    char *method_str = buf;
+    char *uri = strchr(method_str, ' ');
+    char *version = uri ? strchr(uri + 1, ' ') : NULL;
+    if (!uri || !version || strncmp(version + 1, "HTTP/1.", 7) != 0) {
+        send_early_err(server, session, HTTPD_400_BAD_REQUEST);
+        return false;
+    }
+    *uri++ = '\0';
+    *version++ = '\0';
+    if (strlen(uri) > CONFIG_HTTPD_MAX_URI_LEN) {
+        send_early_err(server, session, HTTPD_414_URI_TOO_LONG);
+        return false;
+    }
+    int method = parse_method(method_str);
+
+    // Headers
+    size_t content_len = 0;
+    bool keep_alive = strcmp(version, "HTTP/1.0") != 0;
+    for (char *h = line_end + 2; *h; ) {
+        char *next = strstr(h, "\r\n");
+        if (next) {
+            *next = '\0';
+        }
+        char *colon = strchr(h, ':');
+        if (colon) {
+            *colon = '\0';
+            char *value = colon + 1;
+            while (*value == ' ' || *value == '\t') {
+                value++;
+            }
+            if (strcasecmp(h, "Content-Length") == 0) {
+                content_len = strtoul(value, NULL, 10);
+            } else if (strcasecmp(h, "Connection") == 0) {
+                keep_alive = strcasecmp(value, "close") != 0 &&
+                             (keep_alive || strcasecmp(value, "keep-alive") == 0);
+            } else if (strcasecmp(h, "Transfer-Encoding") == 0) {
+                send_early_err(server, session, HTTPD_411_LENGTH_REQUIRED);
+                return false;
+            }
+        }
+        if (!next) {
+            break;
+        }
+        h = next + 2;
+    }
+
+    resp_hdr_t resp_hdrs[server->config.max_resp_headers > 0 ? server->config.max_resp_headers : 1];
+    req_aux_t aux = {
+        .server = server,
+        .session = session,
+        .body = buf + hdr_len,
+        .body_len = filled - hdr_len,
+        .remaining = content_len,
+        .status = HTTPD_200,
+        .content_type = HTTPD_TYPE_TEXT,
+        .resp_hdrs = resp_hdrs,
+        .keep_alive = keep_alive,
+    };
+    // Bytes past this body are the start of the next request
+    if (aux.body_len > content_len) {
+        session->carry_len = aux.body_len - content_len;
+        memcpy(session->carry, aux.body + content_len, session->carry_len);
+        aux.body_len = content_len;
+    }
+
+    httpd_req_t req = {
+        .handle = server,
+        .method = method,
+        .content_len = content_len,
+        .aux = &aux,
+    };
+    snprintf((char *)req.uri, sizeof(req.uri), "%s", uri);
+    char *query = strchr(req.uri, '?');
+    aux.query = query ? query + 1 : NULL;
+    size_t path_len = query ? (size_t)(query - req.uri) : strlen(req.uri);
+
+    const httpd_uri_t *match = NULL;
+    bool path_matched = false;
+    for (int i = 0; i < server->handler_count && !match; i++) {
+        if (uri_matches(server, &server->handlers[i], req.uri, path_len)) {
+            path_matched = true;
+            if ((int)server->handlers[i].method == method) {
+                match = &server->handlers[i];
+            }
+        }
+    }
+
+    esp_err_t ret;
+    if (!match) {
+        ESP_LOGW(TAG, "URI '%s' not found", req.uri);
+        httpd_resp_send_err(&req, path_matched ? HTTPD_405_METHOD_NOT_ALLOWED : HTTPD_404_NOT_FOUND, NULL);
+        ret = ESP_FAIL;
+    } else {
+        req.user_ctx = match->user_ctx;
+        ret = match->handler(&req);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "uri handler execution failed");
+        }
+    }
+    if (ret != ESP_OK || !aux.keep_alive) {
+        return false;
+    }
+
+    // Discard what the handler left of the body
+    char discard[512];
+    while (aux.remaining > 0) {
+        int n = httpd_req_recv(&req, discard, sizeof(discard));
+        if (n <= 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// ---- Server thread ----
+
+static session_t *session_lru(server_t *server) {
+    session_t *lru = NULL;
+    for (int i = 0; i < server->config.max_open_sockets; i++) {
+        session_t *s = &server->sessions[i];
+        if (s->fd >= 0 && (!lru || s->last_used_us < lru->last_used_us)) {
+            lru = s;
+        }
+    }
+    return lru;
+}
+
+static session_t *session_free_slot(server_t *server) {
+    for (int i = 0; i < server->config.max_open_sockets; i++) {
+        if (server->sessions[i].fd < 0) {
+            return &server->sessions[i];
+        }
+    }
+    return NULL;
+}
+
+static void accept_session(server_t *server) {
+    session_t *slot = session_free_slot(server);
+    if (!slot && server->config.lru_purge_enable) {
+        slot = session_lru(server);
+        session_close(slot);
+    }
+    if (!slot) {
+        return;
+    }
+    int fd = accept4(server->listen_fd, NULL, NULL, SOCK_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    set_timeouts(fd, &server->config);
+    slot->fd = fd;
+    slot->carry_len = 0;
+    slot->last_used_us = shim_monotonic_us();
+}
+
+static void server_cleanup(server_t *server) {
+    for (int i = 0; i < server->config.max_open_sockets; i++) {
+        session_close(&server->sessions[i]);
+    }
+    close(server->listen_fd);
+    close(server->ctrl_pipe[0]);
+    close(server->ctrl_pipe[1]);
+    free(server->sessions);
+    free(server->handlers);
+    free(server);
+}
+
+static void *server_thread(void *arg) {
+    server_t *server = arg;
+    pthread_setname_np(pthread_self(), "httpd");
+
+    while (!server->stop_requested) {
+        fd_set fds;
+        FD_ZERO(&fds);
+        FD_SET(server->ctrl_pipe[0], &fds);
+        int max_fd = server->ctrl_pipe[0];
+        bool room = session_free_slot(server) || server->config.lru_purge_enable;
+        if (room) {
+            FD_SET(server->listen_fd, &fds);
+            max_fd = server->listen_fd > max_fd ? server->listen_fd : max_fd;
+        }
+        bool buffered = false;
+        for (int i = 0; i < server->config.max_open_sockets; i++) {
+            session_t *s = &server->sessions[i];
+            if (s->fd >= 0) {
+                FD_SET(s->fd, &fds);
+                max_fd = s->fd > max_fd ? s->fd : max_fd;
+                buffered |= s->carry_len > 0;
+            }
+        }
+
+        struct timeval poll_now = {0};
+        if (select(max_fd + 1, &fds, NULL, NULL, buffered ? &poll_now : NULL) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ESP_LOGE(TAG, "select failed: %s", strerror(errno));
+            break;
+        }
+        if (FD_ISSET(server->ctrl_pipe[0], &fds)) {
+            break;
+        }
+
+        for (int i = 0; i < server->config.max_open_sockets && !server->stop_requested; i++) {
+            session_t *s = &server->sessions[i];
+            if (s->fd >= 0 && (FD_ISSET(s->fd, &fds) || s->carry_len > 0)) {
+                s->last_used_us = shim_monotonic_us();
+                if (!session_serve(server, s)) {
+                    session_close(s);
+                }
+            }
+        }
+        if (room && FD_ISSET(server->listen_fd, &fds)) {
+            accept_session(server);
+        }
+    }
+
+    server_cleanup(server);
+    return NULL;
+}
+
+esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config) {
+    if (!handle || !config || config->max_open_sockets == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    server_t *server = calloc(1, sizeof(*server));
+    if (!server) {
+        return ESP_ERR_HTTPD_ALLOC_MEM;
+    }
+    server->config = *config;
+    if (shim_options.http_port) {
+        server->config.server_port = shim_options.http_port;
+    }
+    server->handlers = calloc(config->max_uri_handlers, sizeof(httpd_uri_t));
+    server->sessions = calloc(config->max_open_sockets, sizeof(session_t));
+    if (!server->handlers || !server->sessions || pipe2(server->ctrl_pipe, O_CLOEXEC) != 0) {
+        free(server->handlers);
+        free(server->sessions);
+        free(server);
+        return ESP_ERR_HTTPD_ALLOC_MEM;
+    }
+    for (int i = 0; i < config->max_open_sockets; i++) {
+        server->sessions[i].fd = -1;
+    }
+
+    server->listen_fd = socket(AF_INET6, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int one = 1, zero = 0;
+    setsockopt(server->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    setsockopt(server->listen_fd, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero));
+    struct sockaddr_in6 addr = {
+        .sin6_family = AF_INET6,
+        .sin6_addr = in6addr_any,
+        .sin6_port = htons(server->config.server_port),
+    };
+    if (server->listen_fd < 0 ||
+        bind(server->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(server->listen_fd, config->backlog_conn) != 0) {
+        ESP_LOGE(TAG, "Cannot listen on port %u: %s", server->config.server_port, strerror(errno));
+        if (server->listen_fd >= 0) {
+            close(server->listen_fd);
+        }
+        close(server->ctrl_pipe[0]);
+        close(server->ctrl_pipe[1]);
+        free(server->handlers);
+        free(server->sessions);
+        free(server);
+        return ESP_ERR_HTTPD_TASK;
+    }
+
+    if (pthread_create(&server->thread, NULL, server_thread, server) != 0) {
+        server_cleanup(server);
+        return ESP_ERR_HTTPD_TASK;
+    }
+    ESP_LOGI(TAG, "Listening on port %u", server->config.server_port);
+    *handle = server;
+    return ESP_OK;
+}
+
+esp_err_t httpd_stop(httpd_handle_t handle) {
+    server_t *server = handle;
+    if (!server) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    server->stop_requested = true;
+    if (pthread_equal(pthread_self(), server->thread)) {
+        // Called from a handler: the loop ends and cleans up after it returns
+        pthread_detach(server->thread);
+        return ESP_OK;
+    }
+    if (write(server->ctrl_pipe[1], "x", 1) < 0) {
+        return ESP_FAIL;
+    }
+    pthread_join(server->thread, NULL);
+    return ESP_OK;
+}
@@ -0,0 +1,229 @@
+// nvs.c - Host shim: NVS namespaces as directories, keys as files
+//
+// Writes go straight to the file, so nvs_commit() has nothing to flush;
+// the firmware's own commit calls are kept for the device.
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "shim_internal.h"
+#include <dirent.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define NVS_MAX_HANDLES     16
+
+typedef struct {
+    bool used;
+    bool writable;
+    char dir[256];
+} nvs_slot_t;
+
+static nvs_slot_t slots[NVS_MAX_HANDLES];
+static bool nvs_ready = false;
+static pthread_mutex_t nvs_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void remove_tree(const char *path) {
+    DIR *dir = opendir(path);
+    if (!dir) {
+        unlink(path);
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        char child[512];
+        snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+        remove_tree(child);
+    }
+    closedir(dir);
+    rmdir(path);
+}
+
+esp_err_t nvs_flash_init(void) {
+    char path[256];
+    shim_data_path(path, sizeof(path), "nvs");
+    if (shim_mkdirs(path, true) != 0) {
+        return ESP_ERR_NVS_NO_FREE_PAGES;
+    }
+    nvs_ready = true;
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void) {
+    char path[256];
+    remove_tree(shim_data_path(path, sizeof(path), "nvs"));
+    nvs_ready = false;
+    return ESP_OK;
+}
+
+static nvs_slot_t *slot_get(nvs_handle_t handle) {
+    if (handle == 0 || handle > NVS_MAX_HANDLES || !slots[handle - 1].used) {
+        return NULL;
+    }
+    return &slots[handle - 1];
+}
+
+static bool key_valid(const char *key) {
+    return key && key[0] && strlen(key) < NVS_KEY_NAME_MAX_SIZE && !strchr(key, '/');
+}
+
+esp_err_t nvs_open(const char *namespace_name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle) {
+    if (!nvs_ready) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+    if (!key_valid(namespace_name)) {
+        return ESP_ERR_NVS_INVALID_NAME;
+    }
+
+    char sub[64], dir[256];
+    snprintf(sub, sizeof(sub), "nvs/%s", namespace_name);
+    shim_data_path(dir, sizeof(dir), sub);
+
+    struct stat st;
+    if (stat(dir, &st) != 0) {
+        // As on the device, reading a namespace nobody wrote is an error
+        if (open_mode == NVS_READONLY) {
+            return ESP_ERR_NVS_NOT_FOUND;
+        }
+        if (shim_mkdirs(dir, true) != 0) {
+            return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+        }
+    }
+
+    esp_err_t ret = ESP_ERR_NO_MEM;
+    pthread_mutex_lock(&nvs_lock);
+    for (int i = 0; i < NVS_MAX_HANDLES; i++) {
+        if (!slots[i].used) {
+            slots[i].used = true;
+            slots[i].writable = open_mode == NVS_READWRITE;
+            snprintf(slots[i].dir, sizeof(slots[i].dir), "%s", dir);
+            *out_handle = i + 1;
+            ret = ESP_OK;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&nvs_lock);
+    return ret;
+}
+
+void nvs_close(nvs_handle_t handle) {
+    pthread_mutex_lock(&nvs_lock);
+    nvs_slot_t *slot = slot_get(handle);
+    if (slot) {
+        slot->used = false;
+    }
+    pthread_mutex_unlock(&nvs_lock);
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+    return slot_get(handle) ? ESP_OK : ESP_ERR_NVS_INVALID_HANDLE;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length) {
+    nvs_slot_t *slot = slot_get(handle);
+    if (!slot) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    if (!key_valid(key)) {
+        return ESP_ERR_NVS_INVALID_NAME;
+    }
+
+    char path[300];
+    snprintf(path, sizeof(path), "%s/%s", slot->dir, key);
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    // NULL out_value asks for the stored size, as in IDF
+    if (!out_value) {
+        *length = st.st_size;
+        return ESP_OK;
+    }
+    if (*length < (size_t)st.st_size) {
+        *length = st.st_size;
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    size_t n = fread(out_value, 1, st.st_size, f);
+    fclose(f);
+    *length = n;
+    return n == (size_t)st.st_size ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length) {
+    nvs_slot_t *slot = slot_get(handle);
+    if (!slot) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    if (!slot->writable) {
+        return ESP_ERR_NVS_READ_ONLY;
+    }
+    if (!key_valid(key)) {
+        return ESP_ERR_NVS_INVALID_NAME;
+    }
+
+    // Write then rename, so a crash never leaves half a blob
+    char path[300], tmp[310];
+    snprintf(path, sizeof(path), "%s/%s", slot->dir, key);
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "wb");
+    if (!f) {
+        return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    }
+    bool ok = fwrite(value, 1, length, f) == length;
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp, path) != 0) {
+        unlink(tmp);
+        return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    }
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *out_value) {
+    size_t len = sizeof(*out_value);
+    esp_err_t ret = nvs_get_blob(handle, key, out_value, &len);
+    if (ret == ESP_OK && len != sizeof(*out_value)) {
+        ret = ESP_ERR_NVS_TYPE_MISMATCH;
+    }
+    return ret == ESP_ERR_NVS_INVALID_LENGTH ? ESP_ERR_NVS_TYPE_MISMATCH : ret;
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value) {
+    return nvs_set_blob(handle, key, &value, sizeof(value));
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key) {
+    nvs_slot_t *slot = slot_get(handle);
+    if (!slot) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    if (!slot->writable) {
+        return ESP_ERR_NVS_READ_ONLY;
+    }
+    char path[300];
+    snprintf(path, sizeof(path), "%s/%s", slot->dir, key);
+    return unlink(path) == 0 ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle) {
+    nvs_slot_t *slot = slot_get(handle);
+    if (!slot) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    if (!slot->writable) {
+        return ESP_ERR_NVS_READ_ONLY;
+    }
+    remove_tree(slot->dir);
+    shim_mkdirs(slot->dir, true);
+    return ESP_OK;
+}
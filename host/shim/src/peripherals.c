@@ -0,0 +1,331 @@
+// peripherals.c - Host shim: GPIO levels, the battery ADC and raw registers
+#include "driver/gpio.h"
+#include "soc/gpio_reg.h"
+#include "soc/system_reg.h"
+#include "soc/apb_saradc_reg.h"
+#include "esp_adc/adc_continuous.h"
+#include "esp_adc/adc_cali.h"
+#include "esp_adc/adc_cali_scheme.h"
+#include "shim_internal.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// XIAO ESP32-C3 battery input: 1:2 divider in front of a 0-3300 mV ADC
+#define ADC_DIVIDER         2
+#define ADC_FULL_SCALE_MV   3300
+#define ADC_MAX_RAW         4095
+
+// Raw code of the --battery-mv voltage on the battery channel
+static uint32_t battery_raw(void) {
+    uint32_t raw = shim_options.battery_mv / ADC_DIVIDER * ADC_MAX_RAW / ADC_FULL_SCALE_MV;
+    return raw > ADC_MAX_RAW ? ADC_MAX_RAW : raw;
+}
+
+// ---- GPIO ----
+
+static volatile uint32_t gpio_out = 0;
+static volatile uint32_t gpio_enable = 0;
+static volatile uint32_t gpio_pullup = 0;
+
+static void gpio_reg_write(uint32_t reg, uint32_t val) {
+    switch (reg) {
+        case GPIO_OUT_REG:          gpio_out = val; break;
+        case GPIO_OUT_W1TS_REG:     gpio_out |= val; break;
+        case GPIO_OUT_W1TC_REG:     gpio_out &= ~val; break;
+        case GPIO_ENABLE_REG:       gpio_enable = val; break;
+        case GPIO_ENABLE_W1TS_REG:  gpio_enable |= val; break;
+        case GPIO_ENABLE_W1TC_REG:  gpio_enable &= ~val; break;
+        default: break;
+    }
+}
+
+static uint32_t gpio_reg_read(uint32_t reg) {
+    switch (reg) {
+        case GPIO_OUT_REG:      return gpio_out;
+        case GPIO_ENABLE_REG:   return gpio_enable;
+        // Driven pins read back their level, released ones their pull
+        case GPIO_IN_REG:       return (gpio_out & gpio_enable) | (gpio_pullup & ~gpio_enable);
+        default:                return 0;
+    }
+}
+
+static esp_err_t pin_check(gpio_num_t gpio_num) {
+    return gpio_num >= 0 && gpio_num < GPIO_NUM_MAX ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t gpio_config(const gpio_config_t *pGPIOConfig) {
+    for (int pin = 0; pin < GPIO_NUM_MAX; pin++) {
+        if (pGPIOConfig->pin_bit_mask & (1ULL << pin)) {
+            gpio_set_direction(pin, pGPIOConfig->mode);
+            if (pGPIOConfig->pull_up_en) {
+                gpio_set_pull_mode(pin, GPIO_PULLUP_ONLY);
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t gpio_reset_pin(gpio_num_t gpio_num) {
+    esp_err_t ret = pin_check(gpio_num);
+    if (ret == ESP_OK) {
+        gpio_set_direction(gpio_num, GPIO_MODE_INPUT);
+        gpio_set_pull_mode(gpio_num, GPIO_PULLUP_ONLY);
+    }
+    return ret;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode) {
+    esp_err_t ret = pin_check(gpio_num);
+    if (ret == ESP_OK) {
+        gpio_reg_write(mode & GPIO_MODE_OUTPUT ? GPIO_ENABLE_W1TS_REG : GPIO_ENABLE_W1TC_REG,
+                            1u << gpio_num);
+    }
+    return ret;
+}
+
+esp_err_t gpio_set_pull_mode(gpio_num_t gpio_num, gpio_pull_mode_t pull) {
+    esp_err_t ret = pin_check(gpio_num);
+    if (ret == ESP_OK) {
+        if (pull == GPIO_PULLUP_ONLY || pull == GPIO_PULLUP_PULLDOWN) {
+            gpio_pullup |= 1u << gpio_num;
+        } else {
+            gpio_pullup &= ~(1u << gpio_num);
+        }
+    }
+    return ret;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level) {
+    esp_err_t ret = pin_check(gpio_num);
+    if (ret == ESP_OK) {
+        gpio_reg_write(level ? GPIO_OUT_W1TS_REG : GPIO_OUT_W1TC_REG, 1u << gpio_num);
+    }
+    return ret;
+}
+
+int gpio_get_level(gpio_num_t gpio_num) {
+    if (pin_check(gpio_num) != ESP_OK) {
+        return 0;
+    }
+    return (gpio_reg_read(GPIO_IN_REG) >> gpio_num) & 1;
+}
+
+esp_err_t gpio_hold_en(gpio_num_t gpio_num) {
+    return pin_check(gpio_num);
+}
+
+esp_err_t gpio_hold_dis(gpio_num_t gpio_num) {
+    return pin_check(gpio_num);
+}
+
+void gpio_deep_sleep_hold_en(void) {
+}
+
+void gpio_deep_sleep_hold_dis(void) {
+}
+
+// ---- Continuous ADC ----
+
+struct adc_continuous_ctx_t {
+    pthread_mutex_t lock;
+    bool started;
+    uint32_t sample_freq_hz;
+    adc_digi_pattern_config_t pattern;
+};
+
+esp_err_t adc_continuous_new_handle(const adc_continuous_handle_cfg_t *hdl_config,
+                                    adc_continuous_handle_t *ret_handle) {
+    struct adc_continuous_ctx_t *ctx = calloc(1, sizeof(*ctx));
+    if (!ctx) {
+        return ESP_ERR_NO_MEM;
+    }
+    pthread_mutex_init(&ctx->lock, NULL);
+    ctx->sample_freq_hz = SOC_ADC_SAMPLE_FREQ_THRES_LOW;
+    *ret_handle = ctx;
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_config(adc_continuous_handle_t handle, const adc_continuous_config_t *config) {
+    if (!handle || !config || config->pattern_num != 1 ||
+        config->sample_freq_hz < SOC_ADC_SAMPLE_FREQ_THRES_LOW ||
+        config->sample_freq_hz > SOC_ADC_SAMPLE_FREQ_THRES_HIGH) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    handle->pattern = config->adc_pattern[0];
+    handle->sample_freq_hz = config->sample_freq_hz;
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_start(adc_continuous_handle_t handle) {
+    pthread_mutex_lock(&handle->lock);
+    esp_err_t ret = handle->started ? ESP_ERR_INVALID_STATE : ESP_OK;
+    handle->started = true;
+    pthread_mutex_unlock(&handle->lock);
+    return ret;
+}
+
+esp_err_t adc_continuous_stop(adc_continuous_handle_t handle) {
+    pthread_mutex_lock(&handle->lock);
+    esp_err_t ret = handle->started ? ESP_OK : ESP_ERR_INVALID_STATE;
+    handle->started = false;
+    pthread_mutex_unlock(&handle->lock);
+    return ret;
+}
+
+// A stopped converter has nothing buffered: reads time out, which ends the
+// caller's drain loop. A running one delivers a frame per frame time.
+esp_err_t adc_continuous_read(adc_continuous_handle_t handle, uint8_t *buf, uint32_t length_max,
+                              uint32_t *out_length, uint32_t timeout_ms) {
+    pthread_mutex_lock(&handle->lock);
+    bool started = handle->started;
+    adc_digi_pattern_config_t pattern = handle->pattern;
+    uint32_t freq = handle->sample_freq_hz;
+    pthread_mutex_unlock(&handle->lock);
+
+    *out_length = 0;
+    if (!started) {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    uint32_t samples = length_max / SOC_ADC_DIGI_RESULT_BYTES;
+    uint64_t frame_us = (uint64_t)samples * 1000000 / freq;
+    if (frame_us > (uint64_t)timeout_ms * 1000) {
+        samples = (uint32_t)((uint64_t)timeout_ms * freq / 1000);
+        frame_us = (uint64_t)timeout_ms * 1000;
+    }
+    struct timespec ts = { .tv_sec = frame_us / 1000000, .tv_nsec = (frame_us % 1000000) * 1000 };
+    nanosleep(&ts, NULL);
+    if (samples == 0) {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    uint32_t raw = battery_raw();
+    for (uint32_t i = 0; i < samples; i++) {
+        adc_digi_output_data_t out = {0};
+        out.type2.data = raw;
+        out.type2.channel = pattern.channel;
+        out.type2.unit = pattern.unit;
+        memcpy(buf + i * SOC_ADC_DIGI_RESULT_BYTES, &out, SOC_ADC_DIGI_RESULT_BYTES);
+    }
+    *out_length = samples * SOC_ADC_DIGI_RESULT_BYTES;
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_deinit(adc_continuous_handle_t handle) {
+    if (!handle) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    pthread_mutex_destroy(&handle->lock);
+    free(handle);
+    return ESP_OK;
+}
+
+// ---- Calibration ----
+
+struct adc_cali_scheme_t {
+    adc_unit_t unit;
+};
+
+esp_err_t adc_cali_create_scheme_curve_fitting(const adc_cali_curve_fitting_config_t *config,
+                                               adc_cali_handle_t *ret_handle) {
+    struct adc_cali_scheme_t *cali = calloc(1, sizeof(*cali));
+    if (!cali) {
+        return ESP_ERR_NO_MEM;
+    }
+    cali->unit = config->unit_id;
+    *ret_handle = cali;
+    return ESP_OK;
+}
+
+esp_err_t adc_cali_delete_scheme_curve_fitting(adc_cali_handle_t handle) {
+    free(handle);
+    return ESP_OK;
+}
+
+esp_err_t adc_cali_raw_to_voltage(adc_cali_handle_t handle, int raw, int *voltage) {
+    if (!handle || !voltage) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *voltage = raw * ADC_FULL_SCALE_MV / ADC_MAX_RAW;
+    return ESP_OK;
+}
+
+// ---- Raw registers (soc/soc.h) ----
+
+#define REG_FILE_SIZE   32
+
+static struct {
+    uint32_t addr;
+    uint32_t val;
+} reg_file[REG_FILE_SIZE];
+static int reg_count = 0;
+static pthread_mutex_t reg_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint32_t *reg_slot(uint32_t addr) {
+    for (int i = 0; i < reg_count; i++) {
+        if (reg_file[i].addr == addr) {
+            return &reg_file[i].val;
+        }
+    }
+    if (reg_count == REG_FILE_SIZE) {
+        return NULL;
+    }
+    reg_file[reg_count].addr = addr;
+    reg_file[reg_count].val = 0;
+    return &reg_file[reg_count++].val;
+}
+
+static void reg_store(uint32_t addr, uint32_t val) {
+    uint32_t *slot = reg_slot(addr);
+    if (slot) {
+        *slot = val;
+    }
+}
+
+static uint32_t reg_load(uint32_t addr) {
+    uint32_t *slot = reg_slot(addr);
+    return slot ? *slot : 0;
+}
+
+// A one-shot ADC1 start converts at once if the SAR ADC is clocked
+static void saradc_reg_write(uint32_t addr, uint32_t val) {
+    if (addr == APB_SARADC_INT_CLR_REG) {
+        reg_store(APB_SARADC_INT_RAW_REG, reg_load(APB_SARADC_INT_RAW_REG) & ~val);
+        return;
+    }
+    uint32_t old = reg_load(addr);
+    reg_store(addr, val);
+    if (addr == APB_SARADC_ONETIME_SAMPLE_REG && (val & APB_SARADC_ONETIME_START) &&
+        !(old & APB_SARADC_ONETIME_START) && (val & APB_SARADC1_ONETIME_SAMPLE) &&
+        (reg_load(SYSTEM_PERIP_CLK_EN0_REG) & SYSTEM_APB_SARADC_CLK_EN)) {
+        reg_store(APB_SARADC_1_DATA_STATUS_REG, battery_raw());
+        reg_store(APB_SARADC_INT_RAW_REG,
+                  reg_load(APB_SARADC_INT_RAW_REG) | APB_SARADC_ADC1_DONE_INT_RAW);
+    }
+}
+
+void shim_reg_write(uint32_t addr, uint32_t val) {
+    if (addr >= DR_REG_GPIO_BASE && addr < DR_REG_GPIO_BASE + 0x1000) {
+        gpio_reg_write(addr, val);
+        return;
+    }
+    pthread_mutex_lock(&reg_lock);
+    if (addr >= DR_REG_APB_SARADC_BASE && addr < DR_REG_APB_SARADC_BASE + 0x1000) {
+        saradc_reg_write(addr, val);
+    } else {
+        reg_store(addr, val);
+    }
+    pthread_mutex_unlock(&reg_lock);
+}
+
+uint32_t shim_reg_read(uint32_t addr) {
+    if (addr >= DR_REG_GPIO_BASE && addr < DR_REG_GPIO_BASE + 0x1000) {
+        return gpio_reg_read(addr);
+    }
+    pthread_mutex_lock(&reg_lock);
+    uint32_t val = reg_load(addr);
+    pthread_mutex_unlock(&reg_lock);
+    return val;
+}
@@ -0,0 +1,39 @@
+// shim_internal.h - Shared state of the host shim (not an ESP-IDF header)
+#ifndef SHIM_INTERNAL_H
+#define SHIM_INTERNAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+#include <pthread.h>
+#include "freertos/FreeRTOS.h"
+
+// Command line settings, filled in by host_main.c before app_main()
+typedef struct {
+    uint16_t http_port;         // Replaces the server_port main.c asks for
+    const char *data_dir;       // NVS, partitions and SPIFFS files live here
+    uint32_t battery_mv;        // Battery voltage the ADC reports
+    uint32_t heap_kb;           // Heap the device would have free at boot
+    char **argv;                // For the re-exec of esp_restart()/deep sleep
+} shim_options_t;
+
+extern shim_options_t shim_options;
+
+// Restores RTC memory after a simulated deep sleep and settles the reset
+// reason; call once before anything else runs
+void shim_system_init(void);
+
+int64_t shim_monotonic_us(void);
+
+// Absolute CLOCK_MONOTONIC deadline ticks from now; false for portMAX_DELAY
+bool shim_deadline(TickType_t ticks, struct timespec *deadline);
+
+// Condition variable waiting on CLOCK_MONOTONIC
+void shim_cond_init(pthread_cond_t *cond);
+
+// "<data_dir>/<sub>" into buf; creates the parent directories of the path
+const char *shim_data_path(char *buf, size_t len, const char *sub);
+int shim_mkdirs(const char *path, bool include_last);
+
+#endif // SHIM_INTERNAL_H
@@ -0,0 +1,218 @@
+// vfs.c - Host shim: SPIFFS mount points redirected into the data directory
+//
+// On the device the VFS layer routes "/storage/..." to SPIFFS. Here the
+// link wraps the few libc calls the firmware makes on such paths
+// (-Wl,--wrap, see CMakeLists.txt) and rewrites the mount prefix to
+// "<data>/<label>". SPIFFS has no directories - "/storage/sim/x" is just
+// a long name - so opening for write creates whatever directories the
+// rewritten path needs.
+#include "esp_spiffs.h"
+#include "esp_partition.h"
+#include "esp_log.h"
+#include "shim_internal.h"
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define VFS_MAX_MOUNTS  2
+
+static const char *TAG = "HOST_VFS";
+
+typedef struct {
+    char base_path[32];
+    char label[17];
+    char host_dir[200];
+    size_t total_bytes;
+} vfs_mount_t;
+
+static vfs_mount_t mounts[VFS_MAX_MOUNTS];
+static int mount_count = 0;
+
+FILE *__real_fopen(const char *path, const char *mode);
+DIR *__real_opendir(const char *name);
+int __real_stat(const char *path, struct stat *st);
+int __real_unlink(const char *path);
+int __real_remove(const char *path);
+int __real_rename(const char *oldpath, const char *newpath);
+int __real_mkdir(const char *path, mode_t mode);
+
+// ---- Data directory helpers ----
+
+int shim_mkdirs(const char *path, bool include_last) {
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s", path);
+    for (char *p = buf + 1; *p; p++) {
+        if (*p == '/') {
+            *p = '\0';
+            if (__real_mkdir(buf, 0755) != 0 && errno != EEXIST) {
+                return -1;
+            }
+            *p = '/';
+        }
+    }
+    if (include_last && __real_mkdir(buf, 0755) != 0 && errno != EEXIST) {
+        return -1;
+    }
+    return 0;
+}
+
+const char *shim_data_path(char *buf, size_t len, const char *sub) {
+    snprintf(buf, len, "%s/%s", shim_options.data_dir, sub);
+    shim_mkdirs(buf, false);
+    return buf;
+}
+
+// ---- Path translation ----
+
+// Host path for a mounted path, or NULL if it is not under a mount point
+static const char *translate(const char *path, char *buf, size_t len) {
+    if (!path) {
+        return NULL;
+    }
+    for (int i = 0; i < mount_count; i++) {
+        size_t n = strlen(mounts[i].base_path);
+        if (strncmp(path, mounts[i].base_path, n) == 0 && (path[n] == '/' || path[n] == '\0')) {
+            snprintf(buf, len, "%s%s", mounts[i].host_dir, path + n);
+            return buf;
+        }
+    }
+    return NULL;
+}
+
+FILE *__wrap_fopen(const char *path, const char *mode) {
+    char buf[256];
+    const char *host = translate(path, buf, sizeof(buf));
+    if (!host) {
+        return __real_fopen(path, mode);
+    }
+    if (strpbrk(mode, "wa")) {
+        shim_mkdirs(host, false);
+    }
+    return __real_fopen(host, mode);
+}
+
+DIR *__wrap_opendir(const char *name) {
+    char buf[256];
+    const char *host = translate(name, buf, sizeof(buf));
+    if (!host) {
+        return __real_opendir(name);
+    }
+    // Every "directory" exists on SPIFFS; it lists the names with that prefix
+    shim_mkdirs(host, true);
+    return __real_opendir(host);
+}
+
+int __wrap_stat(const char *path, struct stat *st) {
+    char buf[256];
+    const char *host = translate(path, buf, sizeof(buf));
+    return __real_stat(host ? host : path, st);
+}
+
+int __wrap_unlink(const char *path) {
+    char buf[256];
+    const char *host = translate(path, buf, sizeof(buf));
+    return __real_unlink(host ? host : path);
+}
+
+int __wrap_remove(const char *path) {
+    char buf[256];
+    const char *host = translate(path, buf, sizeof(buf));
+    return __real_remove(host ? host : path);
+}
+
+int __wrap_rename(const char *oldpath, const char *newpath) {
+    char old_buf[256], new_buf[256];
+    const char *old_host = translate(oldpath, old_buf, sizeof(old_buf));
+    const char *new_host = translate(newpath, new_buf, sizeof(new_buf));
+    if (new_host) {
+        shim_mkdirs(new_host, false);
+    }
+    return __real_rename(old_host ? old_host : oldpath, new_host ? new_host : newpath);
+}
+
+int __wrap_mkdir(const char *path, mode_t mode) {
+    char buf[256];
+    const char *host = translate(path, buf, sizeof(buf));
+    return __real_mkdir(host ? host : path, mode);
+}
+
+// ---- SPIFFS ----
+
+esp_err_t esp_vfs_spiffs_register(const esp_vfs_spiffs_conf_t *conf) {
+    if (!conf || !conf->base_path) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (mount_count == VFS_MAX_MOUNTS) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    const char *label = conf->partition_label ? conf->partition_label : "spiffs";
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                           ESP_PARTITION_SUBTYPE_DATA_SPIFFS,
+                                                           conf->partition_label);
+    if (!part) {
+        ESP_LOGE(TAG, "No SPIFFS partition '%s' in the partition table", label);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    vfs_mount_t *m = &mounts[mount_count];
+    snprintf(m->base_path, sizeof(m->base_path), "%s", conf->base_path);
+    snprintf(m->label, sizeof(m->label), "%s", label);
+    snprintf(m->host_dir, sizeof(m->host_dir), "%s/%s", shim_options.data_dir, label);
+    m->total_bytes = part->size;
+    if (shim_mkdirs(m->host_dir, true) != 0) {
+        ESP_LOGE(TAG, "Cannot create %s", m->host_dir);
+        return ESP_FAIL;
+    }
+    mount_count++;
+    ESP_LOGI(TAG, "%s mounted on %s", m->base_path, m->host_dir);
+    return ESP_OK;
+}
+
+esp_err_t esp_vfs_spiffs_unregister(const char *partition_label) {
+    for (int i = 0; i < mount_count; i++) {
+        if (!partition_label || strcmp(mounts[i].label, partition_label) == 0) {
+            mounts[i] = mounts[--mount_count];
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_INVALID_STATE;
+}
+
+static size_t dir_bytes(const char *path) {
+    size_t total = 0;
+    DIR *dir = __real_opendir(path);
+    if (!dir) {
+        return 0;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        char child[512];
+        struct stat st;
+        snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+        if (__real_stat(child, &st) != 0) {
+            continue;
+        }
+        total += S_ISDIR(st.st_mode) ? dir_bytes(child) : (size_t)st.st_size;
+    }
+    closedir(dir);
+    return total;
+}
+
+esp_err_t esp_spiffs_info(const char *partition_label, size_t *total_bytes, size_t *used_bytes) {
+    for (int i = 0; i < mount_count; i++) {
+        if (!partition_label || strcmp(mounts[i].label, partition_label) == 0) {
+            *total_bytes = mounts[i].total_bytes;
+            *used_bytes = dir_bytes(mounts[i].host_dir);
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_INVALID_STATE;
+}
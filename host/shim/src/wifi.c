@@ -0,0 +1,551 @@
+// wifi.c - Host shim: event loop, station interface and WiFi driver
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "esp_wifi.h"
+#include "esp_mac.h"
+#include "esp_log.h"
+#include "config.h"
+#include "shim_internal.h"
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SCAN_MAX_RECORDS    2
+#define AP_CHANNEL          6
+
+static const char *TAG = "HOST_WIFI";
+
+ESP_EVENT_DEFINE_BASE(WIFI_EVENT);
+ESP_EVENT_DEFINE_BASE(IP_EVENT);
+
+// ---- Event loop ----
+
+typedef struct event_handler {
+    esp_event_base_t base;
+    int32_t id;
+    esp_event_handler_t handler;
+    void *arg;
+    struct event_handler *next;
+} event_handler_t;
+
+typedef struct posted_event {
+    esp_event_base_t base;
+    int32_t id;
+    struct posted_event *next;
+    size_t data_size;
+    uint8_t data[];
+} posted_event_t;
+
+static pthread_mutex_t event_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t event_cond;
+static event_handler_t *handlers = NULL;
+static posted_event_t *event_head = NULL;
+static posted_event_t *event_tail = NULL;
+static bool event_loop_running = false;
+
+static void *event_loop_thread(void *arg) {
+    pthread_setname_np(pthread_self(), "sys_evt");
+    pthread_mutex_lock(&event_lock);
+    while (1) {
+        while (!event_head) {
+            pthread_cond_wait(&event_cond, &event_lock);
+        }
+        posted_event_t *event = event_head;
+        event_head = event->next;
+        if (!event_head) {
+            event_tail = NULL;
+        }
+
+        // Handlers run unlocked; they may post or register in turn
+        for (event_handler_t *h = handlers; h; h = h->next) {
+            if (h->base == event->base && (h->id == ESP_EVENT_ANY_ID || h->id == event->id)) {
+                pthread_mutex_unlock(&event_lock);
+                h->handler(h->arg, event->base, event->id, event->data_size ? event->data : NULL);
+                pthread_mutex_lock(&event_lock);
+            }
+        }
+        free(event);
+    }
+    return NULL;
+}
+
+esp_err_t esp_event_loop_create_default(void) {
+    pthread_mutex_lock(&event_lock);
+    esp_err_t ret = ESP_OK;
+    if (event_loop_running) {
+        ret = ESP_ERR_INVALID_STATE;
+    } else {
+        shim_cond_init(&event_cond);
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, event_loop_thread, NULL) != 0) {
+            ret = ESP_FAIL;
+        } else {
+            pthread_detach(thread);
+            event_loop_running = true;
+        }
+    }
+    pthread_mutex_unlock(&event_lock);
+    return ret;
+}
+
+esp_err_t esp_event_loop_delete_default(void) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_event_handler_register(esp_event_base_t event_base, int32_t event_id,
+                                     esp_event_handler_t event_handler, void *event_handler_arg) {
+    event_handler_t *h = calloc(1, sizeof(*h));
+    if (!h) {
+        return ESP_ERR_NO_MEM;
+    }
+    h->base = event_base;
+    h->id = event_id;
+    h->handler = event_handler;
+    h->arg = event_handler_arg;
+
+    // Appended, so handlers run in registration order as in IDF. Entries
+    // are never freed while the loop may be walking the list.
+    pthread_mutex_lock(&event_lock);
+    event_handler_t **p = &handlers;
+    while (*p) {
+        p = &(*p)->next;
+    }
+    *p = h;
+    pthread_mutex_unlock(&event_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_unregister(esp_event_base_t event_base, int32_t event_id,
+                                       esp_event_handler_t event_handler) {
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    pthread_mutex_lock(&event_lock);
+    for (event_handler_t *h = handlers; h; h = h->next) {
+        if (h->base == event_base && h->id == event_id && h->handler == event_handler) {
+            h->base = NULL;     // Never matches again
+            ret = ESP_OK;
+        }
+    }
+    pthread_mutex_unlock(&event_lock);
+    return ret;
+}
+
+esp_err_t esp_event_post(esp_event_base_t event_base, int32_t event_id,
+                         const void *event_data, size_t event_data_size, uint32_t ticks_to_wait) {
+    posted_event_t *event = calloc(1, sizeof(*event) + event_data_size);
+    if (!event) {
+        return ESP_ERR_NO_MEM;
+    }
+    event->base = event_base;
+    event->id = event_id;
+    event->data_size = event_data ? event_data_size : 0;
+    if (event->data_size) {
+        memcpy(event->data, event_data, event_data_size);
+    }
+
+    pthread_mutex_lock(&event_lock);
+    if (!event_loop_running) {
+        pthread_mutex_unlock(&event_lock);
+        free(event);
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (event_tail) {
+        event_tail->next = event;
+    } else {
+        event_head = event;
+    }
+    event_tail = event;
+    pthread_cond_signal(&event_cond);
+    pthread_mutex_unlock(&event_lock);
+    return ESP_OK;
+}
+
+// ---- Station interface ----
+
+struct esp_netif_obj {
+    bool dhcpc_running;
+    esp_netif_ip_info_t ip_info;
+    esp_netif_dns_info_t dns[ESP_NETIF_DNS_MAX];
+};
+
+static struct esp_netif_obj sta_netif_obj;
+static esp_netif_t *sta_netif = NULL;
+static pthread_mutex_t netif_lock = PTHREAD_MUTEX_INITIALIZER;
+
+esp_err_t esp_netif_init(void) {
+    return ESP_OK;
+}
+
+esp_netif_t *esp_netif_create_default_wifi_sta(void) {
+    pthread_mutex_lock(&netif_lock);
+    if (!sta_netif) {
+        memset(&sta_netif_obj, 0, sizeof(sta_netif_obj));
+        sta_netif_obj.dhcpc_running = true;
+        sta_netif = &sta_netif_obj;
+    }
+    pthread_mutex_unlock(&netif_lock);
+    return sta_netif;
+}
+
+esp_netif_t *esp_netif_get_handle_from_ifkey(const char *if_key) {
+    return if_key && strcmp(if_key, "WIFI_STA_DEF") == 0 ? sta_netif : NULL;
+}
+
+esp_err_t esp_netif_get_ip_info(esp_netif_t *esp_netif, esp_netif_ip_info_t *ip_info) {
+    if (!esp_netif || !ip_info) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&netif_lock);
+    *ip_info = esp_netif->ip_info;
+    pthread_mutex_unlock(&netif_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_set_ip_info(esp_netif_t *esp_netif, const esp_netif_ip_info_t *ip_info) {
+    if (!esp_netif || !ip_info) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t ret = ESP_OK;
+    pthread_mutex_lock(&netif_lock);
+    if (esp_netif->dhcpc_running) {
+        ret = ESP_ERR_INVALID_STATE;    // IDF: ESP_ERR_ESP_NETIF_DHCP_NOT_STOPPED
+    } else {
+        esp_netif->ip_info = *ip_info;
+    }
+    pthread_mutex_unlock(&netif_lock);
+    return ret;
+}
+
+esp_err_t esp_netif_get_dns_info(esp_netif_t *esp_netif, esp_netif_dns_type_t type,
+                                 esp_netif_dns_info_t *dns) {
+    if (!esp_netif || !dns || type >= ESP_NETIF_DNS_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&netif_lock);
+    *dns = esp_netif->dns[type];
+    pthread_mutex_unlock(&netif_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_set_dns_info(esp_netif_t *esp_netif, esp_netif_dns_type_t type,
+                                 esp_netif_dns_info_t *dns) {
+    if (!esp_netif || !dns || type >= ESP_NETIF_DNS_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&netif_lock);
+    esp_netif->dns[type] = *dns;
+    pthread_mutex_unlock(&netif_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_dhcpc_start(esp_netif_t *esp_netif) {
+    if (!esp_netif) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&netif_lock);
+    esp_netif->dhcpc_running = true;
+    pthread_mutex_unlock(&netif_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_dhcpc_stop(esp_netif_t *esp_netif) {
+    if (!esp_netif) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&netif_lock);
+    esp_netif->dhcpc_running = false;
+    pthread_mutex_unlock(&netif_lock);
+    return ESP_OK;
+}
+
+uint32_t esp_ip4addr_aton(const char *addr) {
+    return inet_addr(addr);
+}
+
+char *esp_ip4addr_ntoa(const esp_ip4_addr_t *addr, char *buf, int buflen) {
+    struct in_addr in = { .s_addr = addr->addr };
+    return inet_ntop(AF_INET, &in, buf, buflen) ? buf : NULL;
+}
+
+// ---- WiFi driver ----
+
+typedef struct {
+    const char *ssid;
+    uint8_t bssid[6];
+    int8_t rssi;
+    bool lr;
+} host_ap_t;
+
+// The networks config.h asks for, always in range
+static const host_ap_t host_aps[] = {
+    { WIFI_SSID, { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 }, -45, false },
+    { WIFI_LR_SSID, { 0x02, 0x00, 0x00, 0x00, 0x00, 0x02 }, -60, true },
+};
+
+static pthread_mutex_t wifi_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool wifi_initialized = false;
+static bool wifi_started = false;
+static const host_ap_t *connected_ap = NULL;
+static wifi_config_t sta_config;
+static uint8_t sta_protocol = WIFI_PROTOCOL_11B | WIFI_PROTOCOL_11G | WIFI_PROTOCOL_11N;
+static wifi_ps_type_t ps_type = WIFI_PS_MIN_MODEM;
+static int8_t max_tx_power = 80;
+static wifi_ap_record_t scan_records[SCAN_MAX_RECORDS];
+static uint16_t scan_count = 0;
+
+static bool ap_visible(const host_ap_t *ap) {
+    return ap->lr ? WIFI_LR_ENABLED && (sta_protocol & WIFI_PROTOCOL_LR)
+                  : (sta_protocol & (WIFI_PROTOCOL_11B | WIFI_PROTOCOL_11G | WIFI_PROTOCOL_11N));
+}
+
+static void ap_record(const host_ap_t *ap, wifi_ap_record_t *rec) {
+    memset(rec, 0, sizeof(*rec));
+    memcpy(rec->bssid, ap->bssid, sizeof(rec->bssid));
+    strncpy((char *)rec->ssid, ap->ssid, sizeof(rec->ssid) - 1);
+    rec->primary = AP_CHANNEL;
+    rec->rssi = ap->rssi;
+    rec->authmode = WIFI_AUTH_WPA2_PSK;
+    rec->phy_lr = ap->lr;
+    rec->phy_11b = rec->phy_11g = rec->phy_11n = !ap->lr;
+}
+
+esp_err_t esp_wifi_init(const wifi_init_config_t *config) {
+    pthread_mutex_lock(&wifi_lock);
+    wifi_initialized = true;
+    pthread_mutex_unlock(&wifi_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode) {
+    return wifi_initialized ? ESP_OK : ESP_ERR_WIFI_NOT_INIT;
+}
+
+esp_err_t esp_wifi_set_config(wifi_interface_t interface, wifi_config_t *conf) {
+    if (!wifi_initialized) {
+        return ESP_ERR_WIFI_NOT_INIT;
+    }
+    if (interface != WIFI_IF_STA || !conf) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&wifi_lock);
+    sta_config = *conf;
+    pthread_mutex_unlock(&wifi_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_protocol(wifi_interface_t ifx, uint8_t protocol_bitmap) {
+    if (!wifi_initialized) {
+        return ESP_ERR_WIFI_NOT_INIT;
+    }
+    pthread_mutex_lock(&wifi_lock);
+    sta_protocol = protocol_bitmap;
+    pthread_mutex_unlock(&wifi_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_start(void) {
+    if (!wifi_initialized) {
+        return ESP_ERR_WIFI_NOT_INIT;
+    }
+    pthread_mutex_lock(&wifi_lock);
+    bool was_started = wifi_started;
+    wifi_started = true;
+    pthread_mutex_unlock(&wifi_lock);
+    if (!was_started) {
+        esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_START, NULL, 0, 0);
+    }
+    return ESP_OK;
+}
+
+static void post_disconnected(const host_ap_t *ap, uint8_t reason) {
+    wifi_event_sta_disconnected_t event = { .reason = reason, .rssi = ap ? ap->rssi : 0 };
+    if (ap) {
+        memcpy(event.bssid, ap->bssid, sizeof(event.bssid));
+    }
+    esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, &event, sizeof(event), 0);
+}
+
+esp_err_t esp_wifi_stop(void) {
+    if (!wifi_initialized) {
+        return ESP_ERR_WIFI_NOT_INIT;
+    }
+    pthread_mutex_lock(&wifi_lock);
+    bool was_started = wifi_started;
+    const host_ap_t *ap = connected_ap;
+    wifi_started = false;
+    connected_ap = NULL;
+    pthread_mutex_unlock(&wifi_lock);
+
+    if (ap) {
+        post_disconnected(ap, WIFI_REASON_ASSOC_LEAVE);
+    }
+    if (was_started) {
+        esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_STOP, NULL, 0, 0);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_connect(void) {
+    pthread_mutex_lock(&wifi_lock);
+    if (!wifi_started) {
+        pthread_mutex_unlock(&wifi_lock);
+        return ESP_ERR_WIFI_NOT_STARTED;
+    }
+    const host_ap_t *ap = NULL;
+    for (size_t i = 0; i < sizeof(host_aps) / sizeof(host_aps[0]); i++) {
+        if (ap_visible(&host_aps[i]) &&
+            strncmp((const char *)sta_config.sta.ssid, host_aps[i].ssid, sizeof(sta_config.sta.ssid)) == 0) {
+            ap = &host_aps[i];
+            break;
+        }
+    }
+    connected_ap = ap;
+    pthread_mutex_unlock(&wifi_lock);
+
+    if (!ap) {
+        post_disconnected(NULL, WIFI_REASON_NO_AP_FOUND);
+        return ESP_OK;
+    }
+
+    wifi_event_sta_connected_t connected = {
+        .channel = AP_CHANNEL,
+        .authmode = WIFI_AUTH_WPA2_PSK,
+        .aid = 1,
+    };
+    connected.ssid_len = strlen(ap->ssid);
+    memcpy(connected.ssid, ap->ssid, connected.ssid_len < 32 ? connected.ssid_len : 32);
+    memcpy(connected.bssid, ap->bssid, sizeof(connected.bssid));
+    esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_CONNECTED, &connected, sizeof(connected), 0);
+
+    // DHCP "leases" loopback; a static address is reported as set
+    ip_event_got_ip_t got_ip = { .esp_netif = sta_netif, .ip_changed = true };
+    pthread_mutex_lock(&netif_lock);
+    if (sta_netif && sta_netif->dhcpc_running) {
+        sta_netif->ip_info.ip.addr = inet_addr("127.0.0.1");
+        sta_netif->ip_info.netmask.addr = inet_addr("255.0.0.0");
+        sta_netif->ip_info.gw.addr = inet_addr("127.0.0.1");
+        sta_netif->dns[ESP_NETIF_DNS_MAIN].ip.u_addr.ip4.addr = inet_addr("127.0.0.1");
+        sta_netif->dns[ESP_NETIF_DNS_MAIN].ip.type = ESP_IPADDR_TYPE_V4;
+    }
+    if (sta_netif) {
+        got_ip.ip_info = sta_netif->ip_info;
+    }
+    pthread_mutex_unlock(&netif_lock);
+    esp_event_post(IP_EVENT, IP_EVENT_STA_GOT_IP, &got_ip, sizeof(got_ip), 0);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_disconnect(void) {
+    pthread_mutex_lock(&wifi_lock);
+    const host_ap_t *ap = connected_ap;
+    connected_ap = NULL;
+    bool started = wifi_started;
+    pthread_mutex_unlock(&wifi_lock);
+    if (!started) {
+        return ESP_ERR_WIFI_NOT_STARTED;
+    }
+    post_disconnected(ap, WIFI_REASON_ASSOC_LEAVE);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_scan_start(const wifi_scan_config_t *config, bool block) {
+    pthread_mutex_lock(&wifi_lock);
+    if (!wifi_started) {
+        pthread_mutex_unlock(&wifi_lock);
+        return ESP_ERR_WIFI_NOT_STARTED;
+    }
+    scan_count = 0;
+    for (size_t i = 0; i < sizeof(host_aps) / sizeof(host_aps[0]); i++) {
+        if (ap_visible(&host_aps[i])) {
+            ap_record(&host_aps[i], &scan_records[scan_count++]);
+        }
+    }
+    pthread_mutex_unlock(&wifi_lock);
+    ESP_LOGD(TAG, "Scan found %d networks", scan_count);
+    esp_event_post(WIFI_EVENT, WIFI_EVENT_SCAN_DONE, NULL, 0, 0);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_scan_stop(void) {
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_scan_get_ap_records(uint16_t *number, wifi_ap_record_t *ap_records) {
+    pthread_mutex_lock(&wifi_lock);
+    uint16_t n = *number < scan_count ? *number : scan_count;
+    memcpy(ap_records, scan_records, n * sizeof(wifi_ap_record_t));
+    *number = n;
+    scan_count = 0;     // The driver frees its list once it is read
+    pthread_mutex_unlock(&wifi_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_clear_ap_list(void) {
+    pthread_mutex_lock(&wifi_lock);
+    scan_count = 0;
+    pthread_mutex_unlock(&wifi_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t *ap_info) {
+    pthread_mutex_lock(&wifi_lock);
+    const host_ap_t *ap = connected_ap;
+    pthread_mutex_unlock(&wifi_lock);
+    if (!ap) {
+        return ESP_ERR_WIFI_NOT_CONNECT;
+    }
+    ap_record(ap, ap_info);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_sta_get_negotiated_phymode(wifi_phy_mode_t *phymode) {
+    pthread_mutex_lock(&wifi_lock);
+    const host_ap_t *ap = connected_ap;
+    pthread_mutex_unlock(&wifi_lock);
+    if (!ap) {
+        return ESP_ERR_WIFI_NOT_CONNECT;
+    }
+    *phymode = ap->lr ? WIFI_PHY_MODE_LR : WIFI_PHY_MODE_HT20;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_mac(wifi_interface_t ifx, uint8_t mac[6]) {
+    return esp_read_mac(mac, ifx == WIFI_IF_STA ? ESP_MAC_WIFI_STA : ESP_MAC_WIFI_SOFTAP);
+}
+
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t type) {
+    pthread_mutex_lock(&wifi_lock);
+    ps_type = type;
+    pthread_mutex_unlock(&wifi_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_ps(wifi_ps_type_t *type) {
+    pthread_mutex_lock(&wifi_lock);
+    *type = ps_type;
+    pthread_mutex_unlock(&wifi_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_max_tx_power(int8_t power) {
+    if (!wifi_started) {
+        return ESP_ERR_WIFI_NOT_STARTED;
+    }
+    if (power < 8 || power > 84) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&wifi_lock);
+    max_tx_power = power;
+    pthread_mutex_unlock(&wifi_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_max_tx_power(int8_t *power) {
+    if (!wifi_started) {
+        return ESP_ERR_WIFI_NOT_STARTED;
+    }
+    pthread_mutex_lock(&wifi_lock);
+    *power = max_tx_power;
+    pthread_mutex_unlock(&wifi_lock);
+    return ESP_OK;
+}
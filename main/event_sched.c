@@ -0,0 +1,197 @@
+// event_sched.c - Single-worker event scheduler built on esp_timer
+//
+// Each event is an esp_timer one-shot. The timer callback only posts the
+// event to a queue; one worker task runs the handlers. Nothing polls, so
+// between events the CPU can stay in light sleep until the next deadline.
+#include "event_sched.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include <stdlib.h>
+#include <stdbool.h>
+
+static const char *TAG = "SCHED";
+
+#define SCHED_QUEUE_LEN     8
+// Sized from the worker's high-water mark (about 3 KB on the C3, deepest on
+// the failsafe/reconnect-expiry path with its NVS writes) plus 1 KB margin;
+// the health check logs the mark so the margin can be re-checked
+#define SCHED_TASK_STACK    4096
+// Same priority as the HTTP server: the failsafe deadline still gets its
+// time slice while a job runs, and the expiry path cannot starve WiFi/lwIP
+#define SCHED_TASK_PRIO     5
+
+struct sched_event {
+    const char *name;
+    sched_handler_t handler;
+    void *arg;
+    uint32_t period_ms;
+    esp_timer_handle_t timer;
+    int64_t due_us;             // 0 = not armed
+    uint32_t generation;        // Bumped by every arm and cancel
+};
+
+// A fired timer as queued for the worker: stale once the event is re-armed
+// or cancelled, whatever the worker is doing when it gets there
+typedef struct {
+    sched_event_t *event;
+    uint32_t generation;
+} sched_fire_t;
+
+static QueueHandle_t sched_queue = NULL;
+static TaskHandle_t sched_task = NULL;
+
+// Guards due_us and generation, written from the caller, the esp_timer
+// task and the worker
+static portMUX_TYPE sched_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void sched_timer_cb(void *arg) {
+    sched_fire_t fire = { .event = (sched_event_t *)arg };
+
+    // A stop that raced with the expiry can still deliver the old callback:
+    // only an armed event at or past its deadline fires
+    portENTER_CRITICAL(&sched_lock);
+    bool due = fire.event->due_us > 0 && esp_timer_get_time() >= fire.event->due_us;
+    fire.generation = fire.event->generation;
+    portEXIT_CRITICAL(&sched_lock);
+
+    if (due && xQueueSend(sched_queue, &fire, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Queue full - dropping %s", fire.event->name);
+    }
+}
+
+static void sched_worker_task(void *arg) {
+    sched_fire_t fire;
+
+    while (1) {
+        if (xQueueReceive(sched_queue, &fire, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        sched_event_t *event = fire.event;
+
+        // Cancelled or re-armed after this fire was queued - drop it
+        portENTER_CRITICAL(&sched_lock);
+        bool current = fire.generation == event->generation;
+        if (current) {
+            event->due_us = 0;
+        }
+        portEXIT_CRITICAL(&sched_lock);
+        if (!current) {
+            continue;
+        }
+
+        event->handler(event->arg);
+
+        // Re-arm periodic events unless someone re-armed/cancelled meanwhile
+        portENTER_CRITICAL(&sched_lock);
+        bool rearm = event->period_ms > 0 && fire.generation == event->generation;
+        portEXIT_CRITICAL(&sched_lock);
+        if (rearm) {
+            event_sched_after(event, event->period_ms);
+        }
+    }
+}
+
+esp_err_t event_sched_init(void) {
+    if (sched_queue) {
+        return ESP_OK;
+    }
+
+    sched_queue = xQueueCreate(SCHED_QUEUE_LEN, sizeof(sched_fire_t));
+    if (!sched_queue) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (xTaskCreate(sched_worker_task, "sched", SCHED_TASK_STACK, NULL,
+                    SCHED_TASK_PRIO, &sched_task) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create scheduler task");
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Event scheduler started");
+    return ESP_OK;
+}
+
+sched_event_t* event_sched_create(const char *name, sched_handler_t handler,
+                                  void *arg, uint32_t period_ms) {
+    if (!handler) {
+        return NULL;
+    }
+
+    sched_event_t *event = calloc(1, sizeof(sched_event_t));
+    if (!event) {
+        return NULL;
+    }
+
+    event->name = name;
+    event->handler = handler;
+    event->arg = arg;
+    event->period_ms = period_ms;
+
+    esp_timer_create_args_t timer_args = {
+        .callback = sched_timer_cb,
+        .arg = event,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = name,
+        .skip_unhandled_events = true
+    };
+
+    if (esp_timer_create(&timer_args, &event->timer) != ESP_OK) {
+        free(event);
+        return NULL;
+    }
+
+    return event;
+}
+
+esp_err_t event_sched_after(sched_event_t *event, uint32_t delay_ms) {
+    if (!event) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_timer_stop(event->timer);  // Harmless if not running
+
+    portENTER_CRITICAL(&sched_lock);
+    event->due_us = esp_timer_get_time() + (int64_t)delay_ms * 1000;
+    event->generation++;
+    portEXIT_CRITICAL(&sched_lock);
+
+    return esp_timer_start_once(event->timer, (uint64_t)delay_ms * 1000);
+}
+
+esp_err_t event_sched_cancel(sched_event_t *event) {
+    if (!event) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Also drops a fire already queued and suppresses the periodic re-arm
+    portENTER_CRITICAL(&sched_lock);
+    event->due_us = 0;
+    event->generation++;
+    portEXIT_CRITICAL(&sched_lock);
+
+    esp_timer_stop(event->timer);
+    return ESP_OK;
+}
+
+uint64_t event_sched_remaining_us(sched_event_t *event) {
+    if (!event) {
+        return 0;
+    }
+
+    portENTER_CRITICAL(&sched_lock);
+    int64_t due_us = event->due_us;
+    portEXIT_CRITICAL(&sched_lock);
+    if (due_us <= 0) {
+        return 0;
+    }
+
+    int64_t remaining = due_us - esp_timer_get_time();
+    return remaining > 0 ? (uint64_t)remaining : 0;
+}
+
+uint32_t event_sched_stack_free(void) {
+    return sched_task ? uxTaskGetStackHighWaterMark(sched_task) : 0;
+}
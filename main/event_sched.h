@@ -0,0 +1,34 @@
+// event_sched.h - Single-worker event scheduler built on esp_timer
+#ifndef EVENT_SCHED_H
+#define EVENT_SCHED_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+// Handlers run one at a time on the scheduler worker task, never in the
+// esp_timer callback context, so they may block briefly and log freely
+typedef void (*sched_handler_t)(void *arg);
+
+typedef struct sched_event sched_event_t;
+
+// Create the worker task and queue (call once, early)
+esp_err_t event_sched_init(void);
+
+// Create an event. period_ms > 0 re-arms it automatically after each run.
+sched_event_t* event_sched_create(const char *name, sched_handler_t handler,
+                                  void *arg, uint32_t period_ms);
+
+// Arm (or re-arm) the event to fire once after delay_ms
+esp_err_t event_sched_after(sched_event_t *event, uint32_t delay_ms);
+
+// Disarm the event; a run already queued is dropped (one already running
+// completes, but is not re-armed)
+esp_err_t event_sched_cancel(sched_event_t *event);
+
+// Microseconds until the event fires (0 if not armed)
+uint64_t event_sched_remaining_us(sched_event_t *event);
+
+// Least free stack the worker has had so far, in bytes (its high-water mark)
+uint32_t event_sched_stack_free(void);
+
+#endif // EVENT_SCHED_H
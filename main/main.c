@@ -23,7 +23,16 @@
 #include "swd_mem.h"
 #include "swd_flash.h"
 #include "power_mgmt.h"
+#include "power_history.h"
 #include "wifi_manager.h"
+#include "phase_timer.h"
+#include "power_energy.h"
+#include "power_schedule.h"
+#include "event_sched.h"
+#include "telemetry.h"
+#include "binlog.h"
+#include "target_monitor.h"
+#include "golden.h"
 
 
 static const char *TAG = "FLASHER";
@@ -32,10 +41,16 @@ static const char *TAG = "FLASHER";
 static char* device_ip = "Not connected";
 static httpd_handle_t web_server = NULL;
 
-// Failsafe reboot timer (CRITICAL: ensures device returns to sleep/wake cycle)
-static TaskHandle_t failsafe_task_handle = NULL;
+// Failsafe reboot deadline (CRITICAL: ensures device returns to sleep/wake cycle)
+static sched_event_t *failsafe_event = NULL;
 static bool failsafe_armed = false;
-static uint32_t failsafe_start_time = 0;
+static int64_t failsafe_start_us = 0;
+static volatile uint32_t failsafe_activity_ms = 0;  // Last operator request/job, 0 = none
+#define FAILSAFE_BUSY_RECHECK_MS 5000
+
+// Background checks - scheduled events instead of polling loops
+#define HEALTH_CHECK_INTERVAL_MS 60000  // Heap only moves with requests; once a minute is enough
+#define ACTIVE_MONITOR_INTERVAL_MS 60000
 
 // Brownout loop protection (RTC memory - persists through resets and deep sleep)
 RTC_DATA_ATTR static uint32_t rtc_brownout_count = 0;
@@ -62,7 +77,9 @@ typedef struct {
 // Function declarations
 static void init_system(void);
 static void init_storage(void);
-static void system_health_task(void *arg);
+static void system_health_check(void *arg);
+void get_failsafe_status(bool *is_armed, uint32_t *remaining_sec);
+static void failsafe_note_activity(void);
 static esp_err_t start_webserver(void);
 void stop_webserver(void);  // Made global for wifi_manager cleanup
 static esp_err_t release_swd_handler(httpd_req_t *req);
@@ -84,11 +101,14 @@ static void init_storage(void) {
 
     size_t total = 0, used = 0;
     esp_spiffs_info(conf.partition_label, &total, &used);
-    ESP_LOGI(TAG, "Storage partition: %d bytes total, %d bytes used", total, used);
+    ESP_LOGI(TAG, "Storage partition: %zu bytes total, %zu bytes used", total, used);
 }
 
 // Enhanced web server handler with new tabbed interface
 static esp_err_t root_handler(httpd_req_t *req) {
+    power_history_set_outcome(HISTORY_OUTCOME_CLIENT);
+    power_schedule_record_client();
+
     // Part 1: HTML header and styles
     const char* html_start =
         "<!DOCTYPE html><html><head><title>Mesh Radio Flasher</title>"
@@ -162,7 +182,7 @@ static esp_err_t root_handler(httpd_req_t *req) {
         "<h3>ESP32 Status</h3>"
         "<div class='info-item'><span class='info-label'>Status:</span><span class='info-value'><span class='status-indicator status-online'></span>Online</span></div>"
         "<div class='info-item'><span class='info-label'>Device IP:</span><span class='info-value' id='device-ip'>%s</span></div>"
-        "<div class='info-item'><span class='info-label'>Free Heap:</span><span class='info-value' id='free-heap'>%lu bytes</span></div>"
+        "<div class='info-item'><span class='info-label'>Free Heap:</span><span class='info-value' id='free-heap'>%" PRIu32 " bytes</span></div>"
         "</div>"
         "<div class='info-card'>"
         "<h3>🔋 Battery Status</h3>"
@@ -308,7 +328,7 @@ static esp_err_t root_handler(httpd_req_t *req) {
         "}"
         ""
         "function refreshStatus() {"
-        "  fetch('/check_swd')"
+        "  fetch('/check_swd?poll=1')"
         "    .then(response => response.json())"
         "    .then(data => {"
         "      updateHomeStatus(data);"
@@ -725,6 +745,11 @@ static esp_err_t root_handler(httpd_req_t *req) {
         "  xhr.send(file);"
         "}"
         ""
+        // Literals are joined without newlines: everything after the first
+        // JS "//" comment below is commented out, so this must come first.
+        // Gives the device real time so the learned wake schedule uses wall clock.
+        "fetch('/time_sync?epoch=' + Math.floor(Date.now() / 1000), {method: 'POST'});"
+        ""
         "// Call functions immediately when script loads (don't wait for DOMContentLoaded)"
         "window.addEventListener('load', function() {"
         "  // Call all status functions immediately"
@@ -790,29 +815,133 @@ static esp_err_t root_handler(httpd_req_t *req) {
 static esp_err_t failsafe_status_handler(httpd_req_t *req) {
     char resp[256];
 
-    bool is_armed = failsafe_armed;
+    bool is_armed = false;
     uint32_t remaining = 0;
+    get_failsafe_status(&is_armed, &remaining);
+
+    snprintf(resp, sizeof(resp),
+        "{\"armed\":%s,\"remaining_sec\":%" PRIu32 ",\"limit_sec\":%d,"
+        "\"idle_sec\":%d,\"activity_sec\":%d}",
+        is_armed ? "true" : "false",
+        remaining,
+        MAX_UPTIME_AFTER_WIFI_SEC,
+        FAILSAFE_IDLE_SEC,
+        FAILSAFE_ACTIVITY_SEC);
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, resp, strlen(resp));
+    return ESP_OK;
+}
+
+// Per-phase wake timing and WiFi connect latency (rolling stats in RTC memory)
+static esp_err_t phase_timing_handler(httpd_req_t *req) {
+    char resp[2048];
+    int len = snprintf(resp, sizeof(resp), "{\"phases\":[");
+
+    for (int i = 0; i < PHASE_COUNT && len < (int)sizeof(resp); i++) {
+        phase_stats_t stats;
+        if (!phase_timer_get((boot_phase_t)i, &stats)) {
+            continue;
+        }
+        len += snprintf(resp + len, sizeof(resp) - len,
+            "%s{\"phase\":\"%s\",\"count\":%" PRIu32 ",\"last_ms\":%.1f,"
+            "\"min_ms\":%.1f,\"avg_ms\":%.1f,\"max_ms\":%.1f}",
+            i > 0 ? "," : "",
+            phase_timer_name((boot_phase_t)i),
+            stats.count,
+            stats.last_us / 1000.0f,
+            stats.min_us / 1000.0f,
+            stats.avg_us / 1000.0f,
+            stats.max_us / 1000.0f);
+    }
 
-    if (is_armed && failsafe_start_time > 0) {
-        uint32_t current_time = xTaskGetTickCount() * portTICK_PERIOD_MS / 1000;
-        uint32_t elapsed = current_time - failsafe_start_time;
+    if (len < (int)sizeof(resp)) {
+        len += snprintf(resp + len, sizeof(resp) - len, "],\"wifi\":[");
+    }
 
-        if (elapsed < MAX_UPTIME_AFTER_WIFI_SEC) {
-            remaining = MAX_UPTIME_AFTER_WIFI_SEC - elapsed;
+    for (int i = 0; i < WIFI_STEP_COUNT && len < (int)sizeof(resp); i++) {
+        phase_stats_t stats;
+        if (!wifi_manager_get_latency((wifi_step_t)i, &stats) || stats.count == 0) {
+            continue;
         }
+        len += snprintf(resp + len, sizeof(resp) - len,
+            "%s{\"step\":\"%s\",\"count\":%" PRIu32 ",\"last_ms\":%.1f,"
+            "\"min_ms\":%.1f,\"avg_ms\":%.1f,\"max_ms\":%.1f}",
+            resp[len - 1] == '[' ? "" : ",",
+            wifi_manager_step_name((wifi_step_t)i),
+            stats.count,
+            stats.last_us / 1000.0f,
+            stats.min_us / 1000.0f,
+            stats.avg_us / 1000.0f,
+            stats.max_us / 1000.0f);
+    }
+
+    if (len < (int)sizeof(resp)) {
+        len += snprintf(resp + len, sizeof(resp) - len, "],\"wifi_state\":\"%s\"}",
+                        wifi_manager_state_name(wifi_manager_get_state()));
     }
+    if (len >= (int)sizeof(resp)) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Response too large");
+        return ESP_FAIL;
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, resp, len);
+    return ESP_OK;
+}
+
+// Target liveness monitor counters
+static esp_err_t target_monitor_handler(httpd_req_t *req) {
+    char resp[384];
+    target_monitor_status_t st;
+    target_monitor_get_status(&st);
 
     snprintf(resp, sizeof(resp),
-        "{\"armed\":%s,\"remaining_sec\":%lu,\"limit_sec\":%d}",
-        is_armed ? "true" : "false",
-        remaining,
-        MAX_UPTIME_AFTER_WIFI_SEC);
+        "{\"enabled\":%s,\"source\":\"%s\",\"address\":\"0x%08lx\","
+        "\"interval_ms\":%d,\"probes\":%" PRIu32 ",\"failures\":%" PRIu32 ",\"skipped\":%" PRIu32 ","
+        "\"stalls\":%" PRIu32 ",\"stall_limit\":%d,\"cycles\":%" PRIu32 ",\"last_value\":%" PRIu32 ","
+        "\"last_probe_us\":%" PRIu32 ",\"max_probe_us\":%" PRIu32 "}",
+        st.enabled ? "true" : "false",
+        st.dwt_mode ? "dwt_cyccnt" : "ram",
+        st.dwt_mode ? 0xE0001004UL : st.heartbeat_addr,
+        TARGET_MONITOR_INTERVAL_MS,
+        st.probes, st.failures, st.skipped,
+        st.stalls, TARGET_MONITOR_STALL_CHECKS, st.cycles, st.last_value,
+        st.last_probe_us, st.max_probe_us);
 
     httpd_resp_set_type(req, "application/json");
     httpd_resp_send(req, resp, strlen(resp));
     return ESP_OK;
 }
 
+// Background polls from an open page - not a sign that anyone is at it.
+// The page also refreshes /check_swd on a timer; it marks that with ?poll=1
+// so only an explicit check counts as activity.
+static bool is_status_poll(const char *uri_template, const char *uri) {
+    static const char *polls[] = {
+        "/power_status", "/battery_status", "/wifi_status", "/failsafe_status"
+    };
+    for (size_t i = 0; i < sizeof(polls) / sizeof(polls[0]); i++) {
+        if (strcmp(uri_template, polls[i]) == 0) {
+            return true;
+        }
+    }
+    const char *query = strchr(uri, '?');
+    return query && strstr(query, "poll=1") != NULL;
+}
+
+// Every request passes through URI matching - the hook for activity tracking
+static bool activity_uri_match(const char *uri_template, const char *uri_to_match,
+                               size_t match_upto) {
+    if (!httpd_uri_match_wildcard(uri_template, uri_to_match, match_upto)) {
+        return false;
+    }
+    if (!is_status_poll(uri_template, uri_to_match)) {
+        failsafe_note_activity();
+    }
+    return true;
+}
+
 static esp_err_t start_webserver(void) {
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.server_port = 80;
@@ -820,6 +949,7 @@ static esp_err_t start_webserver(void) {
     config.recv_wait_timeout = 10;
     config.send_wait_timeout = 10;
     config.stack_size = 10240;
+    config.uri_match_fn = activity_uri_match;
 
     if (httpd_start(&web_server, &config) == ESP_OK) {
         // Register handlers
@@ -844,11 +974,30 @@ static esp_err_t start_webserver(void) {
             .user_ctx = NULL
         };
 
+        httpd_uri_t phase_timing_uri = {
+            .uri = "/phase_timing",
+            .method = HTTP_GET,
+            .handler = phase_timing_handler,
+            .user_ctx = NULL
+        };
+
+        httpd_uri_t target_monitor_uri = {
+            .uri = "/target_monitor",
+            .method = HTTP_GET,
+            .handler = target_monitor_handler,
+            .user_ctx = NULL
+        };
+
         httpd_register_uri_handler(web_server, &root_uri);
         httpd_register_uri_handler(web_server, &release_uri);
         httpd_register_uri_handler(web_server, &failsafe_uri);
+        httpd_register_uri_handler(web_server, &phase_timing_uri);
+        httpd_register_uri_handler(web_server, &target_monitor_uri);
         register_upload_handlers(web_server);
         register_power_handlers(web_server);
+        register_profile_handlers(web_server);
+        register_debug_handlers(web_server);
+        register_bench_handlers(web_server);
 
         ESP_LOGI(TAG, "Web server started successfully");
         return ESP_OK;
@@ -872,32 +1021,15 @@ void stop_webserver(void) {
 // SWD connection function removed - SWD initializes on-demand when web interface requests it
 // This reduces boot time and prevents unnecessary target interference
 
-// System health monitoring task - simplified to only monitor heap
-static void system_health_task(void *arg) {
-    ESP_LOGI(TAG, "System health monitoring started");
-
+// System health check - scheduled event, only monitors heap
+static void system_health_check(void *arg) {
     size_t free_heap = esp_get_free_heap_size();
-    ESP_LOGI(TAG, "Initial free heap: %d bytes", free_heap);
-
-    // Monitor heap every 5 seconds
-    while (1) {
-        vTaskDelay(pdMS_TO_TICKS(5000));
 
-        free_heap = esp_get_free_heap_size();
-
-        // Only log if memory is getting low
-        if (free_heap < 20000) {
-            ESP_LOGW(TAG, "Low memory warning: %d bytes free", free_heap);
-        }
-
-        // Log periodically even if OK (every minute)
-        static int check_count = 0;
-        check_count++;
-        if (check_count >= 12) {  // 12 * 5 seconds = 60 seconds
-            ESP_LOGI(TAG, "Heap: %d bytes free", free_heap);
-            check_count = 0;
-        }
+    if (free_heap < 20000) {
+        ESP_LOGW(TAG, "Low memory warning: %zu bytes free", free_heap);
     }
+    ESP_LOGI(TAG, "Heap: %zu bytes free, scheduler stack %" PRIu32 " bytes unused",
+             free_heap, event_sched_stack_free());
 }
 
 // System initialization
@@ -911,6 +1043,12 @@ static void init_system(void) {
     ESP_ERROR_CHECK(ret);
     ESP_LOGI(TAG, "NVS Flash initialized");
 
+    // Up before anything can record or end this wake
+    if (telemetry_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Telemetry log unavailable");
+    }
+    binlog_init();
+
     power_config_t power_cfg = {
         .target_power_gpio = TARGET_POWER_GPIO,
         .power_on_delay_ms = 100,
@@ -927,13 +1065,22 @@ static void init_system(void) {
     };
     ESP_ERROR_CHECK(power_mgmt_init(&power_cfg));
 
+    // Full speed until the web server is ready, then drop to idle PM
+    power_pm_init();
+    power_perf_acquire();
+
     wake_reason_t wake_reason = power_get_wake_reason();
     ESP_LOGI(TAG, "Wake reason: %d", wake_reason);
 
     // SWD initialization removed - only initializes when web interface requests it
     ESP_LOGI(TAG, "SWD will initialize on-demand when needed");
 
-    xTaskCreate(system_health_task, "health", 4096, NULL, 5, NULL);
+    // One worker runs all periodic checks and the failsafe deadline
+    ESP_ERROR_CHECK(event_sched_init());
+    ESP_LOGI(TAG, "Initial free heap: %d bytes", esp_get_free_heap_size());
+    sched_event_t *health_event = event_sched_create("health", system_health_check,
+                                                     NULL, HEALTH_CHECK_INTERVAL_MS);
+    event_sched_after(health_event, HEALTH_CHECK_INTERVAL_MS);
 
     // ========================================================================
     // Initialize hardware watchdog last (after all other initialization)
@@ -963,41 +1110,36 @@ static esp_err_t release_swd_handler(httpd_req_t *req) {
 // =============================================================================
 
 /**
- * @brief High-priority task that forces reboot after configured timeout
+ * @brief Failsafe deadline reached - shut down cleanly and reboot
  */
-static void failsafe_reboot_task(void *arg) {
-    uint32_t timeout_sec = *((uint32_t*)arg);
-    uint32_t elapsed_sec = 0;
-
-    ESP_LOGW(TAG, "╔════════════════════════════════════════════════════════════╗");
-    ESP_LOGW(TAG, "║  FAILSAFE TIMER ARMED: Device will reboot in %4lu seconds  ║", timeout_sec);
-    ESP_LOGW(TAG, "║  This ensures device returns to sleep/wake cycle          ║");
-    ESP_LOGW(TAG, "╚════════════════════════════════════════════════════════════╝");
-
-    // Main countdown loop - check every 10 seconds
-    while (elapsed_sec < timeout_sec) {
-        uint32_t remaining = timeout_sec - elapsed_sec;
-
-        // Log warnings in final 5 minutes
-        if (remaining <= 300 && remaining % 60 == 0) {
-            ESP_LOGW(TAG, "⏰ FAILSAFE: %lu minutes until automatic reboot", remaining / 60);
-        }
-
-        vTaskDelay(pdMS_TO_TICKS(10000));
-        elapsed_sec += 10;
-    }
-
-    // TIMEOUT REACHED - FORCE REBOOT
+static void failsafe_reboot(void) {
     ESP_LOGW(TAG, "");
     ESP_LOGW(TAG, "╔════════════════════════════════════════════════════════════╗");
     ESP_LOGW(TAG, "║           FAILSAFE TRIGGERED - FORCING REBOOT              ║");
     ESP_LOGW(TAG, "╚════════════════════════════════════════════════════════════╝");
-    ESP_LOGW(TAG, "Reason: Maximum uptime (%lu sec) reached", timeout_sec);
+    uint32_t session_sec = (uint32_t)((esp_timer_get_time() - failsafe_start_us) / 1000000LL);
+    if (failsafe_activity_ms == 0) {
+        ESP_LOGW(TAG, "Reason: no client activity within %d sec", FAILSAFE_IDLE_SEC);
+    } else if (session_sec >= MAX_UPTIME_AFTER_WIFI_SEC) {
+        ESP_LOGW(TAG, "Reason: maximum uptime (%" PRIu32 " sec) reached", (uint32_t)MAX_UPTIME_AFTER_WIFI_SEC);
+    } else {
+        ESP_LOGW(TAG, "Reason: idle for %d sec after last request", FAILSAFE_ACTIVITY_SEC);
+    }
 
     // Get final battery status
     battery_status_t battery;
     if (power_get_battery_status(&battery) == ESP_OK) {
         ESP_LOGI(TAG, "Final battery: %.2fV (%.0f%%)", battery.voltage, battery.percentage);
+        power_history_record(battery.voltage, 0);
+    }
+    power_energy_sync();
+
+    // A /debug session left without op=release keeps the radio halted with
+    // comparators armed, and they survive our reboot
+    if (swd_is_connected()) {
+        ESP_LOGW(TAG, "Releasing target left connected...");
+        swd_release_target();
+        swd_shutdown();
     }
 
     // Prepare GPIO states
@@ -1026,6 +1168,86 @@ static void failsafe_reboot_task(void *arg) {
     esp_restart();
 }
 
+/**
+ * @brief Current deadline: a short idle window until the first request, a
+ * longer one after each request or job, never past the hard cap
+ */
+static int64_t failsafe_deadline_us(void) {
+    int64_t cap_us = failsafe_start_us + (int64_t)MAX_UPTIME_AFTER_WIFI_SEC * 1000000LL;
+    uint32_t activity_ms = failsafe_activity_ms;
+    int64_t deadline_us;
+
+    if (activity_ms == 0) {
+        deadline_us = failsafe_start_us + (int64_t)FAILSAFE_IDLE_SEC * 1000000LL;
+    } else {
+        deadline_us = (int64_t)activity_ms * 1000LL + (int64_t)FAILSAFE_ACTIVITY_SEC * 1000000LL;
+    }
+    return deadline_us < cap_us ? deadline_us : cap_us;
+}
+
+static uint32_t failsafe_remaining_ms(void) {
+    int64_t remaining_us = failsafe_deadline_us() - esp_timer_get_time();
+    return remaining_us > 0 ? (uint32_t)(remaining_us / 1000) : 0;
+}
+
+/**
+ * @brief An operator request or job step - pushes the deadline out. Only
+ * stores a timestamp; the armed event re-checks when it fires, and activity
+ * only ever moves the deadline later, so the event is never late.
+ */
+static void failsafe_note_activity(void) {
+    if (failsafe_armed) {
+        failsafe_activity_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    }
+}
+
+/**
+ * @brief Arm the next failsafe wakeup: 5 minutes before the deadline, then
+ * on each minute boundary for the countdown warnings, then the deadline
+ */
+static void failsafe_schedule_next(void) {
+    uint32_t remaining_ms = failsafe_remaining_ms();
+    uint32_t delay_ms;
+
+    if (remaining_ms > 300000) {
+        delay_ms = remaining_ms - 300000;
+    } else if (remaining_ms > 60000) {
+        delay_ms = remaining_ms % 60000 ? remaining_ms % 60000 : 60000;
+    } else {
+        delay_ms = remaining_ms;
+    }
+
+    event_sched_after(failsafe_event, delay_ms);
+}
+
+/**
+ * @brief Scheduled failsafe event - countdown warning, re-arm or reboot
+ */
+static void failsafe_deadline_handler(void *arg) {
+    // A running job holds the perf or SWD lock - it counts as activity and
+    // is never cut off, even past the hard cap
+    if (power_perf_active() || swd_is_busy()) {
+        failsafe_note_activity();
+        ESP_LOGI(TAG, "Failsafe: job in progress - rechecking in %d ms", FAILSAFE_BUSY_RECHECK_MS);
+        event_sched_after(failsafe_event, FAILSAFE_BUSY_RECHECK_MS);
+        return;
+    }
+
+    uint32_t remaining_ms = failsafe_remaining_ms();
+
+    if (remaining_ms > 500) {
+        // Activity moved the deadline - only the final minutes are worth a warning
+        if (remaining_ms <= 300500) {
+            ESP_LOGW(TAG, "⏰ FAILSAFE: %" PRIu32 " minutes until automatic reboot",
+                    (remaining_ms + 500) / 60000);
+        }
+        failsafe_schedule_next();
+        return;
+    }
+
+    failsafe_reboot();
+}
+
 /**
  * @brief Start the failsafe reboot timer
  */
@@ -1040,28 +1262,27 @@ static void start_failsafe_timer(void) {
         return;
     }
 
-    static uint32_t timeout = MAX_UPTIME_AFTER_WIFI_SEC;
+    uint32_t timeout = FAILSAFE_IDLE_SEC < MAX_UPTIME_AFTER_WIFI_SEC ?
+                       FAILSAFE_IDLE_SEC : MAX_UPTIME_AFTER_WIFI_SEC;
 
-    BaseType_t result = xTaskCreate(
-        failsafe_reboot_task,
-        "failsafe",
-        4096,                           // Stack size
-        &timeout,                       // Pass timeout as parameter
-        configMAX_PRIORITIES - 1,       // HIGHEST priority
-        &failsafe_task_handle
-    );
-
-    if (result != pdPASS) {
-        ESP_LOGE(TAG, "CRITICAL: Failed to create failsafe task!");
+    failsafe_event = event_sched_create("failsafe", failsafe_deadline_handler, NULL, 0);
+    if (!failsafe_event) {
+        ESP_LOGE(TAG, "CRITICAL: Failed to create failsafe event!");
         return;
     }
 
+    failsafe_start_us = esp_timer_get_time();
+    failsafe_activity_ms = 0;
     failsafe_armed = true;
-    failsafe_start_time = xTaskGetTickCount() * portTICK_PERIOD_MS / 1000;
+    failsafe_schedule_next();
 
+    ESP_LOGW(TAG, "╔════════════════════════════════════════════════════════════╗");
+    ESP_LOGW(TAG, "║  FAILSAFE TIMER ARMED: Device will reboot in %4" PRIu32 " seconds  ║", timeout);
+    ESP_LOGW(TAG, "║  This ensures device returns to sleep/wake cycle          ║");
+    ESP_LOGW(TAG, "╚════════════════════════════════════════════════════════════╝");
     ESP_LOGW(TAG, "");
-    ESP_LOGW(TAG, "⏰ FAILSAFE ENABLED: Device will auto-reboot in %lu seconds (%.1f hours)",
-            timeout, timeout / 3600.0f);
+    ESP_LOGW(TAG, "⏰ FAILSAFE ENABLED: reboot after %" PRIu32 " s without a client, %d s after the last"
+            " request, %d s at most", timeout, FAILSAFE_ACTIVITY_SEC, MAX_UPTIME_AFTER_WIFI_SEC);
     ESP_LOGW(TAG, "   This prevents battery drain from extended wake periods");
     ESP_LOGW(TAG, "");
 }
@@ -1073,23 +1294,63 @@ void get_failsafe_status(bool *is_armed, uint32_t *remaining_sec) {
     if (!is_armed || !remaining_sec) return;
 
     *is_armed = failsafe_armed;
+    *remaining_sec = failsafe_armed ? failsafe_remaining_ms() / 1000 : 0;
+}
 
-    if (failsafe_armed) {
-        uint32_t current_time = xTaskGetTickCount() * portTICK_PERIOD_MS / 1000;
-        uint32_t elapsed = current_time - failsafe_start_time;
+// =============================================================================
+// ACTIVE MODE MONITORING (scheduled events)
+// =============================================================================
 
-        if (elapsed < MAX_UPTIME_AFTER_WIFI_SEC) {
-            *remaining_sec = MAX_UPTIME_AFTER_WIFI_SEC - elapsed;
-        } else {
-            *remaining_sec = 0;
-        }
+static void absolute_timer_check(void *arg) {
+    power_check_absolute_timer();  // Will reboot if threshold exceeded
+}
+
+// Keeps the cached battery reading fresh between jobs
+static void battery_sample_event(void *arg) {
+    power_battery_refresh(0);
+}
+
+static void active_battery_check(void *arg) {
+    battery_status_t batt;
+    power_get_battery_status(&batt);
+
+    // Get absolute timer status if enabled
+    uint64_t accumulated, limit, remaining;
+    if (power_get_absolute_timer_status(&accumulated, &limit, &remaining) == ESP_OK) {
+        uint64_t acc_min = accumulated / 60;
+        uint64_t lim_min = limit / 60;
+
+        ESP_LOGI(TAG, "Active: Battery=%.2fV (%.0f%%) | WiFi=%s | Wake=%" PRIu32 " | nRF52=%s | Uptime=%" PRIu64 "/%" PRIu64 "m",
+                batt.voltage,
+                batt.percentage,
+                wifi_manager_is_connected() ? "Connected" : "Disconnected",
+                power_get_wake_count(),
+                power_target_is_on() ? "ON" : "OFF",
+                acc_min,
+                lim_min);
     } else {
-        *remaining_sec = 0;
+        ESP_LOGI(TAG, "Active: Battery=%.2fV (%.0f%%) | WiFi=%s | Wake=%" PRIu32 " | nRF52=%s",
+                batt.voltage,
+                batt.percentage,
+                wifi_manager_is_connected() ? "Connected" : "Disconnected",
+                power_get_wake_count(),
+                power_target_is_on() ? "ON" : "OFF");
+    }
+
+    // Check if battery dropped below threshold during active mode
+    if (batt.voltage < NRF52_POWER_OFF_VOLTAGE &&
+        power_target_is_on() &&
+        ENABLE_BATTERY_PROTECTION) {
+        ESP_LOGW(TAG, "Battery dropped below %.2fV during active mode - turning off nRF52",
+                NRF52_POWER_OFF_VOLTAGE);
+        power_target_off();
     }
 }
 
 // Main application entry
 void app_main(void) {
+    phase_timer_init();
+
     // =========================================================================
     // BROWNOUT LOOP PROTECTION - Hardware BMS System
     // =========================================================================
@@ -1222,13 +1483,14 @@ void app_main(void) {
 
     esp_sleep_wakeup_cause_t wake_cause = esp_sleep_get_wakeup_cause();
     if (wake_cause == ESP_SLEEP_WAKEUP_TIMER) {
-        ESP_LOGI(TAG, "=== Woke from deep sleep (count: %lu) ===",
+        ESP_LOGI(TAG, "=== Woke from deep sleep (count: %" PRIu32 ") ===",
                  power_get_wake_count());
     } else {
         ESP_LOGI(TAG, "=== Fresh boot (power on) ===");
     }
 
     // Initialize system
+    phase_timer_begin(PHASE_INIT);
     init_system();
 
     // ========================================================================
@@ -1253,6 +1515,7 @@ void app_main(void) {
     // STATE: BATTERY CHECK (ONCE)
     // =========================================================================
     wake_ctx.state = WAKE_STATE_BATTERY_CHECK;
+    phase_timer_begin(PHASE_BATTERY_CHECK);
     ESP_LOGI(TAG, "");
     ESP_LOGI(TAG, "╔════════════════════════════════════════════════════════════╗");
     ESP_LOGI(TAG, "║  STATE: BATTERY CHECK                                      ║");
@@ -1281,6 +1544,8 @@ void app_main(void) {
         ESP_LOGW(TAG, "");
 
         power_target_off();  // Turn off nRF52
+        power_history_set_outcome(HISTORY_OUTCOME_LOW_BATTERY);
+        phase_timer_end();
         power_enter_adaptive_deep_sleep();
         // Never returns
     }
@@ -1289,6 +1554,7 @@ void app_main(void) {
     // STATE: NRF52 POWER DECISION (ONCE)
     // =========================================================================
     wake_ctx.state = WAKE_STATE_NRF52_DECISION;
+    phase_timer_begin(PHASE_NRF52_DECISION);
     ESP_LOGI(TAG, "");
     ESP_LOGI(TAG, "╔════════════════════════════════════════════════════════════╗");
     ESP_LOGI(TAG, "║  STATE: NRF52 POWER DECISION                               ║");
@@ -1343,10 +1609,15 @@ void app_main(void) {
         }
     }
 
+    // Heartbeat probe runs on the scheduler worker alongside the WiFi connect
+    target_monitor_start();
+
     // =========================================================================
     // STATE: WIFI SCAN
     // =========================================================================
     wake_ctx.state = WAKE_STATE_WIFI_SCAN;
+    phase_timer_begin(PHASE_WIFI_CONNECT);
+    power_energy_enter(ENERGY_WIFI_CONNECT);
     ESP_LOGI(TAG, "");
     ESP_LOGI(TAG, "╔════════════════════════════════════════════════════════════╗");
     ESP_LOGI(TAG, "║  STATE: WIFI SCAN                                          ║");
@@ -1370,6 +1641,8 @@ void app_main(void) {
                 wake_ctx.battery.is_critical ? "Critical" : "Normal");
 
         wake_ctx.state = WAKE_STATE_SLEEP;
+        power_history_set_outcome(HISTORY_OUTCOME_NO_WIFI);
+        phase_timer_end_as(PHASE_WIFI_FAILED);
         power_enter_adaptive_deep_sleep();
         // Never returns
     }
@@ -1379,6 +1652,9 @@ void app_main(void) {
     // =========================================================================
     wake_ctx.state = WAKE_STATE_ACTIVE;
     wake_ctx.wifi_connected = true;
+    phase_timer_begin(PHASE_ACTIVE_SETUP);
+    power_energy_enter(ENERGY_ACTIVE_IDLE);
+    power_history_set_outcome(HISTORY_OUTCOME_IDLE);
 
     ESP_LOGI(TAG, "");
     ESP_LOGI(TAG, "╔════════════════════════════════════════════════════════════╗");
@@ -1403,6 +1679,10 @@ void app_main(void) {
     ESP_LOGI(TAG, "Initializing storage...");
     init_storage();
 
+    // Golden image check needs the cache in storage and must finish before
+    // the web server can start a job
+    golden_check_on_wake(wake_ctx.wake_count);
+
     // Start web server
     ESP_LOGI(TAG, "Starting web server...");
     esp_err_t server_result = start_webserver();
@@ -1415,6 +1695,9 @@ void app_main(void) {
 
     // SWD testing removed - triggers automatically from web interface
 
+    phase_timer_ready();
+    power_perf_release();  // Idle: DFS, light sleep, modem sleep until a job runs
+
     // System ready
     ESP_LOGI(TAG, "");
     ESP_LOGI(TAG, "╔════════════════════════════════════════════════════════════╗");
@@ -1425,74 +1708,28 @@ void app_main(void) {
     ESP_LOGI(TAG, "  WiFi Mode: %s", power_get_wifi_is_lr() ? "ESP-LR" : "Normal");
     ESP_LOGI(TAG, "  Battery: %.2fV (%.0f%%)",
              wake_ctx.battery.voltage, wake_ctx.battery.percentage);
-    ESP_LOGI(TAG, "  Wake Count: %lu", wake_ctx.wake_count);
+    ESP_LOGI(TAG, "  Wake Count: %" PRIu32, wake_ctx.wake_count);
     ESP_LOGI(TAG, "╚════════════════════════════════════════════════════════════╝");
     ESP_LOGI(TAG, "");
 
     // =========================================================================
     // BACKGROUND MONITORING (Active Mode Only)
     // =========================================================================
+    // Scheduled events on the shared worker - app_main returns and its stack
+    // is freed, and nothing wakes the CPU between checks
     ESP_LOGI(TAG, "Starting background monitoring (60 second interval)...");
-    TickType_t last_battery_check = xTaskGetTickCount();
-    TickType_t last_absolute_timer_check = xTaskGetTickCount();
-
-    while (1) {
-        vTaskDelay(pdMS_TO_TICKS(5000));  // Check every 5 seconds
-
-        // ====================================================================
-        // CRITICAL: Check absolute uptime timer (every 60 seconds)
-        // Ensures scheduled reboot happens even during long WiFi sessions
-        // This is independent of WiFi failsafe timer
-        // ====================================================================
-        if ((xTaskGetTickCount() - last_absolute_timer_check) > pdMS_TO_TICKS(60000)) {
-            power_check_absolute_timer();  // Will reboot if threshold exceeded
-            last_absolute_timer_check = xTaskGetTickCount();
-        }
 
-        // ====================================================================
-        // CRITICAL: Feed hardware watchdog to prevent reboot
-        // Must be called at least every 60 seconds
-        // ====================================================================
-        // power_feed_watchdog();
-
-        // Battery monitoring every 60 seconds
-        if ((xTaskGetTickCount() - last_battery_check) > pdMS_TO_TICKS(60000)) {
-            battery_status_t batt;
-            power_get_battery_status(&batt);
-
-            // Get absolute timer status if enabled
-            uint64_t accumulated, limit, remaining;
-            if (power_get_absolute_timer_status(&accumulated, &limit, &remaining) == ESP_OK) {
-                uint64_t acc_min = accumulated / 60;
-                uint64_t lim_min = limit / 60;
-
-                ESP_LOGI(TAG, "Active: Battery=%.2fV (%.0f%%) | WiFi=%s | Wake=%lu | nRF52=%s | Uptime=%llu/%llum",
-                        batt.voltage,
-                        batt.percentage,
-                        wifi_manager_is_connected() ? "Connected" : "Disconnected",
-                        wake_ctx.wake_count,
-                        power_target_is_on() ? "ON" : "OFF",
-                        acc_min,
-                        lim_min);
-            } else {
-                ESP_LOGI(TAG, "Active: Battery=%.2fV (%.0f%%) | WiFi=%s | Wake=%lu | nRF52=%s",
-                        batt.voltage,
-                        batt.percentage,
-                        wifi_manager_is_connected() ? "Connected" : "Disconnected",
-                        wake_ctx.wake_count,
-                        power_target_is_on() ? "ON" : "OFF");
-            }
+    // CRITICAL: absolute uptime timer - ensures scheduled reboot happens even
+    // during long WiFi sessions, independent of the WiFi failsafe timer
+    sched_event_t *absolute_timer_event = event_sched_create("abs_timer",
+            absolute_timer_check, NULL, ACTIVE_MONITOR_INTERVAL_MS);
+    event_sched_after(absolute_timer_event, ACTIVE_MONITOR_INTERVAL_MS);
 
-            // Check if battery dropped below threshold during active mode
-            if (batt.voltage < NRF52_POWER_OFF_VOLTAGE &&
-                power_target_is_on() &&
-                ENABLE_BATTERY_PROTECTION) {
-                ESP_LOGW(TAG, "Battery dropped below %.2fV during active mode - turning off nRF52",
-                        NRF52_POWER_OFF_VOLTAGE);
-                power_target_off();
-            }
+    sched_event_t *battery_sample = event_sched_create("batt_sample",
+            battery_sample_event, NULL, BATTERY_SAMPLE_INTERVAL_MS);
+    event_sched_after(battery_sample, BATTERY_SAMPLE_INTERVAL_MS);
 
-            last_battery_check = xTaskGetTickCount();
-        }
-    }
+    sched_event_t *battery_event = event_sched_create("battery",
+            active_battery_check, NULL, ACTIVE_MONITOR_INTERVAL_MS);
+    event_sched_after(battery_event, ACTIVE_MONITOR_INTERVAL_MS);
 }
\ No newline at end of file
@@ -0,0 +1,115 @@
+// phase_timer.c - Boot/wake phase timing, persisted across deep sleep
+#include "phase_timer.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include <string.h>
+
+static const char *TAG = "PHASE";
+
+#define PHASE_STATS_MAGIC   0x50484153  // "PHAS"
+#define PHASE_AVG_SHIFT     3           // EMA weight 1/8
+
+typedef struct {
+    uint32_t magic;
+    phase_stats_t phases[PHASE_COUNT];
+} phase_rtc_t;
+
+RTC_DATA_ATTR static phase_rtc_t rtc_phases;
+
+static boot_phase_t current_phase = PHASE_COUNT;  // PHASE_COUNT = none running
+static int64_t phase_start_us = 0;
+
+static const char *phase_names[PHASE_COUNT] = {
+    [PHASE_BOOT]            = "boot",
+    [PHASE_INIT]            = "init",
+    [PHASE_BATTERY_CHECK]   = "battery_check",
+    [PHASE_NRF52_DECISION]  = "nrf52_decision",
+    [PHASE_WIFI_CONNECT]    = "wifi_connect",
+    [PHASE_WIFI_FAILED]     = "wifi_failed",
+    [PHASE_ACTIVE_SETUP]    = "active_setup",
+    [PHASE_WAKE_TO_READY]   = "wake_to_ready",
+};
+
+void phase_stats_add(phase_stats_t *s, int64_t duration_us) {
+    if (duration_us < 0) {
+        return;
+    }
+
+    uint32_t us = duration_us > UINT32_MAX ? UINT32_MAX : (uint32_t)duration_us;
+
+    if (s->count == 0) {
+        s->min_us = us;
+        s->max_us = us;
+        s->avg_us = us;
+    } else {
+        if (us < s->min_us) s->min_us = us;
+        if (us > s->max_us) s->max_us = us;
+        s->avg_us = (uint32_t)((int64_t)s->avg_us +
+                               (((int64_t)us - (int64_t)s->avg_us) >> PHASE_AVG_SHIFT));
+    }
+    s->last_us = us;
+    s->count++;
+}
+
+static void phase_record(boot_phase_t phase, int64_t duration_us) {
+    if (phase >= PHASE_COUNT || duration_us < 0) {
+        return;
+    }
+
+    phase_stats_t *s = &rtc_phases.phases[phase];
+    phase_stats_add(s, duration_us);
+
+    ESP_LOGI(TAG, "%s: %" PRIu32 " ms (avg %" PRIu32 " ms over %" PRIu32 " wakes)",
+             phase_names[phase], s->last_us / 1000, s->avg_us / 1000, s->count);
+}
+
+void phase_timer_init(void) {
+    int64_t now = esp_timer_get_time();
+
+    if (rtc_phases.magic != PHASE_STATS_MAGIC) {
+        memset(&rtc_phases, 0, sizeof(rtc_phases));
+        rtc_phases.magic = PHASE_STATS_MAGIC;
+    }
+
+    // esp_timer starts counting during early startup, so this is the time
+    // from reset to app_main (ROM/bootloader time before that is not visible)
+    phase_record(PHASE_BOOT, now);
+    current_phase = PHASE_COUNT;
+    phase_start_us = now;
+}
+
+void phase_timer_end_as(boot_phase_t phase) {
+    if (current_phase == PHASE_COUNT) {
+        return;
+    }
+    phase_record(phase, esp_timer_get_time() - phase_start_us);
+    current_phase = PHASE_COUNT;
+}
+
+void phase_timer_end(void) {
+    phase_timer_end_as(current_phase);
+}
+
+void phase_timer_begin(boot_phase_t phase) {
+    phase_timer_end();
+    current_phase = phase;
+    phase_start_us = esp_timer_get_time();
+}
+
+void phase_timer_ready(void) {
+    phase_timer_end();
+    phase_record(PHASE_WAKE_TO_READY, esp_timer_get_time());
+}
+
+bool phase_timer_get(boot_phase_t phase, phase_stats_t *stats) {
+    if (phase >= PHASE_COUNT || !stats || rtc_phases.magic != PHASE_STATS_MAGIC) {
+        return false;
+    }
+    *stats = rtc_phases.phases[phase];
+    return true;
+}
+
+const char* phase_timer_name(boot_phase_t phase) {
+    return phase < PHASE_COUNT ? phase_names[phase] : "unknown";
+}
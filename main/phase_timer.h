@@ -0,0 +1,48 @@
+// phase_timer.h - Boot/wake phase timing, persisted across deep sleep
+#ifndef PHASE_TIMER_H
+#define PHASE_TIMER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Wake phases, in the order app_main walks through them
+typedef enum {
+    PHASE_BOOT = 0,         // Reset/wake to app_main (bootloader + startup)
+    PHASE_INIT,             // NVS, power management, ADC, RTC restore
+    PHASE_BATTERY_CHECK,
+    PHASE_NRF52_DECISION,
+    PHASE_WIFI_CONNECT,     // Successful connect, including DHCP
+    PHASE_WIFI_FAILED,      // Time burnt on a connect that failed
+    PHASE_ACTIVE_SETUP,     // Failsafe, storage, web server
+    PHASE_WAKE_TO_READY,    // Total: reset to web server ready
+    PHASE_COUNT
+} boot_phase_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t last_us;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint32_t avg_us;        // Rolling average (EMA, 1/8 weight)
+} phase_stats_t;
+
+// Call first thing in app_main - records PHASE_BOOT and validates RTC stats
+void phase_timer_init(void);
+
+// End the running phase (if any) and start the next one
+void phase_timer_begin(boot_phase_t phase);
+
+// End the running phase, optionally booking its time to a different phase
+void phase_timer_end(void);
+void phase_timer_end_as(boot_phase_t phase);
+
+// Web server is up - ends the running phase and records PHASE_WAKE_TO_READY
+void phase_timer_ready(void);
+
+// Fold one duration into a stats block (shared with the WiFi latency stats)
+void phase_stats_add(phase_stats_t *stats, int64_t duration_us);
+
+bool phase_timer_get(boot_phase_t phase, phase_stats_t *stats);
+const char* phase_timer_name(boot_phase_t phase);
+
+#endif // PHASE_TIMER_H
@@ -0,0 +1,198 @@
+// target_monitor.c - nRF52 liveness check with automatic power-cycle
+//
+// A radio firmware that hangs keeps drawing current and stops relaying, and
+// nobody notices until a site visit. The monitor reads a heartbeat from the
+// running target - a counter the firmware increments in RAM, or the DWT
+// cycle counter when no address is configured - with swd_probe(): one
+// non-halting read, well under a millisecond of SWD time. A value that does
+// not move for TARGET_MONITOR_STALL_CHECKS probes in a row means the core is
+// stuck, and the radio gets power-cycled.
+//
+// The last value and stall count live in RTC memory, so probes from
+// successive wakes count towards the same verdict. CYCCNT stops while the
+// nRF52 sleeps in WFE; it only works as a heartbeat for firmware that never
+// idles long enough to sleep through a whole probe interval.
+#include "target_monitor.h"
+#include "config.h"
+#include "event_sched.h"
+#include "power_mgmt.h"
+#include "swd_core.h"
+#include "esp_log.h"
+#include "esp_attr.h"
+#include <string.h>
+
+static const char *TAG = "TARGET_MON";
+
+#define MONITOR_MAGIC       0x544D4F4E  // "TMON"
+
+typedef struct {
+    uint32_t magic;
+    uint8_t have_value;
+    uint8_t reserved[3];
+    uint32_t last_value;
+    uint32_t stalls;
+    uint32_t probes;
+    uint32_t failures;
+    uint32_t cycles;
+    uint32_t max_probe_us;
+} monitor_rtc_t;
+
+RTC_DATA_ATTR static monitor_rtc_t rtc_monitor;
+
+static sched_event_t *monitor_event = NULL;
+static uint32_t skipped = 0;
+static uint32_t last_probe_us = 0;
+
+static const swd_config_t probe_cfg = {
+    .pin_swclk = SWD_PIN_SWCLK,
+    .pin_swdio = SWD_PIN_SWDIO,
+    .pin_reset = SWD_PIN_RESET,
+    .swclk_khz = SWD_TARGET_KHZ
+};
+
+static void monitor_forget_value(void) {
+    rtc_monitor.have_value = 0;
+    rtc_monitor.stalls = 0;
+}
+
+// DWT mode reads the enables along with the counter and switches them on
+// (read-modify-write, keeping the firmware's own trace settings) if needed
+static esp_err_t monitor_read_heartbeat(uint32_t *value, uint32_t *probe_us) {
+    if (TARGET_MONITOR_HEARTBEAT_ADDR != 0) {
+        swd_mem_op_t op = { .addr = TARGET_MONITOR_HEARTBEAT_ADDR };
+        esp_err_t ret = swd_probe(&probe_cfg, &op, 1, probe_us);
+        *value = op.value;
+        return ret;
+    }
+
+    swd_mem_op_t ops[3] = {
+        { .addr = DEMCR_ADDR },
+        { .addr = DWT_CTRL_ADDR },
+        { .addr = DWT_CYCCNT_ADDR },
+    };
+    esp_err_t ret = swd_probe(&probe_cfg, ops, 3, probe_us);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    *value = ops[2].value;
+
+    if (!(ops[0].value & DEMCR_TRCENA) || !(ops[1].value & DWT_CTRL_CYCCNTENA)) {
+        swd_mem_op_t enable[2] = {
+            { .addr = DEMCR_ADDR, .value = ops[0].value | DEMCR_TRCENA, .write = true },
+            { .addr = DWT_CTRL_ADDR, .value = ops[1].value | DWT_CTRL_CYCCNTENA, .write = true },
+        };
+        uint32_t enable_us = 0;
+        ret = swd_probe(&probe_cfg, enable, 2, &enable_us);
+        *probe_us += enable_us;
+        if (ret == ESP_OK) {
+            ESP_LOGI(TAG, "Cycle counter enabled on target");
+            return ESP_ERR_NOT_FINISHED;  // No baseline yet
+        }
+    }
+    return ret;
+}
+
+static void monitor_check(void *arg) {
+    if (!power_target_is_on()) {
+        monitor_forget_value();
+        return;
+    }
+    // Never share the pins with a job, and never slow one down
+    if (swd_is_initialized() || swd_is_busy() || power_perf_active()) {
+        skipped++;
+        return;
+    }
+
+    uint32_t value = 0;
+    uint32_t probe_us = 0;
+    swd_busy_begin();
+    esp_err_t ret = monitor_read_heartbeat(&value, &probe_us);
+    swd_busy_end();
+
+    last_probe_us = probe_us;
+    if (probe_us > rtc_monitor.max_probe_us) {
+        rtc_monitor.max_probe_us = probe_us;
+    }
+
+    if (ret == ESP_ERR_NOT_FINISHED) {
+        monitor_forget_value();
+        return;
+    }
+    if (ret != ESP_OK) {
+        // No answer says nothing about the firmware (debug port may be locked
+        // or disconnected) - don't build a stall verdict on it
+        rtc_monitor.failures++;
+        ESP_LOGW(TAG, "Probe failed: %s (%" PRIu32 " us)", esp_err_to_name(ret), probe_us);
+        return;
+    }
+
+    rtc_monitor.probes++;
+    if (probe_us > 1000) {
+        ESP_LOGW(TAG, "Probe took %" PRIu32 " us", probe_us);
+    }
+
+    if (!rtc_monitor.have_value || value != rtc_monitor.last_value) {
+        rtc_monitor.have_value = 1;
+        rtc_monitor.last_value = value;
+        rtc_monitor.stalls = 0;
+        ESP_LOGD(TAG, "Heartbeat 0x%08" PRIx32 " (%" PRIu32 " us)", value, probe_us);
+        return;
+    }
+
+    rtc_monitor.stalls++;
+    ESP_LOGW(TAG, "Heartbeat stuck at 0x%08" PRIx32 " (%" PRIu32 "/%d)",
+             value, rtc_monitor.stalls, TARGET_MONITOR_STALL_CHECKS);
+    if (rtc_monitor.stalls < TARGET_MONITOR_STALL_CHECKS) {
+        return;
+    }
+
+    ESP_LOGE(TAG, "Target hung - power-cycling the radio");
+    monitor_forget_value();
+    if (power_target_cycle(TARGET_MONITOR_CYCLE_OFF_MS) == ESP_OK) {
+        rtc_monitor.cycles++;
+    }
+}
+
+esp_err_t target_monitor_start(void) {
+    if (!TARGET_MONITOR_ENABLE) {
+        return ESP_OK;
+    }
+
+    if (rtc_monitor.magic != MONITOR_MAGIC) {
+        memset(&rtc_monitor, 0, sizeof(rtc_monitor));
+        rtc_monitor.magic = MONITOR_MAGIC;
+    }
+
+    if (monitor_event == NULL) {
+        monitor_event = event_sched_create("target_mon", monitor_check, NULL,
+                                           TARGET_MONITOR_INTERVAL_MS);
+        if (monitor_event == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    if (TARGET_MONITOR_HEARTBEAT_ADDR != 0) {
+        ESP_LOGI(TAG, "Monitoring heartbeat at 0x%08" PRIx32 " every %d ms",
+                 (uint32_t)TARGET_MONITOR_HEARTBEAT_ADDR, TARGET_MONITOR_INTERVAL_MS);
+    } else {
+        ESP_LOGI(TAG, "Monitoring DWT cycle counter every %d ms", TARGET_MONITOR_INTERVAL_MS);
+    }
+    return event_sched_after(monitor_event, 0);
+}
+
+void target_monitor_get_status(target_monitor_status_t *status) {
+    memset(status, 0, sizeof(*status));
+    status->enabled = TARGET_MONITOR_ENABLE;
+    status->dwt_mode = TARGET_MONITOR_HEARTBEAT_ADDR == 0;
+    status->heartbeat_addr = TARGET_MONITOR_HEARTBEAT_ADDR;
+    status->skipped = skipped;
+    status->last_probe_us = last_probe_us;
+    if (rtc_monitor.magic == MONITOR_MAGIC) {
+        status->probes = rtc_monitor.probes;
+        status->failures = rtc_monitor.failures;
+        status->stalls = rtc_monitor.stalls;
+        status->cycles = rtc_monitor.cycles;
+        status->last_value = rtc_monitor.last_value;
+        status->max_probe_us = rtc_monitor.max_probe_us;
+    }
+}
@@ -0,0 +1,29 @@
+// target_monitor.h - nRF52 liveness check with automatic power-cycle
+#ifndef TARGET_MONITOR_H
+#define TARGET_MONITOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+typedef struct {
+    bool enabled;
+    bool dwt_mode;              // Heartbeat is the DWT cycle counter
+    uint32_t heartbeat_addr;
+    uint32_t probes;            // Successful probes (lifetime, RTC)
+    uint32_t failures;          // Probes the target did not answer
+    uint32_t skipped;           // Probes skipped for a running job
+    uint32_t stalls;            // Consecutive probes without progress
+    uint32_t cycles;            // Power-cycles triggered (lifetime, RTC)
+    uint32_t last_value;
+    uint32_t last_probe_us;     // SWD time of the latest probe
+    uint32_t max_probe_us;
+} target_monitor_status_t;
+
+// Probe once now and every TARGET_MONITOR_INTERVAL_MS while awake.
+// No-op unless TARGET_MONITOR_ENABLE; the event scheduler must be running.
+esp_err_t target_monitor_start(void);
+
+void target_monitor_get_status(target_monitor_status_t *status);
+
+#endif // TARGET_MONITOR_H
@@ -1,34 +1,243 @@
+// wifi_manager.c - Event-driven WiFi connection state machine
+//
+// WIFI_EVENT / IP_EVENT callbacks only record what happened (event group
+// bits) and drive the in-session reconnect. The connect sequence walks the
+// states STARTING -> SCANNING -> CONNECTING -> GETTING_IP -> CONNECTED,
+// waiting on the matching event with a per-transition timeout instead of
+// fixed delays. Each transition's latency is kept in RTC memory.
 #include "wifi_manager.h"
 #include "config.h"
+#include "event_sched.h"
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_log.h"
 #include "esp_netif.h"
+#include "esp_timer.h"
+#include "esp_mac.h"
 #include "power_mgmt.h"
+#include "power_history.h"
+#include "telemetry.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
 #include <string.h>
+#include <stdlib.h>
 
 static const char *TAG = "WIFI_MGR";
 static EventGroupHandle_t wifi_event_group = NULL;
 static const int CONNECTED_BIT = BIT0;
-static wifi_state_t current_state = WIFI_STATE_DISCONNECTED;
+static const int GOT_IP_BIT = BIT1;
+static const int FAIL_BIT = BIT2;
+static const int STARTED_BIT = BIT3;
+static const int SCAN_DONE_BIT = BIT4;
 static char current_ip[16] = "Not connected";
 static bool wifi_initialized = false;
-static bool is_connecting = false;  // Track if we're in connection process
+static bool wifi_started = false;
+static bool static_ip_active = false;
+static esp_netif_t *sta_netif = NULL;
+
+static portMUX_TYPE state_lock = portMUX_INITIALIZER_UNLOCKED;
+static wifi_state_t current_state = WIFI_STATE_DISCONNECTED;
+static sched_event_t *reconnect_event = NULL;
+static int64_t reconnect_start_us = 0;
+
+static const char *state_names[] = {
+    [WIFI_STATE_DISCONNECTED]   = "DISCONNECTED",
+    [WIFI_STATE_STARTING]       = "STARTING",
+    [WIFI_STATE_SCANNING]       = "SCANNING",
+    [WIFI_STATE_CONNECTING]     = "CONNECTING",
+    [WIFI_STATE_GETTING_IP]     = "GETTING_IP",
+    [WIFI_STATE_CONNECTED]      = "CONNECTED",
+    [WIFI_STATE_RECONNECTING]   = "RECONNECTING",
+};
+
+// Connect latency per transition, rolling stats across wakes
+#define WIFI_LATENCY_MAGIC 0x574C4154  // "WLAT"
+
+typedef struct {
+    uint32_t magic;
+    phase_stats_t steps[WIFI_STEP_COUNT];
+} wifi_rtc_latency_t;
+
+RTC_DATA_ATTR static wifi_rtc_latency_t rtc_latency;
+
+static const char *step_names[WIFI_STEP_COUNT] = {
+    [WIFI_STEP_START]       = "driver_start",
+    [WIFI_STEP_SCAN]        = "scan",
+    [WIFI_STEP_ASSOC]       = "auth_assoc",
+    [WIFI_STEP_DHCP]        = "dhcp",
+    [WIFI_STEP_RECONNECT]   = "reconnect",
+};
+
+// Last successful association, kept across deep sleep so the next wake can
+// connect straight to the same AP on a single channel
+#define WIFI_CACHE_MAGIC 0x57494649  // "WIFI"
+
+typedef struct {
+    uint32_t magic;
+    uint8_t bssid[6];
+    uint8_t channel;
+    bool is_lr;
+    uint32_t ip;        // Last lease (lwIP byte order)
+    uint32_t netmask;
+    uint32_t gw;
+    uint32_t dns;
+} wifi_rtc_cache_t;
+
+RTC_DATA_ATTR static wifi_rtc_cache_t rtc_wifi_cache;
+
+// Recent connect outcomes per mode (bit 0 = latest, 1 = success), kept
+// separately from the AP cache so they survive a cache invalidation
+#define WIFI_MODE_HISTORY_MAGIC 0x4D4F4445  // "MODE"
+#define WIFI_MODE_NORMAL 0
+#define WIFI_MODE_LR 1
+#define WIFI_SCAN_MAX_RECORDS 16
+
+typedef struct {
+    uint8_t outcomes;   // Shift register of the last 8 attempts
+    uint8_t attempts;   // Valid bits in outcomes (max 8)
+} wifi_mode_history_t;
+
+typedef struct {
+    uint32_t magic;
+    wifi_mode_history_t modes[2];
+} wifi_rtc_history_t;
+
+RTC_DATA_ATTR static wifi_rtc_history_t rtc_mode_history;
+
+// One way to reach the network: an SSID/mode, plus the AP found by the scan
+typedef struct {
+    const char *ssid;
+    const char *password;
+    bool is_lr;
+    uint8_t bssid[6];
+    uint8_t channel;    // 0 = not located, let the driver scan
+    int8_t rssi;
+    int score;
+} wifi_candidate_t;
+
+static void mode_history_record(bool is_lr, bool success) {
+    if (rtc_mode_history.magic != WIFI_MODE_HISTORY_MAGIC) {
+        memset(&rtc_mode_history, 0, sizeof(rtc_mode_history));
+        rtc_mode_history.magic = WIFI_MODE_HISTORY_MAGIC;
+    }
+
+    wifi_mode_history_t *h = &rtc_mode_history.modes[is_lr ? WIFI_MODE_LR : WIFI_MODE_NORMAL];
+    h->outcomes = (uint8_t)((h->outcomes << 1) | (success ? 1 : 0));
+    if (h->attempts < 8) {
+        h->attempts++;
+    }
+}
+
+// Successes minus failures over the recorded attempts (-8 .. 8)
+static int mode_history_balance(bool is_lr) {
+    if (rtc_mode_history.magic != WIFI_MODE_HISTORY_MAGIC) {
+        return 0;
+    }
+
+    const wifi_mode_history_t *h = &rtc_mode_history.modes[is_lr ? WIFI_MODE_LR : WIFI_MODE_NORMAL];
+    uint8_t mask = h->attempts >= 8 ? 0xFF : (uint8_t)((1 << h->attempts) - 1);
+    int successes = __builtin_popcount(h->outcomes & mask);
+    return successes - (h->attempts - successes);
+}
+
+static bool cache_valid(void) {
+    return rtc_wifi_cache.magic == WIFI_CACHE_MAGIC &&
+           rtc_wifi_cache.channel >= 1 && rtc_wifi_cache.channel <= 14;
+}
+
+static wifi_state_t get_state(void) {
+    portENTER_CRITICAL(&state_lock);
+    wifi_state_t state = current_state;
+    portEXIT_CRITICAL(&state_lock);
+    return state;
+}
+
+static wifi_state_t set_state(wifi_state_t next) {
+    portENTER_CRITICAL(&state_lock);
+    wifi_state_t prev = current_state;
+    current_state = next;
+    portEXIT_CRITICAL(&state_lock);
+
+    if (prev != next) {
+        ESP_LOGI(TAG, "State: %s -> %s", state_names[prev], state_names[next]);
+    }
+    return prev;
+}
+
+static void latency_record(wifi_step_t step, int64_t start_us) {
+    if (rtc_latency.magic != WIFI_LATENCY_MAGIC) {
+        memset(&rtc_latency, 0, sizeof(rtc_latency));
+        rtc_latency.magic = WIFI_LATENCY_MAGIC;
+    }
+
+    int64_t duration_us = esp_timer_get_time() - start_us;
+    phase_stats_add(&rtc_latency.steps[step], duration_us);
+    ESP_LOGI(TAG, "%s: %" PRId64 " ms", step_names[step], duration_us / 1000);
+}
+
+// Wait for one transition. With fail_fast a disconnect ends the wait early.
+static esp_err_t wait_transition(EventBits_t bits, uint32_t timeout_ms, bool fail_fast) {
+    EventBits_t got = xEventGroupWaitBits(wifi_event_group,
+        bits | (fail_fast ? FAIL_BIT : 0),
+        pdFALSE,
+        pdFALSE,
+        pdMS_TO_TICKS(timeout_ms));
+
+    if (got & bits) {
+        return ESP_OK;
+    }
+    return (got & FAIL_BIT) ? ESP_FAIL : ESP_ERR_TIMEOUT;
+}
+
+// Link lost mid-session: keep the web server, let the driver find the AP
+// again within the reconnect window
+static void reconnect_begin(void) {
+    if (set_state(WIFI_STATE_RECONNECTING) != WIFI_STATE_RECONNECTING) {
+        reconnect_start_us = esp_timer_get_time();
+        strcpy(current_ip, "Reconnecting");
+        ESP_LOGW(TAG, "Link lost - reconnecting for up to %d s (web server kept up)",
+                 WIFI_RECONNECT_WINDOW_SEC);
+        event_sched_after(reconnect_event, WIFI_RECONNECT_WINDOW_SEC * 1000);
+    }
+
+    if (WIFI_RECONNECT_WINDOW_SEC > 0) {
+        esp_wifi_connect();
+    }
+}
+
+static void reconnect_done(void) {
+    event_sched_cancel(reconnect_event);
+    latency_record(WIFI_STEP_RECONNECT, reconnect_start_us);
+    set_state(WIFI_STATE_CONNECTED);
+}
+
+// Reconnect window expired (scheduler worker) - fall back to sleep
+static void reconnect_timeout_handler(void *arg) {
+    if (get_state() == WIFI_STATE_RECONNECTING) {
+        ESP_LOGW(TAG, "Reconnect window expired");
+        wifi_manager_disconnect_handler();
+    }
+}
 
 static void wifi_event_handler(void* arg, esp_event_base_t event_base,
                               int32_t event_id, void* event_data) {
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
-        if (!is_connecting) {
-            esp_wifi_connect();
-        }
+        xEventGroupSetBits(wifi_event_group, STARTED_BIT);
+
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_SCAN_DONE) {
+        xEventGroupSetBits(wifi_event_group, SCAN_DONE_BIT);
+
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
-        // ALWAYS set connected bit when WiFi connects (regardless of is_connecting state)
-        ESP_LOGI(TAG, "WiFi connected to AP");
+        wifi_event_sta_connected_t *conn = (wifi_event_sta_connected_t *)event_data;
+        ESP_LOGI(TAG, "WiFi connected to AP (channel %d)", conn->channel);
+        memcpy(rtc_wifi_cache.bssid, conn->bssid, sizeof(rtc_wifi_cache.bssid));
+        rtc_wifi_cache.channel = conn->channel;
         xEventGroupSetBits(wifi_event_group, CONNECTED_BIT);
-        current_state = WIFI_STATE_CONNECTED;
-        // Don't clear is_connecting here - let it be cleared when we're done
+
+        // A fixed address needs no DHCP round - the link is back
+        if (get_state() == WIFI_STATE_RECONNECTING && static_ip_active) {
+            reconnect_done();
+        }
 
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
         wifi_event_sta_disconnected_t *disconn = (wifi_event_sta_disconnected_t *)event_data;
@@ -48,38 +257,128 @@ static void wifi_event_handler(void* arg, esp_event_base_t event_base,
         }
         ESP_LOGI(TAG, "Disconnect reason: %s", reason_str);
 
-        xEventGroupClearBits(wifi_event_group, CONNECTED_BIT);
-        current_state = WIFI_STATE_DISCONNECTED;
-        strcpy(current_ip, "Not connected");
+        xEventGroupClearBits(wifi_event_group, CONNECTED_BIT | GOT_IP_BIT);
+        xEventGroupSetBits(wifi_event_group, FAIL_BIT);
 
-        // Only handle disconnect if we're not actively connecting
-        if (!is_connecting) {
-            wifi_manager_disconnect_handler();
+        // During the connect sequence FAIL_BIT ends the attempt; in session
+        // the state machine reconnects on its own
+        wifi_state_t state = get_state();
+        if (state == WIFI_STATE_CONNECTED || state == WIFI_STATE_RECONNECTING) {
+            reconnect_begin();
+        } else if (state == WIFI_STATE_DISCONNECTED) {
+            strcpy(current_ip, "Not connected");
         }
 
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
         snprintf(current_ip, sizeof(current_ip), IPSTR, IP2STR(&event->ip_info.ip));
         ESP_LOGI(TAG, "Got IP address: %s", current_ip);
-        xEventGroupSetBits(wifi_event_group, CONNECTED_BIT);
-        current_state = WIFI_STATE_CONNECTED;
-        // Wake count managed automatically in RTC memory
-        is_connecting = false;
+
+        rtc_wifi_cache.ip = event->ip_info.ip.addr;
+        rtc_wifi_cache.netmask = event->ip_info.netmask.addr;
+        rtc_wifi_cache.gw = event->ip_info.gw.addr;
+
+        xEventGroupSetBits(wifi_event_group, CONNECTED_BIT | GOT_IP_BIT);
+
+        if (get_state() == WIFI_STATE_RECONNECTING) {
+            reconnect_done();
+        }
     }
 }
 
-static esp_err_t try_wifi_mode(const char* ssid, const char* password, bool is_lr, int timeout_sec) {
-    ESP_LOGI(TAG, "Attempting %s WiFi: %s (timeout: %ds)",
-             is_lr ? "ESP-LR" : "Normal", ssid, timeout_sec);
+// Apply a fixed address instead of running DHCP. Returns true if one was set.
+static bool apply_static_ip(bool fast) {
+    esp_netif_ip_info_t ip_info = {0};
+    esp_netif_dns_info_t dns = {0};
+
+    if (strlen(WIFI_STATIC_IP) > 0) {
+        ip_info.ip.addr = esp_ip4addr_aton(WIFI_STATIC_IP);
+        ip_info.netmask.addr = esp_ip4addr_aton(WIFI_STATIC_NETMASK);
+        ip_info.gw.addr = esp_ip4addr_aton(WIFI_STATIC_GATEWAY);
+        dns.ip.u_addr.ip4.addr = ip_info.gw.addr;
+    } else if (WIFI_REUSE_DHCP_LEASE && fast && rtc_wifi_cache.ip != 0) {
+        ip_info.ip.addr = rtc_wifi_cache.ip;
+        ip_info.netmask.addr = rtc_wifi_cache.netmask;
+        ip_info.gw.addr = rtc_wifi_cache.gw;
+        dns.ip.u_addr.ip4.addr = rtc_wifi_cache.dns ? rtc_wifi_cache.dns : rtc_wifi_cache.gw;
+    } else {
+        esp_netif_dhcpc_start(sta_netif);  // No-op if already running
+        return false;
+    }
 
-    // Clear the connected bit
-    xEventGroupClearBits(wifi_event_group, CONNECTED_BIT);
+    esp_netif_dhcpc_stop(sta_netif);
+    if (esp_netif_set_ip_info(sta_netif, &ip_info) != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to apply static IP - using DHCP");
+        esp_netif_dhcpc_start(sta_netif);
+        return false;
+    }
+    dns.ip.type = ESP_IPADDR_TYPE_V4;
+    esp_netif_set_dns_info(sta_netif, ESP_NETIF_DNS_MAIN, &dns);
+    esp_ip4addr_ntoa(&ip_info.ip, current_ip, sizeof(current_ip));
+    return true;
+}
 
-    // Stop WiFi first
-    esp_wifi_stop();
 
-    // Small delay to let things settle
-    vTaskDelay(pdMS_TO_TICKS(100));
+// Stop the driver (protocol changes need it stopped) and load the new
+// station config. A NULL config keeps the current one.
+static esp_err_t driver_configure(wifi_config_t *config, uint8_t protocol) {
+    set_state(WIFI_STATE_STARTING);
+
+    if (wifi_started) {
+        esp_wifi_stop();
+        wifi_started = false;
+    }
+
+    xEventGroupClearBits(wifi_event_group,
+        CONNECTED_BIT | GOT_IP_BIT | FAIL_BIT | STARTED_BIT | SCAN_DONE_BIT);
+
+    esp_err_t err = esp_wifi_set_mode(WIFI_MODE_STA);
+    if (err == ESP_OK && config) {
+        err = esp_wifi_set_config(WIFI_IF_STA, config);
+    }
+    if (err == ESP_OK) {
+        err = esp_wifi_set_protocol(WIFI_IF_STA, protocol);
+    }
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "WiFi configuration failed: %s", esp_err_to_name(err));
+        set_state(WIFI_STATE_DISCONNECTED);
+    }
+    return err;
+}
+
+static esp_err_t driver_start(void) {
+    int64_t start_us = esp_timer_get_time();
+
+    esp_err_t err = esp_wifi_start();
+    if (err == ESP_OK) {
+        wifi_started = true;
+        err = wait_transition(STARTED_BIT, WIFI_START_TIMEOUT_MS, false);
+    }
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "WiFi start failed: %s", esp_err_to_name(err));
+        set_state(WIFI_STATE_DISCONNECTED);
+        return err;
+    }
+
+    latency_record(WIFI_STEP_START, start_us);
+    return ESP_OK;
+}
+
+// Connect to a candidate. If it carries a channel, go straight to that
+// BSSID instead of letting the driver scan; fast marks the cached AP from
+// the last wake (fail on the first error, lease reuse allowed).
+static esp_err_t try_wifi_mode(const wifi_candidate_t *cand, uint32_t timeout_ms, bool fast) {
+    const char *ssid = cand->ssid;
+    bool is_lr = cand->is_lr;
+    bool targeted = cand->channel != 0;
+
+    ESP_LOGI(TAG, "Attempting %s WiFi%s: %s (timeout: %" PRIu32 "ms)",
+             is_lr ? "ESP-LR" : "Normal", fast ? " (cached AP)" : targeted ? " (scanned AP)" : "",
+             ssid, timeout_ms);
+
+    int64_t start_us = esp_timer_get_time();
 
     // Configure WiFi
     wifi_config_t wifi_config = {
@@ -90,93 +389,209 @@ static esp_err_t try_wifi_mode(const char* ssid, const char* password, bool is_l
             .sae_pwe_h2e = WPA3_SAE_PWE_BOTH,
             .listen_interval = 10,  // Check beacon every 10 intervals
             .sort_method = WIFI_CONNECT_AP_BY_SIGNAL,  // Connect to strongest AP
-            .failure_retry_cnt = 5,  // Retry connection 5 times before giving up
+            .failure_retry_cnt = fast ? 1 : targeted ? 2 : 5,  // Fail fast on known APs
         },
     };
 
     strcpy((char*)wifi_config.sta.ssid, ssid);
-    strcpy((char*)wifi_config.sta.password, password);
+    strcpy((char*)wifi_config.sta.password, cand->password);
 
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
+    if (targeted) {
+        memcpy(wifi_config.sta.bssid, cand->bssid, sizeof(wifi_config.sta.bssid));
+        wifi_config.sta.bssid_set = true;
+        wifi_config.sta.channel = cand->channel;
+    }
 
-    // Set protocol
-    if (is_lr) {
-        ESP_ERROR_CHECK(esp_wifi_set_protocol(WIFI_IF_STA, WIFI_PROTOCOL_LR));
-        ESP_LOGI(TAG, "WiFi protocol set to LR (Long Range) mode");
-    } else {
-        ESP_ERROR_CHECK(esp_wifi_set_protocol(WIFI_IF_STA,
-            WIFI_PROTOCOL_11B | WIFI_PROTOCOL_11G | WIFI_PROTOCOL_11N));
-        ESP_LOGI(TAG, "WiFi protocol set to 802.11 BGN mode");
+    uint8_t protocol = is_lr ? WIFI_PROTOCOL_LR :
+                       WIFI_PROTOCOL_11B | WIFI_PROTOCOL_11G | WIFI_PROTOCOL_11N;
+    if (driver_configure(&wifi_config, protocol) != ESP_OK) {
+        return ESP_FAIL;
     }
+    ESP_LOGI(TAG, "WiFi protocol set to %s", is_lr ? "LR (Long Range) mode" : "802.11 BGN mode");
+
+    static_ip_active = apply_static_ip(fast);
 
-    // === START WIFI FIRST ===
-    ESP_ERROR_CHECK(esp_wifi_start());
-    ESP_LOGI(TAG, "WiFi started");
+    if (driver_start() != ESP_OK) {
+        return ESP_FAIL;
+    }
 
-    // === NOW SET THE RESILIENCE PARAMETERS AFTER WIFI IS STARTED ===
     // Set maximum TX power for better range (normal mode only)
     esp_err_t err;
     if (!is_lr) {
         err = esp_wifi_set_max_tx_power(84);  // 84 = 21dBm (max for ESP32-C3)
-        if (err == ESP_OK) {
-            ESP_LOGI(TAG, "Set WiFi TX power to maximum (21dBm)");
-        } else {
+        if (err != ESP_OK) {
             ESP_LOGW(TAG, "Failed to set TX power: %s", esp_err_to_name(err));
         }
     }
 
-    // CRITICAL: Disable power save for LR mode stability
-    esp_err_t ps_ret = esp_wifi_set_ps(WIFI_PS_NONE);
-    ESP_LOGI(TAG, "WiFi power save disabled: %s", esp_err_to_name(ps_ret));
-
-    // Small delay before connect
-    vTaskDelay(pdMS_TO_TICKS(100));
+    // CRITICAL: Disable power save while connecting (LR stability); the
+    // runtime PM re-enables modem sleep once the device goes idle
+    esp_wifi_set_ps(WIFI_PS_NONE);
 
-    // Manually connect
-    ESP_LOGI(TAG, "Calling esp_wifi_connect()...");
+    // A late disconnect from the previous attempt must not end this one
+    xEventGroupClearBits(wifi_event_group, FAIL_BIT);
+    set_state(WIFI_STATE_CONNECTING);
+    int64_t assoc_start_us = esp_timer_get_time();
     err = esp_wifi_connect();
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "esp_wifi_connect failed: %s", esp_err_to_name(err));
+        set_state(WIFI_STATE_DISCONNECTED);
         return ESP_FAIL;
     }
 
-    // Wait for connection OR timeout
-    ESP_LOGI(TAG, "Waiting for connection...");
-    EventBits_t bits = xEventGroupWaitBits(wifi_event_group,
-        CONNECTED_BIT,
-        pdFALSE,
-        pdFALSE,
-        pdMS_TO_TICKS(timeout_sec * 1000));
-
-    if (bits & CONNECTED_BIT) {
-        ESP_LOGI(TAG, "✓ Connected successfully in %s mode", is_lr ? "LR" : "Normal");
-        power_set_wifi_info(is_lr, ssid);
-
-        // Give DHCP extra time to get IP
-        ESP_LOGI(TAG, "Waiting for DHCP IP address...");
-        vTaskDelay(pdMS_TO_TICKS(3000));
-
-        // Check if we have an IP
-        esp_netif_t *netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
-        esp_netif_ip_info_t ip_info;
-        if (netif && esp_netif_get_ip_info(netif, &ip_info) == ESP_OK) {
-            char ip_str[16];
-            esp_ip4addr_ntoa(&ip_info.ip, ip_str, sizeof(ip_str));
-            if (strcmp(ip_str, "0.0.0.0") != 0) {
-                ESP_LOGI(TAG, "Got IP: %s", ip_str);
-                strcpy(current_ip, ip_str);
-            } else {
-                ESP_LOGW(TAG, "Connected but no IP yet - proceeding anyway");
-                strcpy(current_ip, "Waiting for IP");
+    // Attempts on a located AP give up on the first disconnect so the next
+    // candidate starts immediately
+    err = wait_transition(CONNECTED_BIT, timeout_ms, targeted);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "✗ %s mode connection failed (%s)", is_lr ? "LR" : "Normal",
+                 err == ESP_ERR_TIMEOUT ? "timeout" : "disconnected");
+        mode_history_record(is_lr, false);
+        set_state(WIFI_STATE_DISCONNECTED);
+        return ESP_FAIL;
+    }
+
+    latency_record(WIFI_STEP_ASSOC, assoc_start_us);
+    mode_history_record(is_lr, true);
+
+    ESP_LOGI(TAG, "✓ Connected successfully in %s mode", is_lr ? "LR" : "Normal");
+    power_set_wifi_info(is_lr, ssid);
+    rtc_wifi_cache.is_lr = is_lr;
+    rtc_wifi_cache.magic = WIFI_CACHE_MAGIC;
+
+    if (static_ip_active) {
+        ESP_LOGI(TAG, "Using static IP: %s", current_ip);
+    } else {
+        // Proceed as soon as DHCP completes rather than after a fixed delay
+        set_state(WIFI_STATE_GETTING_IP);
+        int64_t dhcp_start_us = esp_timer_get_time();
+        xEventGroupClearBits(wifi_event_group, FAIL_BIT);
+
+        err = wait_transition(GOT_IP_BIT, WIFI_DHCP_TIMEOUT_MS, true);
+        if (err == ESP_OK) {
+            latency_record(WIFI_STEP_DHCP, dhcp_start_us);
+            esp_netif_dns_info_t dns;
+            if (esp_netif_get_dns_info(sta_netif, ESP_NETIF_DNS_MAIN, &dns) == ESP_OK) {
+                rtc_wifi_cache.dns = dns.ip.u_addr.ip4.addr;
             }
+        } else if (err == ESP_FAIL) {
+            ESP_LOGW(TAG, "Link dropped while waiting for DHCP");
+            set_state(WIFI_STATE_DISCONNECTED);
+            return ESP_FAIL;
+        } else {
+            ESP_LOGW(TAG, "Connected but no IP yet - proceeding anyway");
+            strcpy(current_ip, "Waiting for IP");
         }
+    }
 
-        return ESP_OK;
+    set_state(WIFI_STATE_CONNECTED);
+    ESP_LOGI(TAG, "WiFi ready in %" PRId64 " ms", (esp_timer_get_time() - start_us) / 1000);
+
+    wifi_ap_record_t ap_info;
+    if (esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK) {
+        telemetry_record(TELEM_RSSI_DBM, ap_info.rssi);
     }
+    return ESP_OK;
+}
 
-    ESP_LOGW(TAG, "✗ %s mode connection failed", is_lr ? "LR" : "Normal");
-    return ESP_FAIL;
+static void candidate_init(wifi_candidate_t *cand, bool is_lr) {
+    memset(cand, 0, sizeof(*cand));
+    cand->is_lr = is_lr;
+    cand->ssid = is_lr ? WIFI_LR_SSID : WIFI_SSID;
+    cand->password = is_lr ? WIFI_LR_PASSWORD : WIFI_PASSWORD;
+}
+
+static uint32_t candidate_timeout_ms(const wifi_candidate_t *cand) {
+    return cand->is_lr ? WIFI_LR_CONNECT_TIMEOUT_SEC * 1000 : WIFI_CONNECT_TIMEOUT_SEC * 1000;
+}
+
+// One active scan with LR and BGN enabled finds both networks at once.
+// Fills out[] with the SSIDs that were seen, best first. Returns the count,
+// or -1 if the scan itself failed.
+static int scan_candidates(wifi_candidate_t *out) {
+    if (driver_configure(NULL, WIFI_PROTOCOL_11B | WIFI_PROTOCOL_11G |
+                               WIFI_PROTOCOL_11N | WIFI_PROTOCOL_LR) != ESP_OK ||
+        driver_start() != ESP_OK) {
+        return -1;
+    }
+
+    wifi_scan_config_t scan_config = {
+        .ssid = NULL,
+        .show_hidden = false,
+        .scan_type = WIFI_SCAN_TYPE_ACTIVE,
+        .scan_time.active = {
+            .min = WIFI_SCAN_CHANNEL_MIN_MS,
+            .max = WIFI_SCAN_CHANNEL_MAX_MS
+        }
+    };
+
+    set_state(WIFI_STATE_SCANNING);
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t err = esp_wifi_scan_start(&scan_config, false);
+    if (err == ESP_OK) {
+        err = wait_transition(SCAN_DONE_BIT, WIFI_SCAN_TIMEOUT_MS, false);
+        if (err != ESP_OK) {
+            esp_wifi_scan_stop();
+        }
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Scan failed: %s", esp_err_to_name(err));
+        set_state(WIFI_STATE_DISCONNECTED);
+        return -1;
+    }
+    latency_record(WIFI_STEP_SCAN, start_us);
+
+    uint16_t ap_count = WIFI_SCAN_MAX_RECORDS;
+    wifi_ap_record_t *records = calloc(ap_count, sizeof(wifi_ap_record_t));
+    if (!records) {
+        esp_wifi_clear_ap_list();
+        return -1;
+    }
+    esp_wifi_scan_get_ap_records(&ap_count, records);
+
+    wifi_candidate_t found[2];
+    candidate_init(&found[WIFI_MODE_NORMAL], false);
+    candidate_init(&found[WIFI_MODE_LR], true);
+
+    for (int i = 0; i < ap_count; i++) {
+        for (int m = 0; m < 2; m++) {
+            wifi_candidate_t *cand = &found[m];
+            if (m == WIFI_MODE_LR && !WIFI_LR_ENABLED) {
+                continue;
+            }
+            if (strcmp((const char *)records[i].ssid, cand->ssid) != 0) {
+                continue;
+            }
+            if (cand->channel == 0 || records[i].rssi > cand->rssi) {
+                memcpy(cand->bssid, records[i].bssid, sizeof(cand->bssid));
+                cand->channel = records[i].primary;
+                cand->rssi = records[i].rssi;
+            }
+        }
+    }
+    free(records);
+
+    ESP_LOGI(TAG, "Scan: %u APs", ap_count);
+
+    // Rank by signal, nudged by how each mode has fared on recent wakes
+    int count = 0;
+    for (int m = 0; m < 2; m++) {
+        wifi_candidate_t *cand = &found[m];
+        if (cand->channel == 0) {
+            continue;
+        }
+        cand->score = cand->rssi + WIFI_HISTORY_WEIGHT_DB * mode_history_balance(cand->is_lr);
+        ESP_LOGI(TAG, "  %s '%s': %d dBm, ch %d, history %+d -> score %d",
+                 cand->is_lr ? "LR" : "Normal", cand->ssid, cand->rssi, cand->channel,
+                 mode_history_balance(cand->is_lr), cand->score);
+        out[count++] = *cand;
+    }
+
+    if (count == 2 && out[1].score > out[0].score) {
+        wifi_candidate_t tmp = out[0];
+        out[0] = out[1];
+        out[1] = tmp;
+    }
+    return count;
 }
 
 esp_err_t wifi_manager_init(void) {
@@ -188,7 +603,7 @@ esp_err_t wifi_manager_init(void) {
     
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
-    esp_netif_create_default_wifi_sta();
+    sta_netif = esp_netif_create_default_wifi_sta();
     
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
@@ -204,6 +619,8 @@ esp_err_t wifi_manager_init(void) {
                                               &wifi_event_handler, NULL));
     
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
+
+    reconnect_event = event_sched_create("wifi_reconn", reconnect_timeout_handler, NULL, 0);
     
     wifi_initialized = true;
     ESP_LOGI(TAG, "WiFi manager initialized");
@@ -212,44 +629,81 @@ esp_err_t wifi_manager_init(void) {
 
 esp_err_t wifi_manager_connect(void) {
     ESP_LOGI(TAG, "=== Starting WiFi Connection Sequence ===");
-    current_state = WIFI_STATE_CONNECTING;
-    is_connecting = true;
-
-    // Always try LR first if enabled
-    if (WIFI_LR_ENABLED) {
-        ESP_LOGI(TAG, "Step 1: Trying ESP-LR connection");
-        if (try_wifi_mode(WIFI_LR_SSID, WIFI_LR_PASSWORD, true,
-                         WIFI_LR_CONNECT_TIMEOUT_SEC) == ESP_OK) {
-            ESP_LOGI(TAG, "=== WiFi Connected (LR mode) ===");
-            is_connecting = false;  // Clear flag on success
+
+    // Known network: go straight to the AP we used last time
+    if (WIFI_FAST_RECONNECT && cache_valid() &&
+        (!rtc_wifi_cache.is_lr || WIFI_LR_ENABLED)) {
+        wifi_candidate_t cached;
+        candidate_init(&cached, rtc_wifi_cache.is_lr);
+        memcpy(cached.bssid, rtc_wifi_cache.bssid, sizeof(cached.bssid));
+        cached.channel = rtc_wifi_cache.channel;
+
+        ESP_LOGI(TAG, "Step 0: Trying cached AP " MACSTR " on channel %d",
+                 MAC2STR(rtc_wifi_cache.bssid), rtc_wifi_cache.channel);
+        if (try_wifi_mode(&cached, WIFI_FAST_CONNECT_TIMEOUT_MS, true) == ESP_OK) {
+            ESP_LOGI(TAG, "=== WiFi Connected (%s mode, cached AP) ===",
+                     cached.is_lr ? "LR" : "Normal");
             return ESP_OK;
         }
+        ESP_LOGW(TAG, "Cached AP unavailable - falling back to scan");
+        rtc_wifi_cache.magic = 0;
     }
 
-    // Fall back to normal WiFi
-    ESP_LOGI(TAG, "Step 2: Trying Normal WiFi connection");
-    if (try_wifi_mode(WIFI_SSID, WIFI_PASSWORD, false,
-                     WIFI_CONNECT_TIMEOUT_SEC) == ESP_OK) {
-        ESP_LOGI(TAG, "=== WiFi Connected (Normal mode) ===");
-        is_connecting = false;  // Clear flag on success
-        return ESP_OK;
+    // One scan finds whichever networks are in range
+    ESP_LOGI(TAG, "Step 1: Scanning for %s%s%s", WIFI_SSID,
+             WIFI_LR_ENABLED ? " / " : "", WIFI_LR_ENABLED ? WIFI_LR_SSID : "");
+    wifi_candidate_t candidates[2];
+    int count = scan_candidates(candidates);
+
+    if (count < 0) {
+        // Scan unavailable - blind attempts, most successful mode first
+        bool lr_first = WIFI_LR_ENABLED &&
+                        mode_history_balance(true) >= mode_history_balance(false);
+        count = 0;
+        if (lr_first) {
+            candidate_init(&candidates[count++], true);
+        }
+        candidate_init(&candidates[count++], false);
+        if (WIFI_LR_ENABLED && !lr_first) {
+            candidate_init(&candidates[count++], true);
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        ESP_LOGI(TAG, "Step %d: Trying %s WiFi", i + 2, candidates[i].is_lr ? "ESP-LR" : "Normal");
+        if (try_wifi_mode(&candidates[i], candidate_timeout_ms(&candidates[i]), false) == ESP_OK) {
+            ESP_LOGI(TAG, "=== WiFi Connected (%s mode) ===", candidates[i].is_lr ? "LR" : "Normal");
+            return ESP_OK;
+        }
+    }
+
+    if (count == 0) {
+        ESP_LOGW(TAG, "No configured network in range");
+        mode_history_record(false, false);
+        if (WIFI_LR_ENABLED) {
+            mode_history_record(true, false);
+        }
     }
 
     ESP_LOGE(TAG, "=== All WiFi connection attempts failed ===");
-    current_state = WIFI_STATE_DISCONNECTED;
-    is_connecting = false;  // Clear flag on failure
+    if (wifi_started) {
+        esp_wifi_stop();  // Radio off - nothing left to try this wake
+        wifi_started = false;
+    }
+    set_state(WIFI_STATE_DISCONNECTED);
     return ESP_FAIL;
 }
 
 void wifi_manager_disconnect_handler(void) {
-    static bool handling_disconnect = false;
-
-    // Prevent recursive calls
-    if (handling_disconnect || is_connecting) {
+    // Only a session that was up can be lost; the connect sequence
+    // reports its own failures
+    wifi_state_t prev = set_state(WIFI_STATE_DISCONNECTED);
+    if (prev != WIFI_STATE_CONNECTED && prev != WIFI_STATE_RECONNECTING) {
         return;
     }
 
-    handling_disconnect = true;
+    event_sched_cancel(reconnect_event);
+    power_history_set_outcome(HISTORY_OUTCOME_WIFI_LOST);
 
     ESP_LOGW(TAG, "");
     ESP_LOGW(TAG, "╔════════════════════════════════════════════════════════════╗");
@@ -264,11 +718,10 @@ void wifi_manager_disconnect_handler(void) {
 
     // Stop WiFi cleanly
     esp_wifi_stop();
+    wifi_started = false;
+    strcpy(current_ip, "Not connected");
     ESP_LOGI(TAG, "WiFi stopped");
 
-    // Give a short delay for cleanup
-    vTaskDelay(pdMS_TO_TICKS(1000));
-
     // Check battery one more time before sleep
     battery_status_t battery;
     power_get_battery_status(&battery);
@@ -292,7 +745,27 @@ void wifi_manager_disconnect_handler(void) {
 }
 
 bool wifi_manager_is_connected(void) {
-    return current_state == WIFI_STATE_CONNECTED;
+    return get_state() == WIFI_STATE_CONNECTED;
+}
+
+wifi_state_t wifi_manager_get_state(void) {
+    return get_state();
+}
+
+const char* wifi_manager_state_name(wifi_state_t state) {
+    return state <= WIFI_STATE_RECONNECTING ? state_names[state] : "UNKNOWN";
+}
+
+bool wifi_manager_get_latency(wifi_step_t step, phase_stats_t *stats) {
+    if (step >= WIFI_STEP_COUNT || !stats || rtc_latency.magic != WIFI_LATENCY_MAGIC) {
+        return false;
+    }
+    *stats = rtc_latency.steps[step];
+    return true;
+}
+
+const char* wifi_manager_step_name(wifi_step_t step) {
+    return step < WIFI_STEP_COUNT ? step_names[step] : "unknown";
 }
 
 const char* wifi_manager_get_ip(void) {
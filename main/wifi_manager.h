@@ -2,20 +2,41 @@
 #define WIFI_MANAGER_H
 
 #include "esp_err.h"
+#include "phase_timer.h"
 #include <stdbool.h>
 
+// Connection state machine, driven by WIFI_EVENT / IP_EVENT
 typedef enum {
     WIFI_STATE_DISCONNECTED,
-    WIFI_STATE_CONNECTING,
-    WIFI_STATE_CONNECTED
+    WIFI_STATE_STARTING,        // Driver (re)starting with a new config
+    WIFI_STATE_SCANNING,
+    WIFI_STATE_CONNECTING,      // Auth + association + key handshake
+    WIFI_STATE_GETTING_IP,
+    WIFI_STATE_CONNECTED,
+    WIFI_STATE_RECONNECTING     // Link lost in session, web server kept up
 } wifi_state_t;
 
+// Timed transitions (rolling stats kept in RTC memory)
+typedef enum {
+    WIFI_STEP_START = 0,
+    WIFI_STEP_SCAN,
+    WIFI_STEP_ASSOC,            // IDF reports auth and assoc as one event
+    WIFI_STEP_DHCP,
+    WIFI_STEP_RECONNECT,        // Link lost to IP back
+    WIFI_STEP_COUNT
+} wifi_step_t;
+
 // WiFi manager initialization and control
 esp_err_t wifi_manager_init(void);
 esp_err_t wifi_manager_connect(void);
 void wifi_manager_disconnect_handler(void);
 bool wifi_manager_is_connected(void);
 const char* wifi_manager_get_ip(void);
+wifi_state_t wifi_manager_get_state(void);
+const char* wifi_manager_state_name(wifi_state_t state);
+
+bool wifi_manager_get_latency(wifi_step_t step, phase_stats_t *stats);
+const char* wifi_manager_step_name(wifi_step_t step);
 
 // External function from main.c for web server cleanup during disconnect
 // Note: This creates an explicit dependency on main.c's stop_webserver()
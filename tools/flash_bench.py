@@ -0,0 +1,255 @@
+#!/usr/bin/env python3
+"""
+End-to-end flashing benchmark against a running flasher.
+
+Uploads every image in a corpus directory through /upload and records the
+per-phase breakdown the firmware returns (receive, parse, assemble, erase,
+program, finish: ms, bytes, KB/s, SWD transfers, modelled target time).
+Point it at a C3 built with SWD_SIM_ENABLE for repeatable numbers without
+a radio; against real hardware model_ms is reported as 0.
+
+The firmware takes Intel HEX only, so .bin and .uf2 images are converted
+here first: UF2 blocks carry their own addresses, a .bin is placed at the
+address in its name (name@0x26000.bin) or at --bin-base.
+
+With --sink, every image is also posted to /sink, which receives and
+discards the body on the same path as /upload; its MB/s is the network
+ceiling for the link the C3 is on (run once in LR and once in normal mode).
+
+With --host-binary, the script starts the host build of the firmware
+(README, "Host build") on a free local port with a fresh data directory,
+runs the corpus against it and stops it afterwards: the same handlers and
+simulator timing model, without a C3. Phase timings then reflect the host
+CPU, so compare them only against baselines taken the same way.
+
+Results are JSON lines, one per run. With --baseline, the median of each
+image/phase is compared against an earlier results file and the script
+exits non-zero when a phase got slower by more than --max-regress percent.
+
+    python3 tools/flash_bench.py --host 192.168.4.1 --corpus images/ \\
+        --runs 3 --out results.jsonl --baseline baseline.jsonl
+
+    python3 tools/flash_bench.py --host-binary build-host/flasher_host \\
+        --corpus images/ --runs 3 --sink
+"""
+
+import argparse
+import json
+import os
+import re
+import shutil
+import socket
+import statistics
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+import urllib.request
+
+UF2_MAGIC_START0 = 0x0A324655
+UF2_MAGIC_START1 = 0x9E5D5157
+UF2_MAGIC_END = 0x0AB16F30
+UF2_FLAG_NOT_MAIN_FLASH = 0x00000001
+
+PHASES = ("receive", "parse", "assemble", "erase", "program", "finish")
+
+
+def ihex_record(rec_type, addr, data):
+    body = bytes([len(data), (addr >> 8) & 0xFF, addr & 0xFF, rec_type]) + data
+    checksum = (-sum(body)) & 0xFF
+    return ":" + (body + bytes([checksum])).hex().upper() + "\n"
+
+
+def to_ihex(segments):
+    """Intel HEX text for a list of (address, bytes) segments"""
+    out = []
+    upper = None
+    for base, data in sorted(segments):
+        for offset in range(0, len(data), 16):
+            addr = base + offset
+            if addr >> 16 != upper:
+                upper = addr >> 16
+                out.append(ihex_record(0x04, 0, struct.pack(">H", upper)))
+            out.append(ihex_record(0x00, addr & 0xFFFF, data[offset:offset + 16]))
+    out.append(ihex_record(0x01, 0, b""))
+    return "".join(out).encode()
+
+
+def uf2_segments(blob):
+    segments = []
+    for pos in range(0, len(blob) - 511, 512):
+        (start0, start1, flags, addr, size, _block, _count, _family) = \
+            struct.unpack_from("<8I", blob, pos)
+        end, = struct.unpack_from("<I", blob, pos + 508)
+        if start0 != UF2_MAGIC_START0 or start1 != UF2_MAGIC_START1 or end != UF2_MAGIC_END:
+            raise ValueError("bad UF2 block at offset %d" % pos)
+        if flags & UF2_FLAG_NOT_MAIN_FLASH:
+            continue
+        segments.append((addr, blob[pos + 32:pos + 32 + size]))
+    return segments
+
+
+def load_image(path, bin_base):
+    with open(path, "rb") as f:
+        blob = f.read()
+    ext = os.path.splitext(path)[1].lower()
+    if ext in (".hex", ".ihex"):
+        return blob
+    if ext == ".uf2":
+        return to_ihex(uf2_segments(blob))
+    if ext == ".bin":
+        match = re.search(r"@(0x[0-9a-fA-F]+)", os.path.basename(path))
+        base = int(match.group(1), 16) if match else bin_base
+        return to_ihex([(base, blob)])
+    return None
+
+
+def upload(host, payload, timeout, path="/upload"):
+    req = urllib.request.Request("http://%s%s" % (host, path), data=payload, method="POST",
+                                 headers={"Content-Type": "application/octet-stream"})
+    start = time.monotonic()
+    with urllib.request.urlopen(req, timeout=timeout) as resp:
+        body = json.loads(resp.read().decode())
+    body["client_ms"] = round((time.monotonic() - start) * 1000, 1)
+    return body
+
+
+def wait_ready(host, timeout):
+    """Wait for the server to accept connections (startup, or a failsafe reboot)"""
+    name, _, port = host.partition(":")
+    deadline = time.monotonic() + timeout
+    while True:
+        try:
+            socket.create_connection((name, int(port or 80)), timeout=1).close()
+            return
+        except OSError:
+            if time.monotonic() > deadline:
+                raise
+            time.sleep(0.2)
+
+
+def start_host(binary, battery_mv):
+    """Run the host build on a free port; returns (process, host, data dir)"""
+    with socket.socket() as s:
+        s.bind(("127.0.0.1", 0))
+        port = s.getsockname()[1]
+    data_dir = tempfile.mkdtemp(prefix="flasher_host_")
+    proc = subprocess.Popen([os.path.abspath(binary), "--port", str(port), "--data", data_dir,
+                             "--battery-mv", str(battery_mv)],
+                            stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    host = "127.0.0.1:%d" % port
+    try:
+        wait_ready(host, 30)
+    except OSError:
+        proc.kill()
+        shutil.rmtree(data_dir, ignore_errors=True)
+        raise
+    return proc, host, data_dir
+
+
+def stop_host(proc, data_dir):
+    proc.terminate()
+    try:
+        proc.wait(timeout=5)
+    except subprocess.TimeoutExpired:
+        proc.kill()
+        proc.wait()
+    shutil.rmtree(data_dir, ignore_errors=True)
+
+
+def medians(results):
+    """{(image, phase): (median kb_s, median model_ms)} plus the totals"""
+    grouped = {}
+    for r in results:
+        if not r.get("success") or r.get("endpoint", "upload") != "upload":
+            continue
+        for phase in PHASES + ("total",):
+            p = r["phases"].get(phase) if phase != "total" else \
+                {"kb_s": r["bytes"] / 1.024 / max(r["total_ms"], 0.001),
+                 "model_ms": sum(v["model_ms"] for v in r["phases"].values())}
+            if p:
+                grouped.setdefault((r["image"], phase), []).append(p)
+    return {key: (statistics.median(p["kb_s"] for p in ps),
+                  statistics.median(p["model_ms"] for p in ps))
+            for key, ps in grouped.items()}
+
+
+def compare(results, baseline_path, max_regress):
+    with open(baseline_path) as f:
+        baseline = medians(json.loads(line) for line in f if line.strip())
+    current = medians(results)
+    regressions = 0
+    for key in sorted(current):
+        if key not in baseline:
+            continue
+        (kb_s, model_ms), (base_kb_s, base_model_ms) = current[key], baseline[key]
+        if base_kb_s <= 0:
+            continue
+        delta = (kb_s - base_kb_s) * 100.0 / base_kb_s
+        flag = ""
+        if delta < -max_regress:
+            flag = "  REGRESSION"
+            regressions += 1
+        print("%-32s %-9s %9.1f KB/s (%+6.1f%%)  model %9.1f ms (base %9.1f)%s"
+              % (key[0], key[1], kb_s, delta, model_ms, base_model_ms, flag), file=sys.stderr)
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("--host", default="192.168.4.1")
+    parser.add_argument("--corpus", required=True, help="directory of .hex/.bin/.uf2 images")
+    parser.add_argument("--runs", type=int, default=1)
+    parser.add_argument("--bin-base", type=lambda v: int(v, 0), default=0x26000,
+                        help="load address for .bin images without @0x... in the name")
+    parser.add_argument("--timeout", type=float, default=600)
+    parser.add_argument("--out", help="append JSON lines here (default: stdout)")
+    parser.add_argument("--baseline", help="earlier results to compare against")
+    parser.add_argument("--max-regress", type=float, default=5.0, help="percent")
+    parser.add_argument("--sink", action="store_true", help="also measure raw ingest on /sink")
+    parser.add_argument("--sink-buf", type=int, default=1024, help="/sink recv buffer size")
+    parser.add_argument("--host-binary", help="start this host build and benchmark it instead of --host")
+    parser.add_argument("--battery-mv", type=int, default=4000,
+                        help="battery voltage the host build reports")
+    args = parser.parse_args()
+
+    if args.host_binary:
+        proc, args.host, data_dir = start_host(args.host_binary, args.battery_mv)
+        try:
+            return run(args)
+        finally:
+            stop_host(proc, data_dir)
+    return run(args)
+
+
+def run(args):
+    out = open(args.out, "a") if args.out else sys.stdout
+    results = []
+    for name in sorted(os.listdir(args.corpus)):
+        payload = load_image(os.path.join(args.corpus, name), args.bin_base)
+        if payload is None:
+            continue
+        endpoints = [("upload", "/upload")]
+        if args.sink:
+            endpoints.append(("sink", "/sink?buf=%d" % args.sink_buf))
+        for run in range(args.runs):
+            for endpoint, path in endpoints:
+                try:
+                    wait_ready(args.host, 30)
+                    result = upload(args.host, payload, args.timeout, path)
+                except Exception as e:  # One bad image should not end the suite
+                    result = {"success": False, "message": str(e)}
+                result.update({"image": name, "run": run, "endpoint": endpoint,
+                               "upload_bytes": len(payload), "time": int(time.time())})
+                results.append(result)
+                out.write(json.dumps(result, sort_keys=True) + "\n")
+                out.flush()
+
+    if args.baseline:
+        return 1 if compare(results, args.baseline, args.max_regress) else 0
+    return 0 if all(r.get("success") for r in results) else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())